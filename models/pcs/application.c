@@ -90,6 +90,7 @@ void ProcessEvent(unsigned int me, simtime_t now, int event_type, event_content_
 	//printf("%d executing %d at %f\n", me, event_type, now);
 
 	event_content_type new_event_content;
+	event_content_type *handoff;
 
 	new_event_content.cell = -1;
 	new_event_content.channel = -1;
@@ -237,10 +238,14 @@ void ProcessEvent(unsigned int me, simtime_t now, int event_type, event_content_
 			state->leaving_handoffs++;
 			deallocation(me, state, event_content->channel, now);
 
-			new_event_content.call_term_time =  event_content->call_term_time;
-			new_event_content.from = me;
-			new_event_content.dummy = &(state->dummy);
-			ScheduleNewEvent(event_content->cell, now, HANDOFF_RECV, &new_event_content, sizeof(new_event_content));
+			// The handoff is built in place, without copying it
+			handoff = AllocEvent(event_content->cell, now, HANDOFF_RECV, sizeof(*handoff));
+			handoff->cell = -1;
+			handoff->channel = -1;
+			handoff->call_term_time = event_content->call_term_time;
+			handoff->from = me;
+			handoff->dummy = &(state->dummy);
+			CommitEvent(handoff);
 			break;
 
 		case HANDOFF_RECV:
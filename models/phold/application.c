@@ -15,7 +15,8 @@ enum{
 	OPT_WC,
 	OPT_WD,
 	OPT_RD,
-	OPT_TAU
+	OPT_TAU,
+	OPT_PU
 };
 
 const struct argp_option model_options[] = {
@@ -30,6 +31,7 @@ const struct argp_option model_options[] = {
 		{"write-distribution", 		OPT_WD, "DOUBLE", 0, NULL, 0},
 		{"read-distribution", 		OPT_RD, "DOUBLE", 0, NULL, 0},
 		{"tau", 					OPT_TAU, "DOUBLE", 0, NULL, 0},
+		{"print-until",				OPT_PU, "DOUBLE", 0, NULL, 0},
 		{0}
 };
 
@@ -56,6 +58,7 @@ static error_t model_parse(int key, char *arg, struct argp_state *state) {
 		HANDLE_ARGP_CASE(OPT_WD, 	"%lf", 	write_distribution);
 		HANDLE_ARGP_CASE(OPT_RD, 	"%lf", 	read_distribution);
 		HANDLE_ARGP_CASE(OPT_TAU, 	"%lf", 	tau);
+		HANDLE_ARGP_CASE(OPT_PU, 	"%lf", 	print_until);
 
 		case ARGP_KEY_SUCCESS:
 			printf("\t* ROOT-Sim's PHOLD Benchmark - Current Configuration *\n");
@@ -83,6 +86,11 @@ static error_t model_parse(int key, char *arg, struct argp_state *state) {
 struct _topology_settings_t topology_settings = {.type = TOPOLOGY_OBSTACLES, .default_geometry = TOPOLOGY_GRAPH, .write_enabled = false};
 struct argp model_argp = {model_options, model_parse, NULL, NULL, NULL, NULL, NULL};
 
+// When built with -DSHARED_STACK_SIZE=<bytes>, LPs share stacks of that size: they keep nothing on the stack across events
+#ifdef SHARED_STACK_SIZE
+struct _stack_settings_t stack_settings = {.stack_size = SHARED_STACK_SIZE, .shared = true};
+#endif
+
 // These global variables are used to store execution configuration values
 // They are initialised to some default values but then the initialization could change those
 int	object_total_size = OBJECT_TOTAL_SIZE,
@@ -95,7 +103,8 @@ int	object_total_size = OBJECT_TOTAL_SIZE,
 unsigned int complete_alloc = COMPLETE_ALLOC;
 double	write_distribution = WRITE_DISTRIBUTION,
 	read_distribution = READ_DISTRIBUTION,
-	tau = TAU;
+	tau = TAU,
+	print_until = 0;
 
 
 void ProcessEvent(int me, simtime_t now, int event_type, event_content_type *event_content, unsigned int size, void *state) {
@@ -223,6 +232,9 @@ void ProcessEvent(int me, simtime_t now, int event_type, event_content_type *eve
 				j = i;
 			}
 			state_ptr->events++;
+			// Trace the events, so that runs can be compared with each other
+			if(now < print_until)
+				CommitPrintf("LP %d: LOOP event at %f\n", me, now);
 			timestamp = now + (simtime_t)(Expent(TAU));
 			ScheduleNewEvent(me, timestamp, LOOP, NULL, 0);
 			if(Random() < 0.2)
@@ -76,5 +76,6 @@ extern unsigned int
 		complete_alloc;
 extern double	write_distribution,
 		read_distribution,
-		tau;
+		tau,
+		print_until;
 
@@ -80,8 +80,8 @@ function do_test() {
 
 function do_test_custom() {
 
-        # Compile and store the name of the test suite
-        rootsim-cc models/$1/*.c -o model
+        # Compile and store the name of the test suite, with the compiler flags in MODEL_CFLAGS
+        rootsim-cc $MODEL_CFLAGS models/$1/*.c -o model
         tests+=("$1-cust")
 
         # Run this model using MPI
@@ -121,10 +121,88 @@ function do_test_custom() {
         fi
 }
 
+function do_test_shm() {
+
+	# Compile and store the name of the test suite
+	rootsim-cc models/$1/*.c -o model
+	tests+=("$1-shm")
+
+	# Run this model on kernels forked by the shared-memory transport, without mpiexec
+	echo -n "Running test $1-shm using the shared-memory transport... "
+	./model --transport shm --kernels 2 --wt 2 ${@:2} --no-core-binding > /dev/null
+	if test $? -eq 0; then
+		mpi+=('Y')
+		echo "passed."
+	else
+		mpi+=('N')
+		retval=1
+		echo "failed."
+	fi
+
+	# Only multiple kernels are of interest here
+	normal+=('-')
+	sequential+=('-')
+}
+
+function do_test_output() {
+
+	# Compile and store the name of the test suite
+	rootsim-cc models/$1/*.c -o model
+	tests+=("$1-out")
+
+	# The sequential run is the reference: the committed output of the
+	# other runs must match it, regardless of rollbacks
+	echo -n "Running test $1-out sequentially... "
+	./model --sequential ${@:2} | grep -o "LP [0-9]*: .*" | sort > output.seq
+	if test ${PIPESTATUS[0]} -eq 0 && test -s output.seq; then
+		sequential+=('Y')
+		echo "passed."
+	else
+		sequential+=('N')
+		retval=1
+		echo "failed."
+	fi
+
+	# Run this model using only worker threads
+	echo -n "Running test $1-out using parallel simulator... "
+	./model --wt 2 ${@:2} | grep -o "LP [0-9]*: .*" | sort > output.par
+	if test ${PIPESTATUS[0]} -eq 0 && cmp -s output.seq output.par; then
+		normal+=('Y')
+		echo "passed."
+	else
+		normal+=('N')
+		retval=1
+		echo "failed."
+	fi
+
+	# Run this model using MPI. Each kernel writes to its own file, as the
+	# output of different kernels could be interleaved within lines.
+	# Committed output is written unbuffered, so the files are complete
+	# even if mpiexec has to be killed by the timeout while the kernels
+	# shut down: the outcome is decided by the output alone
+	echo -n "Running test $1-out using MPI... "
+	timeout 120 mpiexec --np 2 sh -c "./model --wt 2 ${*:2} --no-core-binding > output.mpi.\$\$"
+	ret=$?
+	if test $ret -eq 0 || test $ret -eq 124; then
+		cat output.mpi.* | grep -o "LP [0-9]*: .*" | sort > output.mpi
+	fi
+	if test -f output.mpi && cmp -s output.seq output.mpi; then
+		mpi+=('Y')
+		echo "passed."
+	else
+		mpi+=('N')
+		retval=1
+		echo "failed."
+	fi
+
+	rm -f output.seq output.par output.mpi output.mpi.*
+}
+
 
 # Run available unit tests
 do_unit_test dymelor
 do_unit_test numerical
+do_unit_test partition
 
 
 # Run models to make comprehensive tests
@@ -135,6 +213,17 @@ do_test stupid_model 16
 
 # Additional tests to increase code coverage
 do_test_custom pcs --lp 16 --output-dir dummy --npwd --gvt 500 --gvt-snapshot-cycles 3 --verbose info --seed 12345 --scheduler stf --cktrm-mode normal --simulation-time 1000
+do_test_custom pcs --lp 16 --gvt 100 --gvt-mode piggyback
+do_test_custom pcs --lp 16 --gvt 100 --checkpoint-every 2
+do_test_custom packet --lp 4 --gvt 100 --comm-thread
+do_test_shm pcs --lp 16 --gvt 100
+do_test_shm pcs --lp 16 --gvt 100 --gvt-mode piggyback
+do_test_shm packet --lp 4 --gvt 100 --comm-thread
+do_test_custom phold --lp 16 --gvt 100 --migrate-every 2
+do_test_custom phold --lp 16 --gvt 100 --comm-profile 2
+do_test_custom pcs --lp 16 --gvt 100 --lp-memory-quota 256
+MODEL_CFLAGS="-DSHARED_STACK_SIZE=131072" do_test_custom phold --lp 16 --gvt 100
+do_test_output phold --lp 16 --gvt 100 --deterministic-seed --print-until 100
 
 
 
@@ -76,8 +76,24 @@ int Zipf(double skew, int limit);
 
 // ROOT-Sim core API
 extern void (*ScheduleNewEvent)(unsigned int receiver, simtime_t timestamp, unsigned int event_type, void *event_content, unsigned int event_size);
+
+// Zero-copy variant of ScheduleNewEvent(): the payload is written in the returned buffer, which is then sent by CommitEvent()
+extern void *(*AllocEvent)(unsigned int receiver, simtime_t timestamp, unsigned int event_type, unsigned int event_size);
+extern void (*CommitEvent)(void *event_content);
 extern void SetState(void *new_state);
 
+// Rollback-safe output: it is actually written only once the generating event is committed
+extern void CommitPrintf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+extern void CommitWrite(int fd, const void *buf, size_t len);
+
+/**
+ * Defining this struct in the model source code tunes the stacks which events are processed on.
+ */
+__attribute((weak)) extern struct _stack_settings_t{
+	const size_t stack_size;	/// Size in bytes of the stack of each LP, 0 for the default 4 MB
+	const bool shared;		/// Set if the LPs keep nothing on the stack across events, so that the LPs of a worker thread can share one
+} stack_settings;
+
 /*********************************/
 /********TOPOLOGY*LIBRARY*********/
 /*********************************/
@@ -58,6 +58,7 @@ inline int atomic_test_and_set(int *);
 inline void atomic_inc(atomic_t *);
 inline void atomic_dec(atomic_t *);
 inline int atomic_inc_and_test(atomic_t * v);
+inline int atomic_dec_and_test(atomic_t * v);
 inline bool spin_trylock(spinlock_t * s);
 inline void spin_unlock(spinlock_t * s);
 inline void spin_lock(spinlock_t * s);
@@ -152,3 +152,46 @@ size_t getCurrentRSS(void)
 	return (size_t)0L;			/* Unsupported. */
 #endif
 }
+
+
+
+/**
+ * This function measures how much of the anonymous memory of the process
+ * is backed by huge pages, either transparent or reserved in the system.
+ * Only Linux exposes this information.
+ *
+ * @param anon Where to store the resident anonymous memory in bytes
+ * @param huge Where to store the part of it backed by huge pages in bytes
+ */
+void getHugePagesUsage(size_t *anon, size_t *huge)
+{
+	*anon = 0;
+	*huge = 0;
+
+#if defined(__linux__) || defined(__linux) || defined(linux) || defined(__gnu_linux__)
+	char line[128];
+	size_t kb;
+	FILE* fp = NULL;
+
+	/* smaps_rollup already sums up all mappings, but older kernels lack it */
+	if ( (fp = fopen( "/proc/self/smaps_rollup", "r" )) == NULL &&
+	     (fp = fopen( "/proc/self/smaps", "r" )) == NULL )
+		return;			/* Can't open? */
+
+	while ( fgets( line, sizeof(line), fp ) != NULL )
+	{
+		if ( sscanf( line, "Anonymous: %zu kB", &kb ) == 1 )
+			*anon += kb * 1024;
+		else if ( sscanf( line, "AnonHugePages: %zu kB", &kb ) == 1 )
+			*huge += kb * 1024;
+		else if ( sscanf( line, "Private_Hugetlb: %zu kB", &kb ) == 1 ||
+			  sscanf( line, "Shared_Hugetlb: %zu kB", &kb ) == 1 )
+		{
+			/* Hugetlb pages are not accounted as anonymous memory */
+			*anon += kb * 1024;
+			*huge += kb * 1024;
+		}
+	}
+	fclose( fp );
+#endif
+}
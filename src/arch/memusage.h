@@ -35,3 +35,4 @@
 #include <string.h>
 extern size_t getCurrentRSS(void);
 extern size_t getPeakRSS(void);
+extern void getHugePagesUsage(size_t *anon, size_t *huge);
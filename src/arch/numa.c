@@ -0,0 +1,273 @@
+/**
+ * @file arch/numa.c
+ *
+ * @brief NUMA topology discovery
+ *
+ * This module discovers how CPU cores are organized into NUMA nodes,
+ * by inspecting /sys/devices/system/node. If this information is not
+ * available, all cores are considered to be part of a single node.
+ *
+ * Where the hardware exposes them, the accesses of worker threads to the
+ * memory of the local and of remote NUMA nodes are also counted, via the
+ * performance counters of the CPU.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <linux/perf_event.h>
+
+#include <arch/numa.h>
+#include <arch/thread.h>
+#include <core/init.h>
+#include <mm/mm.h>
+
+/// Where the kernel exposes the NUMA nodes, one node%u directory each
+#define NUMA_NODES_PATH "/sys/devices/system/node"
+
+/// Where the kernel exposes the CPUs belonging to each NUMA node
+#define NUMA_CPULIST_PATH NUMA_NODES_PATH "/node%u/cpulist"
+
+/// Maximum length of a line in a cpulist file
+#define CPULIST_LEN 4096
+
+/// One past the highest id of the NUMA nodes found on the machine
+static unsigned int n_numa_nodes = 1;
+
+/// Number of NUMA nodes found on the machine. Node ids need not be contiguous
+static unsigned int n_online_nodes = 1;
+
+/// Number of CPUs which have been mapped to a NUMA node
+static unsigned int n_mapped_cpus;
+
+/// NUMA node of each CPU
+static unsigned int *cpu_to_node;
+
+/// Performance counter of the loads served by DRAM, for the current thread
+static __thread int node_loads_fd = -1;
+
+/// Performance counter of the loads served by the DRAM of a remote node, for the current thread
+static __thread int node_remote_loads_fd = -1;
+
+
+/**
+ * @brief Map to a NUMA node all the CPUs in a cpulist
+ *
+ * A cpulist is a comma-separated list of CPU ids or CPU ranges,
+ * such as "0-3,8-11".
+ *
+ * @param list The cpulist to parse
+ * @param node The NUMA node the CPUs in @p list belong to
+ */
+static void parse_cpulist(char *list, unsigned int node)
+{
+	char *tok, *saveptr;
+	unsigned int first, last, cpu;
+
+	for (tok = strtok_r(list, ",\n", &saveptr); tok != NULL; tok = strtok_r(NULL, ",\n", &saveptr)) {
+		switch (sscanf(tok, "%u-%u", &first, &last)) {
+		case 1:
+			last = first;
+			break;
+		case 2:
+			break;
+		default:
+			continue;
+		}
+
+		for (cpu = first; cpu <= last && cpu < n_mapped_cpus; cpu++)
+			cpu_to_node[cpu] = node;
+	}
+}
+
+
+/**
+ * @brief Discover the NUMA topology of the machine
+ *
+ * Node ids need not be contiguous (e.g. with offline or memoryless nodes),
+ * so all the node directories exposed by the kernel are inspected.
+ * CPUs which are not listed by any node (or all CPUs, if the
+ * topology cannot be read) are mapped to node 0.
+ */
+void numa_init(void)
+{
+	char path[64];
+	char list[CPULIST_LEN];
+	unsigned int node, found = 0, highest = 0;
+	struct dirent *entry;
+	char tail;
+	DIR *dir;
+	FILE *f;
+
+	n_mapped_cpus = get_cores();
+	cpu_to_node = rsalloc(n_mapped_cpus * sizeof(unsigned int));
+	bzero(cpu_to_node, n_mapped_cpus * sizeof(unsigned int));
+
+	if ((dir = opendir(NUMA_NODES_PATH)) == NULL)
+		return;
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (sscanf(entry->d_name, "node%u%c", &node, &tail) != 1)
+			continue;
+
+		snprintf(path, sizeof(path), NUMA_CPULIST_PATH, node);
+		if ((f = fopen(path, "r")) == NULL)
+			continue;
+
+		if (fgets(list, sizeof(list), f) != NULL)
+			parse_cpulist(list, node);
+		fclose(f);
+
+		found++;
+		if (node > highest)
+			highest = node;
+	}
+	closedir(dir);
+
+	if (found > 0) {
+		n_online_nodes = found;
+		n_numa_nodes = highest + 1;
+	}
+}
+
+
+/**
+ * @brief Release the data structures describing the NUMA topology
+ */
+void numa_fini(void)
+{
+	rsfree(cpu_to_node);
+}
+
+
+/**
+ * @brief Tell how many NUMA node ids are in use
+ *
+ * @return One past the highest NUMA node id of the machine, so that
+ *         arrays indexed by node id can be sized with it
+ */
+unsigned int numa_nodes(void)
+{
+	return n_numa_nodes;
+}
+
+
+/**
+ * @brief Tell on which NUMA node a CPU is placed
+ *
+ * @param cpu The id of the CPU
+ *
+ * @return The NUMA node hosting @p cpu
+ */
+unsigned int numa_node_of_cpu(unsigned int cpu)
+{
+	if (cpu >= n_mapped_cpus)
+		return 0;
+	return cpu_to_node[cpu];
+}
+
+
+/**
+ * @brief Tell on which NUMA node the calling worker thread runs
+ *
+ * @return The NUMA node of the core the calling thread is bound to, or -1 if
+ *         threads are not bound to cores or there is a single NUMA node
+ */
+int numa_current_node(void)
+{
+	if (n_online_nodes < 2 || !rootsim_config.core_binding)
+		return -1;
+	return (int)numa_node_of_cpu(local_tid);
+}
+
+
+/**
+ * @brief Open a performance counter of the loads served by DRAM
+ *
+ * @param result PERF_COUNT_HW_CACHE_RESULT_ACCESS to count all the loads,
+ *               PERF_COUNT_HW_CACHE_RESULT_MISS to count the ones served
+ *               by a remote node
+ *
+ * @return The file descriptor of the counter, or -1 if it is not available
+ */
+static int open_node_counter(unsigned long long result)
+{
+	struct perf_event_attr attr;
+
+	bzero(&attr, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.config = PERF_COUNT_HW_CACHE_NODE | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+
+/**
+ * @brief Start counting the local and remote memory accesses of the calling thread
+ *
+ * Counters are often unavailable, e.g. in virtual machines or when
+ * perf_event_paranoid forbids them: in that case nothing is counted.
+ */
+void numa_counters_start(void)
+{
+	node_loads_fd = open_node_counter(PERF_COUNT_HW_CACHE_RESULT_ACCESS);
+	node_remote_loads_fd = open_node_counter(PERF_COUNT_HW_CACHE_RESULT_MISS);
+
+	if (node_loads_fd < 0 || node_remote_loads_fd < 0) {
+		if (node_loads_fd >= 0)
+			close(node_loads_fd);
+		if (node_remote_loads_fd >= 0)
+			close(node_remote_loads_fd);
+		node_loads_fd = node_remote_loads_fd = -1;
+	}
+}
+
+
+/**
+ * @brief Stop counting the memory accesses of the calling thread
+ *
+ * @param loads Where to store the number of loads served by DRAM
+ * @param remote_loads Where to store the number of loads served by the DRAM of a remote node
+ *
+ * Both values are left to zero if the counters are not available.
+ */
+void numa_counters_stop(double *loads, double *remote_loads)
+{
+	unsigned long long value;
+
+	*loads = *remote_loads = 0;
+
+	if (node_loads_fd < 0)
+		return;
+
+	if (read(node_loads_fd, &value, sizeof(value)) == sizeof(value))
+		*loads = value;
+	if (read(node_remote_loads_fd, &value, sizeof(value)) == sizeof(value))
+		*remote_loads = value;
+
+	close(node_loads_fd);
+	close(node_remote_loads_fd);
+	node_loads_fd = node_remote_loads_fd = -1;
+}
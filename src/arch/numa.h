@@ -0,0 +1,82 @@
+/**
+ * @file arch/numa.h
+ *
+ * @brief NUMA topology discovery
+ *
+ * This module discovers how CPU cores are organized into NUMA nodes,
+ * so that data structures shared by worker threads can be laid out
+ * according to the memory hierarchy. The topology is read from sysfs,
+ * and memory is placed via the mbind() system call, so that no
+ * dependency on libnuma is introduced.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/// Size of a cache line, used to pad data structures shared by worker threads
+#define CACHE_LINE_SIZE 64
+
+// From <numaif.h>, which comes with libnuma
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED	1
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE	(1 << 1)
+#endif
+
+/// Largest NUMA node which memory can be placed on
+#define NUMA_MAX_NODE	(sizeof(unsigned long) * 8 - 1)
+
+/**
+ * @brief Place a range of memory on a NUMA node
+ *
+ * Pages of the range which are touched afterwards are taken from @p node,
+ * if it has free memory. Placement is only an optimization, so failures
+ * are silently ignored.
+ *
+ * @param addr The page-aligned beginning of the range
+ * @param len The length of the range in bytes
+ * @param node The NUMA node, or -1 to leave the memory where it is
+ * @param move If true, the pages of the range which are already resident
+ *             are moved to @p node as well
+ */
+static inline void numa_place_memory(void *addr, size_t len, int node, bool move)
+{
+	unsigned long nodemask;
+
+	if (node < 0 || (unsigned int)node > NUMA_MAX_NODE)
+		return;
+
+	nodemask = 1UL << node;
+	(void)syscall(SYS_mbind, addr, len, MPOL_PREFERRED, &nodemask, NUMA_MAX_NODE + 1, move ? MPOL_MF_MOVE : 0);
+}
+
+extern void numa_init(void);
+extern void numa_fini(void);
+extern unsigned int numa_nodes(void);
+extern unsigned int numa_node_of_cpu(unsigned int cpu);
+extern int numa_current_node(void);
+extern void numa_counters_start(void);
+extern void numa_counters_stop(double *loads, double *remote_loads);
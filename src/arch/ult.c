@@ -41,6 +41,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include <arch/ult.h>
 #include <core/core.h>
@@ -53,19 +56,19 @@ __thread kernel_context_t kernel_context;
 #if defined(OS_LINUX)
 
 /**
-* When this function is called, a zeroed page-aligned stack for the ULT is created and returned.
-* The size of the stack can be specified by using the parameter. It's suggested to give a stack
-* size which is a multiple of the page size. Nevertheless, no check is done by this function.
+* When this function is called, a page-aligned stack for the ULT is created and returned.
+* The stack is only reserved: its pages are committed (and zeroed) by the system when they
+* are first touched. The page below the stack is a guard page, so that an overflow faults
+* instead of silently corrupting other memory.
 *
 * @author Alessandro Pellegrini
 *
-* @param size The size of the requested stack
-* @return A pointer to the allocated and zeroed page-aligned stack
+* @param size The size of the requested stack, which is rounded up to a multiple of the page size
+* @return A pointer to the lowest address of the allocated stack
 */
 void *get_ult_stack(size_t size)
 {
-	void *stack;
-	size_t reminder;
+	unsigned char *stack;
 	size_t page_size;
 
 	// Sanity check
@@ -74,20 +77,34 @@ void *get_ult_stack(size_t size)
 	}
 	// Align the size to the page boundary (by increasing the stack size)
 	page_size = getpagesize();
-	reminder = size % page_size;
-	if (unlikely(reminder != 0)) {
-		size += page_size - reminder;
-	}
-	// The first call to the LP malloc subsystem gives page-aligned memory
-	stack = rsalloc(size);
-	if (stack == NULL) {
+	size = (size + page_size - 1) & ~(page_size - 1);
+
+	stack = mmap(NULL, size + page_size, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+	if (stack == MAP_FAILED) {
 		rootsim_error(true,
 			      "Error allocating LP stack: not enough memory.\n");
 	}
 
-	bzero(stack, size);
+	if (mprotect(stack, page_size, PROT_NONE) != 0) {
+		rootsim_error(false, "Unable to set up the guard page of a stack: %s\n", strerror(errno));
+	}
+
+	return stack + page_size;
+}
+
+/**
+* Release a stack obtained from get_ult_stack().
+*
+* @param stack The pointer returned by get_ult_stack()
+* @param size The size passed to get_ult_stack()
+*/
+void free_ult_stack(void *stack, size_t size)
+{
+	size_t page_size = getpagesize();
 
-	return stack;
+	size = (size + page_size - 1) & ~(page_size - 1);
+	munmap((unsigned char *)stack - page_size, size + page_size);
 }
 
 #elif defined(OS_WINDOWS) || defined(OS_CYGWIN)
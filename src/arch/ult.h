@@ -82,6 +82,7 @@ typedef exec_context_t kernel_context_t;
 		long_jmp(context_new, 1)
 
 extern void *get_ult_stack(size_t size);
+extern void free_ult_stack(void *stack, size_t size);
 
 #elif defined(OS_CYGWIN) || defined(OS_WINDOWS)
 
@@ -114,6 +115,7 @@ typedef struct __execution_context_t kernel_context_t;
 
 // On Windows/Cygwin we use fibers, so there is no need to allocate LP's stacks
 #define get_ult_stack(lid, size) NULL
+#define free_ult_stack(stack, size) {}
 #define context_save(context) {}
 #define context_restore(context) {}
 
@@ -127,6 +127,26 @@ inline int atomic_inc_and_test(atomic_t * v)
 	return c != 0;
 }
 
+/**
+* This function implements (on x86-64 architectures) the atomic dec operation.
+* It decrements the atomic counter 'v' by 1 unit
+*
+* @param v the atomic counter which is the destination of the operation
+*
+* @return true if the counter became zero
+*/
+inline int atomic_dec_and_test(atomic_t * v)
+{
+	unsigned char c = 0;
+
+	__asm__ __volatile__("lock decl %0\n\t"
+			     "sete %1"
+			     :"=m"(v->count), "=qm"(c)
+			     :"m"(v->count)
+			     :"memory");
+	return c != 0;
+}
+
 /**
 * This function implements (on x86-64 architectures) a spinlock operation.
 *
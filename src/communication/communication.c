@@ -39,16 +39,34 @@
 #include <statistics/statistics.h>
 #include <scheduler/scheduler.h>
 #include <scheduler/process.h>
+#include <scheduler/placement.h>
 #include <datatypes/list.h>
 #include <mm/mm.h>
 #include <arch/atomic.h>
-#ifdef HAVE_MPI
 #include <communication/mpi.h>
-#endif
 
 /// This is the function pointer to correctly set ScheduleNewEvent API version, depending if we're running serially or in parallel
 void (*ScheduleNewEvent)(unsigned int gid_receiver, simtime_t timestamp, unsigned int event_type, void *event_content, unsigned int event_size);
 
+/// As for ScheduleNewEvent, these point to the serial or parallel version of the zero-copy API
+void *(*AllocEvent)(unsigned int gid_receiver, simtime_t timestamp, unsigned int event_type, unsigned int event_size);
+void (*CommitEvent)(void *event_content);
+
+/// Type of the messages handed out by ParallelAllocEvent() for events which must not be sent
+#define DISCARDED_EVENT		MAX_VALUE_CONTROL
+
+/// Whether the current thread runs LPs: the MPI communication thread shares @ref local_tid with a worker thread, but does not
+__thread bool runs_lps = true;
+
+/// Initial number of receivers for which send_antimessages() can group antimessages
+#define INIT_PENDING_ANTIMSGS	8U
+
+/// The antimessages being grouped by send_antimessages(), one for each receiver
+static __thread antimsg_t *pending_antimsgs;
+
+/// How many antimessages fit in @ref pending_antimsgs
+static __thread unsigned int pending_antimsgs_max;
+
 /**
 * @brief Initialize the communication subsystem
 *
@@ -58,9 +76,7 @@ void (*ScheduleNewEvent)(unsigned int gid_receiver, simtime_t timestamp, unsigne
 */
 void communication_init(void)
 {
-#ifdef HAVE_MPI
 	inter_kernel_comm_init();
-#endif
 }
 
 
@@ -74,19 +90,14 @@ void communication_init(void)
 */
 void communication_fini(void)
 {
-#ifdef HAVE_MPI
 	inter_kernel_comm_finalize();
-	mpi_finalize();
-#endif
+	inter_kernel_shutdown();
 
-	// Release memory used for remaining input/output queues
+	// Release memory used for remaining input queues
 	foreach_lp(lp) {
 		while (!list_empty(lp->queue_in)) {
 			list_pop(lp->queue_in);
 		}
-		while (!list_empty(lp->queue_out)) {
-			list_pop(lp->queue_out);
-		}
 	}
 }
 
@@ -117,86 +128,192 @@ static inline struct lp_struct *which_slab_to_use(GID_t sender, GID_t receiver)
 }
 
 
+/// Messages too large for the slabs are kept in pooled power-of-two buffers, up to this log2 size
+#define MSG_POOL_MAX_SHIFT	24
+
+/// How many bytes of released buffers of each size a thread keeps in its pool
+#define MSG_POOL_BUDGET		(32UL << 20)
+
+/// A pool of released message buffers of the same size, linked through their first word
+struct msg_pool {
+	void *head;		///< The last buffer released to the pool
+	unsigned int count;	///< How many buffers are in the pool
+};
+
+/// Per-thread pools of large message buffers, one for each power of two above @ref MSG_SLAB_MAX_SIZE
+static __thread struct msg_pool large_msg_pools[MSG_POOL_MAX_SHIFT - MSG_SLAB_MAX_SHIFT];
+
+
 /**
-* @brief Release a message header
+* @brief Get a buffer for a message too large for the slabs
 *
-* Message headers are taken always from the sender LP, as they are the
-* compact representation of an antimessage. Therefore, the release function
-* does not check whether the LP is local or not, but it frees memory
-* directly from the sender slab allocator.
+* Buffers are rounded up to a power of two, so that a buffer released to
+* the pool of the current thread can be reused for any message of a similar
+* size. Messages larger than 2^@ref MSG_POOL_MAX_SHIFT bytes are rare enough
+* to be taken directly from the allocator.
 *
-* @param msg A pointer to the message header to release
+* @param total The size of the message, including the @ref msg_t header
+*
+* @return A pointer to the buffer
 */
-void msg_hdr_release(msg_hdr_t *msg)
+static msg_t *get_large_msg_buffer(size_t total)
 {
-	struct lp_struct *lp;
+	unsigned int shift = msg_size_shift(total);
+	struct msg_pool *pool;
+	msg_t *msg;
 
-	lp = find_lp_by_gid(msg->sender);
-	slab_free(lp->mm->slab, msg);
+	if (unlikely(shift > MSG_POOL_MAX_SHIFT)) {
+		statistics_post_data(NULL, STAT_LARGE_MSG_BUFFER, 0.0);
+		return rsalloc(total);
+	}
+
+	pool = &large_msg_pools[shift - MSG_SLAB_MAX_SHIFT - 1];
+	if (pool->head == NULL) {
+		statistics_post_data(NULL, STAT_LARGE_MSG_BUFFER, 0.0);
+		return rsalloc(1UL << shift);
+	}
+
+	msg = pool->head;
+	pool->head = *(void **)msg;
+	pool->count--;
+	statistics_post_data(NULL, STAT_LARGE_MSG_BUFFER, 1.0);
+	return msg;
 }
 
 
 /**
-* @brief Get a buffer to keep a message header
+* @brief Release a buffer obtained with get_large_msg_buffer()
 *
-* Message headers are the compact way used to represent antimessages. This
-* function retrieves a buffer to keep a message header. Antimessages are
-* associated with the sender LP, so the @ref lp_struct used here must be
-* the one of the sender LP.
+* The buffer is kept in the pool of the current thread, unless the buffers
+* of the same size already in the pool take @ref MSG_POOL_BUDGET bytes.
 *
-* @todo This function is hacky: to preserve memory separation, we rely on
-*       the LP message slab. Nevertheless, currently we have only a slab
-*       for one single size, which is the size of a message. Therefore,
-*       we are wasting a lot lot lot of memory here to keep antimessages.
-*       A separate per-LP slab allocator, sized to the size of a message
-*       header, should be added.
+* @param msg A pointer to the buffer to release
+* @param total The size of the message, including the @ref msg_t header
+*/
+static void release_large_msg_buffer(msg_t *msg, size_t total)
+{
+	unsigned int shift = msg_size_shift(total);
+	struct msg_pool *pool;
+
+	if (unlikely(shift > MSG_POOL_MAX_SHIFT)) {
+		rsfree(msg);
+		return;
+	}
+
+	pool = &large_msg_pools[shift - MSG_SLAB_MAX_SHIFT - 1];
+	if (((size_t)pool->count << shift) >= MSG_POOL_BUDGET) {
+		rsfree(msg);
+		return;
+	}
+
+	*(void **)msg = pool->head;
+	pool->head = msg;
+	pool->count++;
+}
+
+
+/**
+* @brief Check whether the slabs of an LP belong to the current thread
 *
-* @param lp A pointer to the @ref lp_struct where to take the message header
-*           from. The slab allocator of the LP is used.
+* The slabs of an LP are owned by the worker thread the LP is bound to,
+* which can use their magazines without locking. Other threads allocate
+* from the slabs under their lock, and release objects to their lock-free
+* remote-free lists.
 *
-* @return A pointer to the freshly allocated buffer. It is large enough to
-*         keep a @ref msg_hdr_t datatype.
+* @param lp A pointer to the @ref lp_struct of the LP
 */
-msg_hdr_t *get_msg_hdr_from_slab(struct lp_struct *lp)
+static inline bool owns_slabs(struct lp_struct *lp)
 {
-	// TODO: The magnitude of this hack compares to that of the national debt.
-	// We are wasting a lot of memory from the LP buddy just to keep antimessages!
-	msg_hdr_t *msg = (msg_hdr_t *) get_msg_from_slab(lp);
-	bzero(msg, SLAB_MSG_SIZE);
-	return msg;
+	return runs_lps && lp->worker_thread == local_tid;
+}
+
+
+static inline void *lp_slab_alloc(struct lp_struct *lp, struct slab_chain *sch)
+{
+	return owns_slabs(lp) ? slab_alloc_local(sch) : slab_alloc(sch);
+}
+
+
+static inline void lp_slab_free(struct lp_struct *lp, struct slab_chain *sch, const void *obj)
+{
+	if (owns_slabs(lp))
+		slab_free_local(sch, obj);
+	else
+		slab_free_remote(sch, obj);
 }
 
 
 /**
 * @brief Get a buffer to keep a message.
 *
-* This function allocates a buffer from the slab of the LP identified by
-* the specified @ref lp_struct to keep a message.
+* This function allocates a buffer large enough to keep a message with
+* a payload of @p size bytes. The buffer is taken from the slab class of
+* the LP identified by the specified @ref lp_struct which fits the whole
+* message. Messages larger than @ref MSG_SLAB_MAX_SIZE are kept in pooled
+* buffers instead. Either way, msg_release() finds out where the buffer
+* came from by looking at the @c size member of the message.
 *
-* @warning The slab allocator is configured at simulation startup to keep
-*          buffers of size @ref SLAB_MSG_SIZE. The type @ref msg_t uses
-*          a flexible array (the @c event_content member) to keep also
-*          the model-specific payload. Therefore, if the size of the payload
-*          is such that @c sizeof(msg_t)+payload is larger that @ref SLAB_MSG_SIZE,
-*          relying on this function to allocate a @ref msg_t will generate
-*          a memory overflow. @b ALWAYS check the size of the payload before
-*          getting a message buffer from here!
+* Only the @ref msg_t header is cleared: the payload is left to the caller.
 *
 * @param lp A pointer to the @ref lp_struct where to take the message
-*           buffer from. The slab allocator of the LP is used.
+*           buffer from. The slab allocators of the LP are used.
+* @param size The size of the payload of the message
 *
-* @return A pointer to the freshly allocated buffer. It is large enough to
-*         keep a @ref msg_t datatype, but it might be too small to also
-*         keep the event payload.
+* @return A pointer to the freshly allocated buffer
 */
-msg_t *get_msg_from_slab(struct lp_struct *lp)
+msg_t *get_msg_buffer(struct lp_struct *lp, size_t size)
 {
-	msg_t *msg = (msg_t *) slab_alloc(lp->mm->slab);
-	bzero(msg, SLAB_MSG_SIZE);
+	size_t total = sizeof(msg_t) + size;
+	unsigned int class;
+	msg_t *msg;
+
+	if (likely(total <= MSG_SLAB_MAX_SIZE)) {
+		class = msg_slab_class(total);
+		msg = lp_slab_alloc(lp, lp->mm->msg_slabs[class]);
+		statistics_post_data(NULL, STAT_MSG_BUFFER, class);
+	} else {
+		msg = get_large_msg_buffer(total);
+	}
+
+	bzero(msg, offsetof(msg_t, event_content));
+	msg->size = size;
 	return msg;
 }
 
 
+/**
+* @brief Get a buffer to keep an antimessage
+*
+* Antimessages are kept in a per-LP slab sized to the @ref antimsg_t type.
+* Differently from messages, they are always taken from the receiver LP,
+* because they are either inserted in its bottom halves or, if the receiver
+* is remote, they are copied in the outgoing MPI buffers and this is
+* never called. Therefore, @p lp must be a locally-hosted receiver.
+*
+* @param lp A pointer to the @ref lp_struct of the LP receiving the antimessage
+*
+* @return A pointer to the freshly allocated antimessage
+*/
+antimsg_t *get_antimsg_from_slab(struct lp_struct *lp)
+{
+	return lp_slab_alloc(lp, lp->mm->antimsg_slab);
+}
+
+
+/**
+* @brief Release an antimessage
+*
+* @param anti A pointer to the antimessage to release. It must have been
+*             obtained with get_antimsg_from_slab().
+*/
+void antimsg_release(antimsg_t *anti)
+{
+	struct lp_struct *lp = find_lp_by_gid(anti->receiver);
+
+	lp_slab_free(lp, lp->mm->antimsg_slab, anti);
+}
+
+
 /**
  * @brief Release a message buffer
  *
@@ -208,9 +325,10 @@ msg_t *get_msg_from_slab(struct lp_struct *lp)
  * To free the message, this function checks againts the total size
  * of the message, considering both the size of the @ref msg_t structure
  * and that of the payload kept in the @c event_content member of @ref msg_t.
- * If the total size is smaller than @ref SLAB_MSG_SIZE, then the message
- * was taken from a slab, otherwise it has been taken by the buddy system.
- * Therefore, we free the buffer from the corresponding data structure.
+ * If the total size is at most @ref MSG_SLAB_MAX_SIZE, then the message
+ * was taken from the slab class fitting that size, otherwise it has been
+ * taken from the pools of large buffers. Therefore, we free the buffer to
+ * the corresponding data structure.
  *
  * Messages are freed using this function both if they are stable and
  * transient in this simulation instance, i.e. if they were destined
@@ -223,50 +341,37 @@ msg_t *get_msg_from_slab(struct lp_struct *lp)
  */
 void msg_release(msg_t *msg)
 {
+	size_t total = sizeof(msg_t) + msg->size;
 	struct lp_struct *lp;
 
-	if (likely(sizeof(msg_t) + msg->size <= SLAB_MSG_SIZE)) {
+	if (likely(total <= MSG_SLAB_MAX_SIZE)) {
 		lp = which_slab_to_use(msg->sender, msg->receiver);
-		slab_free(lp->mm->slab, msg);
+		lp_slab_free(lp, lp->mm->msg_slabs[msg_slab_class(total)], msg);
 	} else {
-		rsfree(msg);
+		release_large_msg_buffer(msg, total);
 	}
 }
 
 
 /**
- * @brief Schedule a new message to some LP
- *
- * This is one of the entry points from the application model, used in
- * parallel/distributed simulations. The simulation model calls
- * ScheduleNewEvent() which is a function pointer, set to point to this
- * implementation if the @c --sequential flag is not passed as an option.
+ * @brief Check and pack a new event generated by the current LP
  *
- * This function performs all the required sanity checks:
- * * Is the destination LP id valid?
- * * Are we sending an event to the past?
- * * Is the event type in a valid range?
+ * This performs the sanity checks on a new event, and packs it in a
+ * platform-level message, which is not yet sent.
  *
- * If all the checks pass, then the event content is copied in a platform-level
- * buffer and a pointer to it is placed in the temporary LP outgoing buffer,
- * for later delivery (possibly via MPI).
- *
- * If the LP is running in silent execution, this function simply returns
- * as the event has already been sent during a previous event execution.
- * 
  * @param gid_receiver Global id of logical process at which the message must be delivered
  * @param timestamp Logical Virtual Time associated with the event enveloped into the message
  * @param event_type Type of the event
- * @param event_content Payload of the event
  * @param event_size Size of event's payload
+ * @param event_content Payload of the event, or NULL if the model writes it later
+ *
+ * @return The new message, or NULL if the event must not be sent
  */
-void ParallelScheduleNewEvent(unsigned int gid_receiver, simtime_t timestamp, unsigned int event_type, void *event_content, unsigned int event_size)
+static msg_t *new_event(unsigned int gid_receiver, simtime_t timestamp, unsigned int event_type, unsigned int event_size, void *event_content)
 {
 	msg_t *event;
 	GID_t receiver;
 
-	switch_to_platform_mode();
-
 	// Internally to the platform, the receiver is a GID, while models
 	// have no difference across GIDs and LIDs. We convert here the passed
 	// id to a GID.
@@ -274,12 +379,12 @@ void ParallelScheduleNewEvent(unsigned int gid_receiver, simtime_t timestamp, un
 
 	// In Silent execution, we do not send again already sent messages
 	if (unlikely(current->state == LP_STATE_SILENT_EXEC)) {
-		return;
+		return NULL;
 	}
 	// Check whether the destination LP is out of range
 	if (unlikely(gid_receiver > n_prc_tot - 1)) {	// It's unsigned, so no need to check whether it's < 0
 		rootsim_error(false, "Warning: the destination LP %u is out of range. The event has been ignored\n", gid_receiver);
-		goto out;
+		return NULL;
 	}
 	// Check if the associated timestamp is negative
 	if (unlikely(timestamp < lvt(current))) {
@@ -303,9 +408,108 @@ void ParallelScheduleNewEvent(unsigned int gid_receiver, simtime_t timestamp, un
 		fflush(stdout);
 	}
 
-	insert_outgoing_msg(event);
+	return event;
+}
+
+/**
+ * @brief Schedule a new message to some LP
+ *
+ * This is one of the entry points from the application model, used in
+ * parallel/distributed simulations. The simulation model calls
+ * ScheduleNewEvent() which is a function pointer, set to point to this
+ * implementation if the @c --sequential flag is not passed as an option.
+ *
+ * This function performs all the required sanity checks:
+ * * Is the destination LP id valid?
+ * * Are we sending an event to the past?
+ * * Is the event type in a valid range?
+ *
+ * If all the checks pass, then the event content is copied in a platform-level
+ * buffer and a pointer to it is placed in the temporary LP outgoing buffer,
+ * for later delivery (possibly via MPI).
+ *
+ * If the LP is running in silent execution, this function simply returns
+ * as the event has already been sent during a previous event execution.
+ * 
+ * @param gid_receiver Global id of logical process at which the message must be delivered
+ * @param timestamp Logical Virtual Time associated with the event enveloped into the message
+ * @param event_type Type of the event
+ * @param event_content Payload of the event
+ * @param event_size Size of event's payload
+ */
+void ParallelScheduleNewEvent(unsigned int gid_receiver, simtime_t timestamp, unsigned int event_type, void *event_content, unsigned int event_size)
+{
+	msg_t *event;
+
+	switch_to_platform_mode();
+
+	event = new_event(gid_receiver, timestamp, event_type, event_size, event_content);
+	if (event != NULL)
+		insert_outgoing_msg(event);
+
+	switch_to_application_mode();
+}
+
+/**
+ * @brief Allocate a new event, whose payload is written in place by the model
+ *
+ * This is the parallel/distributed implementation of AllocEvent(). The same
+ * checks as in ParallelScheduleNewEvent() are performed, and the message is
+ * allocated right away, so that the model can build the payload directly in
+ * it rather than in a temporary buffer which is later copied. The event is
+ * sent once the model hands the returned buffer to CommitEvent().
+ *
+ * If the LP is running in silent execution, or if the destination LP is out
+ * of range, the event must not be sent. A message is allocated all the same,
+ * so that each returned buffer stays valid until it is committed, but it is
+ * marked with the @ref DISCARDED_EVENT type: CommitEvent() releases it rather
+ * than sending it.
+ *
+ * @param gid_receiver Global id of logical process at which the message must be delivered
+ * @param timestamp Logical Virtual Time associated with the event enveloped into the message
+ * @param event_type Type of the event
+ * @param event_size Size of event's payload
+ *
+ * @return A pointer to @p event_size bytes where the payload must be written
+ */
+void *ParallelAllocEvent(unsigned int gid_receiver, simtime_t timestamp, unsigned int event_type, unsigned int event_size)
+{
+	msg_t *event;
+
+	switch_to_platform_mode();
+
+	event = new_event(gid_receiver, timestamp, event_type, event_size, NULL);
+	if (unlikely(event == NULL)) {
+		event = get_msg_buffer(current, event_size);
+		event->sender = current->gid;
+		event->receiver = current->gid;
+		event->type = DISCARDED_EVENT;
+	}
+
+	switch_to_application_mode();
+	return event->event_content;
+}
+
+/**
+ * @brief Send an event allocated with AllocEvent()
+ *
+ * This is the parallel/distributed implementation of CommitEvent(). The
+ * message is placed in the temporary LP outgoing buffer, as it is done by
+ * ParallelScheduleNewEvent().
+ *
+ * @param event_content The buffer returned by ParallelAllocEvent()
+ */
+void ParallelCommitEvent(void *event_content)
+{
+	msg_t *event = msg_from_content(event_content);
+
+	switch_to_platform_mode();
+
+	if (likely(event->type != DISCARDED_EVENT))
+		insert_outgoing_msg(event);
+	else
+		msg_release(event);
 
- out:
 	switch_to_application_mode();
 }
 
@@ -317,36 +521,72 @@ void ParallelScheduleNewEvent(unsigned int gid_receiver, simtime_t timestamp, un
  * a simulation time (which is associated with the time at which
  * we are rolling back.
  *
- * After that the antimessage is sent, the header is immediately removed
+ * After that the antimessage is sent, the record is immediately removed
  * from the output queue, as MPI guarantees that the antimessage is
- * eventually received at the destination.
+ * eventually received at the destination. The output queue is ordered
+ * by send time, so the records to cancel are all at its tail.
+ *
+ * Antimessages are sent using the compact @ref antimsg_t representation,
+ * which travels on a dedicated channel, both towards local LPs and on the
+ * wire. A single antimessage is sent to each receiver, which cancels all
+ * the messages sent to it after @p after_simtime. Antimessages of control
+ * messages are instead full messages, one per message, as they must go
+ * through the control message handlers at the receiver.
  *
  * @param lp A pointer to the LP lp_struct for which antimessages should be sent
  * @param after_simtime The simulation time instant after which to send antimessages
  */
 void send_antimessages(struct lp_struct *lp, simtime_t after_simtime)
 {
-	msg_hdr_t *anti_msg, *anti_msg_prev;
+	msg_hdr_t *anti_msg;
+	antimsg_t *anti;
+	unsigned int i, receivers = 0;
 	msg_t *msg;
 
-	if (unlikely(list_empty(lp->queue_out)))
-		return;
+	// Scan the output queue backwards, collecting the messages to cancel for each receiver
+	while (!ring_empty(lp->queue_out) && ring_tail(lp->queue_out).send_time > after_simtime) {
+		anti_msg = &ring_tail(lp->queue_out);
+
+		if (unlikely(anti_msg->type >= MIN_VALUE_CONTROL)) {
+			msg = get_msg_buffer(which_slab_to_use(lp->gid, anti_msg->receiver), 0);
+			msg->sender = lp->gid;
+			hdr_to_msg(anti_msg, msg);
+			msg->message_kind = negative;
+			Send(msg);
+			goto remove;
+		}
+
+		// Rollbacks usually hit a handful of receivers: a linear search suffices
+		for (i = 0; i < receivers; i++) {
+			if (pending_antimsgs[i].receiver.to_int == anti_msg->receiver.to_int)
+				break;
+		}
 
-	// Scan the output queue backwards, sending all required antimessages
-	anti_msg = list_tail(lp->queue_out);
-	while (anti_msg != NULL && anti_msg->send_time > after_simtime) {
-		msg = get_msg_from_slab(which_slab_to_use(anti_msg->sender, anti_msg->receiver));
-		hdr_to_msg(anti_msg, msg);
-		msg->message_kind = negative;
+		if (i == receivers) {
+			if (unlikely(receivers == pending_antimsgs_max)) {
+				pending_antimsgs_max = max(2 * pending_antimsgs_max, INIT_PENDING_ANTIMSGS);
+				pending_antimsgs = rsrealloc(pending_antimsgs, pending_antimsgs_max * sizeof(antimsg_t));
+			}
+			anti = &pending_antimsgs[receivers++];
+			bzero(anti, sizeof(*anti));
+			anti->sender = lp->gid;
+			anti->receiver = anti_msg->receiver;
+			anti->send_time = after_simtime;
+			anti->timestamp = INFTY;
+		}
 
-		Send(msg);
+		anti = &pending_antimsgs[i];
+		anti->count++;
+		anti->timestamp = min(anti->timestamp, anti_msg->timestamp);
+		anti->mark = max(anti->mark, anti_msg->mark);
 
-		// Remove the already-sent antimessage from the output queue
-		anti_msg_prev = list_prev(anti_msg);
-		list_delete_by_content(lp->queue_out, anti_msg);
-		msg_hdr_release(anti_msg);
-		anti_msg = anti_msg_prev;
+	    remove:
+		// Remove the cancelled message from the output queue
+		ring_pop_tail(lp->queue_out);
 	}
+
+	for (i = 0; i < receivers; i++)
+		SendAnti(&pending_antimsgs[i]);
 }
 
 
@@ -368,17 +608,39 @@ void Send(msg_t *msg)
 {
 	validate_msg(msg);
 
-#ifdef HAVE_MPI
 	// Check whether the message recepient kernel is remote
 	if (find_kernel_by_gid(msg->receiver) != kid) {
 		send_remote_msg(msg);
 		return;
 	}
-#endif
 	insert_bottom_half(msg);
 }
 
 
+/**
+ * @brief Send an antimessage
+ *
+ * This is the counterpart of Send() for antimessages. The antimessage is
+ * either copied in the antimessage bottom half of the receiver LP or
+ * handed to MPI.
+ *
+ * @param anti A pointer to the antimessage to send. It is copied, so it
+ *             can be reused upon return.
+ */
+void SendAnti(antimsg_t *anti)
+{
+	antimsg_t *local;
+
+	if (find_kernel_by_gid(anti->receiver) != kid) {
+		send_remote_antimsg(anti);
+		return;
+	}
+	local = get_antimsg_from_slab(find_lp_by_gid(anti->receiver));
+	*local = *anti;
+	insert_antimsg_bottom_half(local);
+}
+
+
 /**
  * @brief Place a message in the temporary LP outgoing buffer
  *
@@ -404,6 +666,8 @@ void insert_outgoing_msg(msg_t *msg)
 
 	current->outgoing_buffer.outgoing_msgs[current->outgoing_buffer.size++] = msg;
 
+	placement_on_send(msg);
+
 	// Store the minimum timestamp of outgoing messages
 	// TODO: check whether this is still used by preemptive Time Warp or not
 	if (msg->timestamp < current->outgoing_buffer.min_in_transit[current->worker_thread]) {
@@ -419,9 +683,13 @@ void insert_outgoing_msg(msg_t *msg)
  * queue during the execution of an event (see insert_outgoing_msg())
  * to the destination LPs. Also, this function records in the output
  * queue of the sender LP that at a certain simulation time a certain
- * message was sent---this is done using the @ref msg_hdr_t type.
+ * message was sent---this is done appending a @ref msg_hdr_t record to it.
  * This information is used upon a rollback to send out antimessages.
  *
+ * Model events directed to the sender itself, or to any other LP bound to
+ * the current worker thread, are placed straight in the input queue of the
+ * receiver, as no other thread can access it.
+ *
  * After the execution of this function, the temporary outgoing queue
  * is considered as empty.
  *
@@ -432,17 +700,26 @@ void send_outgoing_msgs(struct lp_struct *lp)
 {
 	register unsigned int i = 0;
 	msg_t *msg;
-	msg_hdr_t *msg_hdr;
+	struct lp_struct *receiver;
 
 	for (i = 0; i < lp->outgoing_buffer.size; i++) {
-		msg_hdr = get_msg_hdr_from_slab(lp);
 		msg = lp->outgoing_buffer.outgoing_msgs[i];
-		msg_to_hdr(msg_hdr, msg);
-
-		Send(msg);
 
-		// register the message in the sender's output queue, for antimessage management
-		list_insert(lp->queue_out, send_time, msg_hdr);
+		// register the message in the sender's output queue, for antimessage management.
+		// Events are sent in nondecreasing send time, so the queue stays ordered.
+		msg_to_hdr(ring_push_tail(lp->queue_out), msg);
+
+		// Model events towards an LP bound to this thread skip the bottom half
+		if (msg->receiver.to_int == lp->gid.to_int)
+			receiver = lp;
+		else
+			receiver = lps_by_gid[msg->receiver.to_int];
+
+		if (receiver != NULL && receiver->worker_thread == local_tid
+		    && msg->type < MIN_VALUE_CONTROL && msg->message_kind == positive)
+			insert_local_msg(receiver, msg);
+		else
+			Send(msg);
 	}
 
 	lp->outgoing_buffer.size = 0;
@@ -456,10 +733,9 @@ void send_outgoing_msgs(struct lp_struct *lp)
  * event and pack it in a simulation-level datastructure representing
  * a message (namely, a @ref msg_t type).
  *
- * This function also allocates the buffer for that message. To this end,
- * it determines whether the buffer can be taken from some slab allocator
- * or not (depending on the size of the payload, which determines whether
- * the final message fits into a buffer of size @ref SLAB_MSG_SIZE).
+ * This function also allocates the buffer for that message, with
+ * get_msg_buffer(): the size of the payload determines the slab class
+ * the buffer is taken from, or whether it comes from a pool of large buffers.
  *
  * This is a uniform internal API which can be used in any situation.
  * Indeed, it relies on the which_slab_to_use() internal function to find
@@ -493,13 +769,7 @@ void send_outgoing_msgs(struct lp_struct *lp)
  */
 void pack_msg(msg_t **msg, GID_t sender, GID_t receiver, int type, simtime_t timestamp, simtime_t send_time, size_t size, void *payload)
 {
-	// Check if we can rely on a slab to initialize the message
-	if (likely(sizeof(msg_t) + size <= SLAB_MSG_SIZE)) {
-		*msg = get_msg_from_slab(which_slab_to_use(sender, receiver));
-	} else {
-		*msg = rsalloc(sizeof(msg_t) + size);
-		bzero(*msg, sizeof(msg_t) + size);
-	}
+	*msg = get_msg_buffer(which_slab_to_use(sender, receiver), size);
 
 	(*msg)->sender = sender;
 	(*msg)->receiver = receiver;
@@ -533,7 +803,6 @@ void msg_to_hdr(msg_hdr_t *hdr, msg_t *msg)
 {
 	validate_msg(msg);
 
-	hdr->sender = msg->sender;
 	hdr->receiver = msg->receiver;
 	hdr->type = msg->type;
 	hdr->rendezvous_mark = msg->rendezvous_mark;
@@ -555,7 +824,8 @@ void msg_to_hdr(msg_hdr_t *hdr, msg_t *msg)
  * information is taken from compact versions of the originally sent
  * messages, kept in the @ref msg_hdr_t type. When an antimessage must
  * be sent out, this is done by copying the message header into a
- * @ref msg_t type.
+ * @ref msg_t type. The header does not keep the sender, which is the
+ * LP owning the output queue: it must be set in @p msg by the caller.
  * This is required because all message sending logic assumes that
  * a @ref msg_t data structure is being passed (this avoid having to
  * perform multiple checks or multiple casts in the code base).
@@ -567,7 +837,6 @@ void msg_to_hdr(msg_hdr_t *hdr, msg_t *msg)
  */
 void hdr_to_msg(msg_hdr_t *hdr, msg_t *msg)
 {
-	msg->sender = hdr->sender;
 	msg->receiver = hdr->receiver;
 	msg->type = hdr->type;
 	msg->rendezvous_mark = hdr->rendezvous_mark;
@@ -590,9 +859,7 @@ void dump_msg_content(msg_t *msg)
 {
 	printf("\tsender: %u\n", msg->sender.to_int);
 	printf("\treceiver: %u\n", msg->sender.to_int);
-#ifdef HAVE_MPI
 	printf("\tcolour: %d\n", msg->colour);
-#endif
 	printf("\ttype: %d\n", msg->type);
 	printf("\tmessage_kind: %d\n", msg->message_kind);
 	printf("\ttimestamp: %f\n", msg->timestamp);
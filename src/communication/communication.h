@@ -33,15 +33,6 @@
 
 #include <core/core.h>
 
-/**
- * @brief Slab allocator max message size.
- *
- * This is the size in bytes of a slab from the message slab allocator.
- * If messages are smaller than this size, then message buffers are taken
- * from the slab. Otherwise, the buddy system is queried directly.
- */
-#define SLAB_MSG_SIZE		512
-
 /**
  * @brief Simulation Platform Control Messages
  *
@@ -76,6 +67,13 @@ enum _control_msgs {
 #define is_control_msg(type)	(type >= MIN_VALUE_CONTROL && type != RENDEZVOUS_START)
 
 
+/// Transports of messages across simulation kernels
+enum {
+	TRANSPORT_INVALID = 0,	/**< By convention 0 is the invalid field */
+	TRANSPORT_MPI,		/**< Kernels are started by mpiexec, and communicate via MPI */
+	TRANSPORT_SHM		/**< Kernels are forked on the same host, and communicate via shared memory */
+};
+
 /**
  * @brief Internal MPI tags.
  *
@@ -85,7 +83,8 @@ enum _control_msgs {
  */
 enum _mpi_tags {
 	MSG_NEW_GVT = 100,	///< Master notifies the new GVT
-	MSG_FINI		///< One rank informs the others that the simulation has to be stopped
+	MSG_FINI,		///< One rank informs the others that the simulation has to be stopped
+	MSG_GVT_PIGGYBACK	///< GVT information which could not be piggybacked on any message
 };
 
 /**
@@ -128,17 +127,22 @@ typedef struct _outgoing_t {
 
 
 
+extern __thread bool runs_lps;
+
 extern void ParallelScheduleNewEvent(unsigned int, simtime_t, unsigned int, void *, unsigned int);
+extern void *ParallelAllocEvent(unsigned int, simtime_t, unsigned int, unsigned int);
+extern void ParallelCommitEvent(void *);
 extern void communication_init(void);
 extern void communication_fini(void);
 extern void Send(msg_t * msg);
 extern void insert_outgoing_msg(msg_t * msg);
 extern void send_outgoing_msgs(struct lp_struct *);
 extern void send_antimessages(struct lp_struct *, simtime_t);
+extern void SendAnti(antimsg_t * anti);
 
-extern void msg_hdr_release(msg_hdr_t * msg);
-extern msg_t *get_msg_from_slab(struct lp_struct *);
-extern msg_hdr_t *get_msg_hdr_from_slab(struct lp_struct *);
+extern msg_t *get_msg_buffer(struct lp_struct *, size_t);
+extern antimsg_t *get_antimsg_from_slab(struct lp_struct *);
+extern void antimsg_release(antimsg_t * anti);
 extern void pack_msg(msg_t ** msg, GID_t sender, GID_t receiver, int type, simtime_t timestamp, simtime_t send_time, size_t size, void *payload);
 extern void msg_to_hdr(msg_hdr_t * hdr, msg_t * msg);
 extern void hdr_to_msg(msg_hdr_t * hdr, msg_t * msg);
@@ -35,11 +35,12 @@
 * @author Tommaso Tocci
 */
 
-#ifdef HAVE_MPI
-
 #include <communication/communication.h>
 #include <communication/mpi.h>
 #include <communication/gvt.h>
+#include <core/init.h>
+#include <core/timer.h>
+#include <gvt/gvt.h>
 
 /**
  * Colour phase of each thread. This is a dynamically sized array
@@ -86,7 +87,7 @@ static atomic_t white_1_msg_recv;
  */
 static atomic_t *white_msg_sent;
 
-/// Temporary structure used for the MPI collective primitives
+/// Temporary structure used for the collective operations of the transport
 static int *white_msg_sent_buff;
 
 /**
@@ -95,19 +96,6 @@ static int *white_msg_sent_buff;
  */
 static int expected_white_msg;
 
-/**
- * MPI Request operation to implement the asynchronous counting
- * of white messages
- */
-static MPI_Request white_count_req;
-
-/**
- * Separate MPI communicator to carry out the reduction of white
- * messages. This communicator lives for the whole duration of the
- * simulation.
- */
-static MPI_Comm white_count_comm;
-
 /**
  * Spinlock guard used to ensure that only one thread at a time
  * attempts to perform check operations on the reduction of white
@@ -115,17 +103,6 @@ static MPI_Comm white_count_comm;
  */
 static spinlock_t white_count_lock;
 
-/**
- * MPI Request operation to implement the distributed reduction
- * of the current GVT value.
- */
-static MPI_Request gvt_reduction_req;
-
-/**
- * Separate MPI communicator to carry out the reduction of the GVT.
- */
-static MPI_Comm gvt_reduction_comm;
-
 /**
  * Spinlock guard used to ensure that only one thread at a time
  * attempts to perform check operations on the reduction of the GVT.
@@ -133,27 +110,19 @@ static MPI_Comm gvt_reduction_comm;
 static spinlock_t gvt_reduction_lock;
 
 /**
- * In the end, the GVT reduction is implemented using an MPI All Reduce.
- * This primitive requires some stable buffer in memory to keep the
- * values to be reduced across all ranks. This is a global variable
- * in which each kernel instance places its proposal for the GVT, which
- * is reduced using MPI all reduce.
+ * In the end, the GVT reduction is implemented using a collective
+ * operation of the transport. This requires some stable buffer in memory
+ * to keep the values to be reduced across all kernels. This is a global
+ * variable in which each kernel instance places its proposal for the GVT.
  */
 static simtime_t local_vt_buff;
 
 /**
- * This is the target temporary buffer in which MPI all reduce will
+ * This is the target temporary buffer in which the transport will
  * place the reduced GVT value.
  */
 static simtime_t reduced_gvt;
 
-/**
- * A vector of MPI asynchronous operations used to communicate with all
- * kernel instances in the distributed run in order to initiate the GVT
- * reduction protocol.
- */
-static MPI_Request *gvt_init_reqs;
-
 /**
  * This variable is used to keep track of what round of GVT reduction we
  * are actually starting. This is used also to make a sanity check on
@@ -162,14 +131,54 @@ static MPI_Request *gvt_init_reqs;
  */
 static unsigned int gvt_init_round;
 
+/**
+ * What a kernel knows about the GVT information of a remote kernel
+ * in a given round, as collected from piggybacked data.
+ */
+struct _pb_knowledge {
+	volatile unsigned int round;	///< The round this knowledge refers to
+	volatile int white_sent;	///< White messages sent by the remote kernel to us, -1 if unknown
+	volatile simtime_t kvt;		///< KVT proposed by the remote kernel, -1.0 if unknown
+};
 
 /**
- * @brief Initialize the MPI-based distributed GVT reduction submodule.
+ * Number of GVT rounds for which piggybacked knowledge is kept. A remote
+ * kernel can be at most one round ahead of us, because it cannot complete
+ * a round without knowing our own proposal.
+ */
+#define PB_SLOTS 2
+
+/// Knowledge about all remote kernels, indexed by kernel id and by round parity
+static struct _pb_knowledge (*pb_known)[PB_SLOTS];
+
+/// Guard for @ref pb_known
+static spinlock_t pb_lock;
+
+/// Last round for which @ref white_msg_sent_buff holds the final number of white messages sent
+static volatile unsigned int pb_white_round;
+
+/// Last round for which this kernel has proposed its KVT
+static volatile unsigned int pb_kvt_round;
+
+/// KVT proposals of this kernel, indexed by round parity
+static volatile simtime_t pb_kvt[PB_SLOTS];
+
+/// Last round for which each remote kernel has been told our number of white messages
+static unsigned int *pb_told_white;
+
+/// Last round for which each remote kernel has been told our KVT proposal
+static unsigned int *pb_told_kvt;
+
+/// Started whenever new information to be piggybacked becomes available
+static timer pb_timer;
+
+
+/**
+ * @brief Initialize the distributed GVT reduction submodule.
  *
- * This function is called after that the MPI subsystem is activated.
+ * This function is called after that the transport is set up.
  * Its goal is to initialize all the variable-sized data structures
- * and MPI-related data structures which will be used while running the
- * distributed GVT reduction protocol.
+ * which will be used while running the distributed GVT reduction protocol.
  */
 void gvt_comm_init(void)
 {
@@ -193,30 +202,31 @@ void gvt_comm_init(void)
 	}
 
 	white_msg_sent_buff = rsalloc(n_ker * sizeof(unsigned int));
+	bzero(white_msg_sent_buff, n_ker * sizeof(unsigned int));
 
-	white_count_req = MPI_REQUEST_NULL;
-	MPI_Comm_dup(MPI_COMM_WORLD, &white_count_comm);
 	spinlock_init(&white_count_lock);
-
-	gvt_init_reqs = rsalloc(n_ker * sizeof(MPI_Request));
-	for (i = 0; i < n_ker; i++) {
-		gvt_init_reqs[i] = MPI_REQUEST_NULL;
-	}
-
-	gvt_reduction_req = MPI_REQUEST_NULL;
-	MPI_Comm_dup(MPI_COMM_WORLD, &gvt_reduction_comm);
 	spinlock_init(&gvt_reduction_lock);
+
+	// GVT rounds are numbered starting from 1, so round 0 means "no information"
+	pb_known = rsalloc(n_ker * sizeof(*pb_known));
+	bzero(pb_known, n_ker * sizeof(*pb_known));
+	pb_told_white = rsalloc(n_ker * sizeof(unsigned int));
+	bzero(pb_told_white, n_ker * sizeof(unsigned int));
+	pb_told_kvt = rsalloc(n_ker * sizeof(unsigned int));
+	bzero(pb_told_kvt, n_ker * sizeof(unsigned int));
+	pb_white_round = 0;
+	pb_kvt_round = 0;
+	spinlock_init(&pb_lock);
+	timer_start(pb_timer);
 }
 
 
 /**
- * @brief Shut down the MPI-based distributed GVT reduction submodule.
+ * @brief Shut down the distributed GVT reduction submodule.
  *
- * This function is called just before shutting down the MPI subsystem.
- * It frees all the data structures used to carry out the distributed GVT
- * reduction protocol, and nicely tells MPI to wipe out everything that
- * is no longer needed.
- * Right after this, MPI will be shut down as well.
+ * This function is called once the transport has been released. It
+ * frees all the data structures used to carry out the distributed GVT
+ * reduction protocol.
  */
 void gvt_comm_finalize(void)
 {
@@ -225,23 +235,118 @@ void gvt_comm_finalize(void)
 	rsfree(white_msg_sent);
 	rsfree(white_msg_sent_buff);
 
+	rsfree(pb_known);
+	rsfree(pb_told_white);
+	rsfree(pb_told_kvt);
+}
+
+
+/**
+ * @brief Check whether all remote kernels told us their white messages.
+ *
+ * If all remote kernels have told us, via piggybacked information, how
+ * many white messages they sent to us before entering GVT round @p round,
+ * then @ref expected_white_msg is updated accordingly.
+ *
+ * @param round The GVT round to check
+ *
+ * @return @c true if the number of expected white messages is known,
+ *         @c false otherwise.
+ */
+static bool pb_white_msg_known(unsigned int round)
+{
 	unsigned int i;
+	int expected = 0;
+	bool known = true;
+
+	spin_lock(&pb_lock);
 	for (i = 0; i < n_ker; i++) {
-		if (gvt_init_reqs[i] != MPI_REQUEST_NULL) {
-			MPI_Cancel(&gvt_init_reqs[i]);
-			MPI_Request_free(&gvt_init_reqs[i]);
+		if (i == kid)
+			continue;
+		if (pb_known[i][round % PB_SLOTS].round != round || pb_known[i][round % PB_SLOTS].white_sent < 0) {
+			known = false;
+			break;
 		}
+		expected += pb_known[i][round % PB_SLOTS].white_sent;
 	}
+	spin_unlock(&pb_lock);
+
+	if (known)
+		expected_white_msg = expected;
+	return known;
+}
+
 
-	if (gvt_init_pending()) {
-		gvt_init_clear();
+/**
+ * @brief Check whether all remote kernels told us their KVT proposal.
+ *
+ * If all remote kernels have told us, via piggybacked information, their
+ * KVT proposal for GVT round @p round, then the new GVT is computed
+ * locally and stored into @ref reduced_gvt.
+ *
+ * @param round The GVT round to check
+ *
+ * @return @c true if the new GVT value is known, @c false otherwise.
+ */
+static bool pb_kvt_known(unsigned int round)
+{
+	unsigned int i;
+	simtime_t gvt = local_vt_buff;
+	bool known = true;
+
+	spin_lock(&pb_lock);
+	for (i = 0; i < n_ker; i++) {
+		if (i == kid)
+			continue;
+		if (pb_known[i][round % PB_SLOTS].round != round || pb_known[i][round % PB_SLOTS].kvt < 0.0) {
+			known = false;
+			break;
+		}
+		gvt = min(gvt, pb_known[i][round % PB_SLOTS].kvt);
 	}
+	spin_unlock(&pb_lock);
 
-	MPI_Wait(&white_count_req, MPI_STATUS_IGNORE);
-	MPI_Comm_free(&white_count_comm);
-	MPI_Wait(&gvt_reduction_req, MPI_STATUS_IGNORE);
-	MPI_Comm_free(&gvt_reduction_comm);
-	rsfree(gvt_init_reqs);
+	if (known)
+		reduced_gvt = gvt;
+	return known;
+}
+
+
+/**
+ * @brief Fill the GVT information to be piggybacked towards a kernel.
+ *
+ * This function is thread safe: if the local information is updated
+ * while it is being read, it is read again.
+ *
+ * @param pb A pointer to the @ref gvt_piggyback to fill
+ * @param dst_kid The id of the kernel which will receive @p pb
+ */
+static void pb_fill(gvt_piggyback *pb, unsigned int dst_kid)
+{
+	unsigned int white_round, kvt_round;
+
+	do {
+		white_round = pb_white_round;
+		kvt_round = pb_kvt_round;
+		__sync_synchronize();
+
+		pb->round = white_round;
+		pb->white_sent = white_msg_sent_buff[dst_kid];
+		pb->kvt = (kvt_round == white_round ? pb_kvt[white_round % PB_SLOTS] : -1.0);
+		pb->prev_kvt = (white_round > 1 ? pb_kvt[(white_round - 1) % PB_SLOTS] : -1.0);
+
+		__sync_synchronize();
+	} while (white_round != pb_white_round || kvt_round != pb_kvt_round);
+
+	// Keep track of what the destination kernel will know
+	if (white_round > pb_told_white[dst_kid])
+		pb_told_white[dst_kid] = white_round;
+	if (pb->kvt >= 0.0)
+		kvt_round = white_round;
+	else if (white_round > 0)
+		kvt_round = white_round - 1;
+	if (kvt_round > pb_told_kvt[dst_kid])
+		pb_told_kvt[dst_kid] = kvt_round;
 }
 
 
@@ -261,6 +366,8 @@ void enter_red_phase(void)
 	if (unlikely(in_red_phase())) {
 		rootsim_error(true, "Thread %u cannot enter in red phase because is already in red phase.\n", local_tid);
 	}
+	// White messages still aggregated must not wait for the next scheduling step
+	flush_remote_msgs();
 	min_outgoing_red_msg[local_tid] = INFTY;
 	threads_phase_colour[local_tid] = next_colour(threads_phase_colour[local_tid]);
 }
@@ -281,6 +388,8 @@ void exit_red_phase(void)
 	if (unlikely(!in_red_phase())) {
 		rootsim_error(true, "Thread %u cannot exit from red phase because it wasn't in red phase.\n", local_tid);
 	}
+	flush_remote_msgs();
+	wait_handed_off_buffers();
 	threads_phase_colour[local_tid] = next_colour(threads_phase_colour[local_tid]);
 }
 
@@ -297,6 +406,10 @@ void exit_red_phase(void)
  * After the collective reduction will be terminated `expected_white_msg`
  * will hold the number of white message sent by all the other kernel to this during
  * the last white phase.
+ *
+ * If GVT information is piggybacked, no collective operation is started:
+ * the number of white messages sent to each kernel is made available to
+ * gvt_piggyback_stamp() instead.
  */
 void join_white_msg_redux(void)
 {
@@ -305,9 +418,14 @@ void join_white_msg_redux(void)
 		white_msg_sent_buff[i] = atomic_read(&white_msg_sent[i]);
 	}
 
-	lock_mpi();
-	MPI_Ireduce_scatter_block(white_msg_sent_buff, &expected_white_msg, 1, MPI_INT, MPI_SUM, white_count_comm, &white_count_req);
-	unlock_mpi();
+	if (rootsim_config.gvt_mode == GVT_MODE_PIGGYBACK) {
+		__sync_synchronize();
+		pb_white_round = gvt_init_round;
+		timer_start(pb_timer);
+		return;
+	}
+
+	transport->white_redux(white_msg_sent_buff, &expected_white_msg);
 }
 
 
@@ -322,6 +440,9 @@ void join_white_msg_redux(void)
  * as a lock guard is used to ensure that only one thread at a time
  * performs the check.
  *
+ * If GVT information is piggybacked, the operation is completed as soon
+ * as all remote kernels have told us how many white messages they sent.
+ *
  * @return @c true if the reduction operation is completed,
  *         @c false otherwise.
  */
@@ -331,7 +452,10 @@ bool white_msg_redux_completed(void)
 		return false;
 
 	bool compl = false;
-	compl = is_request_completed(&white_count_req);
+	if (rootsim_config.gvt_mode == GVT_MODE_PIGGYBACK)
+		compl = pb_white_msg_known(gvt_init_round);
+	else
+		compl = transport->white_redux_done();
 
 	spin_unlock(&white_count_lock);
 	return compl;
@@ -348,7 +472,7 @@ bool white_msg_redux_completed(void)
  */
 void wait_white_msg_redux(void)
 {
-	MPI_Wait(&white_count_req, MPI_STATUS_IGNORE);
+	while (!transport->white_redux_done());
 }
 
 
@@ -446,20 +570,8 @@ void flush_white_msg_sent(void)
  */
 void broadcast_gvt_init(unsigned int round)
 {
-	unsigned int i;
-
 	gvt_init_round = round;
-
-	for (i = 0; i < n_ker; i++) {
-		if (i == kid)
-			continue;
-		if (!is_request_completed(&(gvt_init_reqs[i]))) {
-			rootsim_error(true, "Failed to send new GVT init round to kernel %u, because the old init request is still pending\n", i);
-		}
-		lock_mpi();
-		MPI_Isend((const void *)&gvt_init_round, 1, MPI_UNSIGNED, i, MSG_NEW_GVT, MPI_COMM_WORLD, &gvt_init_reqs[i]);
-		unlock_mpi();
-	}
+	transport->gvt_init_send(round);
 }
 
 
@@ -476,24 +588,20 @@ void broadcast_gvt_init(unsigned int round)
  */
 bool gvt_init_pending(void)
 {
-	return pending_msgs(MSG_NEW_GVT);
+	return transport->gvt_init_pending();
 }
 
 
 /**
- * @brief Forcely extract GVT-init message from MPI.
+ * @brief Forcely extract GVT-init message from the transport.
  *
  * This function synchronously extracts messages related to GVT initiation
- * from the MPI library. This should be called as a fallback strategy
- * if gvt_init_pending() determined that a clean shutdown of the
- * communication subsystem is not possible at present time.
+ * from the transport, once gvt_init_pending() has told that a new GVT
+ * round has been started by the master kernel.
  */
 void gvt_init_clear(void)
 {
-	unsigned int new_gvt_round;
-	lock_mpi();
-	MPI_Recv(&new_gvt_round, 1, MPI_UNSIGNED, MPI_ANY_SOURCE, MSG_NEW_GVT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-	unlock_mpi();
+	gvt_init_round = transport->gvt_init_recv();
 }
 
 
@@ -505,19 +613,29 @@ void gvt_init_clear(void)
  * GVT value, and this value has been posted by some thread in @ref
  * local_vt_buff.
  *
- * The goal of this function is to use an All Reduce non-blocking primitive
- * to compute the minimum among the values which have been posted by
- * all kernel instances in @ref local_vt_buff.
+ * The goal of this function is to use a non-blocking collective operation
+ * of the transport to compute the minimum among the values which have
+ * been posted by all kernel instances in @ref local_vt_buff.
  *
  * Eventually, the minimum will be stored in @ref reduced_gvt of all
  * kernel instances.
+ *
+ * If GVT information is piggybacked, the proposal is only made available
+ * to gvt_piggyback_stamp(), and the minimum is computed locally.
  */
 void join_gvt_redux(simtime_t local_vt)
 {
 	local_vt_buff = local_vt;
-	lock_mpi();
-	MPI_Iallreduce(&local_vt_buff, &reduced_gvt, 1, MPI_DOUBLE, MPI_MIN, gvt_reduction_comm, &gvt_reduction_req);
-	unlock_mpi();
+
+	if (rootsim_config.gvt_mode == GVT_MODE_PIGGYBACK) {
+		pb_kvt[gvt_init_round % PB_SLOTS] = local_vt;
+		__sync_synchronize();
+		pb_kvt_round = gvt_init_round;
+		timer_start(pb_timer);
+		return;
+	}
+
+	transport->gvt_redux(&local_vt_buff, &reduced_gvt);
 }
 
 
@@ -542,7 +660,10 @@ bool gvt_redux_completed(void)
 		return false;
 
 	bool compl = false;
-	compl = is_request_completed(&gvt_reduction_req);
+	if (rootsim_config.gvt_mode == GVT_MODE_PIGGYBACK)
+		compl = pb_kvt_known(gvt_init_round);
+	else
+		compl = transport->gvt_redux_done();
 
 	spin_unlock(&gvt_reduction_lock);
 	return compl;
@@ -586,6 +707,20 @@ simtime_t last_reduced_gvt(void)
  *
  * @param msg The message to register as an outgoing message.
  */
+static inline void register_outgoing(GID_t receiver, phase_colour colour, simtime_t timestamp)
+{
+	unsigned int dst_kid = find_kernel_by_gid(receiver);
+
+	if (dst_kid == kid)
+		return;
+
+	if (is_red_colour(colour)) {
+		min_outgoing_red_msg[local_tid] = min(min_outgoing_red_msg[local_tid], timestamp);
+	} else {
+		atomic_inc(&white_msg_sent[dst_kid]);
+	}
+}
+
 void register_outgoing_msg(const msg_t *msg)
 {
 #ifdef HAVE_CROSS_STATE
@@ -593,16 +728,21 @@ void register_outgoing_msg(const msg_t *msg)
 		return;
 #endif
 
-	unsigned int dst_kid = find_kernel_by_gid(msg->receiver);
+	register_outgoing(msg->receiver, msg->colour, msg->timestamp);
+}
 
-	if (dst_kid == kid)
-		return;
 
-	if (is_red_colour(msg->colour)) {
-		min_outgoing_red_msg[local_tid] = min(min_outgoing_red_msg[local_tid], msg->timestamp);
-	} else {
-		atomic_inc(&white_msg_sent[dst_kid]);
-	}
+/**
+ * @brief Register an outgoing antimessage.
+ *
+ * Antimessages are accounted for in the GVT reduction exactly as
+ * messages are, see register_outgoing_msg().
+ *
+ * @param anti The antimessage to register as an outgoing message.
+ */
+void register_outgoing_antimsg(const antimsg_t *anti)
+{
+	register_outgoing(anti->receiver, anti->colour, anti->timestamp);
 }
 
 
@@ -620,6 +760,20 @@ void register_outgoing_msg(const msg_t *msg)
  *
  * @param msg The message to register as an incoming message.
  */
+static inline void register_incoming(GID_t sender, phase_colour colour)
+{
+	unsigned int src_kid = find_kernel_by_gid(sender);
+
+	if (src_kid == kid)
+		return;
+
+	if (colour == white_0) {
+		atomic_inc(&white_0_msg_recv);
+	} else if (colour == white_1) {
+		atomic_inc(&white_1_msg_recv);
+	}
+}
+
 void register_incoming_msg(const msg_t * msg)
 {
 #ifdef HAVE_CROSS_STATE
@@ -627,16 +781,128 @@ void register_incoming_msg(const msg_t * msg)
 		return;
 #endif
 
-	unsigned int src_kid = find_kernel_by_gid(msg->sender);
+	register_incoming(msg->sender, msg->colour);
+}
 
-	if (src_kid == kid)
+
+/**
+ * @brief Register an incoming antimessage.
+ *
+ * Antimessages are accounted for in the GVT reduction exactly as
+ * messages are, see register_incoming_msg().
+ *
+ * @param anti The antimessage to register as an incoming message.
+ */
+void register_incoming_antimsg(const antimsg_t *anti)
+{
+	register_incoming(anti->sender, anti->colour);
+}
+
+
+/**
+ * @brief Piggyback GVT information on an outgoing message.
+ *
+ * Any message sent to a remote kernel carries the number of white messages
+ * sent to that kernel and the KVT proposals of the sender kernel, so that
+ * remote kernels can compute the GVT without relying on any collective
+ * operation.
+ *
+ * @note This function is thread-safe.
+ *
+ * @param msg The message which is being sent
+ * @param dst_kid The id of the kernel which will receive @p msg
+ */
+void gvt_piggyback_stamp(msg_t *msg, unsigned int dst_kid)
+{
+	if (rootsim_config.gvt_mode != GVT_MODE_PIGGYBACK)
 		return;
 
-	if (msg->colour == white_0) {
-		atomic_inc(&white_0_msg_recv);
-	} else if (msg->colour == white_1) {
-		atomic_inc(&white_1_msg_recv);
+	pb_fill(&msg->piggyback, dst_kid);
+}
+
+
+/**
+ * @brief Collect GVT information piggybacked by a remote kernel.
+ *
+ * Information about old rounds is discarded. A remote kernel can be
+ * at most one GVT round ahead of this kernel, so that the knowledge
+ * kept for the current round is never overwritten.
+ *
+ * @note This function is thread-safe.
+ *
+ * @param pb A pointer to the piggybacked information
+ * @param src_kid The id of the kernel which sent @p pb
+ */
+void gvt_piggyback_merge(const gvt_piggyback *pb, unsigned int src_kid)
+{
+	struct _pb_knowledge *slot;
+
+	if (rootsim_config.gvt_mode != GVT_MODE_PIGGYBACK || pb->round == 0)
+		return;
+
+	spin_lock(&pb_lock);
+
+	slot = &pb_known[src_kid][pb->round % PB_SLOTS];
+	if (slot->round < pb->round) {
+		slot->round = pb->round;
+		slot->white_sent = -1;
+		slot->kvt = -1.0;
+	}
+	if (slot->round == pb->round) {
+		if (pb->white_sent >= 0)
+			slot->white_sent = pb->white_sent;
+		if (pb->kvt >= 0.0)
+			slot->kvt = pb->kvt;
+	}
+
+	if (pb->round > 1 && pb->prev_kvt >= 0.0) {
+		slot = &pb_known[src_kid][(pb->round - 1) % PB_SLOTS];
+		if (slot->round < pb->round - 1) {
+			slot->round = pb->round - 1;
+			slot->white_sent = -1;
+		}
+		if (slot->round == pb->round - 1)
+			slot->kvt = pb->prev_kvt;
 	}
+
+	spin_unlock(&pb_lock);
 }
 
-#endif
+
+/**
+ * @brief Make piggybacked GVT information progress.
+ *
+ * If the traffic towards some remote kernel is too sparse to carry our GVT
+ * information within @ref GVT_PIGGYBACK_FALLBACK milliseconds, the information
+ * is sent explicitly to that kernel. This function also collects the GVT
+ * information explicitly sent by remote kernels.
+ *
+ * @warning This function is not thread safe, and should be called by one
+ *          thread at a time.
+ */
+void gvt_piggyback_progress(void)
+{
+	unsigned int i, src_kid;
+	gvt_piggyback pb;
+
+	if (rootsim_config.gvt_mode != GVT_MODE_PIGGYBACK)
+		return;
+
+	while (transport->gvt_info_recv(&pb, &src_kid))
+		gvt_piggyback_merge(&pb, src_kid);
+
+	if (timer_value_milli(pb_timer) < GVT_PIGGYBACK_FALLBACK)
+		return;
+
+	for (i = 0; i < n_ker; i++) {
+		if (i == kid)
+			continue;
+		if (pb_told_white[i] >= pb_white_round && pb_told_kvt[i] >= pb_kvt_round)
+			continue;
+		if (!transport->gvt_info_ready(i))
+			continue;
+
+		pb_fill(&pb, i);
+		transport->gvt_info_send(&pb, i);
+	}
+}
@@ -37,8 +37,6 @@
 
 #pragma once
 
-#ifdef HAVE_MPI
-
 #include <core/core.h>
 
 /**
@@ -81,6 +79,13 @@ enum _msg_colours {
 /// Tells what is the next colour, using simple arithmetics
 #define next_colour(c) ( ((c)+1) & 0x3 )
 
+/**
+ * If GVT information to be piggybacked towards a remote kernel has not found
+ * any message to travel on within this number of milliseconds, it is sent
+ * explicitly.
+ */
+#define GVT_PIGGYBACK_FALLBACK 2
+
 extern phase_colour *threads_phase_colour;
 
 extern simtime_t *min_outgoing_red_msg;
@@ -103,5 +108,8 @@ bool gvt_redux_completed(void);
 simtime_t last_reduced_gvt(void);
 void register_incoming_msg(const msg_t *);
 void register_outgoing_msg(const msg_t *);
-
-#endif /* HAVE_MPI */
+void register_incoming_antimsg(const antimsg_t *);
+void register_outgoing_antimsg(const antimsg_t *);
+void gvt_piggyback_stamp(msg_t *msg, unsigned int dst_kid);
+void gvt_piggyback_merge(const gvt_piggyback *pb, unsigned int src_kid);
+void gvt_piggyback_progress(void);
@@ -1,10 +1,12 @@
 /**
 * @file communication/mpi.c
 *
-* @brief MPI Support Module
+* @brief Inter-kernel communication
 *
-* This module implements all basic MPI facilities to let the distributed
-* execution of a simulation model take place consistently.
+* This module implements all basic facilities to let the distributed
+* execution of a simulation model take place consistently. Kernels are
+* started, and communicate, through a transport: either MPI, or the
+* shared memory of a single host (see communication/shm.c).
 *
 * Several facilities are thread-safe, others are not. Check carefully which
 * of these can be used by worker threads without coordination when relying
@@ -31,19 +33,43 @@
 * @author Tommaso Tocci
 */
 
-#ifdef HAVE_MPI
-
 #include <stdbool.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
 
 #include <communication/mpi.h>
 #include <communication/wnd.h>
+#include <communication/shm.h>
 #include <communication/gvt.h>
 #include <communication/communication.h>
 #include <queues/queues.h>
 #include <core/core.h>
+#include <core/init.h>
 #include <arch/atomic.h>
+#include <arch/thread.h>
 #include <statistics/statistics.h>
 
+/// A guard to ensure isolation in the the message receiving routine
+static spinlock_t msgs_lock;
+
+/**
+ * This counter tells how many simulation kernel instances have already
+ * reached the termination condition. This is updated via collect_termination().
+ */
+static unsigned int terminated = 0;
+
+/// A guard to ensure isolation in collect_termination()
+static spinlock_t msgs_fini;
+
+/// Tag of the buffers of aggregated events
+#define MSG_TAG_EVENTS		0
+
+/// Tag of the buffers of aggregated antimessages, see @ref antimsg_t
+#define MSG_TAG_ANTIMSGS	1
+
+#ifdef HAVE_MPI
+
 /// Flag telling whether the MPI runtime supports multithreading
 bool mpi_support_multithread;
 
@@ -54,21 +80,9 @@ bool mpi_support_multithread;
  */
 spinlock_t mpi_lock;
 
-/// A guard to ensure isolation in the the message receiving routine
-static spinlock_t msgs_lock;
-
-/**
- * This counter tells how many simulation kernel instances have already
- * reached the termination condition. This is updated via collect_termination().
- */
-static unsigned int terminated = 0;
-
 /// MPI Requests to handle termination detection collection asynchronously
 static MPI_Request *termination_reqs;
 
-/// A guard to ensure isolation in collect_termination()
-static spinlock_t msgs_fini;
-
 /// MPI Operation to reduce statics
 static MPI_Op reduce_stats_op;
 
@@ -78,27 +92,151 @@ static MPI_Datatype stats_mpi_t;
 /**
  * @brief MPI Communicator for event/control messages.
  *
- * To enable zero-copy message passing, we must know what LP is the destination
- * of an event, @e before extracting that event from the MPI layer. This
- * is necessary to determine from what slab/buddy the memory to keep
- * the event must be taken. Yet, this is impossible because the MPI layer
- * does not allow to do so.
+ * A separate MPI Communicator is used @e only to exchange events across LPs
+ * (control messages also fall in this category), so that the receive
+ * buffers which are kept posted on it can never match messages used by
+ * the runtime for other purposes.
  *
- * To actually be able to do that, the trick is to create a separate
- * MPI Communicator which is used @e only to exchance events across LPs
- * (control messages also fall in this category). Then, since we can
- * extract events from this communicator, we can match against both
- * MPI_ANY_SOURCE (to receive events from any simulation kernel instance)
- * and MPI_ANY_TAG (to match independently of the tag).
- *
- * We therefore use the tag to identify the GID of the LP.
- *
- * We can retrieve the information about the message sender and the size
- * of the message which will be extracted by inspecting the MPI_Status
- * variable after an MPI_Iprobe is completed.
+ * Events and antimessages are aggregated in separate buffers, each record
+ * carrying the GID of its destination LP. Buffers land in a ring of receive
+ * buffers which are kept posted for each remote kernel, and their tag tells
+ * what they keep. Buffers of events larger than the ring ones are announced
+ * on the ring with the @ref MSG_TAG_ANNOUNCE tag, and sent on @ref large_comm.
  */
 static MPI_Comm msg_comm;
 
+/// MPI Communicator for the buffers which are too large for the ring, received on demand
+static MPI_Comm large_comm;
+
+/// Tag of the announce of a buffer of events which is too large for the ring
+#define MSG_TAG_ANNOUNCE	2
+
+/**
+ * Buffers sent on @ref large_comm are tagged with a per-destination sequence
+ * number, carried by their announce, modulo this value. Announces and large
+ * buffers are not posted atomically with respect to other threads, so their
+ * order on the two communicators may differ. MPI guarantees tags up to 32767.
+ */
+#define LARGE_TAGS		32768
+
+/**
+ * Separate MPI communicator to carry out the reduction of white
+ * messages. This communicator lives for the whole duration of the
+ * simulation.
+ */
+static MPI_Comm white_count_comm;
+
+/// MPI Request operation to implement the asynchronous counting of white messages
+static MPI_Request white_count_req;
+
+/// Separate MPI communicator to carry out the reduction of the GVT
+static MPI_Comm gvt_reduction_comm;
+
+/// MPI Request operation to implement the distributed reduction of the current GVT value
+static MPI_Request gvt_reduction_req;
+
+/**
+ * A vector of MPI asynchronous operations used to communicate with all
+ * kernel instances in the distributed run in order to initiate the GVT
+ * reduction protocol.
+ */
+static MPI_Request *gvt_init_reqs;
+
+/// The GVT round being started, kept stable for the sends in @ref gvt_init_reqs
+static unsigned int gvt_init_buff;
+
+/// Buffers to explicitly send GVT information to remote kernels we have no traffic with
+static gvt_piggyback *pb_fallback_buff;
+
+/// MPI Requests associated with the sends from @ref pb_fallback_buff
+static MPI_Request *pb_fallback_reqs;
+
+#endif /* HAVE_MPI */
+
+/**
+ * Messages directed to the same remote kernel are aggregated by each thread
+ * in buffers which are handed to MPI only once they reach this size, unless
+ * they are explicitly flushed before.
+ */
+#define AGGREGATION_BUFFER_MAX	((size_t)64 * 1024)
+
+/// Initial size of an aggregation buffer, which is grown on demand up to @ref AGGREGATION_BUFFER_MAX
+#define AGGREGATION_BUFFER_MIN	((size_t)4096)
+
+/// Per-thread buffers, one for each remote kernel, in which outgoing messages are aggregated
+static __thread outgoing_msg **aggr_buffers;
+
+/// Per-thread buffers, one for each remote kernel, in which outgoing antimessages are aggregated
+static __thread outgoing_msg **anti_buffers;
+
+#ifdef HAVE_MPI
+
+/// Number of receive buffers which are kept posted for each remote kernel
+#define RECV_RING_SLOTS		4
+
+/// Index of the @p slot-th receive buffer for remote kernel @p peer
+#define ring_idx(peer, slot)	((peer) * RECV_RING_SLOTS + (slot))
+
+/**
+ * Requests of the pre-posted receive buffers, @ref RECV_RING_SLOTS for each
+ * remote kernel. Access to the ring is serialized by @ref msgs_lock, or
+ * performed by the communication thread only.
+ */
+static MPI_Request *recv_reqs;
+
+/// The pre-posted receive buffers, each one of @ref AGGREGATION_BUFFER_MAX bytes
+static unsigned char **recv_bufs;
+
+/// Bytes received in each buffer whose request has completed, -1 if not completed
+static int *recv_sizes;
+
+/// Tag of each buffer whose request has completed
+static int *recv_tags;
+
+/// For each remote kernel, the slot which was posted first and not yet consumed
+static unsigned int *recv_head;
+
+/// Scratch space for MPI_Testsome()
+static int *recv_completed;
+
+/// Scratch space for MPI_Testsome()
+static MPI_Status *recv_statuses;
+
+/// Sequence number of the next buffer too large for the ring sent to each kernel
+static unsigned int *large_seq;
+
+#endif /* HAVE_MPI */
+
+/**
+ * If the communication thread is enabled, each worker thread hands off the
+ * buffers of aggregated messages to it by pushing them on its own lock-free
+ * stack. The communication thread detaches the whole stack at once.
+ */
+static outgoing_msg *volatile *handoff_stacks;
+
+/// Number of buffers handed off by the calling worker thread to the communication thread
+static __thread unsigned long handed_off;
+
+/// Number of buffers of each worker thread which the communication thread has passed to the transport
+static volatile unsigned long *handoff_sent;
+
+/// The communication thread, which performs all the message passing across kernels if enabled
+static pthread_t comm_tid;
+
+/// Tells the communication thread to exit
+static volatile bool comm_thread_stop;
+
+/// The transport across kernels in use, as selected with @c --transport
+const struct transport *transport;
+
+/// The number of buffers of aggregated messages sent to each kernel since the last quiescence
+static atomic_t *buffers_sent;
+
+/// The number of buffers of aggregated messages delivered since the last quiescence
+static atomic_t buffers_delivered;
+
+
+#ifdef HAVE_MPI
 
 /**
  * @brief Check if there are pending messages
@@ -150,13 +288,194 @@ bool is_request_completed(MPI_Request *req)
 	return (bool)flag;
 }
 
+/**
+ * @brief Hand a buffer of aggregated messages to MPI
+ *
+ * The buffer is registered into the outgoing queue of the destination
+ * kernel, in order to allow MPI to keep track of the sending operation.
+ *
+ * @param out_msg The buffer to send
+ * @param dest The id of the destination kernel
+ */
+static void post_remote_buffer(outgoing_msg *out_msg, unsigned int dest)
+{
+	lock_mpi();
+	if (likely(out_msg->size <= AGGREGATION_BUFFER_MAX)) {
+		MPI_Isend(out_msg->data, out_msg->size, MPI_BYTE, dest, out_msg->tag, msg_comm, &out_msg->req);
+	} else {
+		// Too large for the receive ring: announce it, then let the receiver extract it
+		out_msg->announce.size = out_msg->size;
+		out_msg->announce.tag = __sync_fetch_and_add(&large_seq[dest], 1) % LARGE_TAGS;
+		MPI_Isend(&out_msg->announce, sizeof(out_msg->announce), MPI_BYTE, dest, MSG_TAG_ANNOUNCE, msg_comm, &out_msg->announce_req);
+		MPI_Isend(out_msg->data, out_msg->size, MPI_BYTE, dest, (int)out_msg->announce.tag, large_comm, &out_msg->req);
+	}
+	unlock_mpi();
+
+	// Keep the buffer in the outgoing queue until it will be delivered
+	store_outgoing_msg(out_msg, dest);
+}
+
+#endif /* HAVE_MPI */
+
+/**
+ * @brief Send a buffer of aggregated messages towards a remote kernel
+ *
+ * If the communication thread is enabled, the buffer is handed off to it.
+ *
+ * @param out_msg The buffer to send
+ * @param dest The id of the destination kernel
+ */
+static void send_remote_buffer(outgoing_msg *out_msg, unsigned int dest)
+{
+	outgoing_msg *head;
+
+	statistics_post_data(NULL, STAT_MPI_SEND, out_msg->count);
+	atomic_inc(&buffers_sent[dest]);
+
+	if (rootsim_config.comm_thread) {
+		out_msg->dest_kid = dest;
+		handed_off++;
+		do {
+			head = handoff_stacks[local_tid];
+			out_msg->next = head;
+		} while (!__sync_bool_compare_and_swap(&handoff_stacks[local_tid], head, out_msg));
+		return;
+	}
+
+	transport->send(out_msg, dest);
+}
+
+/**
+ * @brief Wait until the buffers handed off to the communication thread are sent
+ *
+ * A buffer is accounted by the GVT reduction as soon as it is handed off,
+ * but it is in transit only once the transport has taken it. With the
+ * shared-memory transport, the communication thread can be blocked for a
+ * while on a full ring, so a thread leaving the red phase waits for its red
+ * messages to be actually sent: otherwise, they could reach their
+ * destination after the next GVT reduction, which does not account for them.
+ *
+ * If the communication thread is not enabled, buffers are passed to the
+ * transport right away, and this function does nothing.
+ */
+void wait_handed_off_buffers(void)
+{
+	if (!rootsim_config.comm_thread)
+		return;
+
+	while (handoff_sent[local_tid] != handed_off)
+		sched_yield();
+
+	// Do not let anything which follows overtake the sends
+	__sync_synchronize();
+}
+
+/**
+ * @brief Send the aggregated messages towards a remote kernel
+ *
+ * This function sends the buffers which the calling thread has been
+ * filling with messages and antimessages directed to the simulation
+ * kernel @p dest. Messages are sent first: an antimessage can never
+ * reach its destination before the message it annihilates.
+ *
+ * @param dest The id of the destination kernel
+ */
+static void flush_remote_buffer(unsigned int dest)
+{
+	if (aggr_buffers[dest] != NULL) {
+		send_remote_buffer(aggr_buffers[dest], dest);
+		aggr_buffers[dest] = NULL;
+	}
+
+	if (anti_buffers[dest] != NULL) {
+		send_remote_buffer(anti_buffers[dest], dest);
+		anti_buffers[dest] = NULL;
+	}
+}
+
+/**
+ * @brief Get room in an aggregation buffer
+ *
+ * This function returns the buffer of the calling thread which aggregates
+ * the messages (or antimessages, depending on @p tag) directed to the
+ * simulation kernel @p dest, making sure that @p len more bytes fit in it.
+ * The buffer is grown if possible, or sent if full. In the latter case,
+ * a new buffer is returned.
+ *
+ * @param dest The id of the destination kernel
+ * @param tag Either @ref MSG_TAG_EVENTS or @ref MSG_TAG_ANTIMSGS
+ * @param len The number of bytes which are going to be packed
+ *
+ * @return The buffer where @p len bytes can be packed
+ */
+static outgoing_msg *get_aggregation_buffer(unsigned int dest, int tag, size_t len)
+{
+	outgoing_msg **buffers;
+	outgoing_msg *out_msg;
+	size_t capacity;
+
+	if (unlikely(aggr_buffers == NULL)) {
+		aggr_buffers = rsalloc(n_ker * sizeof(*aggr_buffers));
+		bzero(aggr_buffers, n_ker * sizeof(*aggr_buffers));
+		anti_buffers = rsalloc(n_ker * sizeof(*anti_buffers));
+		bzero(anti_buffers, n_ker * sizeof(*anti_buffers));
+	}
+
+	buffers = tag == MSG_TAG_ANTIMSGS ? anti_buffers : aggr_buffers;
+	out_msg = buffers[dest];
+	if (out_msg != NULL && out_msg->size + len > out_msg->capacity) {
+		if (out_msg->size + len > AGGREGATION_BUFFER_MAX) {
+			flush_remote_buffer(dest);
+			out_msg = NULL;
+		} else {
+			capacity = max(2 * out_msg->capacity, out_msg->size + len);
+			capacity = min(capacity, AGGREGATION_BUFFER_MAX);
+			out_msg = rsrealloc(out_msg, sizeof(outgoing_msg) + capacity);
+			out_msg->capacity = capacity;
+			buffers[dest] = out_msg;
+		}
+	}
+
+	if (out_msg == NULL) {
+		out_msg = allocate_outgoing_msg(max(len, AGGREGATION_BUFFER_MIN));
+		out_msg->tag = tag;
+		buffers[dest] = out_msg;
+	}
+
+	return out_msg;
+}
+
+/**
+ * @brief Send all the aggregated messages
+ *
+ * Messages sent to remote LPs are kept in per-thread buffers, one for each
+ * destination kernel. This function hands all the non-empty buffers of the
+ * calling thread to the transport. It is called at the end of each scheduling step
+ * and upon GVT phase transitions, so that no message is ever retained
+ * for long.
+ *
+ * @note This function is thread-safe.
+ */
+void flush_remote_msgs(void)
+{
+	unsigned int i;
+
+	if (aggr_buffers == NULL)
+		return;
+
+	for (i = 0; i < n_ker; i++)
+		flush_remote_buffer(i);
+}
+
 /**
  * @brief Send a message to a remote LP
  *
  * This function takes in charge an event to be delivered to a remote LP.
- * The sending operation is non-blocking: to this end, the message is
- * registered into the outgoing queue of the destination kernel, in order
- * to allow MPI to keep track of the sending operation.
+ * The message is packed into the buffer of the calling thread which
+ * aggregates the messages directed to the same remote kernel. The buffer
+ * is handed to the transport once it is full, or when flush_remote_msgs()
+ * is called.
+ * Since the message is copied, it is released right away.
  *
  * Also, the message being sent is registered at the sender thread, to
  * keep track of the white/red message information which is necessary
@@ -168,90 +487,460 @@ bool is_request_completed(MPI_Request *req)
  */
 void send_remote_msg(msg_t *msg)
 {
-	outgoing_msg *out_msg = allocate_outgoing_msg();
-	out_msg->msg = msg;
-	out_msg->msg->colour = threads_phase_colour[local_tid];
 	unsigned int dest = find_kernel_by_gid(msg->receiver);
+	size_t len = MSG_META_SIZE + msg->size;
+	outgoing_msg *out_msg;
+
+	msg->colour = threads_phase_colour[local_tid];
+	register_outgoing_msg(msg);
+	gvt_piggyback_stamp(msg, dest);
 
-	register_outgoing_msg(out_msg->msg);
+	out_msg = get_aggregation_buffer(dest, MSG_TAG_EVENTS, len);
+	memcpy(out_msg->data + out_msg->size, ((char *)msg) + MSG_PADDING, len);
+	out_msg->size += len;
+	out_msg->count++;
 
+	msg_release(msg);
+}
+
+/**
+ * @brief Send an antimessage to a remote LP
+ *
+ * This function is the counterpart of send_remote_msg() for antimessages,
+ * which are aggregated in buffers separate from the ones of messages. No
+ * GVT information is piggybacked on antimessages.
+ *
+ * @note This function is thread-safe.
+ *
+ * @param anti A pointer to the antimessage to be sent remotely. It is copied,
+ *             so it can be released (or be on the stack) upon return.
+ */
+void send_remote_antimsg(antimsg_t *anti)
+{
+	unsigned int dest = find_kernel_by_gid(anti->receiver);
+	outgoing_msg *out_msg;
+
+	anti->colour = threads_phase_colour[local_tid];
+	register_outgoing_antimsg(anti);
+
+	out_msg = get_aggregation_buffer(dest, MSG_TAG_ANTIMSGS, sizeof(*anti));
+	memcpy(out_msg->data + out_msg->size, anti, sizeof(*anti));
+	out_msg->size += sizeof(*anti);
+	out_msg->count++;
+}
+
+/**
+ * @brief Unpack a buffer of aggregated messages
+ *
+ * Each message packed in the buffer is copied into a buffer taken from
+ * the slab class of the destination LP fitting its size (or from the pools
+ * of large buffers, if it is too large) and placed in the bottom half of
+ * the destination LP.
+ *
+ * @param data The buffer received from the transport
+ * @param size The size of the buffer in bytes
+ * @param src_kid The id of the kernel which sent the buffer
+ */
+static void unpack_remote_msgs(const unsigned char *data, size_t size, unsigned int src_kid)
+{
+	msg_t hdr;
+	msg_t *msg;
+	size_t len;
+
+	while (size > 0) {
+		// Messages are packed without any alignment: peek at the header first
+		memcpy(((char *)&hdr) + MSG_PADDING, data, MSG_META_SIZE);
+		len = MSG_META_SIZE + hdr.size;
+
+		msg = get_msg_buffer(find_lp_by_gid(hdr.receiver), hdr.size);
+		memcpy(((char *)msg) + MSG_PADDING, data, len);
+
+		validate_msg(msg);
+		gvt_piggyback_merge(&msg->piggyback, src_kid);
+		insert_bottom_half(msg);
+
+		data += len;
+		size -= len;
+	}
+}
+
+/**
+ * @brief Unpack a buffer of aggregated antimessages
+ *
+ * Each antimessage is copied into a buffer taken from the antimessage slab
+ * of the destination LP, and placed in its antimessage bottom half.
+ *
+ * @param data The buffer received from the transport
+ * @param size The size of the buffer in bytes
+ */
+static void unpack_remote_antimsgs(const unsigned char *data, size_t size)
+{
+	antimsg_t remote;
+	antimsg_t *anti;
+
+	while (size >= sizeof(remote)) {
+		memcpy(&remote, data, sizeof(remote));
+		anti = get_antimsg_from_slab(find_lp_by_gid(remote.receiver));
+		*anti = remote;
+		insert_antimsg_bottom_half(anti);
+
+		data += sizeof(remote);
+		size -= sizeof(remote);
+	}
+}
+
+/**
+ * @brief Deliver a buffer received from a remote kernel
+ *
+ * This is the entry point of all transports, once a buffer of aggregated
+ * messages or antimessages has been received.
+ *
+ * @param data The buffer
+ * @param size The size of the buffer in bytes
+ * @param tag The tag of the buffer, telling what it keeps
+ * @param src_kid The id of the kernel which sent the buffer
+ */
+void deliver_remote_buffer(const unsigned char *data, size_t size, int tag, unsigned int src_kid)
+{
+	atomic_inc(&buffers_delivered);
+
+	switch (tag) {
+	case MSG_TAG_EVENTS:
+		unpack_remote_msgs(data, size, src_kid);
+		break;
+
+	case MSG_TAG_ANTIMSGS:
+		unpack_remote_antimsgs(data, size);
+		break;
+
+	default:
+		rootsim_error(true, "Received a buffer with unknown tag %d from kernel %u\n", tag, src_kid);
+	}
+}
+
+#ifdef HAVE_MPI
+
+/**
+ * @brief Post a receive buffer of the ring
+ *
+ * @param peer The remote kernel whose buffers are received in this slot
+ * @param idx The index of the slot, as computed by ring_idx()
+ */
+static void post_ring_slot(unsigned int peer, unsigned int idx)
+{
+	recv_sizes[idx] = -1;
 	lock_mpi();
-	MPI_Isend(((char *)out_msg->msg) + MSG_PADDING, MSG_META_SIZE + msg->size, MPI_BYTE, dest, msg->receiver.to_int, msg_comm, &out_msg->req);
+	MPI_Irecv(recv_bufs[idx], AGGREGATION_BUFFER_MAX, MPI_BYTE, peer, MPI_ANY_TAG, msg_comm, &recv_reqs[idx]);
 	unlock_mpi();
+}
 
-	// Keep the message in the outgoing queue until it will be delivered
-	store_outgoing_msg(out_msg, dest);
+/**
+ * @brief Deliver the content of a receive buffer of the ring
+ *
+ * A buffer either keeps aggregated messages or antimessages, or announces
+ * that a buffer too large for the ring follows. In the latter case, the
+ * large buffer is extracted right away, so that messages are delivered in
+ * the same order in which they were sent.
+ *
+ * @param peer The remote kernel which sent the buffer
+ * @param idx The index of the slot keeping the buffer
+ */
+static void deliver_ring_slot(unsigned int peer, unsigned int idx)
+{
+	struct large_announce announce;
+	unsigned char *large;
+
+	if (recv_tags[idx] != MSG_TAG_ANNOUNCE) {
+		deliver_remote_buffer(recv_bufs[idx], recv_sizes[idx], recv_tags[idx], peer);
+		return;
+	}
+
+	memcpy(&announce, recv_bufs[idx], sizeof(announce));
+	large = rsalloc(announce.size);
+
+	// The buffer is matched by the tag in its announce: other large buffers could precede it
+	lock_mpi();
+	MPI_Recv(large, announce.size, MPI_BYTE, peer, (int)announce.tag, large_comm, MPI_STATUS_IGNORE);
+	unlock_mpi();
+
+	deliver_remote_buffer(large, announce.size, MSG_TAG_EVENTS, peer);
+	rsfree(large);
+}
+
+/**
+ * @brief Extract all the pending remote messages
+ *
+ * This function harvests with MPI_Testsome() the receive buffers of the ring
+ * which have been filled, and unpacks them. Since MPI matches the messages
+ * of a remote kernel against its receive buffers in the order in which they
+ * were posted, buffers are consumed in that order as well, and each one is
+ * posted again right away.
+ *
+ * @warning This function is not thread safe, and should be called by one
+ *          thread at a time.
+ *
+ * @return @c true if at least one buffer has been extracted, @c false otherwise
+ */
+static bool drain_remote_msgs(void)
+{
+	int outcount, i;
+	unsigned int peer, idx;
+	bool received = false;
+
+	lock_mpi();
+	MPI_Testsome(n_ker * RECV_RING_SLOTS, recv_reqs, &outcount, recv_completed, recv_statuses);
+	unlock_mpi();
+
+	if (outcount == MPI_UNDEFINED || outcount == 0)
+		return false;
+
+	for (i = 0; i < outcount; i++) {
+		MPI_Get_count(&recv_statuses[i], MPI_BYTE, &recv_sizes[recv_completed[i]]);
+		recv_tags[recv_completed[i]] = recv_statuses[i].MPI_TAG;
+	}
+
+	for (peer = 0; peer < n_ker; peer++) {
+		if (peer == kid)
+			continue;
+
+		while (recv_sizes[(idx = ring_idx(peer, recv_head[peer]))] >= 0) {
+			deliver_ring_slot(peer, idx);
+			post_ring_slot(peer, idx);
+			recv_head[peer] = (recv_head[peer] + 1) % RECV_RING_SLOTS;
+			received = true;
+		}
+	}
+
+	return received;
+}
+
+/**
+ * @brief Setup the ring of pre-posted receive buffers
+ */
+static void recv_ring_init(void)
+{
+	unsigned int peer, slot, n = n_ker * RECV_RING_SLOTS;
+
+	recv_reqs = rsalloc(n * sizeof(*recv_reqs));
+	recv_bufs = rsalloc(n * sizeof(*recv_bufs));
+	recv_sizes = rsalloc(n * sizeof(*recv_sizes));
+	recv_tags = rsalloc(n * sizeof(*recv_tags));
+	recv_head = rsalloc(n_ker * sizeof(*recv_head));
+	recv_completed = rsalloc(n * sizeof(*recv_completed));
+	recv_statuses = rsalloc(n * sizeof(*recv_statuses));
+	large_seq = rsalloc(n_ker * sizeof(*large_seq));
+
+	for (peer = 0; peer < n_ker; peer++) {
+		recv_head[peer] = 0;
+		large_seq[peer] = 0;
+		for (slot = 0; slot < RECV_RING_SLOTS; slot++) {
+			recv_reqs[ring_idx(peer, slot)] = MPI_REQUEST_NULL;
+			recv_sizes[ring_idx(peer, slot)] = -1;
+			recv_bufs[ring_idx(peer, slot)] = NULL;
+			if (peer == kid)
+				continue;
+			recv_bufs[ring_idx(peer, slot)] = rsalloc(AGGREGATION_BUFFER_MAX);
+			post_ring_slot(peer, ring_idx(peer, slot));
+		}
+	}
 }
 
+/**
+ * @brief Cancel the receive buffers which are still posted, and release the ring
+ */
+static void recv_ring_fini(void)
+{
+	unsigned int i, n = n_ker * RECV_RING_SLOTS;
+
+	for (i = 0; i < n; i++) {
+		if (recv_reqs[i] != MPI_REQUEST_NULL) {
+			MPI_Cancel(&recv_reqs[i]);
+			MPI_Wait(&recv_reqs[i], MPI_STATUS_IGNORE);
+		}
+		rsfree(recv_bufs[i]);
+	}
+
+	rsfree(recv_reqs);
+	rsfree(recv_bufs);
+	rsfree(recv_sizes);
+	rsfree(recv_tags);
+	rsfree(recv_head);
+	rsfree(recv_completed);
+	rsfree(recv_statuses);
+	rsfree(large_seq);
+}
+
+#endif /* HAVE_MPI */
+
 /**
  * @brief Receive remote messages
  *
- * This function extracts from MPI events destined to locally-hosted
- * LPs. Only messages to LP can be extracted here, because the probing
- * is done towards the @ref msg_comm communicator.
+ * This function extracts from the transport events destined to
+ * locally-hosted LPs.
  *
- * A message which is extracted here is placed (out of order) in the
- * bottom half of the destination LP, for later insertion (in order) in
- * the input queue.
+ * Messages are received in buffers which aggregate all the messages sent
+ * by some thread of a remote kernel. A message which is unpacked here
+ * is placed (out of order) in the bottom half of the destination LP, for
+ * later insertion (in order) in the input queue.
  *
  * This function will try to extract as many messages as possible from
- * the underlying MPI library. In particular, once this function is
- * called, it will return only after that @e no @e message can be found
- * in the MPI library, destined to this simulation kernel instance.
+ * the transport. In particular, once this function is called, it will
+ * return only after that @e no @e message can be found in the transport,
+ * destined to this simulation kernel instance.
  *
  * Currently, this function is called once per main loop iteration. Doing
  * more calls might significantly imbalance the workload of some worker
  * thread.
  *
+ * If the communication thread is enabled, this function does nothing:
+ * messages are delivered to the bottom halves by the communication thread.
+ *
  * @note This function is thread-safe.
  */
 void receive_remote_msgs(void)
 {
-	int size;
-	msg_t *msg;
-	MPI_Status status;
-	MPI_Message mpi_msg;
-	int pending;
-	struct lp_struct *lp;
-	GID_t gid;
+	if (rootsim_config.comm_thread)
+		return;
 
 	// TODO: given the latest changes in the platform, this *might*
 	// be removed.
 	if (!spin_trylock(&msgs_lock))
 		return;
 
-	while (true) {
-		lock_mpi();
-		MPI_Improbe(MPI_ANY_SOURCE, MPI_ANY_TAG, msg_comm, &pending, &mpi_msg, &status);
-		unlock_mpi();
+	transport->drain();
+	gvt_piggyback_progress();
+	spin_unlock(&msgs_lock);
+}
 
-		if (!pending)
-			goto out;
 
-		MPI_Get_count(&status, MPI_BYTE, &size);
+#ifdef HAVE_MPI
 
-		if (likely(MSG_PADDING + size <= SLAB_MSG_SIZE)) {
-			set_gid(gid, status.MPI_TAG);
-			lp = find_lp_by_gid(gid);
-			msg = get_msg_from_slab(lp);
-		} else {
-			msg = rsalloc(MSG_PADDING + size);
-			bzero(msg, MSG_PADDING);
+/**
+ * @brief Wait until all the messages sent across kernels are delivered
+ *
+ * Each kernel learns how many buffers of aggregated messages have been
+ * sent to it, and keeps delivering incoming buffers until it has seen all
+ * of them. Worker threads must not send messages to remote kernels while
+ * this function runs, and must have flushed their aggregation buffers.
+ *
+ * @note This is a collective operation, which must be called by the master
+ *       thread of all kernels.
+ *
+ * @param comm The communicator to use for the collective operation
+ */
+void quiesce_remote_msgs(MPI_Comm comm)
+{
+	int sent[n_ker], expected = 0;
+	MPI_Request req;
+	unsigned int i;
+
+	for (i = 0; i < n_ker; i++)
+		sent[i] = atomic_read(&buffers_sent[i]);
+
+	lock_mpi();
+	MPI_Ireduce_scatter_block(sent, &expected, 1, MPI_INT, MPI_SUM, comm, &req);
+	unlock_mpi();
+
+	// Keep draining while waiting: a remote kernel could be blocked on sending to us
+	while (!is_request_completed(&req) || atomic_read(&buffers_delivered) < expected) {
+		if (rootsim_config.comm_thread) {
+			sched_yield();
+			continue;
 		}
 
-		// Receive the message. Use MPI_Mrecv to be sure that the very same message
-		// which was matched by the previous MPI_Improbe is extracted.
-		lock_mpi();
-		MPI_Mrecv(((char *)msg) + MSG_PADDING, size, MPI_BYTE, &mpi_msg, MPI_STATUS_IGNORE);
-		unlock_mpi();
+		if (spin_trylock(&msgs_lock)) {
+			transport->drain();
+			spin_unlock(&msgs_lock);
+		}
+	}
 
-		validate_msg(msg);
-		insert_bottom_half(msg);
+	for (i = 0; i < n_ker; i++)
+		atomic_set(&buffers_sent[i], 0);
+	atomic_set(&buffers_delivered, atomic_read(&buffers_delivered) - expected);
+}
+
+#endif /* HAVE_MPI */
+
+
+/**
+ * @brief Send the buffers handed off by worker threads
+ *
+ * The stack of each worker thread is detached and reversed, so that
+ * buffers are sent in the same order in which they were filled.
+ *
+ * @return @c true if at least one buffer has been sent, @c false otherwise
+ */
+static bool send_handed_off_buffers(void)
+{
+	unsigned int i;
+	unsigned long count;
+	outgoing_msg *out_msg, *next, *fifo;
+	bool sent = false;
+
+	for (i = 0; i < n_cores; i++) {
+		if (handoff_stacks[i] == NULL)
+			continue;
+
+		out_msg = __sync_lock_test_and_set(&handoff_stacks[i], NULL);
+
+		fifo = NULL;
+		while (out_msg != NULL) {
+			next = out_msg->next;
+			out_msg->next = fifo;
+			fifo = out_msg;
+			out_msg = next;
+		}
+
+		count = 0;
+		while (fifo != NULL) {
+			next = fifo->next;
+			transport->send(fifo, fifo->dest_kid);
+			fifo = next;
+			count++;
+		}
+
+		// Buffers are now in the hands of the transport: tell the worker thread
+		__sync_synchronize();
+		handoff_sent[i] += count;
+		sent = true;
 	}
-    out:
-	spin_unlock(&msgs_lock);
+
+	return sent;
 }
 
+/**
+ * @brief Main loop of the communication thread
+ *
+ * The communication thread performs all the operations needed to
+ * exchange messages with remote kernels: it sends the buffers handed off
+ * by worker threads, delivers incoming messages to the bottom halves of
+ * the destination LPs and keeps track of the completion of sends. GVT
+ * information piggybacked on messages makes progress here as well. When
+ * there is nothing to do, the CPU is yielded.
+ */
+static void *comm_thread_loop(void *args)
+{
+	bool busy;
+
+	(void)args;
+
+	runs_lps = false;
+
+	if (rootsim_config.comm_thread_core >= 0)
+		set_affinity(rootsim_config.comm_thread_core);
+
+	while (!comm_thread_stop) {
+		busy = send_handed_off_buffers();
+		busy |= transport->drain();
+		busy |= prune_outgoing_queues() > 0;
+		gvt_piggyback_progress();
+
+		if (!busy)
+			sched_yield();
+	}
+
+	return NULL;
+}
 
 
 /**
@@ -273,6 +962,16 @@ bool all_kernels_terminated(void)
 }
 
 
+/**
+ * @brief Check if this kernel has reached the termination condition
+ *
+ * @return @c true if broadcast_termination() has already been called
+ */
+bool kernel_terminated(void)
+{
+	return (terminated > 0);
+}
+
 
 /**
  * @brief Check if other kernels have reached the termination condition
@@ -288,43 +987,114 @@ bool all_kernels_terminated(void)
  */
 void collect_termination(void)
 {
-	int res;
-	unsigned int tdata;
-
 	if (terminated == 0 || !spin_trylock(&msgs_fini))
 		return;
 
-	while (pending_msgs(MSG_FINI)) {
-		lock_mpi();
-		res =
-		    MPI_Recv(&tdata, 1, MPI_UNSIGNED, MPI_ANY_SOURCE, MSG_FINI, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-		unlock_mpi();
-		if (unlikely(res != 0)) {
-			rootsim_error(true, "MPI_Recv did not complete correctly");
-			return;
-		}
-		terminated++;
-	}
+	terminated += transport->termination_recv();
 	spin_unlock(&msgs_fini);
 }
 
 
 /**
- * @brief Notify all the kernels about local termination
+ * @brief Notify all the kernels about local termination
+ *
+ * This function is used to inform all other simulation kernel instances
+ * that this kernel is ready to terminate the simulation.
+ *
+ * @warning This function is not thread safe and should be used only
+ *          by one thread at a time
+ *
+ * @note This function can be called multiple times, but the actual
+ *       broadcast operation will be executed only on the first call.
+ */
+void broadcast_termination(void)
+{
+	transport->termination_send();
+	terminated++;
+}
+
+
+/**
+ * @brief Merge statistics.
+ *
+ * This function merges the statistics of a kernel into the ones reduced
+ * so far. It is used by all transports to reduce globally local
+ * statistics upon simulation shutdown.
+ *
+ * @param inout The statistics reduced so far, which are updated
+ * @param in The statistics of a kernel
+ */
+void merge_statistics(struct stat_t *inout, const struct stat_t *in)
+{
+	unsigned int j;
+
+	inout->vec += in->vec;
+	inout->gvt_round_time += in->gvt_round_time;
+	inout->gvt_round_time_min = fmin(inout->gvt_round_time_min, in->gvt_round_time_min);
+	inout->gvt_round_time_max = fmax(inout->gvt_round_time_max, in->gvt_round_time_max);
+	inout->max_resident_set += in->max_resident_set;
+	inout->anon_memory += in->anon_memory;
+	inout->huge_memory += in->huge_memory;
+	inout->ccgs_time += in->ccgs_time;
+	inout->ccgs_rounds += in->ccgs_rounds;
+	inout->mpi_sends += in->mpi_sends;
+	inout->mpi_msgs += in->mpi_msgs;
+	inout->migrated_lps += in->migrated_lps;
+	for (j = 0; j < MSG_SLAB_CLASSES; j++)
+		inout->msg_buffers[j] += in->msg_buffers[j];
+	inout->large_msg_buffers += in->large_msg_buffers;
+	inout->large_msg_reused += in->large_msg_reused;
+	inout->slab_contentions += in->slab_contentions;
+	inout->remote_frees += in->remote_frees;
+	inout->numa_loads += in->numa_loads;
+	inout->numa_remote_loads += in->numa_remote_loads;
+	keep_largest_lp_memory(inout, in);
+}
+
+
+/**
+ * @brief Invoke statistics reduction.
+ *
+ * The statistics of all the kernels are merged with merge_statistics()
+ * in the master kernel.
+ *
+ * @param global A pointer to a struct @ref stat_t where reduced statistics
+ *               will be stored. The reduction only takes place at the
+ *               master kernel, therefore other simulation kernel instances
+ *               will never read actual meaningful information in that structure.
+ * @param local A pointer to a local struct @ref stat_t which is used
+ *               as the source of information for the distributed reduction
+ *               operation.
+ */
+void reduce_statistics(struct stat_t *global, struct stat_t *local)
+{
+	transport->stats_redux(global, local);
+}
+
+
+/**
+ * @brief Reduce the minimum of a value across all the kernels
  *
- * This function is used to inform all other simulation kernel instances
- * that this kernel is ready to terminate the simulation.
+ * @note This is a collective operation, which must be called by the master
+ *       thread of all kernels.
  *
- * @warning This function is not thread safe and should be used only
- *          by one thread at a time
+ * @param value The value proposed by this kernel, which is replaced
+ *              by the minimum among the ones of all kernels
+ */
+void reduce_min(unsigned long long *value)
+{
+	transport->min_redux(value);
+}
+
+
+#ifdef HAVE_MPI
+
+/**
+ * @brief Notify all the kernels about local termination through MPI
  *
  * @note This function can be used concurrently with other MPI functions
- *       (hence its thread unsafety)
- *
- * @note This function can be called multiple times, but the actual
- *       broadcast operation will be executed only on the first call.
  */
-void broadcast_termination(void)
+static void mpi_termination_send(void)
 {
 	unsigned int i;
 	lock_mpi();
@@ -333,11 +1103,35 @@ void broadcast_termination(void)
 			continue;
 		MPI_Isend(&i, 1, MPI_UNSIGNED, i, MSG_FINI, MPI_COMM_WORLD, &termination_reqs[i]);
 	}
-	terminated++;
 	unlock_mpi();
 }
 
 
+/**
+ * @brief Receive the termination notifications sent by remote kernels
+ *
+ * @return The number of notifications received
+ */
+static unsigned int mpi_termination_recv(void)
+{
+	int res;
+	unsigned int tdata, count = 0;
+
+	while (pending_msgs(MSG_FINI)) {
+		lock_mpi();
+		res =
+		    MPI_Recv(&tdata, 1, MPI_UNSIGNED, MPI_ANY_SOURCE, MSG_FINI, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		unlock_mpi();
+		if (unlikely(res != 0)) {
+			rootsim_error(true, "MPI_Recv did not complete correctly");
+			break;
+		}
+		count++;
+	}
+	return count;
+}
+
+
 /**
  * @brief Reduce operation for statistics.
  *
@@ -350,13 +1144,8 @@ static void reduce_stat_vector(struct stat_t *in, struct stat_t *inout, int *len
 	(void)dptr;
 	int i = 0;
 
-	for (i = 0; i < *len; ++i) {
-		inout[i].vec += in[i].vec;
-		inout[i].gvt_round_time += in[i].gvt_round_time;
-		inout[i].gvt_round_time_min = fmin(inout[i].gvt_round_time_min, in[i].gvt_round_time_min);
-		inout[i].gvt_round_time_max = fmax(inout[i].gvt_round_time_max, in[i].gvt_round_time_max);
-		inout[i].max_resident_set += in[i].max_resident_set;
-	}
+	for (i = 0; i < *len; ++i)
+		merge_statistics(&inout[i], &in[i]);
 }
 
 
@@ -411,93 +1200,279 @@ static void stats_reduction_init(void)
 
 
 /**
- * @brief Invoke statistics reduction.
+ * @brief Reduce the statistics at rank 0 with MPI_Reduce
  *
- * This function is a simple wrapper of an MPI_Reduce operation, which
- * uses the custom reduce operation implemented in reduce_stat_vector()
- * to gather reduced statistics in the master kernel (rank 0).
+ * The custom reduce operation implemented in reduce_stat_vector() is used.
  *
- * @param global A pointer to a struct @ref stat_t where reduced statistics
- *               will be stored. The reduction only takes place at rank 0,
- *               therefore other simulation kernel instances will never
- *               read actual meaningful information in that structure.
- * @param local A pointer to a local struct @ref stat_t which is used
- *               as the source of information for the distributed reduction
- *               operation.
+ * @param global Where reduced statistics are stored at rank 0
+ * @param local The statistics of this kernel
  */
-void mpi_reduce_statistics(struct stat_t *global, struct stat_t *local)
+static void mpi_stats_redux(struct stat_t *global, struct stat_t *local)
 {
 	MPI_Reduce(local, global, 1, stats_mpi_t, reduce_stats_op, 0, MPI_COMM_WORLD);
 }
 
 
+/**
+ * @brief Reduce the minimum of a value across all the ranks with MPI_Allreduce
+ *
+ * @param value The value of this kernel, replaced by the minimum
+ */
+static void mpi_min_redux(unsigned long long *value)
+{
+	MPI_Allreduce(MPI_IN_PLACE, value, 1, MPI_UNSIGNED_LONG_LONG, MPI_MIN, MPI_COMM_WORLD);
+}
+
 
 /**
- * @brief Setup the distributed termination subsystem
+ * @brief Start the reduction of white messages with MPI_Ireduce_scatter_block
  *
- * To correctly terminate a distributed simulation, some care must be
- * taken. In particular:
- * * we must be use that no deadlock is generated, e.g. because some
- *   simulation kernel is already waiting for some synchronization action
- *   by other kernels
- * * we must be sure that no MPI action is in place/still pending, when
- *   MPI_Finalize() is called.
+ * @param sent The white messages sent to each kernel
+ * @param expected Where the white messages sent to this kernel are summed up
+ */
+static void mpi_white_redux(const int *sent, int *expected)
+{
+	lock_mpi();
+	MPI_Ireduce_scatter_block(sent, expected, 1, MPI_INT, MPI_SUM, white_count_comm, &white_count_req);
+	unlock_mpi();
+}
+
+
+/**
+ * @brief Test the completion of the reduction of white messages
  *
- * To this end, a specific distributed termination protocol is put in place,
- * which requires some data structures to be available.
+ * @return @c true if the reduction is complete, @c false otherwise
+ */
+static bool mpi_white_redux_done(void)
+{
+	return is_request_completed(&white_count_req);
+}
+
+
+/**
+ * @brief Start the reduction of the GVT with MPI_Iallreduce
  *
- * This function initializes the subsystem and the datastructures which
- * ensure a clean a nice shutdown of distributed simulations.
+ * @param kvt The KVT proposed by this kernel
+ * @param gvt Where the minimum among the KVTs of all kernels is stored
  */
-void dist_termination_init(void)
+static void mpi_gvt_redux(const simtime_t *kvt, simtime_t *gvt)
+{
+	lock_mpi();
+	MPI_Iallreduce(kvt, gvt, 1, MPI_DOUBLE, MPI_MIN, gvt_reduction_comm, &gvt_reduction_req);
+	unlock_mpi();
+}
+
+
+/**
+ * @brief Test the completion of the reduction of the GVT
+ *
+ * @return @c true if the reduction is complete, @c false otherwise
+ */
+static bool mpi_gvt_redux_done(void)
+{
+	return is_request_completed(&gvt_reduction_req);
+}
+
+
+/**
+ * @brief Send to all kernels an asynchronous request to initiate a GVT round
+ *
+ * @param round The GVT round which is started
+ */
+static void mpi_gvt_init_send(unsigned int round)
 {
-	/* init for collective termination */
-	termination_reqs = rsalloc(n_ker * sizeof(MPI_Request));
 	unsigned int i;
+
+	gvt_init_buff = round;
+
 	for (i = 0; i < n_ker; i++) {
-		termination_reqs[i] = MPI_REQUEST_NULL;
+		if (i == kid)
+			continue;
+		if (!is_request_completed(&(gvt_init_reqs[i]))) {
+			rootsim_error(true, "Failed to send new GVT init round to kernel %u, because the old init request is still pending\n", i);
+		}
+		lock_mpi();
+		MPI_Isend((const void *)&gvt_init_buff, 1, MPI_UNSIGNED, i, MSG_NEW_GVT, MPI_COMM_WORLD, &gvt_init_reqs[i]);
+		unlock_mpi();
 	}
-	spinlock_init(&msgs_fini);
 }
 
 
+/**
+ * @brief Check if a request to initiate a GVT round is pending
+ *
+ * @return @c true if a request is pending, @c false otherwise
+ */
+static bool mpi_gvt_init_pending(void)
+{
+	return pending_msgs(MSG_NEW_GVT);
+}
+
 
 /**
- * @brief Cleanup routine of the distributed termination subsystem
+ * @brief Synchronously receive a request to initiate a GVT round
  *
- * Once this function returns, it is sure that we can terminate safely
- * the simulation.
+ * @return The GVT round which is started
  */
-void dist_termination_finalize(void)
+static unsigned int mpi_gvt_init_recv(void)
 {
-	MPI_Waitall(n_ker, termination_reqs, MPI_STATUSES_IGNORE);
+	unsigned int new_gvt_round;
+	lock_mpi();
+	MPI_Recv(&new_gvt_round, 1, MPI_UNSIGNED, MPI_ANY_SOURCE, MSG_NEW_GVT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	unlock_mpi();
+	return new_gvt_round;
 }
 
+
 /**
- * @brief Syncronize all the kernels
+ * @brief Tell whether GVT information can be explicitly sent to a kernel
  *
- * This function can be used as syncronization barrier between all the threads
- * of all the kernels.
+ * @param dest The id of the destination kernel
  *
- * The function will return only after all the threads on all the kernels
- * have already entered this function.
+ * @return @c true if the previous send towards @p dest is complete
+ */
+static bool mpi_gvt_info_ready(unsigned int dest)
+{
+	return is_request_completed(&pb_fallback_reqs[dest]);
+}
+
+
+/**
+ * @brief Explicitly send GVT information to a kernel
+ *
+ * @param pb The GVT information, which is copied
+ * @param dest The id of the destination kernel
+ */
+static void mpi_gvt_info_send(const gvt_piggyback *pb, unsigned int dest)
+{
+	pb_fallback_buff[dest] = *pb;
+	lock_mpi();
+	MPI_Isend(&pb_fallback_buff[dest], sizeof(gvt_piggyback), MPI_BYTE, dest, MSG_GVT_PIGGYBACK, MPI_COMM_WORLD, &pb_fallback_reqs[dest]);
+	unlock_mpi();
+}
+
+
+/**
+ * @brief Receive GVT information explicitly sent by a remote kernel
+ *
+ * @param pb Where the GVT information is stored
+ * @param src_kid Where the id of the sender kernel is stored
+ *
+ * @return @c true if some information has been received, @c false otherwise
+ */
+static bool mpi_gvt_info_recv(gvt_piggyback *pb, unsigned int *src_kid)
+{
+	int pending;
+	MPI_Status status;
+
+	lock_mpi();
+	MPI_Iprobe(MPI_ANY_SOURCE, MSG_GVT_PIGGYBACK, MPI_COMM_WORLD, &pending, &status);
+	if (pending)
+		MPI_Recv(pb, sizeof(*pb), MPI_BYTE, status.MPI_SOURCE, MSG_GVT_PIGGYBACK, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	unlock_mpi();
+
+	if (pending)
+		*src_kid = status.MPI_SOURCE;
+	return pending;
+}
+
+
+/**
+ * @brief Syncronize all the ranks
  *
  * We create a new communicator here, to be sure that we synchronize
  * exactly in this function and not somewhere else.
+ */
+static void mpi_barrier(void)
+{
+	MPI_Comm comm;
+	MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+	MPI_Barrier(comm);
+	MPI_Comm_free(&comm);
+}
+
+
+/**
+ * @brief Setup the MPI transport
  *
- * @warning This function is extremely resource intensive, wastes a lot
- *          of cpu cycles, and drops performance significantly. Avoid
- *          using it as much as possible!
+ * Besides the ring of receive buffers, this function sets up the
+ * separate communicators and the requests used by the collective
+ * operations, and the data structures which ensure a clean and nice
+ * shutdown of distributed simulations. In particular:
+ * * we must be use that no deadlock is generated, e.g. because some
+ *   simulation kernel is already waiting for some synchronization action
+ *   by other kernels
+ * * we must be sure that no MPI action is in place/still pending, when
+ *   MPI_Finalize() is called.
  */
-void syncronize_all(void)
+static void mpi_transport_init(void)
 {
-	if (master_thread()) {
-		MPI_Comm comm;
-		MPI_Comm_dup(MPI_COMM_WORLD, &comm);
-		MPI_Barrier(comm);
-		MPI_Comm_free(&comm);
+	unsigned int i;
+
+	recv_ring_init();
+
+	termination_reqs = rsalloc(n_ker * sizeof(MPI_Request));
+	gvt_init_reqs = rsalloc(n_ker * sizeof(MPI_Request));
+	pb_fallback_buff = rsalloc(n_ker * sizeof(gvt_piggyback));
+	pb_fallback_reqs = rsalloc(n_ker * sizeof(MPI_Request));
+	for (i = 0; i < n_ker; i++) {
+		termination_reqs[i] = MPI_REQUEST_NULL;
+		gvt_init_reqs[i] = MPI_REQUEST_NULL;
+		pb_fallback_reqs[i] = MPI_REQUEST_NULL;
 	}
-	thread_barrier(&all_thread_barrier);
+
+	white_count_req = MPI_REQUEST_NULL;
+	MPI_Comm_dup(MPI_COMM_WORLD, &white_count_comm);
+	gvt_reduction_req = MPI_REQUEST_NULL;
+	MPI_Comm_dup(MPI_COMM_WORLD, &gvt_reduction_comm);
+
+	stats_reduction_init();
+}
+
+
+/**
+ * @brief Release the MPI transport
+ *
+ * Once this function returns, it is sure that we can terminate safely
+ * the simulation: pending requests are completed, or cancelled.
+ */
+static void mpi_transport_fini(void)
+{
+	unsigned int i;
+	gvt_piggyback pb;
+
+	recv_ring_fini();
+
+	MPI_Waitall(n_ker, termination_reqs, MPI_STATUSES_IGNORE);
+	rsfree(termination_reqs);
+
+	for (i = 0; i < n_ker; i++) {
+		if (gvt_init_reqs[i] != MPI_REQUEST_NULL) {
+			MPI_Cancel(&gvt_init_reqs[i]);
+			MPI_Request_free(&gvt_init_reqs[i]);
+		}
+	}
+
+	if (mpi_gvt_init_pending()) {
+		mpi_gvt_init_recv();
+	}
+
+	for (i = 0; i < n_ker; i++) {
+		if (pb_fallback_reqs[i] != MPI_REQUEST_NULL) {
+			MPI_Cancel(&pb_fallback_reqs[i]);
+			MPI_Request_free(&pb_fallback_reqs[i]);
+		}
+	}
+
+	while (mpi_gvt_info_recv(&pb, &i));
+
+	MPI_Wait(&white_count_req, MPI_STATUS_IGNORE);
+	MPI_Comm_free(&white_count_comm);
+	MPI_Wait(&gvt_reduction_req, MPI_STATUS_IGNORE);
+	MPI_Comm_free(&gvt_reduction_comm);
+	rsfree(gvt_init_reqs);
+	rsfree(pb_fallback_buff);
+	rsfree(pb_fallback_reqs);
 }
 
 
@@ -505,13 +1480,14 @@ void syncronize_all(void)
  * @brief Initialize MPI subsystem
  *
  * This is mainly a wrapper of MPI_Init, which contains some boilerplate
- * code to initialize datastructures.
+ * code to initialize datastructures. The kernels are the MPI ranks,
+ * started by mpiexec.
  *
  * Most notably, here we determine if the library which we are using
  * has suitable multithreading support, and we setup the MPI Communicator
  * which will be used later on to exhange model-specific messages.
  */
-void mpi_init(int *argc, char ***argv)
+static void mpi_bootstrap(int *argc, char ***argv)
 {
 	int mpi_thread_lvl_provided = 0;
 	MPI_Init_thread(argc, argv, MPI_THREAD_MULTIPLE, &mpi_thread_lvl_provided);
@@ -533,6 +1509,96 @@ void mpi_init(int *argc, char ***argv)
 
 	// Create a separate communicator which we use to send event messages
 	MPI_Comm_dup(MPI_COMM_WORLD, &msg_comm);
+	MPI_Comm_dup(MPI_COMM_WORLD, &large_comm);
+}
+
+
+/**
+ * @brief Finalize MPI
+ *
+ * This function shutdown the MPI subsystem
+ */
+static void mpi_shutdown(void)
+{
+	MPI_Barrier(MPI_COMM_WORLD);
+	MPI_Comm_free(&msg_comm);
+	MPI_Comm_free(&large_comm);
+	MPI_Finalize();
+}
+
+
+/// The transport across kernels through MPI
+static const struct transport mpi_transport = {
+	.bootstrap = mpi_bootstrap,
+	.shutdown = mpi_shutdown,
+	.init = mpi_transport_init,
+	.fini = mpi_transport_fini,
+	.send = post_remote_buffer,
+	.drain = drain_remote_msgs,
+	.barrier = mpi_barrier,
+	.white_redux = mpi_white_redux,
+	.white_redux_done = mpi_white_redux_done,
+	.gvt_redux = mpi_gvt_redux,
+	.gvt_redux_done = mpi_gvt_redux_done,
+	.gvt_init_send = mpi_gvt_init_send,
+	.gvt_init_pending = mpi_gvt_init_pending,
+	.gvt_init_recv = mpi_gvt_init_recv,
+	.gvt_info_send = mpi_gvt_info_send,
+	.gvt_info_ready = mpi_gvt_info_ready,
+	.gvt_info_recv = mpi_gvt_info_recv,
+	.termination_send = mpi_termination_send,
+	.termination_recv = mpi_termination_recv,
+	.stats_redux = mpi_stats_redux,
+	.min_redux = mpi_min_redux
+};
+
+#endif /* HAVE_MPI */
+
+
+/**
+ * @brief Syncronize all the kernels
+ *
+ * This function can be used as syncronization barrier between all the threads
+ * of all the kernels.
+ *
+ * The function will return only after all the threads on all the kernels
+ * have already entered this function.
+ *
+ * @warning This function is extremely resource intensive, wastes a lot
+ *          of cpu cycles, and drops performance significantly. Avoid
+ *          using it as much as possible!
+ */
+void syncronize_all(void)
+{
+	if (master_thread()) {
+		transport->barrier();
+	}
+	thread_barrier(&all_thread_barrier);
+}
+
+
+/**
+ * @brief Start the simulation kernels
+ *
+ * The transport selected with @c --transport starts the kernels, and tells
+ * how many they are and which one is the current one. MPI is initialized
+ * only if the MPI transport is selected.
+ *
+ * @param argc A pointer to the number of arguments passed at command line
+ * @param argv A pointer to the array of arguments passed at command line
+ */
+void inter_kernel_bootstrap(int *argc, char ***argv)
+{
+#ifdef HAVE_MPI
+	transport = rootsim_config.transport == TRANSPORT_SHM ? &shm_transport : &mpi_transport;
+#else
+	transport = &shm_transport;
+#endif
+	transport->bootstrap(argc, argv);
+
+	if (n_ker > MAX_KERNELS) {
+		rootsim_error(true, "Too many kernels, maximum supported number is %u\n", MAX_KERNELS);
+	}
 }
 
 
@@ -540,16 +1606,29 @@ void mpi_init(int *argc, char ***argv)
  * @brief Initialize inter-kernel communication
  *
  * This function initializes inter-kernel communication, by initializing
- * all the other communication subsystems.
+ * all the other communication subsystems. If requested, the communication
+ * thread is started as well.
  */
 void inter_kernel_comm_init(void)
 {
 	spinlock_init(&msgs_lock);
+	spinlock_init(&msgs_fini);
+
+	buffers_sent = rsalloc(n_ker * sizeof(*buffers_sent));
+	bzero(buffers_sent, n_ker * sizeof(*buffers_sent));
 
 	outgoing_window_init();
+	transport->init();
 	gvt_comm_init();
-	dist_termination_init();
-	stats_reduction_init();
+
+	if (rootsim_config.comm_thread) {
+		handoff_stacks = rsalloc(n_cores * sizeof(*handoff_stacks));
+		bzero((void *)handoff_stacks, n_cores * sizeof(*handoff_stacks));
+		handoff_sent = rsalloc(n_cores * sizeof(*handoff_sent));
+		bzero((void *)handoff_sent, n_cores * sizeof(*handoff_sent));
+		if (pthread_create(&comm_tid, NULL, comm_thread_loop, NULL) != 0)
+			rootsim_error(true, "Unable to create the communication thread\n");
+	}
 }
 
 
@@ -557,33 +1636,35 @@ void inter_kernel_comm_init(void)
  * @brief Finalize inter-kernel communication
  *
  * This function shutdown the subsystems associated with inter-kernel
- * communication.
+ * communication, after having stopped the communication thread (if any).
  */
 void inter_kernel_comm_finalize(void)
 {
-	dist_termination_finalize();
+	if (rootsim_config.comm_thread) {
+		comm_thread_stop = true;
+		pthread_join(comm_tid, NULL);
+		rsfree((void *)handoff_sent);
+	}
+
+	transport->fini();
+	rsfree(buffers_sent);
+
 	//outgoing_window_finalize();
 	gvt_comm_finalize();
 }
 
 
 /**
- * @brief Finalize MPI
- *
- * This function shutdown the MPI subsystem
+ * @brief Stop the simulation kernels
  *
  * @note Only the master thread on each simulation kernel is expected
  *       to call this function
  */
-void mpi_finalize(void)
+void inter_kernel_shutdown(void)
 {
 	if (master_thread()) {
-		MPI_Barrier(MPI_COMM_WORLD);
-		MPI_Comm_free(&msg_comm);
-		MPI_Finalize();
+		transport->shutdown();
 	} else {
-		rootsim_error(true, "MPI finalize has been invoked by a non master thread: T%u\n", local_tid);
+		rootsim_error(true, "Inter-kernel shutdown has been invoked by a non master thread: T%u\n", local_tid);
 	}
 }
-
-#endif /* HAVE_MPI */
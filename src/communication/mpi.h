@@ -1,9 +1,10 @@
 /**
 * @file communication/mpi.h
 *
-* @brief MPI Support Module
+* @brief Inter-kernel communication
 *
-* MPI Support Module
+* Messages, GVT reductions and termination detection across simulation
+* kernels, on top of a transport which is either MPI or shared memory.
 *
 * @copyright
 * Copyright (C) 2008-2019 HPDCS Group
@@ -28,36 +29,89 @@
 
 #pragma once
 
-#ifdef HAVE_MPI
-
 #include <stdbool.h>
+#ifdef HAVE_MPI
 #include <mpi.h>
+#endif
 
 #include <core/core.h>
 #include <communication/wnd.h>
 #include <statistics/statistics.h>
 
+#ifdef HAVE_MPI
 /// This macro takes a global lock if multithread support is not available from MPI
 #define lock_mpi() {if(!mpi_support_multithread) spin_lock(&mpi_lock);}
 
 /// This macro releases a global lock if multithreaded support is not available from MPI
 #define unlock_mpi() {if(!mpi_support_multithread) spin_unlock(&mpi_lock);}
+#endif
 
+/**
+ * @brief A transport across kernels
+ *
+ * A transport starts the simulation kernels, and moves across them
+ * everything they exchange. Messages and antimessages sent to remote
+ * kernels are aggregated in buffers (see @ref outgoing_msg), which are
+ * delivered to deliver_remote_buffer() at the destination, in the order
+ * they were sent. The GVT reduction, termination detection and the final
+ * statistics are carried out with the collective operations offered here.
+ *
+ * Non-blocking collective operations are started by one thread at a time,
+ * and their completion is tested by one thread at a time. The buffers
+ * passed when starting them must be kept until they complete.
+ */
+struct transport {
+	void (*bootstrap)(int *, char ***);	///< Start the kernels, setting @ref n_ker and @ref kid
+	void (*shutdown)(void);			///< Stop the kernels. This is a collective operation
+	void (*init)(void);			///< Setup the transport. This is a collective operation
+	void (*fini)(void);			///< Release the transport
+	void (*send)(outgoing_msg *, unsigned int);	///< Send a buffer to a kernel, taking ownership of it
+	bool (*drain)(void);			///< Deliver the buffers received so far, returns @c true if any
+	void (*barrier)(void);			///< Wait for all the kernels to enter the barrier
+	void (*white_redux)(const int *, int *);	///< Start summing up the white messages sent to each kernel
+	bool (*white_redux_done)(void);		///< Tell whether the last white messages reduction is complete
+	void (*gvt_redux)(const simtime_t *, simtime_t *);	///< Start reducing the minimum of the KVTs
+	bool (*gvt_redux_done)(void);		///< Tell whether the last GVT reduction is complete
+	void (*gvt_init_send)(unsigned int);	///< Tell all the kernels that a GVT round is started
+	bool (*gvt_init_pending)(void);		///< Tell whether a GVT round is started and not yet received
+	unsigned int (*gvt_init_recv)(void);	///< Receive the GVT round which is started
+	void (*gvt_info_send)(const gvt_piggyback *, unsigned int);	///< Send GVT information to a kernel, returns right away
+	bool (*gvt_info_ready)(unsigned int);	///< Tell whether GVT information can be sent to a kernel
+	bool (*gvt_info_recv)(gvt_piggyback *, unsigned int *);	///< Receive GVT information from any kernel, if available
+	void (*termination_send)(void);		///< Tell all the kernels that this kernel has terminated
+	unsigned int (*termination_recv)(void);	///< Count the kernels which have terminated since the last call
+	void (*stats_redux)(struct stat_t *, struct stat_t *);	///< Reduce the statistics at the master kernel
+	void (*min_redux)(unsigned long long *);	///< Reduce the minimum of a value at all the kernels
+};
+
+#ifdef HAVE_MPI
 extern bool mpi_support_multithread;
 extern spinlock_t mpi_lock;
+#endif
 
-void mpi_init(int *argc, char ***argv);
+extern const struct transport *transport;
+
+void inter_kernel_bootstrap(int *argc, char ***argv);
 void inter_kernel_comm_init(void);
 void inter_kernel_comm_finalize(void);
-void mpi_finalize(void);
+void inter_kernel_shutdown(void);
 void syncronize_all(void);
 void send_remote_msg(msg_t * msg);
-bool pending_msgs(int tag);
+void send_remote_antimsg(antimsg_t * anti);
 void receive_remote_msgs(void);
-bool is_request_completed(MPI_Request *);
+void deliver_remote_buffer(const unsigned char *data, size_t size, int tag, unsigned int src_kid);
+void flush_remote_msgs(void);
+void wait_handed_off_buffers(void);
 bool all_kernels_terminated(void);
+bool kernel_terminated(void);
 void broadcast_termination(void);
 void collect_termination(void);
-void mpi_reduce_statistics(struct stat_t *, struct stat_t *);
+void merge_statistics(struct stat_t *inout, const struct stat_t *in);
+void reduce_statistics(struct stat_t *global, struct stat_t *local);
+void reduce_min(unsigned long long *value);
 
-#endif /* HAVE_MPI */
+#ifdef HAVE_MPI
+bool pending_msgs(int tag);
+void quiesce_remote_msgs(MPI_Comm comm);
+bool is_request_completed(MPI_Request *);
+#endif
@@ -0,0 +1,879 @@
+/**
+ * @file communication/shm.c
+ *
+ * @brief Shared-memory transport across simulation kernels
+ *
+ * The kernels are started by forking the process launched by the user, as
+ * many times as requested with @c --kernels, so that no MPI runtime is
+ * needed. Before forking, a shared anonymous mapping is set up, which all
+ * the kernels inherit. It keeps a ring of bytes for each ordered pair of
+ * kernels, and the state of the collective operations.
+ *
+ * Only one kernel writes into a ring, and only one kernel reads from it,
+ * so that the rings need no locking across processes. Threads of the same
+ * kernel sending to the same destination are serialized by a local lock.
+ * Each buffer of aggregated messages is written in the ring as a record
+ * made of a @ref shm_record header and the content of the buffer. Records
+ * larger than the free space are streamed: the receiver reassembles them.
+ *
+ * A sender finding a ring full waits for the destination to make room. If
+ * the communication thread is blocked this way, worker threads leaving the
+ * red phase of a GVT round wait for it, see wait_handed_off_buffers().
+ *
+ * Non-blocking reductions are carried out by publishing the contribution
+ * of each kernel in its @ref shm_kernel slot, along with the number of
+ * reductions it has joined so far. A reduction is complete when all the
+ * kernels have joined it. Since a kernel cannot join a reduction before
+ * all the others have joined the previous one, two slots are enough to
+ * keep the contributions.
+ *
+ * If a kernel dies, the first kernel kills all the other ones; if the first
+ * kernel dies, the other ones are killed by the operating system.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#include <core/core.h>
+#include <core/init.h>
+#include <arch/atomic.h>
+#include <arch/numa.h>
+#include <communication/mpi.h>
+#include <communication/shm.h>
+
+/// Size in bytes of each ring. It must be a power of 2
+#define SHM_RING_SIZE	(1024 * 1024)
+
+/// A single-producer single-consumer ring of bytes from a kernel to another one
+struct shm_ring {
+	volatile uint64_t head __attribute__((aligned(CACHE_LINE_SIZE)));	///< Bytes written so far by the producer
+	volatile uint64_t tail __attribute__((aligned(CACHE_LINE_SIZE)));	///< Bytes read so far by the consumer
+	unsigned char data[SHM_RING_SIZE] __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
+/// Header of a buffer of aggregated messages written in a ring
+struct shm_record {
+	uint64_t size;		///< The size of the buffer, which follows the header
+	int32_t tag;		///< The tag of the buffer, telling what it keeps
+	int32_t padding;
+};
+
+/// A record which is being received from some kernel
+struct shm_partial {
+	struct shm_record hdr;	///< The header of the record
+	size_t hdr_got;		///< How many bytes of @ref hdr have been received
+	size_t got;		///< How many bytes of the buffer have been received
+	unsigned char *buff;	///< Where the buffer is reassembled, if it is not read in place
+	size_t capacity;	///< The size of @ref buff
+};
+
+/// The state shared by all the kernels
+struct shm_control {
+	volatile unsigned int barrier_count;	///< How many kernels have entered the barrier
+	volatile bool barrier_sense;		///< Flipped by the last kernel entering the barrier
+	volatile unsigned int gvt_round;	///< The last GVT round started by the master kernel
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/// The state published by a kernel
+struct shm_kernel {
+	volatile pid_t pid;			///< The process running the kernel, as seen by the first kernel
+	volatile unsigned long white_seq;	///< How many white messages reductions the kernel has joined
+	volatile unsigned long gvt_seq;		///< How many GVT reductions the kernel has joined
+	volatile simtime_t kvt[2];		///< The KVT proposed in the last two GVT reductions
+	volatile bool terminated;		///< The kernel has reached the termination condition
+	volatile unsigned long long min_value;	///< The value proposed in the last reduce_min()
+	struct stat_t stats;			///< The statistics of the kernel, reduced at shutdown
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/// GVT information explicitly sent from a kernel to another one
+struct shm_mailbox {
+	volatile unsigned long seq;	///< Odd while @ref pb is being written
+	gvt_piggyback pb;		///< The last GVT information sent
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/// The shared mapping, inherited by all the kernels
+static void *segment;
+
+/// The size of the shared mapping
+static size_t segment_size;
+
+/// The state shared by all the kernels, in @ref segment
+static struct shm_control *shm_ctl;
+
+/// The state published by each kernel, in @ref segment
+static struct shm_kernel *kernels;
+
+/// The white messages sent by each kernel to each kernel, in the last two reductions
+static volatile int *white_sent;
+
+/// The GVT information sent by each kernel to each kernel, in @ref segment
+static struct shm_mailbox *mailboxes;
+
+/// The rings across each pair of kernels, in @ref segment
+static struct shm_ring *rings;
+
+/// The ring from kernel @p src to kernel @p dst
+#define ring_of(src, dst)	(&rings[(size_t)(src) * n_ker + (dst)])
+
+/// The white messages sent from kernel @p src to kernel @p dst in the reduction @p seq
+#define white_of(seq, src, dst)	(white_sent[(((seq) & 1) * n_ker + (src)) * n_ker + (dst)])
+
+/// The GVT information sent from kernel @p src to kernel @p dst
+#define mailbox_of(src, dst)	(&mailboxes[(size_t)(src) * n_ker + (dst)])
+
+/// Serializes the threads of this kernel sending to the same kernel
+static spinlock_t *send_locks;
+
+/// Serializes the threads of this kernel draining the rings
+static spinlock_t drain_lock;
+
+/// The record being received from each kernel
+static struct shm_partial *partials;
+
+/// The sense of the last barrier this kernel has entered
+static bool barrier_sense;
+
+/// The first kernel has started shutting down, so that children are expected to exit
+static volatile bool shutting_down;
+
+/// The white messages reduction joined last by this kernel
+static unsigned long white_seq;
+
+/// Where to store the result of the white messages reduction, until it completes
+static int *white_result;
+
+/// The GVT reduction joined last by this kernel
+static unsigned long gvt_seq;
+
+/// Where to store the result of the GVT reduction, until it completes
+static simtime_t *gvt_result;
+
+/// The last GVT round received from the master kernel
+static unsigned int gvt_round_seen;
+
+/// The kernels whose termination has already been counted
+static bool *terminated_seen;
+
+/// The sequence number of the last GVT information received from each kernel
+static unsigned long *mailbox_seen;
+
+
+static bool shm_drain(void);
+
+
+/**
+ * @brief Kill all the kernels forked by the first kernel
+ */
+static void kill_children(void)
+{
+	unsigned int i;
+
+	for (i = 1; i < n_ker; i++) {
+		if (kernels[i].pid != 0)
+			kill(kernels[i].pid, SIGKILL);
+	}
+}
+
+
+/**
+ * @brief Reap the kernels which have exited
+ *
+ * This is the handler of SIGCHLD at the first kernel. A kernel exiting
+ * before the simulation is shutting down has failed, so that all the other
+ * kernels are killed as well.
+ *
+ * @param sig The signal number, unused
+ */
+static void child_handler(int sig)
+{
+	unsigned int i;
+	int status;
+	(void)sig;
+
+	for (i = 1; i < n_ker; i++) {
+		if (kernels[i].pid == 0 || waitpid(kernels[i].pid, &status, WNOHANG) <= 0)
+			continue;
+
+		kernels[i].pid = 0;
+		if (shutting_down && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+			continue;
+
+		kill_children();
+		_exit(EXIT_FAILURE);
+	}
+}
+
+
+/**
+ * @brief Start the kernels
+ *
+ * The shared mapping is set up, then the first kernel forks all the other
+ * ones. Command line arguments are left untouched.
+ *
+ * @param argc A pointer to the number of arguments passed at command line, unused
+ * @param argv A pointer to the array of arguments passed at command line, unused
+ */
+static void shm_bootstrap(int *argc, char ***argv)
+{
+	size_t kernels_off, white_off, mailboxes_off, rings_off;
+	struct sigaction sa;
+	pid_t parent, pid;
+	unsigned int i;
+	(void)argc;
+	(void)argv;
+
+	n_ker = rootsim_config.kernels;
+	kid = 0;
+
+	// Each part of the mapping starts on a separate cache line
+	kernels_off = sizeof(struct shm_control);
+	white_off = kernels_off + n_ker * sizeof(struct shm_kernel);
+	mailboxes_off = white_off + ((2 * n_ker * n_ker * sizeof(int) + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1));
+	rings_off = mailboxes_off + (size_t)n_ker * n_ker * sizeof(struct shm_mailbox);
+	segment_size = rings_off + (n_ker > 1 ? (size_t)n_ker * n_ker * sizeof(struct shm_ring) : 0);
+
+	// Pages are zeroed, and only the ones actually touched are allocated
+	segment = mmap(NULL, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (segment == MAP_FAILED)
+		rootsim_error(true, "Unable to map the shared-memory segment: %s\n", strerror(errno));
+
+	shm_ctl = segment;
+	kernels = (struct shm_kernel *)((char *)segment + kernels_off);
+	white_sent = (volatile int *)((char *)segment + white_off);
+	mailboxes = (struct shm_mailbox *)((char *)segment + mailboxes_off);
+	rings = (struct shm_ring *)((char *)segment + rings_off);
+
+	if (n_ker == 1)
+		return;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = child_handler;
+	sa.sa_flags = SA_NOCLDSTOP | SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGCHLD, &sa, NULL);
+
+	// Do not let the children print again what is still buffered
+	fflush(NULL);
+
+	parent = getpid();
+	for (i = 1; i < n_ker; i++) {
+		pid = fork();
+		if (pid < 0) {
+			kill_children();
+			rootsim_error(true, "Unable to fork kernel %u: %s\n", i, strerror(errno));
+		}
+
+		if (pid == 0) {
+			kid = i;
+			signal(SIGCHLD, SIG_DFL);
+			// Do not outlive the first kernel
+			prctl(PR_SET_PDEATHSIG, SIGKILL);
+			if (getppid() != parent)
+				_exit(EXIT_FAILURE);
+			return;
+		}
+
+		kernels[i].pid = pid;
+	}
+}
+
+
+/**
+ * @brief Wait for all the kernels to enter the barrier
+ *
+ * This is a sense-reversing barrier on a counter in the shared mapping.
+ */
+static void shm_barrier(void)
+{
+	barrier_sense = !barrier_sense;
+
+	if (__sync_add_and_fetch(&shm_ctl->barrier_count, 1) == n_ker) {
+		shm_ctl->barrier_count = 0;
+		__sync_synchronize();
+		shm_ctl->barrier_sense = barrier_sense;
+	} else {
+		while (shm_ctl->barrier_sense != barrier_sense) ;
+	}
+}
+
+
+/**
+ * @brief Stop the kernels
+ *
+ * All the kernels wait for each other, then the first kernel waits for the
+ * other ones to exit.
+ *
+ * @note This is a collective operation, which must be called by all kernels.
+ */
+static void shm_shutdown(void)
+{
+	unsigned int i;
+	int status;
+	bool failed = false;
+
+	shutting_down = true;
+	shm_barrier();
+
+	if (master_kernel() && n_ker > 1) {
+		signal(SIGCHLD, SIG_DFL);
+		for (i = 1; i < n_ker; i++) {
+			// The kernel could have been reaped by the handler already
+			if (kernels[i].pid == 0 || waitpid(kernels[i].pid, &status, 0) != kernels[i].pid)
+				continue;
+			if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+				failed = true;
+		}
+	}
+
+	munmap(segment, segment_size);
+
+	if (failed) {
+		fprintf(stderr, "[FATAL ERROR] Some kernel did not terminate correctly\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+/**
+ * @brief Setup the shared-memory transport
+ */
+static void shm_transport_init(void)
+{
+	unsigned int i;
+
+	send_locks = rsalloc(n_ker * sizeof(*send_locks));
+	partials = rsalloc(n_ker * sizeof(*partials));
+	bzero(partials, n_ker * sizeof(*partials));
+	for (i = 0; i < n_ker; i++)
+		spinlock_init(&send_locks[i]);
+	spinlock_init(&drain_lock);
+
+	terminated_seen = rsalloc(n_ker * sizeof(*terminated_seen));
+	bzero(terminated_seen, n_ker * sizeof(*terminated_seen));
+	mailbox_seen = rsalloc(n_ker * sizeof(*mailbox_seen));
+	bzero(mailbox_seen, n_ker * sizeof(*mailbox_seen));
+}
+
+
+/**
+ * @brief Release the shared-memory transport
+ *
+ * The shared mapping is kept until shm_shutdown(), since the kernels
+ * still synchronize through it.
+ */
+static void shm_transport_fini(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < n_ker; i++)
+		rsfree(partials[i].buff);
+
+	rsfree(partials);
+	rsfree(send_locks);
+	rsfree(terminated_seen);
+	rsfree(mailbox_seen);
+}
+
+
+/**
+ * @brief Write into a ring
+ *
+ * If the ring is full, this function drains the rings of this kernel
+ * while waiting for the destination kernel to make room. In this way,
+ * two kernels filling the rings towards each other can always progress.
+ *
+ * @param ring The ring to write into
+ * @param data The bytes to write
+ * @param size The number of bytes to write
+ */
+static void ring_write(struct shm_ring *ring, const unsigned char *data, size_t size)
+{
+	uint64_t head = ring->head;
+	size_t chunk, offset, first;
+
+	while (size > 0) {
+		chunk = min(size, SHM_RING_SIZE - (head - ring->tail));
+		if (chunk == 0) {
+			shm_drain();
+			continue;
+		}
+
+		offset = head & (SHM_RING_SIZE - 1);
+		first = min(chunk, SHM_RING_SIZE - offset);
+		memcpy(ring->data + offset, data, first);
+		memcpy(ring->data, data + first, chunk - first);
+
+		// Make the bytes visible before publishing them
+		head += chunk;
+		__sync_synchronize();
+		ring->head = head;
+
+		data += chunk;
+		size -= chunk;
+	}
+}
+
+
+/**
+ * @brief Read from a ring
+ *
+ * @param ring The ring to read from
+ * @param data Where to copy the bytes
+ * @param size The number of bytes to read, which must be available
+ */
+static void ring_read(struct shm_ring *ring, void *data, size_t size)
+{
+	size_t offset = ring->tail & (SHM_RING_SIZE - 1);
+	size_t first = min(size, SHM_RING_SIZE - offset);
+
+	memcpy(data, ring->data + offset, first);
+	memcpy((unsigned char *)data + first, ring->data, size - first);
+
+	// Finish reading the bytes before giving them back to the producer
+	__sync_synchronize();
+	ring->tail += size;
+}
+
+
+/**
+ * @brief Send a buffer of aggregated messages to a kernel
+ *
+ * The buffer is copied in the ring towards @p dest, and then released.
+ *
+ * @note This function is thread-safe.
+ *
+ * @param out_msg The buffer to send
+ * @param dest The id of the destination kernel
+ */
+static void shm_send_buffer(outgoing_msg *out_msg, unsigned int dest)
+{
+	struct shm_ring *ring = ring_of(kid, dest);
+	struct shm_record hdr = {
+		.size = out_msg->size,
+		.tag = out_msg->tag
+	};
+
+	spin_lock(&send_locks[dest]);
+	ring_write(ring, (unsigned char *)&hdr, sizeof(hdr));
+	ring_write(ring, out_msg->data, out_msg->size);
+	spin_unlock(&send_locks[dest]);
+
+	rsfree(out_msg);
+}
+
+
+/**
+ * @brief Deliver the records available in the ring from a kernel
+ *
+ * A record which is entirely available and contiguous in the ring is
+ * delivered in place. Otherwise, it is reassembled in a separate buffer.
+ *
+ * @param peer The id of the kernel which writes the ring
+ *
+ * @return @c true if at least one record has been delivered, @c false otherwise
+ */
+static bool drain_ring(unsigned int peer)
+{
+	struct shm_ring *ring = ring_of(peer, kid);
+	struct shm_partial *p = &partials[peer];
+	uint64_t avail;
+	size_t offset, chunk;
+	bool received = false;
+
+	while ((avail = ring->head - ring->tail) > 0) {
+		// Do not read the bytes before having seen the head
+		__sync_synchronize();
+
+		if (p->hdr_got < sizeof(p->hdr)) {
+			chunk = min(avail, sizeof(p->hdr) - p->hdr_got);
+			ring_read(ring, (unsigned char *)&p->hdr + p->hdr_got, chunk);
+			p->hdr_got += chunk;
+			p->got = 0;
+			continue;
+		}
+
+		offset = ring->tail & (SHM_RING_SIZE - 1);
+		if (p->got == 0 && avail >= p->hdr.size && offset + p->hdr.size <= SHM_RING_SIZE) {
+			deliver_remote_buffer(ring->data + offset, p->hdr.size, p->hdr.tag, peer);
+			__sync_synchronize();
+			ring->tail += p->hdr.size;
+		} else {
+			if (p->capacity < p->hdr.size) {
+				p->buff = rsrealloc(p->buff, p->hdr.size);
+				p->capacity = p->hdr.size;
+			}
+
+			chunk = min(avail, p->hdr.size - p->got);
+			ring_read(ring, p->buff + p->got, chunk);
+			p->got += chunk;
+			if (p->got < p->hdr.size)
+				continue;
+
+			deliver_remote_buffer(p->buff, p->hdr.size, p->hdr.tag, peer);
+		}
+
+		p->hdr_got = 0;
+		received = true;
+	}
+
+	return received;
+}
+
+
+/**
+ * @brief Deliver all the buffers of aggregated messages received so far
+ *
+ * @note This function is thread-safe. If another thread is already
+ *       draining the rings, it returns right away.
+ *
+ * @return @c true if at least one buffer has been delivered, @c false otherwise
+ */
+static bool shm_drain(void)
+{
+	bool received = false;
+
+	if (!spin_trylock(&drain_lock))
+		return false;
+
+	for (unsigned int peer = 0; peer < n_ker; peer++) {
+		if (peer != kid)
+			received |= drain_ring(peer);
+	}
+
+	spin_unlock(&drain_lock);
+	return received;
+}
+
+
+/**
+ * @brief Join the reduction of white messages
+ *
+ * @param sent The white messages sent to each kernel
+ * @param expected Where the white messages sent to this kernel are summed up
+ */
+static void shm_white_redux(const int *sent, int *expected)
+{
+	unsigned int i;
+
+	white_seq++;
+	for (i = 0; i < n_ker; i++)
+		white_of(white_seq, kid, i) = sent[i];
+
+	white_result = expected;
+	__sync_synchronize();
+	kernels[kid].white_seq = white_seq;
+}
+
+
+/**
+ * @brief Test the completion of the reduction of white messages
+ *
+ * @return @c true if all the kernels have joined the reduction, @c false otherwise
+ */
+static bool shm_white_redux_done(void)
+{
+	unsigned int i;
+	int sum = 0;
+
+	if (white_result == NULL)
+		return true;
+
+	for (i = 0; i < n_ker; i++) {
+		if (kernels[i].white_seq < white_seq)
+			return false;
+	}
+
+	// Do not read the contributions before having seen all of them published
+	__sync_synchronize();
+	for (i = 0; i < n_ker; i++)
+		sum += white_of(white_seq, i, kid);
+
+	*white_result = sum;
+	white_result = NULL;
+	return true;
+}
+
+
+/**
+ * @brief Join the reduction of the GVT
+ *
+ * @param kvt The KVT proposed by this kernel
+ * @param gvt Where the minimum among the KVTs of all kernels is stored
+ */
+static void shm_gvt_redux(const simtime_t *kvt, simtime_t *gvt)
+{
+	gvt_seq++;
+	kernels[kid].kvt[gvt_seq & 1] = *kvt;
+
+	gvt_result = gvt;
+	__sync_synchronize();
+	kernels[kid].gvt_seq = gvt_seq;
+}
+
+
+/**
+ * @brief Test the completion of the reduction of the GVT
+ *
+ * @return @c true if all the kernels have joined the reduction, @c false otherwise
+ */
+static bool shm_gvt_redux_done(void)
+{
+	unsigned int i;
+	simtime_t gvt = INFTY;
+
+	if (gvt_result == NULL)
+		return true;
+
+	for (i = 0; i < n_ker; i++) {
+		if (kernels[i].gvt_seq < gvt_seq)
+			return false;
+	}
+
+	// Do not read the contributions before having seen all of them published
+	__sync_synchronize();
+	for (i = 0; i < n_ker; i++)
+		gvt = min(gvt, kernels[i].kvt[gvt_seq & 1]);
+
+	*gvt_result = gvt;
+	gvt_result = NULL;
+	return true;
+}
+
+
+/**
+ * @brief Tell all the kernels that a GVT round is started
+ *
+ * @param round The GVT round which is started
+ */
+static void shm_gvt_init_send(unsigned int round)
+{
+	gvt_round_seen = round;
+	shm_ctl->gvt_round = round;
+}
+
+
+/**
+ * @brief Check if a GVT round has been started and not yet received
+ *
+ * @return @c true if a GVT round is pending, @c false otherwise
+ */
+static bool shm_gvt_init_pending(void)
+{
+	return shm_ctl->gvt_round > gvt_round_seen;
+}
+
+
+/**
+ * @brief Receive the last GVT round started by the master kernel
+ *
+ * @return The GVT round which is started
+ */
+static unsigned int shm_gvt_init_recv(void)
+{
+	gvt_round_seen = shm_ctl->gvt_round;
+	return gvt_round_seen;
+}
+
+
+/**
+ * @brief Tell whether GVT information can be explicitly sent to a kernel
+ *
+ * A mailbox only keeps the last information sent, so this is always possible.
+ *
+ * @param dest The id of the destination kernel, unused
+ *
+ * @return @c true
+ */
+static bool shm_gvt_info_ready(unsigned int dest)
+{
+	(void)dest;
+	return true;
+}
+
+
+/**
+ * @brief Explicitly send GVT information to a kernel
+ *
+ * The information replaces the one in the mailbox towards @p dest, if any.
+ * Newer information always supersedes older one.
+ *
+ * @param pb The GVT information, which is copied
+ * @param dest The id of the destination kernel
+ */
+static void shm_gvt_info_send(const gvt_piggyback *pb, unsigned int dest)
+{
+	struct shm_mailbox *mb = mailbox_of(kid, dest);
+
+	mb->seq++;
+	__sync_synchronize();
+	mb->pb = *pb;
+	__sync_synchronize();
+	mb->seq++;
+}
+
+
+/**
+ * @brief Receive GVT information explicitly sent by a remote kernel
+ *
+ * The mailboxes towards this kernel are scanned for information not yet
+ * received. A mailbox being written is skipped, and checked again later.
+ *
+ * @param pb Where the GVT information is stored
+ * @param src_kid Where the id of the sender kernel is stored
+ *
+ * @return @c true if some information has been received, @c false otherwise
+ */
+static bool shm_gvt_info_recv(gvt_piggyback *pb, unsigned int *src_kid)
+{
+	struct shm_mailbox *mb;
+	unsigned long seq;
+	unsigned int i;
+
+	for (i = 0; i < n_ker; i++) {
+		mb = mailbox_of(i, kid);
+		seq = mb->seq;
+		if (i == kid || seq == mailbox_seen[i] || (seq & 1))
+			continue;
+
+		__sync_synchronize();
+		*pb = mb->pb;
+		__sync_synchronize();
+		if (mb->seq != seq)
+			continue;
+
+		mailbox_seen[i] = seq;
+		*src_kid = i;
+		return true;
+	}
+
+	return false;
+}
+
+
+/**
+ * @brief Tell all the kernels that this kernel has terminated
+ */
+static void shm_termination_send(void)
+{
+	kernels[kid].terminated = true;
+}
+
+
+/**
+ * @brief Count the kernels which have terminated since the last call
+ *
+ * @return The number of kernels found terminated
+ */
+static unsigned int shm_termination_recv(void)
+{
+	unsigned int i, count = 0;
+
+	for (i = 0; i < n_ker; i++) {
+		if (i == kid || terminated_seen[i] || !kernels[i].terminated)
+			continue;
+		terminated_seen[i] = true;
+		count++;
+	}
+
+	return count;
+}
+
+
+/**
+ * @brief Reduce the statistics at the master kernel
+ *
+ * @note This is a collective operation, which must be called by all kernels.
+ *
+ * @param global Where reduced statistics are stored at the master kernel
+ * @param local The statistics of this kernel
+ */
+static void shm_stats_redux(struct stat_t *global, struct stat_t *local)
+{
+	unsigned int i;
+
+	kernels[kid].stats = *local;
+	shm_barrier();
+
+	if (!master_kernel())
+		return;
+
+	*global = kernels[0].stats;
+	for (i = 1; i < n_ker; i++)
+		merge_statistics(global, &kernels[i].stats);
+}
+
+
+/**
+ * @brief Reduce the minimum of a value at all the kernels
+ *
+ * @note This is a collective operation, which must be called by all kernels.
+ *
+ * @param value The value of this kernel, replaced by the minimum
+ */
+static void shm_min_redux(unsigned long long *value)
+{
+	unsigned long long result = *value;
+	unsigned int i;
+
+	kernels[kid].min_value = *value;
+	shm_barrier();
+
+	for (i = 0; i < n_ker; i++)
+		result = min(result, kernels[i].min_value);
+
+	// Nobody proposes a new value before everybody has read this one
+	shm_barrier();
+	*value = result;
+}
+
+
+/// The transport across kernels forked on the same host
+const struct transport shm_transport = {
+	.bootstrap = shm_bootstrap,
+	.shutdown = shm_shutdown,
+	.init = shm_transport_init,
+	.fini = shm_transport_fini,
+	.send = shm_send_buffer,
+	.drain = shm_drain,
+	.barrier = shm_barrier,
+	.white_redux = shm_white_redux,
+	.white_redux_done = shm_white_redux_done,
+	.gvt_redux = shm_gvt_redux,
+	.gvt_redux_done = shm_gvt_redux_done,
+	.gvt_init_send = shm_gvt_init_send,
+	.gvt_init_pending = shm_gvt_init_pending,
+	.gvt_init_recv = shm_gvt_init_recv,
+	.gvt_info_send = shm_gvt_info_send,
+	.gvt_info_ready = shm_gvt_info_ready,
+	.gvt_info_recv = shm_gvt_info_recv,
+	.termination_send = shm_termination_send,
+	.termination_recv = shm_termination_recv,
+	.stats_redux = shm_stats_redux,
+	.min_redux = shm_min_redux
+};
@@ -0,0 +1,35 @@
+/**
+ * @file communication/shm.h
+ *
+ * @brief Shared-memory transport across simulation kernels
+ *
+ * The simulation kernels are forked on the same host, and the buffers of
+ * aggregated messages are exchanged through single-producer single-consumer
+ * rings kept in shared memory, one for each pair of kernels. Collective
+ * operations are carried out in shared memory as well, so that no MPI
+ * runtime is needed.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <communication/mpi.h>
+
+extern const struct transport shm_transport;
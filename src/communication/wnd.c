@@ -36,8 +36,6 @@
 * @author Tommaso Tocci
 */
 
-#ifdef HAVE_MPI
-
 #include <communication/communication.h>
 #include <communication/wnd.h>
 #include <communication/mpi.h>
@@ -121,15 +119,25 @@ void outgoing_window_finalize(void)
 /**
  * @brief Allocate a buffer for an outgoing message node
  *
- * This function allocates a buffer to keep track of one message
- * which is being remotely sent through MPI
+ * This function allocates a buffer to pack the messages which are
+ * being remotely sent through MPI to the same destination kernel
+ *
+ * @param capacity The number of bytes available to pack messages
  *
- * @return a pointer to a buffer keeping an @ref outgoing_msg to
+ * @return a pointer to a buffer keeping an empty @ref outgoing_msg to
  *         be populated before linking to an outgoing queue
  */
-outgoing_msg *allocate_outgoing_msg(void)
+outgoing_msg *allocate_outgoing_msg(size_t capacity)
 {
-	return rsalloc(sizeof(outgoing_msg));
+	outgoing_msg *out_msg = rsalloc(sizeof(outgoing_msg) + capacity);
+
+#ifdef HAVE_MPI
+	out_msg->announce_req = MPI_REQUEST_NULL;
+#endif
+	out_msg->count = 0;
+	out_msg->size = 0;
+	out_msg->capacity = capacity;
+	return out_msg;
 }
 
 
@@ -147,7 +155,13 @@ outgoing_msg *allocate_outgoing_msg(void)
  */
 static inline bool is_msg_delivered(outgoing_msg *msg)
 {
-	return is_request_completed(&(msg->req));
+#ifdef HAVE_MPI
+	return is_request_completed(&(msg->req)) && is_request_completed(&(msg->announce_req));
+#else
+	// Only the MPI transport keeps buffers in the outgoing queues
+	(void)msg;
+	return true;
+#endif
 }
 
 
@@ -178,7 +192,7 @@ void store_outgoing_msg(outgoing_msg *out_msg, unsigned int dest_kid)
  * @brief Prune an outgoing queue
  *
  * Given an outgoing queue, this function scans through it looking for
- * all messages which have been correctly delivered to their destination.
+ * all message buffers which have been correctly delivered to their destination.
  *
  * The nodes associated with operations which have completed are removed
  * and freed.
@@ -199,9 +213,8 @@ static int prune_outgoing_queue(outgoing_queue *oq)
 	// head (the entry with the minimum timestamp) and delete them
 	// if they have been already delivered
 	while (msg != NULL && is_msg_delivered(msg)) {
-		msg_release(msg->msg);
-
 		list_delete_by_content(oq->queue, msg);
+		rsfree(msg);
 		pruned++;
 		msg = list_head(oq->queue);
 	}
@@ -231,5 +244,3 @@ int prune_outgoing_queues(void)
 	}
 	return pruned;
 }
-
-#endif
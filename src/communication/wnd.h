@@ -28,21 +28,41 @@
 
 #pragma once
 
+#include <stdint.h>
 #ifdef HAVE_MPI
-
 #include <mpi.h>
+#endif
 
 #include <datatypes/list.h>
 #include <mm/mm.h>
 #include <ROOT-Sim.h>
 #include <arch/atomic.h>
 
-/// The structure representing a node in the @ref outgoing_queue list
+/// The announce of a buffer of messages too large for the receive ring, sent ahead of it
+struct large_announce {
+	uint64_t size;			///< The size of the buffer
+	uint64_t tag;			///< The tag the buffer is sent with, unique among the ones in flight to the same kernel
+};
+
+/**
+ * The structure representing a node in the @ref outgoing_queue list.
+ * Each node aggregates a set of messages directed to the same remote
+ * kernel, which are delivered with a single operation of the transport.
+ */
 typedef struct _outgoing_msg {
+#ifdef HAVE_MPI
 	MPI_Request req;		///< The MPI Request used to keep track of the delivery operation
+	MPI_Request announce_req;	///< The MPI Request used to deliver @ref announce, if needed
+	struct large_announce announce;	///< Sent ahead of @ref data if it is too large for the receive ring
+#endif
 	struct _outgoing_msg *next;	///< next pointer for the list
 	struct _outgoing_msg *prev;	///< prev pointer for the list
-	msg_t *msg;			///< A pointer to the @ref msg_t which MPI is delivering
+	unsigned int dest_kid;		///< The kernel the packed messages are directed to
+	int tag;			///< The tag telling whether @ref data keeps messages or antimessages
+	unsigned int count;		///< How many messages are packed in @ref data
+	size_t size;			///< How many bytes of @ref data are in use
+	size_t capacity;		///< How many bytes are available in @ref data
+	unsigned char data[];		///< The packed messages which the transport is delivering
 } outgoing_msg;
 
 
@@ -56,6 +76,4 @@ extern void outgoing_window_init(void);
 extern void outgoing_window_finalize(void);
 extern void store_outgoing_msg(outgoing_msg * out_msg, unsigned int dest_kid);
 extern int prune_outgoing_queues(void);
-extern outgoing_msg *allocate_outgoing_msg(void);
-
-#endif	/* HAVE_MPI */
+extern outgoing_msg *allocate_outgoing_msg(size_t capacity);
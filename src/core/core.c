@@ -37,13 +37,18 @@
 #include <signal.h>
 
 #include <arch/thread.h>
+#include <arch/numa.h>
 #include <core/core.h>
 #include <core/init.h>
 #include <scheduler/process.h>
+#include <scheduler/migration.h>
+#include <scheduler/placement.h>
 #include <scheduler/scheduler.h>
 #include <statistics/statistics.h>
 #include <gvt/gvt.h>
 #include <mm/mm.h>
+#include <mm/persist.h>
+#include <lib/output.h>
 
 /// Barrier for all worker threads
 barrier_t all_thread_barrier;
@@ -132,6 +137,8 @@ void base_init(void)
 
 	barrier_init(&all_thread_barrier, n_cores);
 
+	numa_init();
+
 	// complete the sigaction struct init
 	new_act.sa_handler = handle_signal;
 	// we set the signal action so that it auto disarms itself after the first invocation
@@ -150,6 +157,7 @@ void base_init(void)
 */
 void base_fini(void)
 {
+	numa_fini();
 }
 
 /**
@@ -187,8 +195,15 @@ void simulation_shutdown(int code)
 		thread_barrier(&all_thread_barrier);
 
 		if (master_thread()) {
+			// Committed output goes out before anything else is torn down
+			output_fini();
 			statistics_fini();
 			gvt_fini();
+			persist_fini();
+#ifdef HAVE_MPI
+			migration_fini();
+#endif
+			placement_fini();
 			communication_fini();
 			scheduler_fini();
 			base_fini();
@@ -307,6 +322,14 @@ void distribute_lps_on_kernels(void)
 				n_prc++;
 		}
 		break;
+
+	case LP_DISTRIBUTION_FILE:
+		placement_load(kernel);
+		for (i = 0; i < n_prc_tot; i++) {
+			if (kernel[i] == kid)
+				n_prc++;
+		}
+		break;
 	}
 }
 
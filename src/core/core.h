@@ -77,7 +77,8 @@ extern jmp_buf exit_jmp;
 enum {
 	LP_DISTRIBUTION_INVALID = 0,	/**< By convention 0 is the invalid field */
 	LP_DISTRIBUTION_BLOCK,		/**< Distribute exceeding LPs according to a block policy */
-	LP_DISTRIBUTION_CIRCULAR	/**< Distribute exceeding LPs according to a circular policy */
+	LP_DISTRIBUTION_CIRCULAR,	/**< Distribute exceeding LPs according to a circular policy */
+	LP_DISTRIBUTION_FILE		/**< Distribute LPs according to the placement read from a file */
 };
 
 // XXX should be moved to a more librarish header
@@ -153,9 +154,15 @@ typedef struct _lid_t {
 
 typedef enum { positive, negative, control } message_kind_t;
 
-#ifdef HAVE_MPI
 typedef unsigned char phase_colour;
-#endif
+
+/// GVT information piggybacked on messages exchanged across kernels
+typedef struct _gvt_piggyback {
+	unsigned int round;	///< GVT round which this information refers to, 0 if none
+	int white_sent;		///< White messages sent to the receiver kernel before @e round started, -1 if not yet known
+	simtime_t kvt;		///< KVT proposed by the sender kernel in @e round, -1.0 if not yet known
+	simtime_t prev_kvt;	///< KVT proposed by the sender kernel in @e round - 1, -1.0 if not yet known
+} gvt_piggyback;
 
 #define MSG_PADDING offsetof(msg_t, sender)
 #define MSG_META_SIZE (offsetof(msg_t, event_content) - MSG_PADDING)
@@ -175,38 +182,53 @@ typedef struct _msg_t {
 	// Kernel's information
 	GID_t sender;
 	GID_t receiver;
-#ifdef HAVE_MPI
 	phase_colour colour;
-#endif
 	int type;
 	message_kind_t message_kind;
 	simtime_t timestamp;
 	simtime_t send_time;
 	unsigned long long mark;	/// Unique identifier of the message, used for antimessages
 	unsigned long long rendezvous_mark;	/// Unique identifier of the message, used for rendez-vous events
+	gvt_piggyback piggyback;	/// GVT information piggybacked by the sender kernel
 
 	// Model data
 	unsigned int size;
 	unsigned char event_content[];
 } msg_t;
 
-/// Message envelope definition. This is used to handle the output queue and stores information needed to generate antimessages
+/// Retrieve the message keeping a payload, as returned by AllocEvent()
+#define msg_from_content(content) ((msg_t *)((unsigned char *)(content) - offsetof(msg_t, event_content)))
+
+/**
+ * Message envelope definition. This is the compact record of a sent message kept in
+ * the output queue of the sender, storing the information needed to generate antimessages.
+ * The sender is the LP owning the output queue, so it is not kept here.
+ */
 typedef struct _msg_hdr_t {
-	// Pointers to attach messages to chains
-	struct _msg_hdr_t *next;
-	struct _msg_hdr_t *prev;
-	// Kernel's information
-	GID_t sender;
 	GID_t receiver;
-	// TODO: non serve davvero, togliere
 	int type;
-	unsigned long long rendezvous_mark;	/// Unique identifier of the message, used for rendez-vous event
-	// TODO: fine togliere
 	simtime_t timestamp;
 	simtime_t send_time;
 	unsigned long long mark;
+	unsigned long long rendezvous_mark;	/// Unique identifier of the message, used for rendez-vous event
 } msg_hdr_t;
 
+/**
+ * Antimessage definition. An antimessage annihilates, at once, all the messages which
+ * @e sender has sent to @e receiver after @e send_time, up to the one marked @e mark.
+ * Marks are increasing for a given sender, so that messages sent again after the
+ * rollback are left untouched. It is the same both in the bottom halves and on the wire.
+ */
+typedef struct _antimsg_t {
+	GID_t sender;
+	GID_t receiver;
+	phase_colour colour;
+	unsigned int count;		/// Number of messages to annihilate
+	simtime_t send_time;		/// Messages sent after this time are annihilated
+	simtime_t timestamp;		/// Smallest timestamp of the messages to annihilate
+	unsigned long long mark;	/// Largest mark of the messages to annihilate
+} antimsg_t;
+
 
 /// Barrier for all worker threads
 extern barrier_t all_thread_barrier;
@@ -46,20 +46,22 @@
 #include <core/init.h>
 #include <datatypes/bitmap.h>
 #include <scheduler/process.h>
+#include <scheduler/migration.h>
+#include <scheduler/placement.h>
 #include <gvt/gvt.h>
 #include <gvt/ccgs.h>
 #include <scheduler/scheduler.h>
 #include <mm/state.h>
 #include <mm/ecs.h>
 #include <mm/mm.h>
+#include <mm/persist.h>
 #include <statistics/statistics.h>
 #include <lib/numerical.h>
 #include <lib/topology.h>
 #include <lib/abm_layer.h>
+#include <lib/output.h>
 #include <serial/serial.h>
-#ifdef HAVE_MPI
 #include <communication/mpi.h>
-#endif
 
 
 /// This is the list of mnemonics for arguments
@@ -74,6 +76,9 @@ enum _opt_codes{
 	OPT_STATS = 		OPT_FIRST + PARAM_STATS,
 	OPT_STATE_SAVING = 	OPT_FIRST + PARAM_STATE_SAVING,
 	OPT_SNAPSHOT = 		OPT_FIRST + PARAM_SNAPSHOT,
+	OPT_GVT_MODE =		OPT_FIRST + PARAM_GVT_MODE,
+	OPT_TRANSPORT =		OPT_FIRST + PARAM_TRANSPORT,
+	OPT_HUGEPAGES =		OPT_FIRST + PARAM_HUGEPAGES,
 
 	OPT_NP,
 	OPT_NPRC,
@@ -90,6 +95,17 @@ enum _opt_codes{
 	OPT_SEED,
 	OPT_SERIAL,
 	OPT_NO_CORE_BINDING,
+	OPT_CHECKPOINT_EVERY,
+	OPT_RESTART_FROM,
+	OPT_COMM_PROFILE,
+	OPT_LP_MAPPING,
+	OPT_LP_MEMORY_QUOTA,
+
+	OPT_KERNELS,
+	OPT_COMM_THREAD,
+#ifdef HAVE_MPI
+	OPT_MIGRATE_EVERY,
+#endif
 
 #ifdef HAVE_PREEMPTION
 	OPT_PREEMPTION,
@@ -112,7 +128,8 @@ const char * const param_to_text[][5] = {
 	[OPT_LPS_DISTRIBUTION - OPT_FIRST] = {
 			[LP_DISTRIBUTION_INVALID] = "invalid LPs distribution",
 			[LP_DISTRIBUTION_BLOCK] = "block",
-			[LP_DISTRIBUTION_CIRCULAR] = "circular"
+			[LP_DISTRIBUTION_CIRCULAR] = "circular",
+			[LP_DISTRIBUTION_FILE] = "file"
 	},
 	[OPT_VERBOSE - OPT_FIRST] = {
 			[VERBOSE_INVALID] = "invalid verbose specification",
@@ -135,6 +152,22 @@ const char * const param_to_text[][5] = {
 	[OPT_SNAPSHOT - OPT_FIRST] = {
 			[SNAPSHOT_INVALID] = "invalid snapshot specification",
 			[SNAPSHOT_FULL] = "full",
+	},
+	[OPT_GVT_MODE - OPT_FIRST] = {
+			[GVT_MODE_INVALID] = "invalid GVT mode",
+			[GVT_MODE_COLLECTIVE] = "collective",
+			[GVT_MODE_PIGGYBACK] = "piggyback",
+	},
+	[OPT_TRANSPORT - OPT_FIRST] = {
+			[TRANSPORT_INVALID] = "invalid transport",
+			[TRANSPORT_MPI] = "mpi",
+			[TRANSPORT_SHM] = "shm",
+	},
+	[OPT_HUGEPAGES - OPT_FIRST] = {
+			[HUGEPAGES_INVALID] = "invalid huge pages mode",
+			[HUGEPAGES_NO] = "no",
+			[HUGEPAGES_THP] = "thp",
+			[HUGEPAGES_HUGETLB] = "hugetlb",
 	}
 };
 
@@ -165,7 +198,7 @@ static const struct argp_option argp_options[] = {
 	{"cktrm-mode",		OPT_CKTRM_MODE,		"TYPE",		0,		"Termination Detection mode. Supported values: normal, incremental, accurate", 0},
 	{"gvt-snapshot-cycles",	OPT_GVT_SNAPSHOT_CYCLES, "VALUE",	0,		"Termination detection is invoked after this number of GVT reductions", 0},
 	{"simulation-time",	OPT_SIMULATION_TIME, 	"VALUE",	0,		"Halt the simulation when all LPs reach this logical time. 0 means infinite", 0},
-	{"lps-distribution",	OPT_LPS_DISTRIBUTION, 	"TYPE",		0,		"LPs distributions over simulation kernels policies. Supported values: block, circular", 0},
+	{"lps-distribution",	OPT_LPS_DISTRIBUTION, 	"TYPE",		0,		"LPs distributions over simulation kernels policies. Supported values: block, circular, file (requires --lp-mapping)", 0},
 	{"deterministic-seed",	OPT_DETERMINISTIC_SEED,	0,		0, 		"Do not change the initial random seed for LPs. Enforces different deterministic simulation runs", 0},
 	{"verbose",		OPT_VERBOSE,		"TYPE",		0,		"Verbose execution", 0},
 	{"stats",		OPT_STATS,		"TYPE",		0,		"Level of detail in the output statistics", 0},
@@ -173,6 +206,20 @@ static const struct argp_option argp_options[] = {
 	{"serial",		OPT_SERIAL,		0,		0,		"Run a serial simulation (using Calendar Queues)", 0},
 	{"sequential",		OPT_SERIAL,		0,		OPTION_ALIAS,	NULL, 0},
 	{"no-core-binding",	OPT_NO_CORE_BINDING,	0,		0,		"Disable the binding of threads to specific physical processing cores", 0},
+	{"checkpoint-every",	OPT_CHECKPOINT_EVERY,	"VALUE",	0,		"Save a checkpoint of the whole simulation in the output folder every VALUE GVT reductions", 0},
+	{"restart-from",	OPT_RESTART_FROM,	"PATH",		0,		"Resume the simulation from the most recent checkpoint stored in this folder", 0},
+	{"comm-profile",	OPT_COMM_PROFILE,	"VALUE",	0,		"Profile the communication among LPs for VALUE GVT reductions, then place them on threads accordingly and save the placement in the output folder (requires the collective GVT mode with multiple kernels)", 0},
+	{"lp-mapping",		OPT_LP_MAPPING,		"PATH",		0,		"Place LPs on kernels and threads as in this file, saved by a previous run with --comm-profile", 0},
+	{"lp-memory-quota",	OPT_LP_MEMORY_QUOTA,	"MB",		0,		"Stop the simulation if an LP holds more than MB megabytes of memory, between its state, its checkpoints and its queued messages", 0},
+	{"hugepages",		OPT_HUGEPAGES,		"TYPE",		OPTION_ARG_OPTIONAL, "Back LP memory, message slabs and large checkpoints with huge pages. Supported values: thp (default), hugetlb (falls back to thp if none are reserved), no", 0},
+
+	{"gvt-mode",		OPT_GVT_MODE,		"TYPE",		0,		"Distributed GVT reduction. Supported values: collective, piggyback", 0},
+	{"transport",		OPT_TRANSPORT,		"TYPE",		0,		"Transport across kernels. Supported values: mpi (kernels started by mpiexec), shm (kernels forked on this host, see --kernels)", 0},
+	{"kernels",		OPT_KERNELS,		"VALUE",	0,		"Number of kernels forked on this host by the shm transport", 0},
+	{"comm-thread",		OPT_COMM_THREAD,	"CORE",		OPTION_ARG_OPTIONAL, "Let a dedicated thread perform all message passing across kernels, optionally bound to CORE", 0},
+#ifdef HAVE_MPI
+	{"migrate-every",	OPT_MIGRATE_EVERY,	"VALUE",	0,		"Migrate LPs across kernels to balance the load every VALUE GVT reductions (requires the collective GVT mode)", 0},
+#endif
 
 #ifdef HAVE_PREEMPTION
 	{"no-preemption",	OPT_PREEMPTION,		0,		0,		"Disable Preemptive Time Warp", 0},
@@ -184,10 +231,9 @@ static const struct argp_option argp_options[] = {
 
 #define conflicting_option_failure(msg)	argp_error(state, "the requested option %s with value \"%s\" is conflicting: " msg "\nAborting!", state->argv[state->next -1 -(arg != NULL)], arg)
 
-// this parses an string option leveraging the 2d array of strings specified earlier
+// this parses an string value leveraging the 2d array of strings specified earlier
 // the weird iteration style skips the element 0, which we know is associated with an invalid value description
-#define handle_string_option(label, var)						\
-	case label:									\
+#define parse_string_value(var)								\
 	({										\
 		unsigned __i = 1;							\
 		while(1) {								\
@@ -198,7 +244,11 @@ static const struct argp_option argp_options[] = {
 			if(!param_to_text[key - OPT_FIRST][++__i])			\
 				malformed_option_failure();				\
 		}									\
-	});										\
+	})
+
+#define handle_string_option(label, var)						\
+	case label:									\
+	parse_string_value(var);							\
 	break
 
 
@@ -249,6 +299,15 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 		handle_string_option(OPT_VERBOSE, rootsim_config.verbose);
 		handle_string_option(OPT_STATS, rootsim_config.stats);
 		handle_string_option(OPT_LPS_DISTRIBUTION, rootsim_config.lps_distribution);
+		handle_string_option(OPT_GVT_MODE, rootsim_config.gvt_mode);
+		handle_string_option(OPT_TRANSPORT, rootsim_config.transport);
+
+		case OPT_HUGEPAGES:
+			if(arg == NULL)
+				rootsim_config.hugepages = HUGEPAGES_THP;
+			else
+				parse_string_value(rootsim_config.hugepages);
+			break;
 
 		case OPT_NPWD:
 			if (bitmap_check(scanned, OPT_P-OPT_FIRST)) {
@@ -306,6 +365,42 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 			rootsim_config.core_binding = false;
 			break;
 
+		case OPT_CHECKPOINT_EVERY:
+			rootsim_config.checkpoint_every = parse_ullong_limits(1, UINT_MAX);
+			break;
+
+		case OPT_RESTART_FROM:
+			rootsim_config.restart_from = arg;
+			break;
+
+		case OPT_COMM_PROFILE:
+			rootsim_config.comm_profile = parse_ullong_limits(1, UINT_MAX);
+			break;
+
+		case OPT_LP_MAPPING:
+			rootsim_config.lp_mapping = arg;
+			break;
+
+		case OPT_LP_MEMORY_QUOTA:
+			rootsim_config.lp_memory_quota = parse_ullong_limits(1, UINT_MAX);
+			break;
+
+		case OPT_KERNELS:
+			rootsim_config.kernels = parse_ullong_limits(1, MAX_KERNELS);
+			break;
+
+		case OPT_COMM_THREAD:
+			rootsim_config.comm_thread = true;
+			if(arg != NULL)
+				rootsim_config.comm_thread_core = parse_ullong_limits(0, INT_MAX);
+			break;
+
+#ifdef HAVE_MPI
+		case OPT_MIGRATE_EVERY:
+			rootsim_config.migrate_every = parse_ullong_limits(1, UINT_MAX);
+			break;
+#endif
+
 #ifdef HAVE_PREEMPTION
 		case OPT_PREEMPTION:
 			rootsim_config.disable_preemption = true;
@@ -333,6 +428,25 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 			rootsim_config.set_seed = 0;
 			rootsim_config.serial = false;
 			rootsim_config.core_binding = true;
+			rootsim_config.checkpoint_every = 0;
+			rootsim_config.restart_from = NULL;
+			rootsim_config.comm_profile = 0;
+			rootsim_config.lp_mapping = NULL;
+			rootsim_config.hugepages = HUGEPAGES_NO;
+			rootsim_config.lp_memory_quota = 0;
+
+			rootsim_config.gvt_mode = GVT_MODE_COLLECTIVE;
+#ifdef HAVE_MPI
+			rootsim_config.transport = TRANSPORT_MPI;
+#else
+			rootsim_config.transport = TRANSPORT_SHM;
+#endif
+			rootsim_config.kernels = 1;
+			rootsim_config.comm_thread = false;
+			rootsim_config.comm_thread_core = -1;
+#ifdef HAVE_MPI
+			rootsim_config.migrate_every = 0;
+#endif
 
 #ifdef HAVE_PREEMPTION
 			rootsim_config.disable_preemption = false;
@@ -360,7 +474,70 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 			if(!rootsim_config.serial && n_prc_tot < n_cores)
 				rootsim_error(true, "Requested a simulation run with %u LPs and %u worker threads: the mapping is not possible\n", n_prc_tot, n_cores);
 
-			print_config();
+			if(rootsim_config.serial && (rootsim_config.checkpoint_every > 0 || rootsim_config.restart_from != NULL)) {
+				rootsim_error(false, "Checkpoint/restart is not supported by the serial simulator, ignoring\n");
+				rootsim_config.checkpoint_every = 0;
+				rootsim_config.restart_from = NULL;
+			}
+
+			if(rootsim_config.lp_mapping != NULL)
+				rootsim_config.lps_distribution = LP_DISTRIBUTION_FILE;
+			else if(rootsim_config.lps_distribution == LP_DISTRIBUTION_FILE)
+				rootsim_error(true, "LPs distribution \"file\" requires the placement of LPs to be given via \"--lp-mapping\"\n");
+
+			if(rootsim_config.serial && (rootsim_config.comm_profile > 0 || rootsim_config.lp_mapping != NULL)) {
+				rootsim_error(false, "Placement of LPs is not supported by the serial simulator, ignoring\n");
+				rootsim_config.comm_profile = 0;
+				rootsim_config.lp_mapping = NULL;
+				rootsim_config.lps_distribution = LP_DISTRIBUTION_BLOCK;
+			}
+
+			if(rootsim_config.serial && rootsim_config.lp_memory_quota > 0) {
+				rootsim_error(false, "Memory quotas are not supported by the serial simulator, ignoring\n");
+				rootsim_config.lp_memory_quota = 0;
+			}
+
+#ifndef HAVE_MPI
+			if(rootsim_config.transport == TRANSPORT_MPI)
+				rootsim_error(true, "The mpi transport is not available, ROOT-Sim was built without MPI support\n");
+#endif
+
+			if(rootsim_config.kernels > 1 && rootsim_config.transport != TRANSPORT_SHM)
+				rootsim_error(true, "Kernels can be forked only by the shm transport, use mpiexec to start MPI kernels\n");
+
+			if(rootsim_config.serial && rootsim_config.kernels > 1) {
+				rootsim_error(false, "Multiple kernels are not supported by the serial simulator, ignoring\n");
+				rootsim_config.kernels = 1;
+			}
+
+			// These rely on MPI collectives, which kernels forked by the shm transport cannot use
+			if(rootsim_config.transport == TRANSPORT_SHM && rootsim_config.kernels > 1) {
+				if(rootsim_config.comm_profile > 0)
+					rootsim_error(true, "Communication profiling across kernels is not supported by the shm transport\n");
+#ifdef HAVE_MPI
+				if(rootsim_config.migrate_every > 0)
+					rootsim_error(true, "LP migration is not supported by the shm transport\n");
+#endif
+			}
+
+			if(rootsim_config.comm_thread_core >= get_cores())
+				rootsim_error(true, "Cannot bind the communication thread to core %d, only %ld cores are available\n", rootsim_config.comm_thread_core, get_cores());
+
+#ifdef HAVE_MPI
+			if(rootsim_config.migrate_every > 0) {
+				if(rootsim_config.checkpoint_every > 0 || rootsim_config.restart_from != NULL)
+					rootsim_error(true, "LP migration cannot be used together with checkpoint/restart\n");
+
+				// The per-LP state of these libraries is built from data which is released after startup
+				if(&abm_settings || (&topology_settings && topology_settings.topology_path != NULL)) {
+					rootsim_error(false, "LP migration is not supported by models using the ABM layer or a topology file, ignoring\n");
+					rootsim_config.migrate_every = 0;
+				}
+
+				if(rootsim_config.serial)
+					rootsim_config.migrate_every = 0;
+			}
+#endif
 
 			break;
 			/* these functionalities are not needed
@@ -379,6 +556,7 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 
 #undef parse_ullong_limits
 #undef handle_string_option
+#undef parse_string_value
 #undef conflicting_option_failure
 #undef malformed_option_failure
 
@@ -389,6 +567,25 @@ static struct argp_child argp_child[2] = {
 
 static struct argp argp = { argp_options, parse_opt, args_doc, doc, argp_child, 0, 0 };
 
+/**
+* Sanity checks on the configuration which depend on the number of kernels,
+* which is known only once the kernels are started.
+*/
+static void check_kernels_config(void)
+{
+#ifdef HAVE_MPI
+	// Kernels must adopt GVT rounds together to agree on migrations
+	if(n_ker == 1)
+		rootsim_config.migrate_every = 0;
+	else if(rootsim_config.migrate_every > 0 && rootsim_config.gvt_mode == GVT_MODE_PIGGYBACK)
+		rootsim_error(true, "LP migration cannot be used together with the piggyback GVT mode\n");
+#endif
+
+	// The placement is computed with collectives, upon the same GVT round in all kernels
+	if(rootsim_config.comm_profile > 0 && rootsim_config.gvt_mode == GVT_MODE_PIGGYBACK && n_ker > 1)
+		rootsim_error(true, "Communication profiling cannot be used together with the piggyback GVT mode\n");
+}
+
 /**
 * This function initializes the simulator
 *
@@ -400,29 +597,31 @@ static struct argp argp = { argp_options, parse_opt, args_doc, doc, argp_child,
 */
 void SystemInit(int argc, char **argv)
 {
-#ifdef HAVE_MPI
-	mpi_init(&argc, &argv);
+	// this retrieves the model's argp parser if declared by the developer
+	argp_child[0].argp = &model_argp;
 
-	if(n_ker > MAX_KERNELS){
-		rootsim_error(true, "Too many kernels, maximum supported number is %u\n", MAX_KERNELS);
-	}
-#else
-	n_ker = 1;
-#endif
+	argp_parse (&argp, argc, argv, 0, NULL, NULL);
+
+	// The serial simulator runs a single kernel, without starting any transport
+	if(rootsim_config.serial)
+		n_ker = 1;
+	else
+		inter_kernel_bootstrap(&argc, &argv);
+
+	check_kernels_config();
+	print_config();
 
 	// Early initialization of ECS subsystem if needed
 #ifdef HAVE_CROSS_STATE
 	ecs_init();
 #endif
 
-	// this retrieves the model's argp parser if declared by the developer
-	argp_child[0].argp = &model_argp;
-
-	argp_parse (&argp, argc, argv, 0, NULL, NULL);
-
 	// If we're going to run a serial simulation, configure the simulation to support it
 	if(rootsim_config.serial) {
 		ScheduleNewEvent = SerialScheduleNewEvent;
+		AllocEvent = SerialAllocEvent;
+		CommitEvent = SerialCommitEvent;
+		segment_init();
 		initialize_lps();
 		numerical_init();
 		statistics_init();
@@ -432,6 +631,8 @@ void SystemInit(int argc, char **argv)
 		return;
 	} else {
 		ScheduleNewEvent = ParallelScheduleNewEvent;
+		AllocEvent = ParallelAllocEvent;
+		CommitEvent = ParallelCommitEvent;
 	}
 
 	// Initialize ROOT-Sim subsystems.
@@ -448,6 +649,12 @@ void SystemInit(int argc, char **argv)
 	numerical_init();
 	topology_init();
 	abm_layer_init();
+	output_init();
+	persist_init();
+#ifdef HAVE_MPI
+	migration_init();
+#endif
+	placement_init();
 
 	// This call tells the simulation engine that the sequential initial simulation is complete
 	initialization_complete();
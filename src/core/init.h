@@ -43,6 +43,9 @@ enum param_codes {
 	PARAM_STATS,
 	PARAM_STATE_SAVING,
 	PARAM_SNAPSHOT,
+	PARAM_GVT_MODE,
+	PARAM_TRANSPORT,
+	PARAM_HUGEPAGES,
 };
 
 /*!
@@ -72,6 +75,21 @@ typedef struct _simulation_configuration {
 	bool serial;			///< If the simulation must be run serially
 	seed_type set_seed;		///< The master seed to be used in this run
 	bool core_binding;		///< Bind threads to specific core (reduce context switches and cache misses)
+	unsigned int checkpoint_every;	///< GVT reductions between two checkpoints of the whole simulation to disk, 0 to disable
+	char *restart_from;		///< Path to a folder keeping the checkpoint to resume the simulation from
+	unsigned int comm_profile;	///< GVT reductions during which the communication among LPs is profiled to place them, 0 to disable
+	char *lp_mapping;		///< Path to a file keeping the placement of LPs onto kernels and threads
+	int hugepages;			///< Whether and how huge pages back the memory of the simulation
+	unsigned int lp_memory_quota;	///< Megabytes of memory each LP can hold, 0 for no limit
+
+	int gvt_mode;			///< How the distributed GVT is reduced across kernels
+	int transport;			///< How messages are exchanged across kernels
+	unsigned int kernels;		///< Kernels forked on this host by the shared-memory transport
+	bool comm_thread;		///< Message passing across kernels is carried out by a dedicated thread
+	int comm_thread_core;		///< The core the communication thread is bound to, -1 if not bound
+#ifdef HAVE_MPI
+	unsigned int migrate_every;	///< GVT reductions between two rounds of LP migration across kernels, 0 to disable
+#endif
 
 #ifdef HAVE_PREEMPTION
 	bool disable_preemption;	///< If compiled for preemptive Time Warp, it can be disabled at runtime
@@ -0,0 +1,550 @@
+/**
+ * @file datatypes/graph.c
+ *
+ * @brief Weighted undirected graphs and their partitioning
+ *
+ * Partitioning follows the multilevel scheme: the graph is repeatedly
+ * coarsened by collapsing the endpoints of heavy edges, the coarsest graph
+ * is split by growing one region at a time around its most connected
+ * vertices, and the partition is then projected back level by level. At
+ * each level, vertices on the boundary of the parts are moved to the part
+ * they are most connected to, as long as the load balance allows it.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+
+#include <core/core.h>
+#include <datatypes/graph.h>
+#include <mm/mm.h>
+
+/// Coarsening stops when the graph has no more than this number of vertices per part
+#define GRAPH_COARSEN_TO	16
+
+/// Coarsening stops when a level shrinks the graph less than this factor
+#define GRAPH_MIN_SHRINK	0.9
+
+/// A part can be heavier than its target weight up to this factor
+#define GRAPH_IMBALANCE		1.05
+
+/// Maximum number of refinement passes at each level
+#define GRAPH_REFINE_PASSES	8
+
+
+static struct graph *graph_alloc(unsigned int n, unsigned int n_adj)
+{
+	struct graph *g = rsalloc(sizeof(struct graph));
+
+	g->n = n;
+	g->xadj = rsalloc(sizeof(unsigned int) * (n + 1));
+	g->adjncy = rsalloc(sizeof(unsigned int) * (n_adj > 0 ? n_adj : 1));
+	g->adjwgt = rsalloc(sizeof(unsigned long long) * (n_adj > 0 ? n_adj : 1));
+	g->vwgt = rsalloc(sizeof(unsigned long long) * (n > 0 ? n : 1));
+
+	return g;
+}
+
+void graph_free(struct graph *g)
+{
+	rsfree(g->xadj);
+	rsfree(g->adjncy);
+	rsfree(g->adjwgt);
+	rsfree(g->vwgt);
+	rsfree(g);
+}
+
+/**
+* Build a graph from a list of directed edges. Edges are made undirected,
+* the weights of parallel edges are summed up and self loops are dropped.
+*
+* @param n The number of vertices
+* @param n_edges The number of directed edges
+* @param src The source vertex of each edge
+* @param dst The destination vertex of each edge
+* @param weight The weight of each edge
+* @param vwgt The weight of each vertex
+*
+* @return The new graph, to be released with graph_free()
+*/
+struct graph *graph_build(unsigned int n, unsigned int n_edges, const unsigned int *src, const unsigned int *dst, const unsigned long long *weight, const unsigned long long *vwgt)
+{
+	struct graph *g;
+	unsigned int *start, *fill, *pos;
+	unsigned int i, v, u, k, out;
+
+	g = graph_alloc(n, 2 * n_edges);
+	memcpy(g->vwgt, vwgt, sizeof(unsigned long long) * n);
+
+	start = rsalloc(sizeof(unsigned int) * (n + 1));
+	fill = rsalloc(sizeof(unsigned int) * (n + 1));
+	pos = rsalloc(sizeof(unsigned int) * (n + 1));
+
+	// Each edge shows up in the adjacency lists of both its endpoints
+	bzero(start, sizeof(unsigned int) * (n + 1));
+	for (v = 0; v < n; v++)
+		pos[v] = UINT_MAX;
+	for (i = 0; i < n_edges; i++) {
+		if (src[i] == dst[i])
+			continue;
+		start[src[i] + 1]++;
+		start[dst[i] + 1]++;
+	}
+	for (v = 0; v < n; v++)
+		start[v + 1] += start[v];
+
+	memcpy(fill, start, sizeof(unsigned int) * (n + 1));
+	for (i = 0; i < n_edges; i++) {
+		if (src[i] == dst[i])
+			continue;
+		g->adjncy[fill[src[i]]] = dst[i];
+		g->adjwgt[fill[src[i]]++] = weight[i];
+		g->adjncy[fill[dst[i]]] = src[i];
+		g->adjwgt[fill[dst[i]]++] = weight[i];
+	}
+
+	// Merge parallel edges. Positions recorded for previous vertices are
+	// smaller than the start of the current list, so they are never matched.
+	out = 0;
+	for (v = 0; v < n; v++) {
+		g->xadj[v] = out;
+		for (k = start[v]; k < start[v + 1]; k++) {
+			u = g->adjncy[k];
+			if (pos[u] != UINT_MAX && pos[u] >= g->xadj[v]) {
+				g->adjwgt[pos[u]] += g->adjwgt[k];
+				continue;
+			}
+			pos[u] = out;
+			g->adjncy[out] = u;
+			g->adjwgt[out++] = g->adjwgt[k];
+		}
+	}
+	g->xadj[n] = out;
+
+	rsfree(start);
+	rsfree(fill);
+	rsfree(pos);
+
+	return g;
+}
+
+/**
+* Extract the subgraph induced by the vertices in a part. Edges towards
+* other parts are dropped.
+*
+* @param g The graph
+* @param part The part of each vertex
+* @param which The part to extract
+* @param map Where the vertex of @p g matching each vertex of the subgraph is stored
+*
+* @return The subgraph, to be released with graph_free()
+*/
+struct graph *graph_subgraph(const struct graph *g, const unsigned int *part, unsigned int which, unsigned int *map)
+{
+	struct graph *sub;
+	unsigned int *inverse;
+	unsigned int v, k, n = 0, n_adj = 0, out = 0;
+
+	inverse = rsalloc(sizeof(unsigned int) * (g->n > 0 ? g->n : 1));
+
+	for (v = 0; v < g->n; v++) {
+		inverse[v] = UINT_MAX;
+		if (part[v] == which) {
+			inverse[v] = n;
+			map[n++] = v;
+			n_adj += g->xadj[v + 1] - g->xadj[v];
+		}
+	}
+
+	sub = graph_alloc(n, n_adj);
+	for (v = 0; v < n; v++) {
+		sub->vwgt[v] = g->vwgt[map[v]];
+		sub->xadj[v] = out;
+		for (k = g->xadj[map[v]]; k < g->xadj[map[v] + 1]; k++) {
+			if (inverse[g->adjncy[k]] == UINT_MAX)
+				continue;
+			sub->adjncy[out] = inverse[g->adjncy[k]];
+			sub->adjwgt[out++] = g->adjwgt[k];
+		}
+	}
+	sub->xadj[n] = out;
+
+	rsfree(inverse);
+	return sub;
+}
+
+/**
+* Compute the total weight of the edges crossing different parts.
+*
+* @param g The graph
+* @param part The part of each vertex
+*
+* @return The weight of the cut
+*/
+unsigned long long graph_edge_cut(const struct graph *g, const unsigned int *part)
+{
+	unsigned long long cut = 0;
+	unsigned int v, k;
+
+	for (v = 0; v < g->n; v++) {
+		for (k = g->xadj[v]; k < g->xadj[v + 1]; k++) {
+			if (g->adjncy[k] > v && part[g->adjncy[k]] != part[v])
+				cut += g->adjwgt[k];
+		}
+	}
+
+	return cut;
+}
+
+/**
+* Collapse pairs of vertices into single vertices. Each vertex is matched
+* with the unmatched neighbour it shares the heaviest edge with. Vertices
+* left without a partner are matched among themselves, so that graphs with
+* few edges can be coarsened as well.
+*
+* @param g The graph to coarsen
+* @param cmap Where the coarse vertex of each vertex of @p g is stored
+* @param max_vwgt The maximum weight of a coarse vertex
+*
+* @return The coarse graph, to be released with graph_free()
+*/
+static struct graph *graph_coarsen(const struct graph *g, unsigned int *cmap, unsigned long long max_vwgt)
+{
+	struct graph *coarse;
+	unsigned int *match, *pos;
+	unsigned int v, u, k, c, best, alone = UINT_MAX, n = 0, out = 0;
+	unsigned long long best_wgt;
+
+	match = rsalloc(sizeof(unsigned int) * g->n);
+	pos = rsalloc(sizeof(unsigned int) * g->n);
+
+	for (v = 0; v < g->n; v++)
+		match[v] = UINT_MAX;
+
+	for (v = 0; v < g->n; v++) {
+		if (match[v] != UINT_MAX)
+			continue;
+
+		best = UINT_MAX;
+		best_wgt = 0;
+		for (k = g->xadj[v]; k < g->xadj[v + 1]; k++) {
+			u = g->adjncy[k];
+			if (match[u] != UINT_MAX || g->vwgt[v] + g->vwgt[u] > max_vwgt)
+				continue;
+			if (best == UINT_MAX || g->adjwgt[k] > best_wgt) {
+				best = u;
+				best_wgt = g->adjwgt[k];
+			}
+		}
+
+		if (best == UINT_MAX && g->vwgt[v] <= max_vwgt / 2) {
+			if (alone == UINT_MAX || match[alone] != UINT_MAX || g->vwgt[alone] + g->vwgt[v] > max_vwgt) {
+				alone = v;
+				continue;
+			}
+			best = alone;
+			alone = UINT_MAX;
+		} else if (best == UINT_MAX) {
+			best = v;
+		}
+
+		match[v] = best;
+		match[best] = v;
+	}
+
+	// Number the coarse vertices, following the order of the first vertex of each pair
+	for (v = 0; v < g->n; v++) {
+		if (match[v] == UINT_MAX)
+			match[v] = v;
+		if (match[v] >= v)
+			cmap[v] = n++;
+		else
+			cmap[v] = cmap[match[v]];
+	}
+
+	coarse = graph_alloc(n, g->xadj[g->n]);
+	for (v = 0; v < n; v++)
+		pos[v] = UINT_MAX;
+
+	for (v = 0; v < g->n; v++) {
+		if (match[v] < v)
+			continue;
+
+		c = cmap[v];
+		coarse->xadj[c] = out;
+		coarse->vwgt[c] = g->vwgt[v];
+		if (match[v] != v)
+			coarse->vwgt[c] += g->vwgt[match[v]];
+
+		for (u = v;; u = match[v]) {
+			for (k = g->xadj[u]; k < g->xadj[u + 1]; k++) {
+				unsigned int cu = cmap[g->adjncy[k]];
+
+				if (cu == c)
+					continue;
+				if (pos[cu] != UINT_MAX && pos[cu] >= coarse->xadj[c]) {
+					coarse->adjwgt[pos[cu]] += g->adjwgt[k];
+					continue;
+				}
+				pos[cu] = out;
+				coarse->adjncy[out] = cu;
+				coarse->adjwgt[out++] = g->adjwgt[k];
+			}
+			if (u == match[v])
+				break;
+		}
+	}
+	coarse->xadj[n] = out;
+
+	rsfree(match);
+	rsfree(pos);
+
+	return coarse;
+}
+
+/**
+* Split a graph by growing one part at a time. Each part starts from the
+* heaviest vertex left, and then takes the vertex left which is most
+* connected to it, until it reaches its target weight. The last part
+* takes whatever is left.
+*
+* @param g The graph
+* @param nparts The number of parts
+* @param target The target weight of each part
+* @param part Where the part of each vertex is stored
+*/
+static void graph_grow_parts(const struct graph *g, unsigned int nparts, const unsigned long long *target, unsigned int *part)
+{
+	unsigned long long *conn, wgt;
+	unsigned int p, v, k, best, left = g->n;
+
+	conn = rsalloc(sizeof(unsigned long long) * g->n);
+
+	for (v = 0; v < g->n; v++)
+		part[v] = UINT_MAX;
+
+	for (p = 0; p + 1 < nparts; p++) {
+		bzero(conn, sizeof(unsigned long long) * g->n);
+		wgt = 0;
+
+		// Leave at least one vertex to each of the remaining parts
+		while (left > nparts - p - 1) {
+			best = UINT_MAX;
+			for (v = 0; v < g->n; v++) {
+				if (part[v] != UINT_MAX)
+					continue;
+				if (best == UINT_MAX || conn[v] > conn[best] || (conn[v] == conn[best] && g->vwgt[v] > g->vwgt[best]))
+					best = v;
+			}
+
+			// Stop if the vertex brings the part farther from its target
+			if (wgt > 0 && wgt + g->vwgt[best] > target[p] && wgt + g->vwgt[best] - target[p] > target[p] - wgt)
+				break;
+
+			part[best] = p;
+			wgt += g->vwgt[best];
+			left--;
+			for (k = g->xadj[best]; k < g->xadj[best + 1]; k++)
+				conn[g->adjncy[k]] += g->adjwgt[k];
+
+			if (wgt >= target[p])
+				break;
+		}
+	}
+
+	for (v = 0; v < g->n; v++) {
+		if (part[v] == UINT_MAX)
+			part[v] = nparts - 1;
+	}
+
+	rsfree(conn);
+}
+
+/**
+* Move vertices to the part they are most connected to, as long as the
+* part does not grow beyond its maximum weight. A vertex of a part which
+* is too heavy is moved to the least loaded part which can take it, even
+* if this increases the cut. A vertex can also be moved to reduce the
+* imbalance among parts when the cut does not change. No part is emptied.
+*
+* @param g The graph
+* @param nparts The number of parts
+* @param target The target weight of each part
+* @param max_pwgt The maximum weight of each part
+* @param part The part of each vertex, which is updated
+*/
+static void graph_refine(const struct graph *g, unsigned int nparts, const unsigned long long *target, const unsigned long long *max_pwgt, unsigned int *part)
+{
+	unsigned long long pwgt[nparts], conn[nparts], vw;
+	unsigned int pcount[nparts], touched[nparts], mark[nparts];
+	unsigned int pass, v, k, t, p, from, best, n_touched, moved, stamp = 0;
+	long long gain, best_gain;
+
+	bzero(pwgt, sizeof(pwgt));
+	bzero(pcount, sizeof(pcount));
+	bzero(conn, sizeof(conn));
+	for (p = 0; p < nparts; p++)
+		mark[p] = 0;
+
+	for (v = 0; v < g->n; v++) {
+		pwgt[part[v]] += g->vwgt[v];
+		pcount[part[v]]++;
+	}
+
+#define load(p, extra) ((double)(pwgt[p] + (extra)) / (double)(target[p] > 0 ? target[p] : 1))
+
+	for (pass = 0; pass < GRAPH_REFINE_PASSES; pass++) {
+		moved = 0;
+
+		for (v = 0; v < g->n; v++) {
+			from = part[v];
+			vw = g->vwgt[v];
+			if (pcount[from] == 1)
+				continue;
+
+			// Parts are marked when first met in the adjacency list of the current vertex
+			stamp++;
+			n_touched = 0;
+			for (k = g->xadj[v]; k < g->xadj[v + 1]; k++) {
+				p = part[g->adjncy[k]];
+				if (mark[p] != stamp) {
+					mark[p] = stamp;
+					conn[p] = 0;
+					touched[n_touched++] = p;
+				}
+				conn[p] += g->adjwgt[k];
+			}
+			if (mark[from] != stamp) {
+				mark[from] = stamp;
+				conn[from] = 0;
+			}
+
+			best = from;
+			best_gain = 0;
+			for (t = 0; t < n_touched; t++) {
+				p = touched[t];
+				if (p == from || pwgt[p] + vw > max_pwgt[p])
+					continue;
+
+				gain = (long long)conn[p] - (long long)conn[from];
+				if (gain > best_gain || (gain == best_gain && gain >= 0 && load(p, vw) < load(best == from ? from : best, best == from ? 0 : vw)))
+					best = p, best_gain = gain;
+			}
+
+			// Relieve a part which is too heavy, whatever the cost
+			if (best == from && pwgt[from] > max_pwgt[from]) {
+				for (p = 0; p < nparts; p++) {
+					if (p != from && pwgt[p] + vw <= max_pwgt[p] && (best == from || load(p, vw) < load(best, vw)))
+						best = p;
+				}
+			}
+
+			if (best == from)
+				continue;
+
+			part[v] = best;
+			pwgt[from] -= vw;
+			pwgt[best] += vw;
+			pcount[from]--;
+			pcount[best]++;
+			moved++;
+		}
+
+		if (moved == 0)
+			break;
+	}
+
+#undef load
+}
+
+static void graph_partition_multilevel(const struct graph *g, unsigned int nparts, const unsigned long long *target, const unsigned long long *max_pwgt, unsigned long long max_vwgt, unsigned int *part)
+{
+	struct graph *coarse = NULL;
+	unsigned int *cmap, *cpart;
+	unsigned int v;
+
+	if (g->n > GRAPH_COARSEN_TO * nparts) {
+		cmap = rsalloc(sizeof(unsigned int) * g->n);
+		coarse = graph_coarsen(g, cmap, max_vwgt);
+
+		if (coarse->n <= g->n * GRAPH_MIN_SHRINK) {
+			cpart = rsalloc(sizeof(unsigned int) * coarse->n);
+			graph_partition_multilevel(coarse, nparts, target, max_pwgt, max_vwgt, cpart);
+			for (v = 0; v < g->n; v++)
+				part[v] = cpart[cmap[v]];
+			rsfree(cpart);
+		} else {
+			graph_free(coarse);
+			coarse = NULL;
+		}
+		rsfree(cmap);
+	}
+
+	if (coarse == NULL)
+		graph_grow_parts(g, nparts, target, part);
+	else
+		graph_free(coarse);
+
+	graph_refine(g, nparts, target, max_pwgt, part);
+}
+
+/**
+* Split a graph in parts, so that the weight of each part is close to its
+* target and the weight of the edges crossing different parts is small.
+* If there are enough vertices, no part is left empty.
+*
+* @param g The graph
+* @param nparts The number of parts
+* @param targets The fraction of the total vertex weight which should go to
+*                each part. If @c NULL, parts get the same weight.
+* @param part Where the part of each vertex is stored
+*/
+void graph_partition(const struct graph *g, unsigned int nparts, const double *targets, unsigned int *part)
+{
+	unsigned long long target[nparts > 0 ? nparts : 1], max_pwgt[nparts > 0 ? nparts : 1];
+	unsigned long long total = 0, heaviest = 0, max_vwgt;
+	double sum = 0;
+	unsigned int v, p;
+
+	if (nparts <= 1 || g->n <= nparts) {
+		for (v = 0; v < g->n; v++)
+			part[v] = (nparts > 1 ? v : 0);
+		return;
+	}
+
+	for (v = 0; v < g->n; v++) {
+		total += g->vwgt[v];
+		heaviest = max(heaviest, g->vwgt[v]);
+	}
+
+	for (p = 0; p < nparts; p++)
+		sum += (targets != NULL ? targets[p] : 1.0);
+
+	for (p = 0; p < nparts; p++) {
+		target[p] = total * (targets != NULL ? targets[p] : 1.0) / sum;
+		max_pwgt[p] = max(target[p] * GRAPH_IMBALANCE, target[p] + 1);
+	}
+
+	// Coarse vertices must stay small enough to let the parts be balanced
+	max_vwgt = max(1.5 * total / (GRAPH_COARSEN_TO * nparts), heaviest);
+
+	graph_partition_multilevel(g, nparts, target, max_pwgt, max_vwgt, part);
+}
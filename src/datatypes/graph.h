@@ -0,0 +1,44 @@
+/**
+ * @file datatypes/graph.h
+ *
+ * @brief Weighted undirected graphs and their partitioning
+ *
+ * Graphs are stored in compressed sparse row format. They can be split in
+ * a number of parts of given weight, so that the total weight of the edges
+ * crossing different parts is small.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+/// A weighted undirected graph
+struct graph {
+	unsigned int n;			///< Number of vertices
+	unsigned int *xadj;		///< The neighbours of vertex i are adjncy[xadj[i]] to adjncy[xadj[i + 1] - 1]
+	unsigned int *adjncy;		///< The adjacency lists of all vertices, one after the other
+	unsigned long long *adjwgt;	///< The weight of each edge in @ref adjncy
+	unsigned long long *vwgt;	///< The weight of each vertex
+};
+
+extern struct graph *graph_build(unsigned int n, unsigned int n_edges, const unsigned int *src, const unsigned int *dst, const unsigned long long *weight, const unsigned long long *vwgt);
+extern struct graph *graph_subgraph(const struct graph *g, const unsigned int *part, unsigned int which, unsigned int *map);
+extern void graph_free(struct graph *g);
+extern void graph_partition(const struct graph *g, unsigned int nparts, const double *targets, unsigned int *part);
+extern unsigned long long graph_edge_cut(const struct graph *g, const unsigned int *part);
@@ -74,13 +74,13 @@ msg_channel *init_channel(void)
 		rootsim_error(true, "Unable to allocate message channel\n");
 
 	mc->buffers[M_READ]->buffer =
-	    rsalloc(INITIAL_CHANNEL_SIZE * sizeof(msg_t *));
+	    rsalloc(INITIAL_CHANNEL_SIZE * sizeof(void *));
 	mc->buffers[M_READ]->size = INITIAL_CHANNEL_SIZE;
 	mc->buffers[M_READ]->written = 0;
 	mc->buffers[M_READ]->read = 0;
 
 	mc->buffers[M_WRITE]->buffer =
-	    rsalloc(INITIAL_CHANNEL_SIZE * sizeof(msg_t *));
+	    rsalloc(INITIAL_CHANNEL_SIZE * sizeof(void *));
 	mc->buffers[M_WRITE]->size = INITIAL_CHANNEL_SIZE;
 	mc->buffers[M_WRITE]->written = 0;
 	mc->buffers[M_WRITE]->read = 0;
@@ -89,12 +89,13 @@ msg_channel *init_channel(void)
 	    || mc->buffers[M_WRITE]->buffer == NULL)
 		rootsim_error(true, "Unable to allocate message channel\n");
 
+	atomic_set(&mc->size, 0);
 	spinlock_init(&mc->write_lock);
 
 	return mc;
 }
 
-void insert_msg(msg_channel * mc, msg_t * msg)
+void insert_msg(msg_channel * mc, void *msg)
 {
 
 	spin_lock(&mc->write_lock);
@@ -107,25 +108,23 @@ void insert_msg(msg_channel * mc, msg_t * msg)
 		mc->buffers[M_WRITE]->size *= 2;
 		mc->buffers[M_WRITE]->buffer =
 		    rsrealloc((void *)mc->buffers[M_WRITE]->buffer,
-			      mc->buffers[M_WRITE]->size * sizeof(msg_t *));
+			      mc->buffers[M_WRITE]->size * sizeof(void *));
 
 		if (unlikely(mc->buffers[M_WRITE]->buffer == NULL))
 			rootsim_error(true, "Unable to reallocate message channel\n");
 
 	}
-#ifndef NDEBUG
-	validate_msg(msg);
-#endif
 
 	int index = mc->buffers[M_WRITE]->written++;
 	mc->buffers[M_WRITE]->buffer[index] = msg;
+	atomic_inc(&mc->size);
 
 	spin_unlock(&mc->write_lock);
 }
 
 void *get_msg(msg_channel * mc)
 {
-	msg_t *msg = NULL;
+	void *msg = NULL;
 
 	if (unlikely(mc->buffers[M_READ]->read == mc->buffers[M_READ]->written)) {
 		spin_lock(&mc->write_lock);
@@ -143,7 +142,6 @@ void *get_msg(msg_channel * mc)
 
 #ifndef NDEBUG
 	mc->buffers[M_READ]->buffer[index] = (void *)0xDEADB00B;
-	validate_msg(msg);
 #endif
 
  leave:
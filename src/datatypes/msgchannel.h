@@ -32,7 +32,7 @@
 #include <core/core.h>
 
 struct _msg_buff {
-	msg_t *volatile *buffer;
+	void *volatile *buffer;
 	volatile unsigned int size;
 	volatile unsigned int written;
 	volatile unsigned int read;
@@ -40,13 +40,16 @@ struct _msg_buff {
 
 typedef struct _msg_channel {
 	struct _msg_buff *volatile buffers[2];
-	atomic_t size;
+	atomic_t size;		///< Messages inserted and not yet retrieved
 	spinlock_t write_lock;
 } msg_channel;
 
+/// Tell without locking whether a channel is empty. A message being inserted concurrently might be missed.
+#define channel_empty(mc) (atomic_read(&(mc)->size) == 0)
+
 #define INITIAL_CHANNEL_SIZE (512)
 
 extern msg_channel *init_channel(void);
 extern void fini_channel(msg_channel *);
-extern void insert_msg(msg_channel *, msg_t *);
+extern void insert_msg(msg_channel *, void *);
 extern void *get_msg(msg_channel *);
@@ -0,0 +1,108 @@
+/**
+ * @file datatypes/ring.h
+ *
+ * @brief A growable ring buffer
+ *
+ * Elements are appended at the tail, and can be removed both from the head
+ * and from the tail in constant time. The buffer doubles its capacity when
+ * it is full, so that appending is constant time in the amortized sense.
+ * This fits queues which are appended in order and then trimmed at both
+ * ends, such as the output queues of LPs.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <string.h>
+
+#include <core/core.h>
+#include <mm/dymelor.h>
+
+/// Initial capacity of a ring buffer. It must be a power of two.
+#define INIT_SIZE_RING 16U
+
+#define rootsim_ring(type) \
+		struct { \
+			type *items; \
+			unsigned head, count, capacity; \
+		}
+
+#define ring_count(self) ((self).count)
+
+#define ring_capacity(self) ((self).capacity)
+
+#define ring_empty(self) (ring_count(self) == 0)
+
+/// The i-th element from the head of the ring. This isn't checked CARE!
+#define ring_get_at(self, i) ((self).items[((self).head + (i)) & (ring_capacity(self) - 1)])
+
+/// The oldest element of the ring. This isn't checked CARE!
+#define ring_head(self) ring_get_at(self, 0)
+
+/// The newest element of the ring. This isn't checked CARE!
+#define ring_tail(self) ring_get_at(self, ring_count(self) - 1)
+
+#define ring_init(self) ({ \
+		ring_capacity(self) = INIT_SIZE_RING; \
+		(self).items = rsalloc(ring_capacity(self) * sizeof(*(self).items)); \
+		(self).head = 0; \
+		ring_count(self) = 0; \
+	})
+
+#define ring_fini(self) ({ \
+		rsfree((self).items); \
+	})
+
+// Move the elements to a buffer of the given capacity, with the head at the beginning
+#define ring_resize(self, new_capacity) ({ \
+		__typeof__((self).items) __newitems = rsalloc((new_capacity) * sizeof(*(self).items)); \
+		unsigned __first = min(ring_count(self), ring_capacity(self) - (self).head); \
+		memcpy(__newitems, &(self).items[(self).head], __first * sizeof(*(self).items)); \
+		memcpy(&__newitems[__first], (self).items, (ring_count(self) - __first) * sizeof(*(self).items)); \
+		rsfree((self).items); \
+		(self).items = __newitems; \
+		(self).head = 0; \
+		ring_capacity(self) = (new_capacity); \
+	})
+
+/// Append an element at the tail of the ring, and return a pointer to it
+#define ring_push_tail(self) ({ \
+		if (unlikely(ring_count(self) == ring_capacity(self))) \
+			ring_resize(self, 2 * ring_capacity(self)); \
+		ring_count(self)++; \
+		&ring_tail(self); \
+	})
+
+/// Drop the newest element of the ring. This isn't checked CARE!
+#define ring_pop_tail(self) ({ \
+		ring_count(self)--; \
+	})
+
+/// Drop the oldest element of the ring. This isn't checked CARE!
+#define ring_pop_head(self) ({ \
+		(self).head = ((self).head + 1) & (ring_capacity(self) - 1); \
+		ring_count(self)--; \
+	})
+
+/// Give memory back if the ring is mostly empty, e.g. after a large truncation
+#define ring_shrink(self) ({ \
+		if (ring_capacity(self) > INIT_SIZE_RING && ring_count(self) * 4 <= ring_capacity(self)) \
+			ring_resize(self, ring_capacity(self) / 2); \
+	})
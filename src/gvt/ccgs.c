@@ -44,6 +44,8 @@
 #include <gvt/ccgs.h>
 #include <scheduler/scheduler.h>
 #include <scheduler/process.h>
+#include <statistics/statistics.h>
+#include <core/timer.h>
 
 /// This variable is an aggregate result for the distributed termination detection
 static bool ccgs_completed_simulation = false;
@@ -51,34 +53,29 @@ static bool ccgs_completed_simulation = false;
 /// In case termination detection is incremental, this array keeps track of LPs that think the simulation can be halted already
 static bool *lps_termination;
 
+/// Tells whether an LP has committed at least one event since OnGVT() was last evaluated on it
+static bool *lps_committed;
+
+/// Number of local LPs which have not yet voted for termination
+static atomic_t lps_not_terminated;
+
 inline bool ccgs_can_halt_simulation(void)
 {
-#ifdef HAVE_MPI
 	return (ccgs_completed_simulation && all_kernels_terminated());
-#else
-	return ccgs_completed_simulation;
-#endif
 }
 
 // Deve essere chiamata da un solo thread al GVT
 void ccgs_reduce_termination(void)
 {
-	register unsigned int i;
-	bool termination = true;
-
 	/* Local termination:  all LPs need to be terminated */
-	for (i = 0; i < n_prc; i++) {
-		termination &= lps_termination[i];
-	}
+	bool termination = (atomic_read(&lps_not_terminated) == 0);
 
-#ifdef HAVE_MPI
 	/* If terminated locally check for global termination
 	 * All other kernel need to terminated
 	 */
 	if (unlikely(!ccgs_completed_simulation && termination)) {
 		broadcast_termination();
 	}
-#endif
 
 	ccgs_completed_simulation = termination;
 }
@@ -108,17 +105,24 @@ void ccgs_compute_snapshot(state_t * time_barrier_pointer[], simtime_t gvt)
 {
 	int i;
 	bool check_res = true;
+	bool lp_terminated;
 	state_t temporary_log;
 
+	timer ccgs_timer;
+
 	(void)gvt;		// This is used for state reconstruction which is currently commented out
 	//msg_t *realignment_evt;
 
+	timer_start(ccgs_timer);
+
 	i = -1;
 	foreach_bound_lp(lp) {
 		i++;
 
 		// If termination detection is incremental, we skip the current LP
-		if (rootsim_config.check_termination_mode == CKTRM_INCREMENTAL && lps_termination[lp->lid.to_int]) {
+		// also if its committed state did not change since the last evaluation
+		if (rootsim_config.check_termination_mode == CKTRM_INCREMENTAL &&
+		    (lps_termination[lp->lid.to_int] || !lps_committed[lp->lid.to_int])) {
 			continue;
 		}
 
@@ -157,9 +161,18 @@ void ccgs_compute_snapshot(state_t * time_barrier_pointer[], simtime_t gvt)
 
 */
 		// Call the application to check termination
-		lps_termination[lp->lid.to_int] =
-		    lp->OnGVT(lp->gid.to_int, lp->current_base_pointer);
-		check_res &= lps_termination[lp->lid.to_int];
+		lp_terminated = lp->OnGVT(lp->gid.to_int, lp->current_base_pointer);
+		lps_committed[lp->lid.to_int] = false;
+		check_res &= lp_terminated;
+
+		// Keep the number of non-terminated LPs up to date
+		if (lp_terminated != lps_termination[lp->lid.to_int]) {
+			lps_termination[lp->lid.to_int] = lp_terminated;
+			if (lp_terminated)
+				atomic_dec(&lps_not_terminated);
+			else
+				atomic_inc(&lps_not_terminated);
+		}
 
 		// Restore the current state
 		lp->state = temporary_log.state;
@@ -176,15 +189,62 @@ void ccgs_compute_snapshot(state_t * time_barrier_pointer[], simtime_t gvt)
 
 	// No real LP is running now!
 	current = NULL;
+
+	statistics_post_data(NULL, STAT_CCGS_TIME, timer_value_micro(ccgs_timer));
+}
+
+/**
+* Notify CCGS that some events of an LP have been committed, i.e. that its
+* time barrier has moved. This is called when a new GVT is adopted, before
+* the snapshot is computed. In incremental mode, OnGVT() is evaluated again
+* only on LPs for which this function has been called since the last
+* snapshot, as the committed state of the other LPs cannot have changed.
+*
+* @param lp A pointer to the lp_struct of the LP which committed some events
+*/
+void ccgs_lp_committed(struct lp_struct *lp)
+{
+	lps_committed[lp->lid.to_int] = true;
+}
+
+/**
+* Notify CCGS that an LP has migrated to this kernel. Its termination is
+* evaluated again at the next snapshot.
+*
+* @param lp A pointer to the lp_struct of the LP which has been installed
+*/
+void ccgs_lp_installed(struct lp_struct *lp)
+{
+	lps_termination[lp->lid.to_int] = false;
+	lps_committed[lp->lid.to_int] = true;
+	atomic_inc(&lps_not_terminated);
+}
+
+/**
+* Notify CCGS that an LP is leaving this kernel.
+*
+* @param lp A pointer to the lp_struct of the LP which is being removed
+*/
+void ccgs_lp_removed(struct lp_struct *lp)
+{
+	if (!lps_termination[lp->lid.to_int])
+		atomic_dec(&lps_not_terminated);
 }
 
 void ccgs_init(void)
 {
-	lps_termination = rsalloc(sizeof(bool) * n_prc);
-	memset(lps_termination, 0, sizeof(bool) * n_prc);
+	lps_termination = rsalloc(sizeof(bool) * max_local_lps());
+	memset(lps_termination, 0, sizeof(bool) * max_local_lps());
+
+	// Every LP must be inspected at least once
+	lps_committed = rsalloc(sizeof(bool) * max_local_lps());
+	memset(lps_committed, 1, sizeof(bool) * max_local_lps());
+
+	atomic_set(&lps_not_terminated, n_prc);
 }
 
 void ccgs_fini(void)
 {
 	rsfree(lps_termination);
+	rsfree(lps_committed);
 }
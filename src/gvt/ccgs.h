@@ -44,7 +44,11 @@ enum {
 };
 
 #include <mm/state.h>
+#include <scheduler/process.h>
 
 extern inline bool ccgs_can_halt_simulation(void);
 extern void ccgs_reduce_termination(void);
 extern void ccgs_compute_snapshot(state_t * time_barrier_pointer[], simtime_t gvt);
+extern void ccgs_lp_committed(struct lp_struct *lp);
+extern void ccgs_lp_installed(struct lp_struct *lp);
+extern void ccgs_lp_removed(struct lp_struct *lp);
@@ -34,6 +34,8 @@
 #include <gvt/ccgs.h>
 #include <mm/state.h>
 #include <mm/mm.h>
+#include <mm/persist.h>
+#include <lib/output.h>
 #include <scheduler/process.h>
 #include <scheduler/scheduler.h>
 #include <statistics/statistics.h>
@@ -82,8 +84,12 @@ void fossil_collection(struct lp_struct *lp, simtime_t time_barrier)
 	statistics_post_data(lp, STAT_COMMITTED, committed_events);
 
 	// Truncate the output queue
-	list_trunc(lp->queue_out, send_time, last_kept_event->timestamp,
-		   msg_hdr_release);
+	while (!ring_empty(lp->queue_out) && ring_head(lp->queue_out).send_time < last_kept_event->timestamp)
+		ring_pop_head(lp->queue_out);
+	ring_shrink(lp->queue_out);
+
+	// Write out the output of committed events
+	output_commit(lp, time_barrier);
 }
 
 /**
@@ -105,10 +111,20 @@ void adopt_new_gvt(simtime_t new_gvt)
 	compute_snapshot =
 	    ((snapshot_cycles % rootsim_config.gvt_snapshot_cycles) == 0);
 
+	// If a checkpoint to disk is due, LPs are saved before their logs are fossil collected
+	persist_on_gvt(new_gvt);
+
 	// Precompute the time barrier for each process
 	i = 0;
 	foreach_bound_lp(lp) {
-		time_barrier_pointer[i++] = find_time_barrier(lp, new_gvt);
+		time_barrier_pointer[i] = find_time_barrier(lp, new_gvt);
+
+		// The oldest state still kept is the time barrier of the last
+		// fossil collection: if the barrier moves, the LP has committed
+		// some events, which CCGS must know before the snapshot is taken
+		if (time_barrier_pointer[i] != NULL && time_barrier_pointer[i] != list_head(lp->queue_states))
+			ccgs_lp_committed(lp);
+		i++;
 	}
 
 	// If needed, call the CCGS subsystem
@@ -128,4 +144,9 @@ void adopt_new_gvt(simtime_t new_gvt)
 
 		i++;
 	}
+
+	// Account what is left to the LPs, and enforce their memory quota
+	foreach_bound_lp(lp) {
+		account_lp_memory(lp);
+	}
 }
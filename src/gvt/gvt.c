@@ -33,12 +33,15 @@
 
 #include <ROOT-Sim.h>
 #include <arch/thread.h>
+#include <arch/numa.h>
 #include <gvt/gvt.h>
 #include <gvt/ccgs.h>
 #include <core/core.h>
 #include <core/init.h>
 #include <core/timer.h>
 #include <scheduler/process.h>
+#include <scheduler/migration.h>
+#include <scheduler/placement.h>
 #include <scheduler/scheduler.h>
 #include <statistics/statistics.h>
 #include <mm/mm.h>
@@ -47,13 +50,9 @@
 
 enum kernel_phases {
 	kphase_start,
-#ifdef HAVE_MPI
 	kphase_white_msg_redux,
-#endif
 	kphase_kvt,
-#ifdef HAVE_MPI
 	kphase_gvt_redux,
-#endif
 	kphase_fossil,
 	kphase_idle
 };
@@ -73,10 +72,8 @@ timer gvt_timer;
 
 timer gvt_round_timer;
 
-#ifdef HAVE_MPI
 static unsigned int init_kvt_tkn;
 static unsigned int commit_gvt_tkn;
-#endif
 
 /* Data shared across threads */
 
@@ -93,14 +90,49 @@ static atomic_t counter_finalized;
 /// To be used with CAS to determine who is starting the next GVT reduction phase
 static volatile unsigned int current_GVT_round = 0;
 
-/// How many threads have left phase A?
-static atomic_t counter_A;
+/**
+ * Counters used to synchronize threads across the phases of the GVT
+ * reduction. They are organized hierarchically: each NUMA node counts
+ * its own threads, and the last thread of a node leaving a phase notifies
+ * the kernel-wide counter, which counts NUMA nodes. In this way, cache
+ * lines bounce across sockets only once per node.
+ */
+enum _phase_counters {
+	CNT_A,		///< How many threads have not left phase A?
+	CNT_SEND,	///< How many threads have not left phase send?
+	CNT_B,		///< How many threads have not left phase B?
+	NUM_CNT
+};
+
+/// Per-NUMA-node data of the GVT reduction
+struct _gvt_node {
+	atomic_t counters[NUM_CNT];	///< How many threads of this node have not left a phase
+	simtime_t min;			///< Minimum of this node, combined by its last thread leaving phase B
+	unsigned int first;		///< Index of the first thread of this node in @ref node_threads
+	unsigned int count;		///< How many threads of this kernel run on this node
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/// Per-thread local minimum, padded to avoid false sharing
+struct _gvt_thread {
+	simtime_t min;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
 
-/// How many threads have left phase send?
-static atomic_t counter_send;
+/// How many NUMA nodes have not left a phase
+static struct {
+	atomic_t counters[NUM_CNT];
+} __attribute__((aligned(CACHE_LINE_SIZE))) kernel_counters;
 
-/// How many threads have left phase B?
-static atomic_t counter_B;
+/// NUMA nodes hosting at least one worker thread of this kernel
+static struct _gvt_node *gvt_nodes;
+
+/// Number of entries in @ref gvt_nodes
+static unsigned int n_gvt_nodes;
+
+/// Entry in @ref gvt_nodes of each thread
+static unsigned int *thread_node;
+
+/// Thread ids, grouped by NUMA node
+static unsigned int *node_threads;
 
 /** Keep track of the last computed gvt value. Its a per-thread variable
  * to avoid synchronization on it, but eventually all threads write here
@@ -121,11 +153,108 @@ static __thread enum thread_phases thread_phase = tphase_idle;
 /// Per-thread GVT round counter
 static __thread unsigned int my_GVT_round = 0;
 
-/// The local (per-thread) minimum. It's not TLS, rather an array, to allow reduction by master thread
-static simtime_t *local_min;
+/// The local (per-thread) minimum. It's not TLS, rather an array, to allow reduction by node leaders
+static struct _gvt_thread *local_min;
 
 static simtime_t *local_min_barrier;
 
+/**
+* Group worker threads by the NUMA node of the core they are bound to.
+* Only nodes which host at least one thread take part in the reduction.
+*/
+static void gvt_nodes_init(void)
+{
+	unsigned int i, node;
+	unsigned int *node_to_entry;
+
+	node_to_entry = rsalloc(sizeof(unsigned int) * numa_nodes());
+	for (node = 0; node < numa_nodes(); node++)
+		node_to_entry[node] = UINT_MAX;
+
+	// Threads are bound to the core matching their local tid
+	thread_node = rsalloc(sizeof(unsigned int) * n_cores);
+	n_gvt_nodes = 0;
+	for (i = 0; i < n_cores; i++) {
+		node = numa_node_of_cpu(i);
+		if (node_to_entry[node] == UINT_MAX)
+			node_to_entry[node] = n_gvt_nodes++;
+		thread_node[i] = node_to_entry[node];
+	}
+	rsfree(node_to_entry);
+
+	if (posix_memalign((void **)&gvt_nodes, CACHE_LINE_SIZE, sizeof(struct _gvt_node) * n_gvt_nodes) != 0)
+		rootsim_error(true, "Unable to allocate GVT data structures\n");
+	bzero(gvt_nodes, sizeof(struct _gvt_node) * n_gvt_nodes);
+	for (i = 0; i < n_cores; i++)
+		gvt_nodes[thread_node[i]].count++;
+	for (node = 1; node < n_gvt_nodes; node++)
+		gvt_nodes[node].first = gvt_nodes[node - 1].first + gvt_nodes[node - 1].count;
+
+	node_threads = rsalloc(sizeof(unsigned int) * n_cores);
+	for (node = 0; node < n_gvt_nodes; node++)
+		gvt_nodes[node].count = 0;
+	for (i = 0; i < n_cores; i++) {
+		node = thread_node[i];
+		node_threads[gvt_nodes[node].first + gvt_nodes[node].count++] = i;
+	}
+}
+
+/**
+* Reset all the phase counters, at the beginning of a GVT round.
+*/
+static void reset_phase_counters(void)
+{
+	unsigned int i, node;
+
+	for (i = 0; i < NUM_CNT; i++) {
+		atomic_set(&kernel_counters.counters[i], n_gvt_nodes);
+		for (node = 0; node < n_gvt_nodes; node++)
+			atomic_set(&gvt_nodes[node].counters[i], gvt_nodes[node].count);
+	}
+}
+
+/**
+* Notify that the calling thread has left a phase of the GVT reduction.
+* When leaving phase B, the last thread of a NUMA node combines the local
+* minima of its node, and the last thread of the kernel combines the minima
+* of all nodes.
+*
+* @param cnt The phase counter to update
+* @param agreed_vt If the calling thread is the last one leaving phase B,
+*                  the minimum across all threads is stored here
+*
+* @return true if the calling thread is the last one of this kernel
+*         leaving the phase, false otherwise
+*/
+static bool leave_phase(enum _phase_counters cnt, simtime_t *agreed_vt)
+{
+	unsigned int i;
+	struct _gvt_node *node = &gvt_nodes[thread_node[local_tid]];
+
+	if (!atomic_dec_and_test(&node->counters[cnt]))
+		return false;
+
+	if (cnt == CNT_B) {
+		node->min = INFTY;
+		for (i = node->first; i < node->first + node->count; i++)
+			node->min = min(node->min, local_min[node_threads[i]].min);
+	}
+
+	if (!atomic_dec_and_test(&kernel_counters.counters[cnt]))
+		return false;
+
+	if (cnt == CNT_B) {
+		*agreed_vt = INFTY;
+		for (i = 0; i < n_gvt_nodes; i++)
+			*agreed_vt = min(*agreed_vt, gvt_nodes[i].min);
+	}
+
+	return true;
+}
+
+/// Tells whether all threads of this kernel have left a phase
+#define phase_completed(cnt) (atomic_read(&kernel_counters.counters[cnt]) == 0)
+
 /**
 * Initialization of the GVT subsystem.
 */
@@ -136,11 +265,14 @@ void gvt_init(void)
 	// This allows the first GVT phase to start
 	atomic_set(&counter_finalized, 0);
 
+	gvt_nodes_init();
+
 	// Initialize the local minima
-	local_min = rsalloc(sizeof(simtime_t) * n_cores);
+	if (posix_memalign((void **)&local_min, CACHE_LINE_SIZE, sizeof(struct _gvt_thread) * n_cores) != 0)
+		rootsim_error(true, "Unable to allocate GVT data structures\n");
 	local_min_barrier = rsalloc(sizeof(simtime_t) * n_cores);
 	for (i = 0; i < n_cores; i++) {
-		local_min[i] = INFTY;
+		local_min[i].min = INFTY;
 		local_min_barrier[i] = INFTY;
 	}
 
@@ -158,7 +290,16 @@ void gvt_fini(void)
 	// Finalize the CCGS subsystem
 	ccgs_fini();
 
-#ifdef HAVE_MPI
+	rsfree(gvt_nodes);
+	rsfree(thread_node);
+	rsfree(node_threads);
+	rsfree(local_min);
+	rsfree(local_min_barrier);
+
+	// Piggybacked GVT information requires no pending collective to be joined
+	if (rootsim_config.gvt_mode == GVT_MODE_PIGGYBACK)
+		return;
+
 	if ((kernel_phase == kphase_idle && !master_thread() && gvt_init_pending()) || kernel_phase == kphase_start) {
 		join_white_msg_redux();
 		wait_white_msg_redux();
@@ -167,7 +308,6 @@ void gvt_fini(void)
 		wait_white_msg_redux();
 		join_gvt_redux(-1.0);
 	}
-#endif
 }
 
 /**
@@ -183,12 +323,15 @@ inline simtime_t get_last_gvt(void)
 
 static inline void reduce_local_gvt(void)
 {
-	foreach_bound_lp(lp) {
+	unsigned int i;
+
+	// Bottom halves have just been drained, so the copies in lps_bound_hot are up to date
+	for (i = 0; i < n_prc_per_thread; i++) {
 		// If no message has been processed, local estimate for
 		// GVT is forced to 0.0. This can happen, e.g., if
 		// GVT is computed very early in the run
-		if (unlikely(lp->bound == NULL)) {
-			local_min[local_tid] = 0.0;
+		if (unlikely(lps_bound_hot.lvt[i] < 0.0)) {
+			local_min[local_tid].min = 0.0;
 			break;
 		}
 
@@ -196,71 +339,58 @@ static inline void reduce_local_gvt(void)
 		// events, we can safely assume that it should not
 		// participate to the computation of the GVT, because any
 		// event to it will appear *after* the GVT
-		if (lp->bound->next == NULL)
+		if (D_EQUAL(lps_bound_hot.next_ts[i], INFTY))
 			continue;
 
-		local_min[local_tid] =
-		    min(local_min[local_tid], lp->bound->timestamp);
+		local_min[local_tid].min =
+		    min(local_min[local_tid].min, lps_bound_hot.lvt[i]);
 	}
 }
 
 simtime_t GVT_phases(void)
 {
-	unsigned int i;
+	simtime_t agreed_vt;
 
 	if (thread_phase == tphase_A) {
-#ifdef HAVE_MPI
 		// Check whether we have new ingoing messages sent by remote instances
 		receive_remote_msgs();
-#endif
 		process_bottom_halves();
 
 		reduce_local_gvt();
 
 		thread_phase = tphase_send;	// Entering phase send
-		atomic_dec(&counter_A);	// Notify finalization of phase A
+		leave_phase(CNT_A, NULL);	// Notify finalization of phase A
 		return -1.0;
 	}
 
-	if (thread_phase == tphase_send && atomic_read(&counter_A) == 0) {
-#ifdef HAVE_MPI
+	if (thread_phase == tphase_send && phase_completed(CNT_A)) {
 		// Check whether we have new ingoing messages sent by remote instances
 		receive_remote_msgs();
-#endif
 		process_bottom_halves();
 		schedule();
+		flush_remote_msgs();
 		thread_phase = tphase_B;
-		atomic_dec(&counter_send);
+		leave_phase(CNT_SEND, NULL);
 		return -1.0;
 	}
 
-	if (thread_phase == tphase_B && atomic_read(&counter_send) == 0) {
-#ifdef HAVE_MPI
+	if (thread_phase == tphase_B && phase_completed(CNT_SEND)) {
 		// Check whether we have new ingoing messages sent by remote instances
 		receive_remote_msgs();
-#endif
 		process_bottom_halves();
 
 		reduce_local_gvt();
 
-#ifdef HAVE_MPI
 		// WARNING: local thread cannot send any remote
 		// message between the two following calls
 		exit_red_phase();
-		local_min[local_tid] =
-		    min(local_min[local_tid], min_outgoing_red_msg[local_tid]);
-#endif
+		local_min[local_tid].min =
+		    min(local_min[local_tid].min, min_outgoing_red_msg[local_tid]);
 
 		thread_phase = tphase_aware;
-		atomic_dec(&counter_B);
 
-		if (atomic_read(&counter_B) == 0) {
-			simtime_t agreed_vt = INFTY;
-			for (i = 0; i < n_cores; i++) {
-				agreed_vt = min(local_min[i], agreed_vt);
-			}
+		if (leave_phase(CNT_B, &agreed_vt))
 			return agreed_vt;
-		}
 		return -1.0;
 	}
 
@@ -269,12 +399,10 @@ simtime_t GVT_phases(void)
 
 bool start_new_gvt(void)
 {
-#ifdef HAVE_MPI
 	if (!master_kernel()) {
 		//Check if we received a new GVT init msg
 		return gvt_init_pending();
 	}
-#endif
 
 	// Has enough time passed since the last GVT reduction?
 	return timer_value_milli(gvt_timer) >
@@ -310,26 +438,22 @@ simtime_t gvt_operations(void)
 
 			timer_start(gvt_round_timer);
 
-#ifdef HAVE_MPI
 			//inform all the other kernels about the new gvt
 			if (master_kernel()) {
 				broadcast_gvt_init(current_GVT_round);
 			} else {
 				gvt_init_clear();
 			}
-#endif
 
 			// Reduce the current CCGS termination detection
 			ccgs_reduce_termination();
 
 			/* kernel GVT round setup */
 
-#ifdef HAVE_MPI
 			flush_white_msg_recv();
 
 			init_kvt_tkn = 1;
 			commit_gvt_tkn = 1;
-#endif
 
 			init_completed_tkn = 1;
 			commit_kvt_tkn = 1;
@@ -339,9 +463,7 @@ simtime_t gvt_operations(void)
 			atomic_set(&counter_kvt, n_cores);
 			atomic_set(&counter_finalized, n_cores);
 
-			atomic_set(&counter_A, n_cores);
-			atomic_set(&counter_send, n_cores);
-			atomic_set(&counter_B, n_cores);
+			reset_phase_counters();
 
 			kernel_phase = kphase_start;
 
@@ -358,28 +480,21 @@ simtime_t gvt_operations(void)
 		// Keep track of this update
 		my_GVT_round = current_GVT_round;
 
-#ifdef HAVE_MPI
 		enter_red_phase();
-#endif
 
-		local_min[local_tid] = INFTY;
+		local_min[local_tid].min = INFTY;
 
 		thread_phase = tphase_A;
 		atomic_dec(&counter_initialized);
 		if (atomic_read(&counter_initialized) == 0) {
 			if (iCAS(&init_completed_tkn, 1, 0)) {
-#ifdef HAVE_MPI
 				join_white_msg_redux();
 				kernel_phase = kphase_white_msg_redux;
-#else
-				kernel_phase = kphase_kvt;
-#endif
 			}
 		}
 		return -1.0;
 	}
 
-#ifdef HAVE_MPI
 	if (kernel_phase == kphase_white_msg_redux
 	    && white_msg_redux_completed() && all_white_msg_received()) {
 		if (iCAS(&init_kvt_tkn, 1, 0)) {
@@ -388,7 +503,6 @@ simtime_t gvt_operations(void)
 		}
 		return -1.0;
 	}
-#endif
 
 	/* KVT phase:
 	 * make all the threads agree on a common virtual time for this kernel */
@@ -397,21 +511,13 @@ simtime_t gvt_operations(void)
 		if (D_DIFFER(kvt, -1.0)) {
 			if (iCAS(&commit_kvt_tkn, 1, 0)) {
 
-#ifdef HAVE_MPI
 				join_gvt_redux(kvt);
 				kernel_phase = kphase_gvt_redux;
-
-#else
-				new_gvt = kvt;
-				kernel_phase = kphase_fossil;
-
-#endif
 			}
 		}
 		return -1.0;
 	}
 
-#ifdef HAVE_MPI
 	if (kernel_phase == kphase_gvt_redux && gvt_redux_completed()) {
 		if (iCAS(&commit_gvt_tkn, 1, 0)) {
 			int gvt_round_time = timer_value_micro(gvt_round_timer);
@@ -422,7 +528,6 @@ simtime_t gvt_operations(void)
 		}
 		return -1.0;
 	}
-#endif
 
 	/* GVT adoption phase:
 	 * the last agreed GVT needs to be adopted by every thread */
@@ -439,6 +544,14 @@ simtime_t gvt_operations(void)
 		// Dump statistics
 		statistics_on_gvt(new_gvt);
 
+#ifdef HAVE_MPI
+		// If a migration round is due, LPs are moved across kernels
+		migration_on_gvt(new_gvt);
+#endif
+
+		// Once the communication among LPs has been profiled, LPs are placed accordingly
+		placement_on_gvt();
+
 		last_gvt = new_gvt;
 
 		thread_phase = tphase_idle;
@@ -35,6 +35,12 @@
 #include <ROOT-Sim.h>
 #include <mm/state.h>
 
+enum {
+	GVT_MODE_INVALID = 0,	/**< By convention 0 is the invalid field */
+	GVT_MODE_COLLECTIVE,	/**< Distributed GVT is reduced using collective operations of the transport */
+	GVT_MODE_PIGGYBACK	/**< Distributed GVT information is piggybacked on messages */
+};
+
 /* API from gvt.c */
 extern void gvt_init(void);
 extern void gvt_fini(void);
@@ -151,15 +151,13 @@ static void agent_to_buffer(struct _agent_abm_t *agent, unsigned char* buffer){
 
 
 /**
-* Checkpoint the region state, saving it into a buffer.
-* This is periodically called by the checkpointing module to save the region state.
-* The returned buffer needs to be freed.
+* Compute the size of the buffer which abm_do_checkpoint() would produce
+* for a region in its current state.
 *
 * @param region A pointer to the region struct to be checkpointed
-* @return A malloc'ed buffer holding all the region data
+* @return The size in bytes of the checkpoint of the region
 */
-unsigned char * abm_do_checkpoint(region_abm_t *region){
-	// calculate dump size
+size_t abm_checkpoint_size(region_abm_t *region){
 	size_t chkp_size_tot = region->chkp_size;
 	chkp_size_tot += hash_map_dump_size(region->agents_table);
 	struct _agent_abm_t *agent;
@@ -171,6 +169,22 @@ unsigned char * abm_do_checkpoint(region_abm_t *region){
 			chkp_size_tot += array_dump_size(agent->past);
 		chkp_size_tot += agent->user_data_size;
 	}
+	return chkp_size_tot;
+}
+
+/**
+* Checkpoint the region state, saving it into a buffer.
+* This is periodically called by the checkpointing module to save the region state.
+* The returned buffer needs to be freed.
+*
+* @param region A pointer to the region struct to be checkpointed
+* @return A malloc'ed buffer holding all the region data
+*/
+unsigned char * abm_do_checkpoint(region_abm_t *region){
+	// calculate dump size
+	size_t chkp_size_tot = abm_checkpoint_size(region);
+	struct _agent_abm_t *agent;
+	unsigned i;
 	// allocate and populate the checkpoint
 	unsigned char *ret = rsalloc(chkp_size_tot), *chk = ret;
 	memcpy(ret, region, region->chkp_size);
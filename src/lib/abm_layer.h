@@ -8,10 +8,13 @@
 #ifndef ABM_LAYER_H_
 #define ABM_LAYER_H_
 
+#include <stddef.h>
+
 typedef struct _region_abm_t region_abm_t;
 
 void 	abm_layer_init	(void);
 void 	ProcessEventABM	(void);
+size_t abm_checkpoint_size(region_abm_t *region);
 unsigned char * abm_do_checkpoint(region_abm_t *region);
 void abm_restore_checkpoint(unsigned char *data, region_abm_t *old_region);
 
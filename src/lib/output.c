@@ -0,0 +1,339 @@
+/**
+ * @file lib/output.c
+ *
+ * @brief Rollback-safe output library
+ *
+ * Models which print results from within ProcessEvent() would produce
+ * duplicated and out-of-order output when events are rolled back. The
+ * CommitPrintf() and CommitWrite() APIs buffer the output in a per-LP queue,
+ * tagged with the event being processed. Upon a rollback, the output of the
+ * undone events is discarded. Upon fossil collection, the output of the
+ * committed events is handed, in timestamp order, to a writer thread, so
+ * that event processing never blocks on I/O.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <semaphore.h>
+
+#include <ROOT-Sim.h>
+#include <arch/atomic.h>
+#include <arch/thread.h>
+#include <core/core.h>
+#include <core/init.h>
+#include <datatypes/list.h>
+#include <gvt/gvt.h>
+#include <lib/output.h>
+#include <scheduler/process.h>
+#include <scheduler/scheduler.h>
+
+/// Size of the buffer on the stack used to format the output of CommitPrintf()
+#define OUTPUT_FORMAT_BUFFER	256
+
+/// Committed output waiting to be written, in the order it has to be written
+static struct output_record *write_head, *write_tail;
+
+/// Protects the committed output queue
+static spinlock_t write_lock;
+
+/// Used to wake up the writer thread
+static sem_t writer_sem;
+
+/// The writer thread
+static pthread_t writer_tid;
+
+/// Tells the writer thread to exit, once all the committed output has been written
+static bool writer_stop;
+
+
+static void write_all(int fd, const unsigned char *data, size_t size)
+{
+	ssize_t ret;
+
+	while (size > 0) {
+		ret = write(fd, data, size);
+		if (unlikely(ret < 0)) {
+			if (errno == EINTR)
+				continue;
+			rootsim_error(false, "Unable to write the output of the model on file descriptor %d: %s\n", fd, strerror(errno));
+			return;
+		}
+		data += ret;
+		size -= ret;
+	}
+}
+
+static void *output_writer(void *args)
+{
+	struct output_record *rec, *next;
+	bool stop;
+
+	(void)args;
+
+	do {
+		sem_wait(&writer_sem);
+
+		spin_lock(&write_lock);
+		rec = write_head;
+		write_head = write_tail = NULL;
+		stop = writer_stop;
+		spin_unlock(&write_lock);
+
+		while (rec != NULL) {
+			write_all(rec->fd, rec->data, rec->size);
+			next = rec->next;
+			rsfree(rec);
+			rec = next;
+		}
+	} while (!stop);
+
+	return NULL;
+}
+
+/**
+* Append a chunk of output to the queue of the current LP. If the output is
+* produced outside of event processing, it is committed straight away.
+*
+* @param fd The file descriptor where the output is to be written
+* @param data The output
+* @param size The number of bytes of output
+*/
+static void output_append(int fd, const void *data, size_t size)
+{
+	struct output_record *rec;
+
+	if (size == 0)
+		return;
+
+	// The serial simulator never rolls back
+	if (rootsim_config.serial) {
+		write_all(fd, data, size);
+		return;
+	}
+
+	// This output has already been produced the first time the event was processed
+	if (current != NULL && current->state == LP_STATE_SILENT_EXEC)
+		return;
+
+	rec = rsalloc(sizeof(*rec) + size);
+	rec->fd = fd;
+	rec->size = size;
+	memcpy(rec->data, data, size);
+
+	if (current != NULL) {
+		rec->timestamp = lvt(current);
+		rec->mark = current->bound != NULL ? current->bound->mark : 0;
+		list_insert_tail(current->queue_output, rec);
+		return;
+	}
+
+	rec->next = NULL;
+	spin_lock(&write_lock);
+	if (write_tail != NULL)
+		write_tail->next = rec;
+	else
+		write_head = rec;
+	write_tail = rec;
+	spin_unlock(&write_lock);
+	sem_post(&writer_sem);
+}
+
+/**
+* Write out some data once the event being processed is committed.
+*
+* @param fd The file descriptor where the data is to be written
+* @param buf The data
+* @param len The number of bytes to write
+*/
+void CommitWrite(int fd, const void *buf, size_t len)
+{
+	output_append(fd, buf, len);
+}
+
+/**
+* A printf() to the standard output which takes place once the event
+* being processed is committed.
+*
+* @param format The format string, as in printf()
+*/
+void CommitPrintf(const char *format, ...)
+{
+	char local[OUTPUT_FORMAT_BUFFER];
+	char *buf = local;
+	va_list args;
+	int len;
+
+	va_start(args, format);
+	len = vsnprintf(local, sizeof(local), format, args);
+	va_end(args);
+
+	if (unlikely(len < 0))
+		return;
+
+	if ((size_t)len >= sizeof(local)) {
+		buf = rsalloc(len + 1);
+		va_start(args, format);
+		vsnprintf(buf, len + 1, format, args);
+		va_end(args);
+	}
+
+	output_append(STDOUT_FILENO, buf, len);
+
+	if (buf != local)
+		rsfree(buf);
+}
+
+/**
+* Tell whether a chunk of output has been produced by an event which is
+* still part of the history of an LP, up to its bound. Output is queued in
+* the order events are processed, so only the events which share their
+* timestamp with the bound have to be told apart: they are found right
+* before the bound in the input queue.
+*
+* @param rec The chunk of output
+* @param bound The last correctly processed event
+* @return true if @p rec has been produced by @p bound or by an event before it
+*/
+static bool output_is_kept(const struct output_record *rec, msg_t *bound)
+{
+	msg_t *evt;
+
+	if (D_DIFFER(rec->timestamp, bound->timestamp))
+		return rec->timestamp < bound->timestamp;
+
+	for (evt = bound; evt != NULL && D_EQUAL(evt->timestamp, bound->timestamp); evt = list_prev(evt)) {
+		if (evt->mark == rec->mark)
+			return true;
+	}
+	return false;
+}
+
+/**
+* Discard the output produced by the events of an LP which are being rolled
+* back, or which have been annihilated. Records are matched against the
+* events which produced them, so the output of events simultaneous to the
+* bound is discarded as well.
+*
+* @param lp A pointer to the lp_struct of the LP which is being rolled back
+* @param bound The last correctly processed event
+*/
+void output_rollback(struct lp_struct *lp, msg_t *bound)
+{
+	struct output_record *rec;
+
+	while ((rec = list_tail(lp->queue_output)) != NULL && !output_is_kept(rec, bound)) {
+		list_delete_by_content(lp->queue_output, rec);
+		rsfree(rec);
+	}
+}
+
+/**
+* Hand the output produced by the committed events of an LP to the writer thread.
+*
+* @param lp A pointer to the lp_struct of the LP
+* @param time_barrier The output of events before this time is written out
+*/
+void output_commit(struct lp_struct *lp, simtime_t time_barrier)
+{
+	struct output_record *rec, *first = NULL, *last = NULL;
+
+	while ((rec = list_head(lp->queue_output)) != NULL && rec->timestamp < time_barrier) {
+		list_delete_by_content(lp->queue_output, rec);
+		rec->next = NULL;
+		if (last != NULL)
+			last->next = rec;
+		else
+			first = rec;
+		last = rec;
+	}
+
+	if (first == NULL)
+		return;
+
+	spin_lock(&write_lock);
+	if (write_tail != NULL)
+		write_tail->next = first;
+	else
+		write_head = first;
+	write_tail = last;
+	spin_unlock(&write_lock);
+	sem_post(&writer_sem);
+}
+
+/**
+* Set up the output queue of an LP.
+*
+* @param lp A pointer to the lp_struct of the LP
+*/
+void output_lp_init(struct lp_struct *lp)
+{
+	lp->queue_output = new_list(struct output_record);
+}
+
+/**
+* Write out the output of an LP which has been committed by @p time_barrier,
+* and release its output queue, dropping the rest.
+*
+* @param lp A pointer to the lp_struct of the LP
+* @param time_barrier The time barrier up to which the output is committed
+*/
+void output_lp_fini(struct lp_struct *lp, simtime_t time_barrier)
+{
+	struct output_record *rec;
+
+	output_commit(lp, time_barrier);
+
+	while ((rec = list_head(lp->queue_output)) != NULL) {
+		list_delete_by_content(lp->queue_output, rec);
+		rsfree(rec);
+	}
+	rsfree(lp->queue_output);
+}
+
+void output_init(void)
+{
+	foreach_lp(lp) {
+		output_lp_init(lp);
+	}
+
+	spinlock_init(&write_lock);
+	sem_init(&writer_sem, 0, 0);
+	if (pthread_create(&writer_tid, NULL, output_writer, NULL) != 0)
+		rootsim_error(true, "Unable to create the output writer thread\n");
+}
+
+void output_fini(void)
+{
+	// Write out what has been committed by the last GVT, and drop the rest
+	foreach_lp(lp) {
+		output_lp_fini(lp, get_last_gvt());
+	}
+
+	spin_lock(&write_lock);
+	writer_stop = true;
+	spin_unlock(&write_lock);
+	sem_post(&writer_sem);
+	pthread_join(writer_tid, NULL);
+	sem_destroy(&writer_sem);
+}
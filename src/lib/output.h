@@ -0,0 +1,52 @@
+/**
+ * @file lib/output.h
+ *
+ * @brief Rollback-safe output library
+ *
+ * This library lets models produce output from within ProcessEvent(). The
+ * output is buffered alongside the event which generated it, discarded if
+ * that event is rolled back, and written out only once the event is committed.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <core/core.h>
+
+struct lp_struct;
+
+/// A chunk of output produced by an LP, waiting for its generating event to commit
+struct output_record {
+	simtime_t timestamp;		///< Timestamp of the event which produced the output
+	unsigned long long mark;	///< Mark of the event which produced the output
+	struct output_record *next;
+	struct output_record *prev;
+	int fd;				///< The file descriptor where the output is to be written
+	size_t size;
+	unsigned char data[];
+};
+
+extern void output_init(void);
+extern void output_fini(void);
+extern void output_lp_init(struct lp_struct *lp);
+extern void output_lp_fini(struct lp_struct *lp, simtime_t time_barrier);
+extern void output_rollback(struct lp_struct *lp, msg_t *bound);
+extern void output_commit(struct lp_struct *lp, simtime_t time_barrier);
@@ -25,6 +25,10 @@ extern struct _topology_global_t{
 // this initializes the topology environment
 void topology_init(void);
 
+struct lp_struct;
+// this initializes the topology of an LP which has migrated to this kernel
+void topology_install_lp(struct lp_struct *lp);
+
 //used internally (also in abm_layer module) to schedule our reserved events TODO: move in a more system-like module
 void UncheckedScheduleNewEvent(unsigned int gid_receiver, simtime_t timestamp, unsigned int event_type, void *event_content, unsigned int event_size);
 
@@ -201,6 +201,43 @@ static void compute_edge(void){
 	topology_global.edge = edge;
 }
 
+/**
+ * Initialize the topology struct of a single LP.
+ *
+ * @param lp the LP to initialize
+ * @param t_data the data extracted from the topology file, or NULL
+ */
+static void topology_lp_init(struct lp_struct *lp, void *t_data) {
+	if(lp->gid.to_int >= topology_global.lp_cnt){
+		// this LP isn't part of the underlying topology
+		lp->topology = NULL;
+	}
+	switch(topology_settings.type){
+		case TOPOLOGY_COSTS:
+			lp->topology = topology_costs_init(lp->gid.to_int, t_data);
+			break;
+		case TOPOLOGY_OBSTACLES:
+			lp->topology = topology_obstacles_init(lp->gid.to_int, t_data);
+			break;
+		case TOPOLOGY_PROBABILITIES:
+			lp->topology = topology_probabilities_init(lp->gid.to_int, t_data);
+			break;
+	}
+}
+
+/**
+ * Initialize the topology struct of an LP which has migrated to this machine.
+ * The topology of the model must not have been loaded from a file.
+ *
+ * @param lp the LP to initialize
+ */
+void topology_install_lp(struct lp_struct *lp) {
+	if(!&topology_settings)
+		return;
+
+	topology_lp_init(lp, NULL);
+}
+
 /**
  * Initialize the topology module for each LP hosted on the machine.
  * This needs to be called right after LP basic initialization before starting to process events.
@@ -238,21 +275,7 @@ void topology_init(void) {
 	}
 	// initialize the topology struct
 	foreach_lp(lp){
-		if(lp->gid.to_int >= topology_global.lp_cnt){
-			// this LP isn't part of the underlying topology
-			lp->topology = NULL;
-		}
-		switch(topology_settings.type){
-			case TOPOLOGY_COSTS:
-				lp->topology = topology_costs_init(lp->gid.to_int, t_data);
-				break;
-			case TOPOLOGY_OBSTACLES:
-				lp->topology = topology_obstacles_init(lp->gid.to_int, t_data);
-				break;
-			case TOPOLOGY_PROBABILITIES:
-				lp->topology = topology_probabilities_init(lp->gid.to_int, t_data);
-				break;
-		}
+		topology_lp_init(lp, t_data);
 	}
 	// free the topology data read from file
 	rsfree(t_data);
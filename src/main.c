@@ -113,9 +113,7 @@ static void *main_simulation_loop(void *arg)
 	// Do the initial (local) LP binding, then execute INIT at all (local) LPs
 	initialize_worker_thread();
 
-#ifdef HAVE_MPI
 	syncronize_all();
-#endif
 
 	// Notify the statistics subsystem that we are now starting the actual simulation
 	if (master_kernel() && master_thread()) {
@@ -133,17 +131,20 @@ static void *main_simulation_loop(void *arg)
 		// Recompute the LPs-thread binding
 		rebind_LPs();
 
-#ifdef HAVE_MPI
 		// Check whether we have new ingoing messages sent by remote instances
 		receive_remote_msgs();
-		prune_outgoing_queues();
-#endif
+		if (!rootsim_config.comm_thread)
+			prune_outgoing_queues();
+
 		// Forward the messages from the kernel incoming message queue to the destination LPs
 		process_bottom_halves();
 
 		// Activate one LP and process one event. Send messages produced during the events' execution
 		schedule();
 
+		// Hand to the transport the messages towards remote kernels aggregated during this step
+		flush_remote_msgs();
+
 		my_time_barrier = gvt_operations();
 
 		// Only a master thread on master kernel prints the time barrier
@@ -164,14 +165,14 @@ static void *main_simulation_loop(void *arg)
 				fflush(stdout);
 			}
 		}
-#ifdef HAVE_MPI
 		collect_termination();
-#endif
 	}
 
  leave_for_error:
 	thread_barrier(&all_thread_barrier);
 
+	finalize_worker_thread();
+
 	// If we're exiting due to an error, we neatly shut down the simulation
 	if (simulation_error()) {
 		simulation_shutdown(EXIT_FAILURE);
@@ -0,0 +1,100 @@
+/**
+* @file mm/accounting.c
+*
+* @brief Per-LP memory accounting
+*
+* The memory held by an LP is accounted in three parts: the chunks allocated
+* by the model via DyMeLoR, the checkpoints in its state queue and the
+* messages in its input and output queues. DyMeLoR keeps the first part up
+* to date at each allocation, and rolls it back together with the state of
+* the LP. The other two parts change at almost every event, so they are
+* recomputed upon each GVT reduction, after fossil collection.
+*
+* When a quota is set via --lp-memory-quota, an LP holding more memory than
+* that stops the simulation, reporting where its memory goes.
+*
+* @copyright
+* Copyright (C) 2008-2019 HPDCS Group
+* https://hpdcs.github.io
+*
+* This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+*
+* ROOT-Sim is free software; you can redistribute it and/or modify it under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation; only version 3 of the License applies.
+*
+* ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+* A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <core/core.h>
+#include <core/init.h>
+#include <datatypes/list.h>
+#include <datatypes/ring.h>
+#include <mm/mm.h>
+#include <mm/state.h>
+#include <scheduler/process.h>
+
+/**
+* Recompute the memory held by an LP in checkpoints and queued messages, and
+* enforce the memory quota on the whole of it. This is meant to be called
+* by the worker thread the LP is bound to, after fossil collection.
+*
+* @param lp A pointer to the lp_struct of the LP
+*/
+void account_lp_memory(struct lp_struct *lp)
+{
+	state_t *state;
+	msg_t *msg;
+	size_t size = 0;
+
+	for (state = list_head(lp->queue_states); state != NULL; state = list_next(state))
+		size += get_log_size(state->log);
+	lp->mm->ckpt_size = size;
+
+	// The output queue is accounted for its whole capacity, as it is never shrunk below it
+	size = ring_capacity(lp->queue_out) * sizeof(msg_hdr_t);
+	for (msg = list_head(lp->queue_in); msg != NULL; msg = list_next(msg))
+		size += sizeof(msg_t) + msg->size;
+	lp->mm->queue_size = size;
+
+	if (rootsim_config.lp_memory_quota > 0)
+		check_lp_memory_quota(lp, 0);
+}
+
+/**
+* The memory held by an LP, with checkpoints and queued messages accounted
+* as of the last GVT reduction.
+*
+* @param lp A pointer to the lp_struct of the LP
+* @return The size in bytes of the memory held by the LP
+*/
+size_t lp_memory_usage(const struct lp_struct *lp)
+{
+	return lp->mm->m_state->live_size + lp->mm->ckpt_size + lp->mm->queue_size;
+}
+
+/**
+* Stop the simulation if an LP is going to hold more memory than its quota.
+*
+* @param lp A pointer to the lp_struct of the LP
+* @param size The size in bytes of the memory the LP is about to allocate
+*/
+void check_lp_memory_quota(struct lp_struct *lp, size_t size)
+{
+	size_t quota = (size_t)rootsim_config.lp_memory_quota << 20;
+
+	if (likely(lp_memory_usage(lp) + size <= quota))
+		return;
+
+	rootsim_error(true, "LP %u exceeded its memory quota of %u MB: %.2f MB allocated by the model (%.2f MB more requested), "
+		      "%.2f MB of checkpoints and %.2f MB of queued messages\n",
+		      lp->gid.to_int, rootsim_config.lp_memory_quota,
+		      lp->mm->m_state->live_size / 1048576.0, size / 1048576.0,
+		      lp->mm->ckpt_size / 1048576.0, lp->mm->queue_size / 1048576.0);
+}
@@ -5,6 +5,14 @@
 *
 * A Buddy System implementation
 *
+* Each LP has a buddy system managing its memory segment, from which its
+* memory areas and its stack are taken. The tree of the buddy system is kept
+* in the first pages of the segment itself. For each node, the tree records
+* the largest free block in the subtree, as the log2 of the ratio between the
+* size of the node and the size of that block. An entirely free node is
+* therefore represented by a zero, so that the pages of the tree are
+* committed only when allocations first reach them.
+*
 * @copyright
 * Copyright (C) 2008-2019 HPDCS Group
 * https://hpdcs.github.io
@@ -36,25 +44,28 @@
 #include <mm/mm.h>
 #include <scheduler/process.h>
 
-static inline int left_child(int index)
+/// Value of a node of the tree with no free fragment in its subtree
+#define BUDDY_FULL	0xff
+
+static inline size_t left_child(size_t index)
 {
 	/* index * 2 + 1 */
 	return ((index << 1) + 1);
 }
 
-static inline int right_child(int index)
+static inline size_t right_child(size_t index)
 {
 	/* index * 2 + 2 */
 	return ((index << 1) + 2);
 }
 
-static inline int parent(int index)
+static inline size_t parent(size_t index)
 {
 	/* (index+1)/2 - 1 */
 	return (((index + 1) >> 1) - 1);
 }
 
-static inline bool is_power_of_2(int index)
+static inline bool is_power_of_2(size_t index)
 {
 	return !(index & (index - 1));
 }
@@ -70,70 +81,62 @@ static inline size_t next_power_of_2(size_t size)
 	return size + 1;
 }
 
-/** allocate a new buddy structure
- * @param lp A pointer to the lp_struct of the LP from whose buddy we are
- *           allocating memory
- * @param num_of_fragments number of fragments of the memory to be managed
- * @return pointer to the allocated buddy structure */
-struct buddy *buddy_new(struct lp_struct *lp, size_t num_of_fragments)
+/// The size of the largest free block in the subtree of a node of size @a node_size
+static inline size_t get_longest(const struct buddy *self, size_t index, size_t node_size)
 {
-	struct buddy *self = NULL;
-	size_t node_size;
-	int i;
-
-	if (num_of_fragments < 1 || !is_power_of_2(num_of_fragments)) {
-		return NULL;
-	}
+	unsigned char v = self->longest[index];
 
-	/* alloacte an array to represent a complete binary tree */
-	(void)lp;
-	//self = (struct buddy *)get_segment_memory(lp, sizeof(struct buddy) + 2 * num_of_fragments * sizeof(size_t));
-	self = (struct buddy *)rsalloc(sizeof(struct buddy) + 2 * num_of_fragments * sizeof(size_t));
-	bzero(self, sizeof(struct buddy) + 2 * num_of_fragments * sizeof(size_t));	// unnecessary, it is later initialized
+	return v == BUDDY_FULL ? 0 : node_size >> v;
+}
 
-	self->size = num_of_fragments;
-	node_size = num_of_fragments * 2;
+static inline void set_longest(struct buddy *self, size_t index, size_t node_size, size_t longest)
+{
+	self->longest[index] = longest == 0 ? BUDDY_FULL : (unsigned char)(__builtin_ctzl(node_size) - __builtin_ctzl(longest));
+}
 
-	/* initialize *longest* array for buddy structure */
-	int iter_end = num_of_fragments * 2 - 1;
-	for (i = 0; i < iter_end; i++) {
-		if (is_power_of_2(i + 1)) {
-			node_size >>= 1;
-		}
-		self->longest[i] = node_size;
-	}
+/// Propagate a change in the node @a index, of size @a node_size, up to the root
+static void update_parents(struct buddy *self, size_t index, size_t node_size)
+{
+	size_t left_longest, right_longest;
 
-	spinlock_init(&self->lock);
+	while (index) {
+		index = parent(index);
+		node_size <<= 1;
 
-	return self;
-}
+		left_longest = get_longest(self, left_child(index), node_size >> 1);
+		right_longest = get_longest(self, right_child(index), node_size >> 1);
 
-void buddy_destroy(struct buddy *self)
-{
-	rsfree(self);
+		if (left_longest + right_longest == node_size) {
+			set_longest(self, index, node_size, node_size);
+		} else {
+			set_longest(self, index, node_size, max(left_longest, right_longest));
+		}
+	}
 }
 
 /** allocate *size* from a buddy system *self*
  * @return the offset from the beginning of memory to be managed */
-int buddy_alloc(struct buddy *self, size_t size)
+static long long buddy_alloc(struct buddy *self, size_t size)
 {
-	if (self == NULL || self->size <= size) {
+	size_t index = 0, node_size;
+	long long offset;
+
+	if (self == NULL || size == 0 || self->size <= size) {
 		return -1;
 	}
 
-	size = next_power_of_2(size);
+	if (!is_power_of_2(size))
+		size = next_power_of_2(size);
 
-	size_t index = 0;
-	if (self->longest[index] < size) {
+	if (get_longest(self, index, self->size) < size) {
 		return -1;
 	}
 
 	/* search recursively for the child */
-	size_t node_size = 0;
 	for (node_size = self->size; node_size != size; node_size >>= 1) {
-		/* choose the child with smaller longest value which is still larger
-		 * than *size* */
-		if (self->longest[left_child(index)] >= size) {
+		/* take the leftmost child which is large enough, to keep the
+		 * used memory compact */
+		if (get_longest(self, left_child(index), node_size >> 1) >= size) {
 			index = left_child(index);
 		} else {
 			index = right_child(index);
@@ -141,55 +144,122 @@ int buddy_alloc(struct buddy *self, size_t size)
 	}
 
 	/* update the *longest* value back */
-	self->longest[index] = 0;
-	int offset = (index + 1) * node_size - self->size;
-
-	while (index) {
-		index = parent(index);
-		self->longest[index] = max(self->longest[left_child(index)], self->longest[right_child(index)]);
-	}
+	set_longest(self, index, node_size, 0);
+	offset = (index + 1) * node_size - self->size;
+	update_parents(self, index, node_size);
 
 	return offset;
 }
 
-void buddy_free(struct buddy *self, size_t offset)
+/** allocate the block of *size* at *offset* from a buddy system *self*,
+ * as done by buddy_alloc() in a previous run
+ * @return true if the block was free, false otherwise */
+static bool buddy_claim(struct buddy *self, size_t offset, size_t size)
 {
-	if (self == NULL || offset >= self->size) {
-		return;
+	size_t index = 0, node_size;
+
+	if (self == NULL || size == 0 || self->size <= size) {
+		return false;
 	}
 
+	if (!is_power_of_2(size))
+		size = next_power_of_2(size);
+
+	if (offset % size != 0 || offset + size > self->size) {
+		return false;
+	}
+
+	/* walk down to the node of the block: its ancestors must not have been handed out */
+	for (node_size = self->size; node_size != size; node_size >>= 1) {
+		if (get_longest(self, index, node_size) < size) {
+			return false;
+		}
+		index = (offset & (node_size >> 1)) ? right_child(index) : left_child(index);
+	}
+
+	if (get_longest(self, index, node_size) != node_size) {
+		return false;
+	}
+
+	set_longest(self, index, node_size, 0);
+	update_parents(self, index, node_size);
+
+	return true;
+}
+
+/** release the block at *offset* to a buddy system *self*
+ * @return the number of fragments in the released block, 0 if no block is there */
+static size_t buddy_free(struct buddy *self, size_t offset)
+{
 	size_t node_size;
 	size_t index;
 
+	if (self == NULL || offset >= self->size) {
+		return 0;
+	}
+
 	/* get the corresponding index from offset */
 	node_size = 1;
 	index = offset + self->size - 1;
 
-	for (; self->longest[index] != 0; index = parent(index)) {
-		node_size <<= 1;
-
+	for (; get_longest(self, index, node_size) != 0; index = parent(index)) {
 		if (index == 0) {
-			break;
+			return 0;
 		}
+		node_size <<= 1;
 	}
 
-	self->longest[index] = node_size;
+	set_longest(self, index, node_size, node_size);
+	update_parents(self, index, node_size);
 
-	while (index) {
-		index = parent(index);
-		node_size <<= 1;
+	return node_size;
+}
 
-		size_t left_longest = self->longest[left_child(index)];
-		size_t right_longest = self->longest[right_child(index)];
+/** allocate a new buddy structure, managing the memory segment of an LP
+ * @param lp A pointer to the lp_struct of the LP from whose buddy we are
+ *           allocating memory
+ * @param num_of_fragments number of fragments of the memory to be managed
+ * @return pointer to the allocated buddy structure */
+struct buddy *buddy_new(struct lp_struct *lp, size_t num_of_fragments)
+{
+	struct buddy *self = NULL;
+	size_t tree_fragments;
 
-		if (left_longest + right_longest == node_size) {
-			self->longest[index] = node_size;
-		} else {
-			self->longest[index] = max(left_longest, right_longest);
-		}
+	if (num_of_fragments < 2 || !is_power_of_2(num_of_fragments)) {
+		return NULL;
 	}
+
+	self = (struct buddy *)rsalloc(sizeof(struct buddy));
+	self->size = num_of_fragments;
+	spinlock_init(&self->lock);
+
+	/* the tree of a complete binary tree has 2 * num_of_fragments - 1 nodes.
+	 * The segment is still untouched, so the tree tells that it is all free */
+	self->longest = lp->mm->segment->base;
+
+	/* the first fragments keep the tree, so they are not available */
+	tree_fragments = 1 + (2 * num_of_fragments - 2) / BUDDY_GRANULARITY;
+	if (unlikely(buddy_alloc(self, tree_fragments) != 0)) {
+		rsfree(self);
+		return NULL;
+	}
+
+	return self;
 }
 
+void buddy_destroy(struct buddy *self)
+{
+	rsfree(self);
+}
+
+/**
+* Take memory from the segment of an LP. The memory is zeroed, and its
+* pages are committed by the system only when they are first touched.
+*
+* @param lp A pointer to the lp_struct of the LP
+* @param size The number of bytes to allocate
+* @return A pointer to page-aligned memory, or NULL if the segment is exhausted
+*/
 void *allocate_lp_memory(struct lp_struct *lp, size_t size)
 {
 	long long offset, displacement;
@@ -213,12 +283,43 @@ void *allocate_lp_memory(struct lp_struct *lp, size_t size)
 	return (void *)((char *)lp->mm->segment->base + displacement);
 }
 
-void free_lp_memory(struct lp_struct *lp, void *ptr)
+/**
+* Take again the memory at a given address from the segment of an LP, as
+* it was taken by allocate_lp_memory() before the LP was checkpointed or
+* migrated. Segments are placed at the same addresses in all runs and
+* kernels, so the memory keeps the same address.
+*
+* @param lp A pointer to the lp_struct of the LP
+* @param ptr The address returned by allocate_lp_memory()
+* @param size The number of bytes passed to allocate_lp_memory()
+* @return true if the memory was available, false otherwise
+*/
+bool claim_lp_memory(struct lp_struct *lp, void *ptr, size_t size)
 {
 	size_t displacement;
+	bool ret;
+
+	displacement = (char *)ptr - (char *)lp->mm->segment->base;
+	if (unlikely(size == 0 || displacement % BUDDY_GRANULARITY != 0 || displacement >= PER_LP_PREALLOCATED_MEMORY))
+		return false;
+
+	spin_lock(&lp->mm->buddy->lock);
+	ret = buddy_claim(lp->mm->buddy, displacement / BUDDY_GRANULARITY, 1 + ((size - 1) / BUDDY_GRANULARITY));
+	spin_unlock(&lp->mm->buddy->lock);
+
+	return ret;
+}
+
+void free_lp_memory(struct lp_struct *lp, void *ptr)
+{
+	size_t displacement, fragments;
 
-	displacement = (int)((char *)ptr - (char *)lp->mm->segment->base);
+	displacement = (char *)ptr - (char *)lp->mm->segment->base;
 	spin_lock(&lp->mm->buddy->lock);
-	buddy_free(lp->mm->buddy, displacement);
+	fragments = buddy_free(lp->mm->buddy, displacement / BUDDY_GRANULARITY);
+	// Give the pages back to the system, which zero-fills them when they are touched again.
+	// This is done under the lock, so that no one gets the block before.
+	if (likely(fragments > 0))
+		madvise(ptr, fragments * BUDDY_GRANULARITY, MADV_DONTNEED);
 	spin_unlock(&lp->mm->buddy->lock);
 }
@@ -35,10 +35,30 @@
 #include <mm/mm.h>
 #include <core/timer.h>
 #include <core/core.h>
+#include <core/init.h>
 #include <scheduler/scheduler.h>
 #include <scheduler/process.h>
 #include <statistics/statistics.h>
 
+/// Logs at least this large are taken from the huge page arena, if huge pages are enabled
+#define log_in_hugepages(size) (rootsim_config.hugepages >= HUGEPAGES_THP && (size) >= HUGE_PAGE_SIZE)
+
+/**
+* Allocate the buffer for a log. Large logs are rounded up to a power of
+* two and taken from the huge page arena, if huge pages are enabled, so that
+* taking and restoring them incurs fewer TLB misses.
+*
+* @param size The size of the log, as returned by get_log_size()
+* @return A pointer to the buffer, to be released with log_delete()
+*/
+void *log_alloc(size_t size)
+{
+	if (log_in_hugepages(size))
+		return hugepage_alloc(POWEROF2(size));
+
+	return rsalloc(size);
+}
+
 /**
 * This function creates a full log of the current simulation states and returns a pointer to it.
 * The algorithm behind this function is based on packing of the really allocated memory chunks into
@@ -88,7 +108,7 @@ void *log_full(struct lp_struct *lp)
 	lp->mm->m_state->is_incremental = false;
 	size = get_log_size(lp->mm->m_state);
 
-	ckpt = rsalloc(size);
+	ckpt = log_alloc(size);
 
 	if (unlikely(ckpt == NULL)) {
 		rootsim_error(true, "(%d) Unable to acquire memory for checkpointing the current state (memory exhausted?)", lp->lid.to_int);
@@ -225,7 +245,7 @@ void *log_state(struct lp_struct *lp)
 void restore_full(struct lp_struct *lp, void *ckpt)
 {
 	void *ptr;
-	int i, original_num_areas, restored_areas;
+	int i, original_num_areas, original_max_num_areas, restored_areas;
 	size_t chunk_size, bitmap_size;
 	malloc_area *m_area, *new_area;
 
@@ -235,13 +255,15 @@ void restore_full(struct lp_struct *lp, void *ckpt)
 	restored_areas = 0;
 	ptr = ckpt;
 	original_num_areas = lp->mm->m_state->num_areas;
+	original_max_num_areas = lp->mm->m_state->max_num_areas;
 	new_area = lp->mm->m_state->areas;
 
-	// Restore malloc_state
+	// Restore malloc_state. The table of malloc_areas may have grown since the checkpoint
 	memcpy(lp->mm->m_state, ptr, sizeof(malloc_state));
 	ptr = (void *)((char *)ptr + sizeof(malloc_state));
 
 	lp->mm->m_state->areas = new_area;
+	lp->mm->m_state->max_num_areas = original_max_num_areas;
 
 	// Scan areas and chunk to restore them
 	for (i = 0; i < lp->mm->m_state->num_areas; i++) {
@@ -262,6 +284,7 @@ void restore_full(struct lp_struct *lp, void *ckpt)
 			if (likely(m_area->use_bitmap != NULL)) {
 				memset(m_area->use_bitmap, 0, bitmap_size);
 				memset(m_area->dirty_bitmap, 0, bitmap_size);
+				summarize_area(m_area);
 			}
 			m_area->last_access = lp->mm->m_state->timestamp;
 
@@ -276,6 +299,7 @@ void restore_full(struct lp_struct *lp, void *ckpt)
 		// Restore use bitmap
 		memcpy(m_area->use_bitmap, ptr, bitmap_size);
 		ptr = (void *)((char *)ptr + bitmap_size);
+		summarize_area(m_area);
 
 		// Reset dirty bitmap
 		bzero(m_area->dirty_bitmap, bitmap_size);
@@ -327,6 +351,7 @@ void restore_full(struct lp_struct *lp, void *ckpt)
 
 				memset(m_area->use_bitmap, 0, bitmap_size);
 				memset(m_area->dirty_bitmap, 0, bitmap_size);
+				summarize_area(m_area);
 			}
 		}
 		lp->mm->m_state->num_areas = original_num_areas;
@@ -373,7 +398,13 @@ void log_restore(struct lp_struct *lp, state_t *state_queue_node)
 */
 void log_delete(void *ckpt)
 {
+	size_t size;
+
 	if (likely(ckpt != NULL)) {
-		rsfree(ckpt);
+		size = get_log_size(ckpt);
+		if (log_in_hugepages(size))
+			hugepage_free(ckpt, POWEROF2(size));
+		else
+			rsfree(ckpt);
 	}
 }
@@ -35,6 +35,22 @@
 #include <mm/mm.h>
 #include <scheduler/scheduler.h>
 
+/// Size in bytes of the summary bitmap of a malloc_area, which has a bit set for each full block of its use bitmap
+#define summary_size(num_chunks) bitmap_required_size((num_chunks) / B_BITS_PER_BLOCK)
+
+/// The summary bitmap of a malloc_area lies right after its dirty bitmap
+#define area_summary(m_area) ((m_area)->dirty_bitmap + bitmap_required_size((m_area)->num_chunks))
+
+/// The block of the use bitmap of a malloc_area which keeps track of the given chunk
+#define use_block(m_area, chunk) (B_UNION_CAST((m_area)->use_bitmap)[(chunk) / B_BITS_PER_BLOCK])
+
+/// The number of bytes taken from the LP segment by a malloc_area, including its header and bitmaps
+static size_t area_size(const malloc_area *m_area)
+{
+	return sizeof(malloc_area *) + bitmap_required_size(m_area->num_chunks) * 2 +
+	    summary_size(m_area->num_chunks) + m_area->num_chunks * UNTAGGED_CHUNK_SIZE(m_area);
+}
+
 /**
 * This function inizializes a malloc_area
 *
@@ -84,6 +100,7 @@ malloc_state *malloc_state_init(void)
 
 	state->total_log_size = 0;
 	state->total_inc_size = 0;
+	state->live_size = 0;
 	state->busy_areas = 0;
 	state->dirty_areas = 0;
 	state->num_areas = NUM_AREAS;
@@ -111,17 +128,73 @@ malloc_state *malloc_state_init(void)
 	return state;
 }
 
-void malloc_state_wipe(malloc_state **state_ptr)
+/**
+* Enlarge the table of the malloc_areas of an LP, so that it can keep at least
+* the given number of them. The table is moved, so the memory of each
+* malloc_area is linked back to the new position of its descriptor.
+*
+* @param state The malloc_state of the LP
+* @param num_areas The number of malloc_areas which the table must be able to keep
+*/
+static void grow_areas(malloc_state *state, int num_areas)
 {
+	malloc_area *areas;
 	int i;
-	malloc_state *state = *state_ptr;
 
-	for (i = 0; i < NUM_AREAS; i++) {
-		rsfree(state->areas[i].self_pointer); // TODO: when reintroducing the buddy, this must be changed
+	if (num_areas <= state->max_num_areas)
+		return;
+
+	while (state->max_num_areas < num_areas)
+		state->max_num_areas <<= 1;
+
+	areas = rsalloc(state->max_num_areas * sizeof(malloc_area));
+	memcpy(areas, state->areas, state->num_areas * sizeof(malloc_area));
+	rsfree(state->areas);
+	state->areas = areas;
+
+	for (i = 0; i < state->num_areas; i++) {
+		if (areas[i].self_pointer != NULL)
+			*(unsigned long long *)areas[i].self_pointer = (unsigned long long)&areas[i];
 	}
+}
 
-	rsfree(*state_ptr);
-	*state_ptr = NULL;
+/**
+* Install in an LP the malloc_areas of a checkpoint, or of an LP which is
+* migrating. The memory of the areas which are currently in use is given
+* back, and the memory of the installed areas is taken again from the LP
+* segment at the same addresses, so that their content can then be restored.
+*
+* @param lp A pointer to the lp_struct of the LP
+* @param areas The malloc_areas to install
+* @param num_areas The number of malloc_areas to install
+*/
+void malloc_state_install(struct lp_struct *lp, const malloc_area *areas, int num_areas)
+{
+	malloc_state *state = lp->mm->m_state;
+	malloc_area *m_area;
+	int i;
+
+	grow_areas(state, num_areas);
+
+	for (i = 0; i < state->num_areas; i++) {
+		if (state->areas[i].self_pointer != NULL)
+			free_lp_memory(lp, state->areas[i].self_pointer);
+	}
+
+	memcpy(state->areas, areas, num_areas * sizeof(malloc_area));
+	state->num_areas = num_areas;
+
+	for (i = 0; i < num_areas; i++) {
+		m_area = &state->areas[i];
+		if (m_area->self_pointer == NULL)
+			continue;
+
+		if (unlikely(!claim_lp_memory(lp, m_area->self_pointer, area_size(m_area))))
+			rootsim_error(true, "Unable to restore the memory areas of LP %u\n", lp->gid.to_int);
+
+		// Link back the memory to its malloc_area
+		*(unsigned long long *)m_area->self_pointer = (unsigned long long)m_area;
+	}
 }
 
 /**
@@ -146,10 +219,32 @@ static size_t compute_size(size_t size)
 	return size_new;
 }
 
+/**
+* Rebuild the summary bitmap of a malloc_area from its use bitmap, e.g. after
+* the use bitmap has been restored from a checkpoint.
+*
+* @param m_area The malloc_area to summarize
+*/
+void summarize_area(malloc_area *m_area)
+{
+	unsigned i;
+
+	if (m_area->use_bitmap == NULL)
+		return;
+
+	bzero(area_summary(m_area), summary_size(m_area->num_chunks));
+	for (i = 0; i < (unsigned)m_area->num_chunks; i += B_BITS_PER_BLOCK) {
+		if (use_block(m_area, i) == ~(B_BLOCK_TYPE)0)
+			bitmap_set(area_summary(m_area), i / B_BITS_PER_BLOCK);
+	}
+}
+
 /**
 * Find the smallest idx associated with a free chunk in a given malloc_area.
 * This function tries to keep the chunks clustered in the beginning of the malloc_area,
-* so to enchance locality
+* so to enchance locality. All the chunks before next_chunk are in use: the
+* summary bitmap tells the first block of the use bitmap, from there on, which
+* is not full, and the free chunk is the first reset bit in that block.
 *
 * @author Roberto Toccaceli
 * @author Francesco Quaglia
@@ -158,22 +253,36 @@ static size_t compute_size(size_t size)
 */
 static void find_next_free(malloc_area * m_area)
 {
-	m_area->next_chunk++;
-
-	while (m_area->next_chunk < m_area->num_chunks) {
-		if (!bitmap_check(m_area->use_bitmap, m_area->next_chunk))
-			break;
+	B_BLOCK_TYPE *summary = B_UNION_CAST(area_summary(m_area));
+	unsigned blocks = m_area->num_chunks / B_BITS_PER_BLOCK;
+	unsigned block = m_area->next_chunk / B_BITS_PER_BLOCK;
+	unsigned word = block / B_BITS_PER_BLOCK;
+	B_BLOCK_TYPE not_full;
+
+	not_full = ~summary[word] & (~(B_BLOCK_TYPE)0 << B_MOD_OF_BPB(block));
+	while (not_full == 0) {
+		if (++word * B_BITS_PER_BLOCK >= blocks) {
+			m_area->next_chunk = m_area->num_chunks;
+			return;
+		}
+		not_full = ~summary[word];
+	}
 
-		m_area->next_chunk++;
+	block = word * B_BITS_PER_BLOCK + B_CTZ(not_full);
+	if (block >= blocks) {
+		m_area->next_chunk = m_area->num_chunks;
+		return;
 	}
 
+	m_area->next_chunk = block * B_BITS_PER_BLOCK + B_CTZ(~use_block(m_area, block * B_BITS_PER_BLOCK));
 }
 
 void *do_malloc(struct lp_struct *lp, size_t size)
 {
 	malloc_area *m_area, *prev_area = NULL;
 	void *ptr;
-	size_t area_size, bitmap_size;
+	size_t bitmap_size;
+	int prev_idx;
 
 	size = compute_size(size);
 
@@ -183,8 +292,11 @@ void *do_malloc(struct lp_struct *lp, size_t size)
 		return NULL;
 	}
 
-	m_area = &lp->mm->m_state->areas[(int)log2(size) -
-					 (int)log2(MIN_CHUNK_SIZE)];
+	if (unlikely(rootsim_config.lp_memory_quota > 0))
+		check_lp_memory_quota(lp, size);
+
+	// The size is a power of two: the first malloc_area of its size is found by its exponent
+	m_area = &lp->mm->m_state->areas[__builtin_ctzl(size) - __builtin_ctzl(MIN_CHUNK_SIZE)];
 
 #ifndef NDEBUG
 	atomic_inc(&m_area->presence);
@@ -212,41 +324,11 @@ void *do_malloc(struct lp_struct *lp, size_t size)
 
 	if (m_area == NULL) {
 
-		printf("Initializing an additional area\n");
-		fflush(stdout);
+		// Make room for a new malloc area. The table may be moved
+		prev_idx = prev_area->idx;
+		grow_areas(lp->mm->m_state, lp->mm->m_state->num_areas + 1);
+		prev_area = &lp->mm->m_state->areas[prev_idx];
 
-		if (lp->mm->m_state->num_areas == lp->mm->m_state->max_num_areas) {
-
-			malloc_area *tmp = NULL;
-
-			if ((lp->mm->m_state->max_num_areas << 1) > MAX_LIMIT_NUM_AREAS) {
-#ifndef NDEBUG
-				atomic_dec(&m_area->presence);
-#endif
-				return NULL;
-			}
-
-			lp->mm->m_state->max_num_areas <<= 1;
-
-			rootsim_error(true, "To reimplement\n");
-//                      tmp = (malloc_area *)pool_realloc_memory(lp->mm->m_state->areas, lp->mm->m_state->max_num_areas * sizeof(malloc_area));
-			if (tmp == NULL) {
-
-				/**
-				* @todo can we find a better way to handle the realloc failure?
-				*/
-				rootsim_error(false,
-					      "DyMeLoR: cannot reallocate the block of malloc_area.\n");
-				lp->mm->m_state->max_num_areas >>= 1;
-
-#ifndef NDEBUG
-				atomic_dec(&m_area->presence);
-#endif
-				return NULL;
-			}
-
-			lp->mm->m_state->areas = tmp;
-		}
 		// Allocate a new malloc area
 		m_area = &lp->mm->m_state->areas[lp->mm->m_state->num_areas];
 
@@ -269,11 +351,8 @@ void *do_malloc(struct lp_struct *lp, size_t size)
 
 		bitmap_size = bitmap_required_size(m_area->num_chunks);
 
-		area_size = sizeof(malloc_area *) + bitmap_size * 2 + m_area->num_chunks * size;
-
-//              m_area->self_pointer = (malloc_area *)allocate_lp_memory(lp, area_size);
-		m_area->self_pointer = rsalloc(area_size);
-		bzero(m_area->self_pointer, area_size);
+		// The memory is already zeroed, and its pages are committed only once touched
+		m_area->self_pointer = allocate_lp_memory(lp, area_size(m_area));
 
 		if (unlikely(m_area->self_pointer == NULL)) {
 			rootsim_error(true, "Error while allocating memory.\n");
@@ -291,7 +370,7 @@ void *do_malloc(struct lp_struct *lp, size_t size)
 		    ((unsigned char *)m_area->use_bitmap + bitmap_size);
 
 		m_area->area =
-		    (void *)((char *)m_area->dirty_bitmap + bitmap_size);
+		    (void *)((char *)area_summary(m_area) + summary_size(m_area->num_chunks));
 	}
 
 	if (unlikely(m_area->area == NULL)) {
@@ -306,6 +385,8 @@ void *do_malloc(struct lp_struct *lp, size_t size)
 	ptr = (void *)((char *)m_area->area + (m_area->next_chunk * size));
 
 	bitmap_set(m_area->use_bitmap, m_area->next_chunk);
+	if (use_block(m_area, m_area->next_chunk) == ~(B_BLOCK_TYPE)0)
+		bitmap_set(area_summary(m_area), m_area->next_chunk / B_BITS_PER_BLOCK);
 
 	bitmap_size = bitmap_required_size(m_area->num_chunks);
 
@@ -334,6 +415,7 @@ void *do_malloc(struct lp_struct *lp, size_t size)
 	//~ RESET_BIT_AT(chk_size, 1);
 
 	m_area->alloc_chunks++;
+	lp->mm->m_state->live_size += size;
 	find_next_free(m_area);
 
 	// TODO: togliere
@@ -387,10 +469,12 @@ void do_free(struct lp_struct *lp, void *ptr)
 		abort();
 	}
 	bitmap_reset(m_area->use_bitmap, idx);
+	bitmap_reset(area_summary(m_area), idx / B_BITS_PER_BLOCK);
 
 	bitmap_size = bitmap_required_size(m_area->num_chunks);
 
 	m_area->alloc_chunks--;
+	lp->mm->m_state->live_size -= chunk_size;
 
 	if (m_area->alloc_chunks == 0) {
 		lp->mm->m_state->bitmap_size -= bitmap_size;
@@ -710,8 +794,7 @@ void clean_buffers_on_gvt(struct lp_struct *lp, simtime_t time_barrier)
 
 			if (m_area->self_pointer != NULL) {
 
-				//free_lp_memory(lp, m_area->self_pointer);
-				rsfree(m_area->self_pointer);
+				free_lp_memory(lp, m_area->self_pointer);
 
 				m_area->use_bitmap = NULL;
 				m_area->dirty_bitmap = NULL;
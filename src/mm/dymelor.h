@@ -56,11 +56,9 @@
 				// application level software (i.e, larger than this number)
 				// will fail, as DyMeLoR will not be able to handle them!
 
-#define NUM_AREAS (log2(MAX_CHUNK_SIZE) - log2(MIN_CHUNK_SIZE) + 1)	// Number of initial malloc_areas available (will be increased at runtime if needed)
-#define MAX_NUM_AREAS (NUM_AREAS * 32)	// Maximum number of allocatable malloc_areas. If MAX_NUM_AREAS
-				// malloc_areas are filled at runtime, subsequent malloc() requests
-				// by the application level software will fail.
-#define MAX_LIMIT_NUM_AREAS MAX_NUM_AREAS
+#define NUM_AREAS (__builtin_ctzl(MAX_CHUNK_SIZE) - __builtin_ctzl(MIN_CHUNK_SIZE) + 1)	// Number of initial malloc_areas available (will be increased at runtime if needed)
+#define MAX_NUM_AREAS (NUM_AREAS * 2)	// Initial size of the table of malloc_areas. It is doubled
+				// whenever it is filled at runtime.
 #define MIN_NUM_CHUNKS 512	// Minimum number of chunks per malloc_area
 #define MAX_NUM_CHUNKS 4096	// Maximum number of chunks per malloc_area
 
@@ -120,6 +118,7 @@ struct _malloc_state {
 	bool is_incremental;	///< Tells if it is an incremental log or a full one (when used for logging)
 	size_t total_log_size;
 	size_t total_inc_size;
+	size_t live_size;	///< Bytes of the chunks currently allocated by the model, rolled back with the state
 	size_t bitmap_size;
 	size_t dirty_bitmap_size;
 	int num_areas;
@@ -151,13 +150,16 @@ extern size_t get_inc_log_size(void *);
 extern int get_granularity(void);
 extern size_t dirty_size(unsigned int, void *, double *);
 extern malloc_state *malloc_state_init(void);
-extern void malloc_state_wipe(malloc_state **);
+extern void malloc_state_install(struct lp_struct *, const malloc_area *, int);
+extern void summarize_area(malloc_area *);
 extern void *do_malloc(struct lp_struct *, size_t);
 extern void do_free(struct lp_struct *, void *ptr);
 extern void *allocate_lp_memory(struct lp_struct *, size_t);
+extern bool claim_lp_memory(struct lp_struct *, void *, size_t);
 extern void free_lp_memory(struct lp_struct *, void *);
 
 // Checkpointing API
+extern void *log_alloc(size_t);
 extern void *log_full(struct lp_struct *);
 extern void *log_state(struct lp_struct *);
 extern void log_restore(struct lp_struct *, state_t *);
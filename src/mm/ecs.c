@@ -119,7 +119,6 @@ void ecs_secondary(void) {
 
 void ecs_initiate(void) {
 	msg_t *control_msg;
-	msg_hdr_t *msg_hdr;
 
 	GID_t target_gid;
 	// Generate a unique mark for this ECS
@@ -133,9 +132,7 @@ void ecs_initiate(void) {
 	control_msg->mark = generate_mark(current);
 
 	// This message must be stored in the output queue as well, in case this LP rollbacks
-	msg_hdr =  get_msg_hdr_from_slab();
-	msg_to_hdr(msg_hdr, control_msg);
-	list_insert(current->queue_out, send_time, msg_hdr);
+	msg_to_hdr(ring_push_tail(current->queue_out), control_msg);
 
 	// Block the execution of this LP
 	current->state = LP_STATE_WAIT_FOR_SYNCH;
@@ -0,0 +1,155 @@
+/**
+* @file mm/hugepages.c
+*
+* @brief Huge page arenas
+*
+* When huge pages are enabled via --hugepages, the large regions of memory
+* used by the simulation are backed by them, to reduce TLB misses. The LP
+* segments are 2 MB-aligned already, so they are just marked for transparent
+* huge pages. Message slabs and large checkpoints are taken from per-thread
+* arenas instead. An arena carves naturally aligned power-of-two blocks out of
+* 2 MB-aligned regions, and keeps the blocks which are released for later
+* reuse: giving back to the system part of a huge page would break it up.
+*
+* @copyright
+* Copyright (C) 2008-2019 HPDCS Group
+* https://hpdcs.github.io
+*
+* This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+*
+* ROOT-Sim is free software; you can redistribute it and/or modify it under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation; only version 3 of the License applies.
+*
+* ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+* A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include <core/core.h>
+#include <core/init.h>
+#include <mm/mm.h>
+
+/// Blocks released to the arena of this thread, linked through their first word, one list per order
+static __thread void *free_blocks[sizeof(size_t) * CHAR_BIT];
+
+/// The part of the current region of the arena of this thread which has not been carved yet
+static __thread unsigned char *region_next, *region_end;
+
+/**
+* Mark a memory range to be backed by transparent huge pages, if huge pages
+* are enabled. The range should be 2 MB-aligned for this to be effective.
+*
+* @param addr The beginning of the range
+* @param len The length of the range in bytes
+*/
+void hugepage_advise(void *addr, size_t len)
+{
+	static bool warned = false;
+
+	if (rootsim_config.hugepages < HUGEPAGES_THP)
+		return;
+
+	if (unlikely(madvise(addr, len, MADV_HUGEPAGE) != 0 && !warned)) {
+		warned = true;
+		rootsim_error(false, "Unable to use transparent huge pages: %s\n", strerror(errno));
+	}
+}
+
+/**
+* Map a region for the arena, aligned to its size. If the huge pages reserved
+* in the system are requested but they are not available, transparent huge
+* pages are used from then on.
+*
+* @param size The size of the region, a power of two not smaller than @ref HUGE_PAGE_SIZE
+* @return A pointer to the region
+*/
+static unsigned char *map_region(size_t size)
+{
+	unsigned char *range, *region;
+
+	// Map twice the size, and keep only the aligned part
+	range = mmap(NULL, size * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (unlikely(range == MAP_FAILED))
+		rootsim_error(true, "Unable to map a huge page arena: %s\n", strerror(errno));
+
+	region = (unsigned char *)(((uintptr_t)range + size - 1) & ~(size - 1));
+	if (region > range)
+		munmap(range, region - range);
+	if (region + size < range + size * 2)
+		munmap(region + size, range + size * 2 - (region + size));
+
+	if (rootsim_config.hugepages == HUGEPAGES_HUGETLB) {
+		if (mmap(region, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0) != MAP_FAILED)
+			return region;
+
+		if (__sync_bool_compare_and_swap(&rootsim_config.hugepages, HUGEPAGES_HUGETLB, HUGEPAGES_THP))
+			rootsim_error(false, "Unable to use the huge pages reserved in the system (%s), using transparent ones\n", strerror(errno));
+
+		// A failed MAP_FIXED mapping may have removed the previous one
+		if (unlikely(mmap(region, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED))
+			rootsim_error(true, "Unable to map a huge page arena: %s\n", strerror(errno));
+	}
+
+	hugepage_advise(region, size);
+	return region;
+}
+
+/**
+* Take a block from the huge page arena of this thread. The block is aligned
+* to its size, and it is not zeroed. Blocks of at least @ref HUGE_PAGE_SIZE
+* bytes get a region of their own.
+*
+* @param size The size of the block, a power of two not smaller than the page size
+* @return A pointer to the block
+*/
+void *hugepage_alloc(size_t size)
+{
+	unsigned int order = __builtin_ctzl(size);
+	void *block;
+
+	if (free_blocks[order] != NULL) {
+		block = free_blocks[order];
+		free_blocks[order] = *(void **)block;
+		return block;
+	}
+
+	if (size >= HUGE_PAGE_SIZE)
+		return map_region(size);
+
+	region_next = (unsigned char *)(((uintptr_t)region_next + size - 1) & ~(size - 1));
+	if (region_next == NULL || region_next + size > region_end) {
+		// What is left of the current region is not worth tracking
+		region_next = map_region(HUGE_PAGE_SIZE);
+		region_end = region_next + HUGE_PAGE_SIZE;
+	}
+
+	block = region_next;
+	region_next += size;
+	return block;
+}
+
+/**
+* Give back a block to the huge page arena of this thread. The block can
+* come from the arena of any thread.
+*
+* @param ptr A pointer to the block, as returned by hugepage_alloc()
+* @param size The size of the block, as passed to hugepage_alloc()
+*/
+void hugepage_free(void *ptr, size_t size)
+{
+	unsigned int order = __builtin_ctzl(size);
+
+	*(void **)ptr = free_blocks[order];
+	free_blocks[order] = ptr;
+}
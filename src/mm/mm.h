@@ -34,17 +34,18 @@
 #include <pthread.h>
 #include <core/core.h>
 #include <arch/atomic.h>
+#include <arch/numa.h>
 #include <mm/dymelor.h>
 
 struct segment {
 	unsigned char *base;
-	unsigned char *brk;
 };
 
 struct buddy {
 	spinlock_t lock;
 	size_t size;
-	size_t longest[] __attribute__((aligned(sizeof(size_t))));
+	/// The tree of the buddy system, kept in the first pages of the segment (see buddy_new())
+	unsigned char *longest;
 };
 
 extern size_t __page_size;
@@ -65,6 +66,9 @@ struct slab_header {
 	uint8_t data[] __attribute__((aligned(sizeof(void *))));
 };
 
+/// How many free objects a slab chain caches for the thread owning it
+#define SLAB_MAGAZINE_SIZE	32
+
 struct slab_chain {
 	spinlock_t lock;
 	size_t itemsize, itemcount;
@@ -72,17 +76,67 @@ struct slab_chain {
 	uint64_t initial_slotmask, empty_slotmask;
 	uintptr_t alignment_mask;
 	struct slab_header *partial, *empty, *full;
+	/// Objects released by threads not owning the chain, linked through their first word
+	void *volatile remote_free;
+	/// Free objects cached for the owner thread, which uses them without locking
+	void **magazine;
+	/// How many objects are in @ref magazine
+	unsigned int cached;
+	/// NUMA node new pages are placed on, -1 if none
+	int numa_node;
 };
 
+/// log2 of the smallest message slab class
+#define MSG_SLAB_MIN_SHIFT	6
+/// log2 of the largest message slab class: larger messages are taken from pooled buffers
+#define MSG_SLAB_MAX_SHIFT	16
+/// Number of message slab classes, one for each power of two from 64 B to 64 KB
+#define MSG_SLAB_CLASSES	(MSG_SLAB_MAX_SHIFT - MSG_SLAB_MIN_SHIFT + 1)
+/// Size in bytes of the largest buffer which can be taken from a message slab
+#define MSG_SLAB_MAX_SIZE	(1UL << MSG_SLAB_MAX_SHIFT)
+
+/// log2 of the smallest power of two not less than @a size, and not less than @ref MSG_SLAB_MIN_SHIFT
+static inline unsigned int msg_size_shift(size_t size)
+{
+	if (size <= (1UL << MSG_SLAB_MIN_SHIFT))
+		return MSG_SLAB_MIN_SHIFT;
+	return (unsigned int)(sizeof(unsigned long) * CHAR_BIT - __builtin_clzl(size - 1));
+}
+
+/// The message slab class keeping buffers of @a size bytes, which must be at most @ref MSG_SLAB_MAX_SIZE
+#define msg_slab_class(size)	(msg_size_shift(size) - MSG_SLAB_MIN_SHIFT)
+
 struct memory_map {
 	malloc_state *m_state;
 	struct buddy *buddy;
-	struct slab_chain *slab;
+	struct slab_chain *msg_slabs[MSG_SLAB_CLASSES];
+	struct slab_chain *antimsg_slab;
 	struct segment *segment;
+	/// NUMA node the memory is placed on, -1 if none
+	int numa_node;
+	/// Bytes of the checkpoints in the state queue, as of the last GVT reduction
+	size_t ckpt_size;
+	/// Bytes of the messages in the input and output queues, as of the last GVT reduction
+	size_t queue_size;
 };
 
-#define PER_LP_PREALLOCATED_MEMORY (262144L * PAGE_SIZE)	// This should be power of 2 multiplied by a page size. This is 1GB per LP.
+extern size_t __segment_size;
+#define PER_LP_PREALLOCATED_MEMORY __segment_size	// Set by segment_init(). This is a power of 2 multiplied by a page size.
+#define MAX_SEGMENT_SIZE (262144L * PAGE_SIZE)	// This is 1GB per LP, unless the segments of all the LPs do not fit in the address space
+#define MIN_SEGMENT_SIZE (4096L * PAGE_SIZE)	// This is 16MB per LP
 #define BUDDY_GRANULARITY PAGE_SIZE	// This is the smallest chunk released by the buddy in bytes. PER_LP_PREALLOCATED_MEMORY/BUDDY_GRANULARITY must be integer and a power of 2
+#define BUDDY_FRAGMENTS (PER_LP_PREALLOCATED_MEMORY / BUDDY_GRANULARITY)	// Number of fragments managed by the buddy of each LP
+
+/// Use of huge pages for the memory of the simulation
+enum {
+	HUGEPAGES_INVALID = 0,	/**< By convention 0 is the invalid field */
+	HUGEPAGES_NO,		/**< Only regular pages are used */
+	HUGEPAGES_THP,		/**< Large regions are 2 MB-aligned and marked for transparent huge pages */
+	HUGEPAGES_HUGETLB	/**< The huge page arenas are backed by the huge pages reserved in the system, if any */
+};
+
+/// Size of a huge page on x86_64
+#define HUGE_PAGE_SIZE	(2UL << 20)
 
 extern bool allocator_init(void);
 extern void allocator_fini(void);
@@ -92,6 +146,10 @@ extern void *get_base_pointer(GID_t gid);
 
 extern void initialize_memory_map(struct lp_struct *lp);
 extern void finalize_memory_map(struct lp_struct *lp);
+extern void rehome_memory_map(struct lp_struct *lp, int node);
+extern void account_lp_memory(struct lp_struct *lp);
+extern size_t lp_memory_usage(const struct lp_struct *lp);
+extern void check_lp_memory_quota(struct lp_struct *lp, size_t size);
 
 extern struct buddy *buddy_new(struct lp_struct *,
 			       unsigned long num_of_fragments);
@@ -100,3 +158,14 @@ void buddy_destroy(struct buddy *);
 extern struct slab_chain *slab_init(const size_t itemsize);
 extern void *slab_alloc(struct slab_chain *const sch);
 extern void slab_free(struct slab_chain *const sch, const void *const addr);
+extern void slab_destroy(const struct slab_chain *const sch);
+extern void *slab_alloc_local(struct slab_chain *const sch);
+extern void slab_free_local(struct slab_chain *const sch, const void *const addr);
+extern void slab_free_remote(struct slab_chain *const sch, const void *const addr);
+extern void slab_rehome(struct slab_chain *const sch, int node);
+extern void hugepage_advise(void *addr, size_t len);
+extern void *hugepage_alloc(size_t size);
+extern void hugepage_free(void *ptr, size_t size);
+
+extern __thread unsigned long long slab_lock_contentions;
+extern __thread unsigned long long slab_remote_frees;
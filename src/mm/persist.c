@@ -0,0 +1,672 @@
+/**
+ * @file mm/persist.c
+ *
+ * @brief Whole-simulation checkpoint and restart
+ *
+ * This module periodically saves to disk a globally consistent snapshot of
+ * the committed simulation, so that a run can be resumed later on.
+ *
+ * Every @e checkpoint_every GVT reductions, each worker thread brings its LPs
+ * to the state they had at the new GVT, starting from the time barrier log and
+ * silently reprocessing the committed events which follow it. The state of the
+ * LP is then serialized, along with the events in its input queue which were
+ * generated by the committed portion of the simulation. Events generated at or
+ * after the GVT are not saved, as they are sent again when the corresponding
+ * events are reprocessed after a restart. Since no event before the GVT can be
+ * executed anymore, and all the messages generated before the GVT have already
+ * been delivered when the GVT is adopted, the union of the per-LP snapshots is
+ * a consistent cut of the whole simulation, also across kernels.
+ *
+ * Worker threads only serialize the LPs into in-memory buffers. A dedicated
+ * writer thread streams them to disk, so that I/O overlaps with the simulation.
+ * Each kernel writes its own file, rotating over @ref PERSIST_SLOTS slots: a
+ * kernel cannot start a new checkpoint before its previous one is on disk, so
+ * the most recent checkpoint which is complete on all kernels is always found
+ * among the ones on disk.
+ *
+ * Checkpoints keep pointers to the memory of the LPs, therefore when this module
+ * is enabled LP memory is taken from per-LP segments, which are placed at the
+ * same addresses in every run.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <semaphore.h>
+
+#include <core/core.h>
+#include <core/init.h>
+#include <arch/thread.h>
+#include <datatypes/list.h>
+#include <mm/mm.h>
+#include <mm/state.h>
+#include <mm/persist.h>
+#include <queues/queues.h>
+#include <scheduler/process.h>
+#include <scheduler/scheduler.h>
+#include <statistics/statistics.h>
+#include <communication/communication.h>
+#include <communication/mpi.h>
+
+/// Identifies a checkpoint file
+#define PERSIST_MAGIC		0x54504b434d495352ULL
+
+/// Version of the checkpoint file layout
+#define PERSIST_VERSION		1
+
+/// Number of checkpoint files which are kept on disk by each kernel
+#define PERSIST_SLOTS		3
+
+/// Microseconds to wait before checking again whether the writer is done
+#define PERSIST_POLL		100
+
+/// Header of a checkpoint file
+struct _persist_header {
+	unsigned long long magic;
+	unsigned int version;
+	unsigned int kid;
+	unsigned int n_ker;
+	unsigned int n_prc_tot;
+	unsigned int n_prc;
+	unsigned int msg_size;		///< sizeof(msg_t), to detect files written by a different build
+	unsigned long long seq;		///< Sequence number of the checkpoint
+	simtime_t gvt;			///< The GVT value at which the checkpoint has been taken
+};
+
+/// Trailer of a checkpoint file, used to tell whether the file was completely written
+struct _persist_trailer {
+	unsigned long long magic;
+	unsigned long long seq;
+};
+
+/**
+ * Record of a single LP in a checkpoint file. It is followed by the DyMeLoR
+ * malloc_areas, the DyMeLoR log of the committed state, the topology and the
+ * region buffers (if any) and the pending input events.
+ */
+struct _persist_lp {
+	GID_t gid;
+	unsigned long long mark;	///< Next mark to be generated by the LP
+	void *base_pointer;		///< The state base pointer installed via SetState()
+	numerical_state_t numerical;
+	int num_areas;
+	size_t log_size;
+	size_t topology_size;
+	size_t region_size;
+	unsigned int pending_events;
+};
+
+/// In-memory buffer where a worker thread serializes its LPs
+struct _persist_buffer {
+	unsigned long long seq;		///< The checkpoint the content of the buffer belongs to
+	size_t size;
+	size_t capacity;
+	unsigned char *data;
+};
+
+/// Per-thread serialization buffers
+static struct _persist_buffer *buffers;
+
+/// For each LP, the last checkpoint in which the LP has been saved
+static unsigned long long *lps_persisted;
+
+/// Protects the variables describing the checkpoint being taken
+static spinlock_t persist_lock;
+
+/// Sequence number of the last checkpoint which has been started
+static unsigned long long persist_seq;
+
+/// GVT value associated with the last checkpoint which has been started
+static simtime_t persist_gvt;
+
+/// Number of local LPs which have still to be saved in the current checkpoint
+static atomic_t lps_to_persist;
+
+/// Tells whether the writer thread is saving a checkpoint to disk
+static bool writer_busy;
+
+/// Tells the writer thread to exit
+static bool writer_stop;
+
+/// Used to wake up the writer thread
+static sem_t writer_sem;
+
+/// The writer thread
+static pthread_t writer_tid;
+
+/// Sequence number of the checkpoint the simulation has been resumed from, 0 if none
+static unsigned long long restart_seq;
+
+/// Number of GVT reductions adopted by the current worker thread
+static __thread unsigned int gvt_rounds;
+
+/// Sequence number of the next checkpoint to be taken by the current worker thread
+static __thread unsigned long long next_seq;
+
+
+static void checkpoint_path(char *path, const char *dir, unsigned long long seq)
+{
+	snprintf(path, MAX_PATHLEN, "%s/checkpoint_%u.%llu", dir, kid, seq % PERSIST_SLOTS);
+}
+
+static void buffer_append(struct _persist_buffer *buf, const void *data, size_t size)
+{
+	if (buf->size + size > buf->capacity) {
+		buf->capacity = max(buf->capacity << 1, buf->size + size);
+		buf->data = rsrealloc(buf->data, buf->capacity);
+		if (unlikely(buf->data == NULL))
+			rootsim_error(true, "Unable to allocate memory for the simulation checkpoint\n");
+	}
+	memcpy(buf->data + buf->size, data, size);
+	buf->size += size;
+}
+
+static void read_or_fail(void *data, size_t size, FILE *f)
+{
+	if (unlikely(size > 0 && fread(data, size, 1, f) != 1))
+		rootsim_error(true, "Checkpoint file is truncated or unreadable\n");
+}
+
+/**
+* Save an LP into the serialization buffer of the current worker thread.
+* The LP is brought to its committed state at the GVT, serialized, and then
+* the current (possibly speculative) state is reinstalled.
+*
+* @param lp A pointer to the lp_struct of the LP to save
+* @param barrier The time barrier state of the LP for the GVT of the checkpoint
+* @param gvt The GVT value at which the checkpoint is taken
+* @param buf The buffer where to serialize the LP
+*/
+static void persist_lp(struct lp_struct *lp, state_t *barrier, simtime_t gvt, struct _persist_buffer *buf)
+{
+	struct _persist_lp record;
+	state_t live_state;
+	msg_t *last_committed, *evt;
+	unsigned char *region = NULL;
+	void *log;
+
+	// Save the current state, to reinstall it after the checkpoint
+	save_state(lp, &live_state);
+
+	// Realign the state to the GVT, reprocessing the committed events after the time barrier
+	RestoreState(lp, barrier);
+	last_committed = barrier->last_event;
+	while (list_next(last_committed) != NULL && list_next(last_committed)->timestamp < gvt)
+		last_committed = list_next(last_committed);
+	silent_execution(lp, barrier->last_event, last_committed);
+
+	log = log_full(lp);
+
+	bzero(&record, sizeof(record));
+	record.gid = lp->gid;
+	record.mark = lp->mark;
+	record.base_pointer = lp->current_base_pointer;
+	memcpy(&record.numerical, &lp->numerical, sizeof(numerical_state_t));
+	record.num_areas = lp->mm->m_state->num_areas;
+	record.log_size = get_log_size(log);
+
+	if (&topology_settings && topology_settings.write_enabled)
+		record.topology_size = topology_global.chkp_size;
+
+	if (&abm_settings) {
+		record.region_size = abm_checkpoint_size(lp->region);
+		region = abm_do_checkpoint(lp->region);
+	}
+
+	// Events sent at or after the GVT are generated again upon restart
+	for (evt = list_next(last_committed); evt != NULL; evt = list_next(evt)) {
+		if (evt->send_time < gvt)
+			record.pending_events++;
+	}
+
+	buffer_append(buf, &record, sizeof(record));
+	buffer_append(buf, lp->mm->m_state->areas, record.num_areas * sizeof(malloc_area));
+	buffer_append(buf, log, record.log_size);
+	if (record.topology_size > 0)
+		buffer_append(buf, lp->topology, record.topology_size);
+	if (region != NULL) {
+		buffer_append(buf, region, record.region_size);
+		rsfree(region);
+	}
+	// The payload is not necessarily at offset sizeof(msg_t), due to the struct padding
+	for (evt = list_next(last_committed); evt != NULL; evt = list_next(evt)) {
+		if (evt->send_time < gvt) {
+			buffer_append(buf, evt, sizeof(msg_t));
+			buffer_append(buf, evt->event_content, evt->size);
+		}
+	}
+
+	log_delete(log);
+
+	// Reinstall the current state
+	RestoreState(lp, &live_state);
+	discard_state(&live_state);
+}
+
+/**
+* Write the checkpoint serialized by the worker threads to disk. The file
+* is written under a temporary name, and renamed only when complete, so that
+* a failure while writing never corrupts a previous checkpoint.
+*/
+static void write_checkpoint(void)
+{
+	struct _persist_header header;
+	struct _persist_trailer trailer;
+	char path[MAX_PATHLEN], tmp_path[MAX_PATHLEN + 4];
+	unsigned int i;
+	bool ok;
+	FILE *f;
+
+	bzero(&header, sizeof(header));
+	header.magic = PERSIST_MAGIC;
+	header.version = PERSIST_VERSION;
+	header.kid = kid;
+	header.n_ker = n_ker;
+	header.n_prc_tot = n_prc_tot;
+	header.n_prc = n_prc;
+	header.msg_size = sizeof(msg_t);
+	spin_lock(&persist_lock);
+	header.seq = persist_seq;
+	header.gvt = persist_gvt;
+	spin_unlock(&persist_lock);
+
+	trailer.magic = PERSIST_MAGIC;
+	trailer.seq = header.seq;
+
+	checkpoint_path(path, rootsim_config.output_dir, header.seq);
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+	if ((f = fopen(tmp_path, "w")) == NULL) {
+		rootsim_error(false, "Cannot open %s, checkpoint %llu is lost\n", tmp_path, header.seq);
+		return;
+	}
+
+	ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	for (i = 0; ok && i < n_cores; i++) {
+		if (buffers[i].seq == header.seq && buffers[i].size > 0)
+			ok = fwrite(buffers[i].data, buffers[i].size, 1, f) == 1;
+	}
+	ok = ok && fwrite(&trailer, sizeof(trailer), 1, f) == 1;
+	ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+	ok = (fclose(f) == 0) && ok;
+
+	if (!ok || rename(tmp_path, path) != 0) {
+		rootsim_error(false, "Error while writing %s, checkpoint %llu is lost\n", path, header.seq);
+		unlink(tmp_path);
+	}
+}
+
+static void *persist_writer(void *args)
+{
+	(void)args;
+
+	while (true) {
+		sem_wait(&writer_sem);
+		if (writer_stop)
+			break;
+
+		write_checkpoint();
+
+		spin_lock(&persist_lock);
+		writer_busy = false;
+		spin_unlock(&persist_lock);
+	}
+
+	return NULL;
+}
+
+/**
+* Start a new checkpoint, unless some other worker thread of this kernel has
+* already started it. If the previous checkpoint is still being written to
+* disk, the calling thread waits for it.
+*
+* @param seq The sequence number of the checkpoint
+* @param gvt The GVT value at which the checkpoint is taken
+*/
+static void start_checkpoint(unsigned long long seq, simtime_t gvt)
+{
+	while (true) {
+		spin_lock(&persist_lock);
+
+		if (persist_seq >= seq)
+			break;
+
+		if (atomic_read(&lps_to_persist) == 0 && !writer_busy) {
+			persist_seq = seq;
+			persist_gvt = gvt;
+			atomic_set(&lps_to_persist, n_prc);
+			break;
+		}
+
+		spin_unlock(&persist_lock);
+		usleep(PERSIST_POLL);
+	}
+
+	spin_unlock(&persist_lock);
+}
+
+/**
+* Save the LPs bound to the current worker thread which are not yet part of
+* the checkpoint being taken. This is called upon each GVT adoption, and
+* whenever the LPs-to-threads binding changes, as an LP could be moved to a
+* thread which has already saved its LPs.
+*/
+void persist_catch_up(void)
+{
+	struct _persist_buffer *buf;
+	unsigned long long seq;
+	simtime_t gvt;
+
+	if (atomic_read(&lps_to_persist) == 0)
+		return;
+
+	spin_lock(&persist_lock);
+	seq = persist_seq;
+	gvt = persist_gvt;
+	spin_unlock(&persist_lock);
+
+	buf = &buffers[local_tid];
+	if (buf->seq != seq) {
+		buf->seq = seq;
+		buf->size = 0;
+	}
+
+	// Messages generated before the GVT could still be waiting in the bottom halves
+	process_bottom_halves();
+
+	foreach_bound_lp(lp) {
+		if (lps_persisted[lp->lid.to_int] == seq)
+			continue;
+
+		persist_lp(lp, find_time_barrier(lp, gvt), gvt, buf);
+		lps_persisted[lp->lid.to_int] = seq;
+
+		spin_lock(&persist_lock);
+		if (atomic_dec_and_test(&lps_to_persist)) {
+			writer_busy = true;
+			sem_post(&writer_sem);
+		}
+		spin_unlock(&persist_lock);
+	}
+
+	// No real LP is running now!
+	current = NULL;
+}
+
+/**
+* Called by every worker thread upon the adoption of a new GVT value, before
+* fossil collection is run. If a checkpoint is due, it is started here.
+*
+* @param new_gvt The newly adopted GVT value
+*/
+void persist_on_gvt(simtime_t new_gvt)
+{
+	if (rootsim_config.checkpoint_every == 0)
+		return;
+
+	if (unlikely(next_seq == 0))
+		next_seq = restart_seq + 1;
+
+	// All threads in all kernels adopt the same GVT values, so they all agree on when to take a checkpoint
+	gvt_rounds++;
+	if (gvt_rounds % rootsim_config.checkpoint_every == 0 && D_DIFFER_ZERO(new_gvt)) {
+		start_checkpoint(next_seq, new_gvt);
+		next_seq++;
+	}
+
+	persist_catch_up();
+}
+
+/**
+* Check whether a checkpoint file is complete and compatible with this run.
+*
+* @param path The path of the checkpoint file
+* @param header Where to store the header of the checkpoint file
+* @return The sequence number of the checkpoint, or 0 if the file cannot be used
+*/
+static unsigned long long check_checkpoint(const char *path, struct _persist_header *header)
+{
+	struct _persist_trailer trailer;
+	unsigned long long seq = 0;
+	FILE *f;
+
+	if ((f = fopen(path, "r")) == NULL)
+		return 0;
+
+	if (fread(header, sizeof(*header), 1, f) != 1 || header->magic != PERSIST_MAGIC)
+		goto out;
+
+	if (header->version != PERSIST_VERSION || header->msg_size != sizeof(msg_t)) {
+		rootsim_error(false, "%s has been written by a different version of ROOT-Sim, ignoring it\n", path);
+		goto out;
+	}
+
+	if (header->kid != kid || header->n_ker != n_ker || header->n_prc_tot != n_prc_tot || header->n_prc != n_prc) {
+		rootsim_error(false, "%s has been written by a simulation with a different configuration, ignoring it\n", path);
+		goto out;
+	}
+
+	if (fseek(f, -(long)sizeof(trailer), SEEK_END) != 0 || fread(&trailer, sizeof(trailer), 1, f) != 1)
+		goto out;
+
+	if (trailer.magic == PERSIST_MAGIC && trailer.seq == header->seq)
+		seq = header->seq;
+
+    out:
+	fclose(f);
+	return seq;
+}
+
+/**
+* Find the most recent checkpoint which has been completely written by all kernels.
+*
+* @return The sequence number of the checkpoint
+*/
+static unsigned long long find_restart_checkpoint(void)
+{
+	struct _persist_header header;
+	char path[MAX_PATHLEN];
+	unsigned long long seq, latest = 0;
+	unsigned int i;
+
+	for (i = 0; i < PERSIST_SLOTS; i++) {
+		checkpoint_path(path, rootsim_config.restart_from, i);
+		seq = check_checkpoint(path, &header);
+		latest = max(latest, seq);
+	}
+
+	// A kernel is at most PERSIST_SLOTS - 1 checkpoints ahead of the others,
+	// so the oldest among the latest checkpoints is available everywhere
+	reduce_min(&latest);
+
+	if (latest == 0)
+		rootsim_error(true, "No usable checkpoint found in %s\n", rootsim_config.restart_from);
+
+	return latest;
+}
+
+/**
+* Rebuild an LP from its record in a checkpoint file. INIT is not executed:
+* the memory, the state and the library data of the LP are installed as they
+* were saved. The INIT event is moved right before the GVT of the checkpoint
+* to act as the bound, and the pending events are placed in the input queue.
+*
+* @param f The checkpoint file
+* @param gvt The GVT value at which the checkpoint was taken
+*/
+static void restore_lp(FILE *f, simtime_t gvt)
+{
+	struct _persist_lp record;
+	struct lp_struct *lp;
+	malloc_area *areas;
+	state_t committed;
+	msg_t header, *init, *msg;
+	unsigned char *region;
+	unsigned int i;
+
+	read_or_fail(&record, sizeof(record), f);
+
+	lp = find_lp_by_gid(record.gid);
+	if (unlikely(lp == NULL))
+		rootsim_error(true, "LP %u in the checkpoint is not hosted by this kernel\n", record.gid.to_int);
+
+	init = list_head(lp->queue_in);
+	lp->bound = init;
+
+	lp->mark = record.mark;
+	lp->current_base_pointer = record.base_pointer;
+	memcpy(&lp->numerical, &record.numerical, sizeof(numerical_state_t));
+
+	// The LP segment is mapped at the same address as in the checkpointed run,
+	// so the malloc_areas get their memory back at the same addresses
+	areas = rsalloc(record.num_areas * sizeof(malloc_area));
+	read_or_fail(areas, record.num_areas * sizeof(malloc_area), f);
+	malloc_state_install(lp, areas, record.num_areas);
+	rsfree(areas);
+
+	committed.log = log_alloc(record.log_size);
+	read_or_fail(committed.log, record.log_size, f);
+	log_restore(lp, &committed);
+	log_delete(committed.log);
+
+	if (record.topology_size > 0) {
+		if (unlikely(record.topology_size != topology_global.chkp_size))
+			rootsim_error(true, "The topology in the checkpoint does not match the current one\n");
+		read_or_fail(lp->topology, record.topology_size, f);
+	}
+
+	if (record.region_size > 0) {
+		region = rsalloc(record.region_size);
+		read_or_fail(region, record.region_size, f);
+		abm_restore_checkpoint(region, lp->region);
+		rsfree(region);
+	}
+
+	// The bound event stands for the whole committed history of the LP
+	init->timestamp = nextafter(gvt, -INFINITY);
+	init->send_time = init->timestamp;
+	init->mark = generate_mark(lp);
+
+	for (i = 0; i < record.pending_events; i++) {
+		read_or_fail(&header, sizeof(msg_t), f);
+		pack_msg(&msg, header.sender, header.receiver, header.type, header.timestamp, header.send_time, header.size, NULL);
+		msg->message_kind = header.message_kind;
+		msg->mark = header.mark;
+		msg->rendezvous_mark = header.rendezvous_mark;
+		read_or_fail(msg->event_content, header.size, f);
+		list_insert_tail(lp->queue_in, msg);
+	}
+
+	// The restored state is the first one in the state queue
+	force_LP_checkpoint(lp);
+	LogState(lp);
+}
+
+/**
+* Rebuild all the local LPs from the checkpoint selected by persist_init().
+* This is called by the master thread of each kernel in place of the
+* regular execution of INIT.
+*/
+void persist_restore(void)
+{
+	struct _persist_header header;
+	struct _persist_trailer trailer;
+	char path[MAX_PATHLEN];
+	unsigned int i;
+	FILE *f;
+
+	checkpoint_path(path, rootsim_config.restart_from, restart_seq);
+	if ((f = fopen(path, "r")) == NULL)
+		rootsim_error(true, "Cannot open %s\n", path);
+
+	read_or_fail(&header, sizeof(header), f);
+	if (unlikely(header.seq != restart_seq))
+		rootsim_error(true, "%s has been modified while restarting the simulation\n", path);
+
+	for (i = 0; i < header.n_prc; i++)
+		restore_lp(f, header.gvt);
+
+	read_or_fail(&trailer, sizeof(trailer), f);
+	if (unlikely(trailer.magic != PERSIST_MAGIC || trailer.seq != restart_seq))
+		rootsim_error(true, "%s is corrupted\n", path);
+
+	fclose(f);
+
+	if (master_kernel())
+		printf("resuming from checkpoint %llu at GVT %f... ", restart_seq, header.gvt);
+}
+
+void persist_init(void)
+{
+	if (!persist_enabled())
+		return;
+
+	spinlock_init(&persist_lock);
+	atomic_set(&lps_to_persist, 0);
+
+	lps_persisted = rsalloc(sizeof(*lps_persisted) * n_prc);
+	bzero(lps_persisted, sizeof(*lps_persisted) * n_prc);
+
+	if (rootsim_config.restart_from != NULL)
+		restart_seq = find_restart_checkpoint();
+	persist_seq = restart_seq;
+
+	if (rootsim_config.checkpoint_every > 0) {
+		buffers = rsalloc(sizeof(*buffers) * n_cores);
+		bzero(buffers, sizeof(*buffers) * n_cores);
+
+		sem_init(&writer_sem, 0, 0);
+		if (pthread_create(&writer_tid, NULL, persist_writer, NULL) != 0)
+			rootsim_error(true, "Unable to create the checkpoint writer thread\n");
+	}
+}
+
+void persist_fini(void)
+{
+	unsigned int i;
+
+	if (!persist_enabled())
+		return;
+
+	if (rootsim_config.checkpoint_every > 0) {
+		// Let the writer complete the checkpoint which it is saving, if any
+		spin_lock(&persist_lock);
+		while (writer_busy) {
+			spin_unlock(&persist_lock);
+			usleep(PERSIST_POLL);
+			spin_lock(&persist_lock);
+		}
+		spin_unlock(&persist_lock);
+
+		writer_stop = true;
+		sem_post(&writer_sem);
+		pthread_join(writer_tid, NULL);
+		sem_destroy(&writer_sem);
+
+		for (i = 0; i < n_cores; i++)
+			rsfree(buffers[i].data);
+		rsfree(buffers);
+	}
+
+	rsfree(lps_persisted);
+}
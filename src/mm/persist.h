@@ -0,0 +1,42 @@
+/**
+ * @file mm/persist.h
+ *
+ * @brief Whole-simulation checkpoint and restart
+ *
+ * This module periodically saves to disk a globally consistent snapshot of
+ * the committed simulation, taken at a GVT value, so that a run can be
+ * resumed later on from that point instead of from the beginning.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <core/core.h>
+#include <core/init.h>
+#include <mm/state.h>
+
+/// This macro expands to true if the simulation is either saved to disk or resumed from disk
+#define persist_enabled() (rootsim_config.checkpoint_every > 0 || rootsim_config.restart_from != NULL)
+
+extern void persist_init(void);
+extern void persist_fini(void);
+extern void persist_on_gvt(simtime_t new_gvt);
+extern void persist_catch_up(void);
+extern void persist_restore(void);
@@ -27,11 +27,12 @@
 * @author Francesco Quaglia
 */
 
-#include <sys/time.h>
-#include <sys/resource.h>
-#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
 #include <sys/types.h>
 
+#include <core/init.h>
 #include <mm/mm.h>
 #include <mm/ecs.h>
 #include <arch/x86/linux/cross_state_manager/cross_state_manager.h>
@@ -39,39 +40,38 @@
 
 size_t __page_size = 0;
 
+size_t __segment_size = 0;
+
 //TODO: document this magic! This is related to the pml4 index intialized in the ECS kernel module
 static unsigned char *init_address = (unsigned char *)(10LL << 39);
 
+/// Upper end of the room for segments on x86_64. Position-independent executables
+/// (and their heap) are loaded at two thirds of the 128 TB user address space.
+#define SEGMENTS_END	((1ULL << 47) / 3 * 2)
+
+// Never replace something which is already mapped where a segment should go.
+// Without MAP_FIXED_NOREPLACE, the address of the segment is passed as a mere
+// hint, and get_segment() fails if the kernel places the segment elsewhere.
+#ifdef MAP_FIXED_NOREPLACE
+#define SEGMENT_MAP_FIXED MAP_FIXED_NOREPLACE
+#else
+#define SEGMENT_MAP_FIXED 0
+#endif
+
 void *get_base_pointer(GID_t gid)
 {
 //      printf("get base pointer for lid % d (gid %d) returns: %p\n",GidToLid(gid),gid,init_address + PER_LP_PREALLOCATED_MEMORY * gid);
 	return init_address + PER_LP_PREALLOCATED_MEMORY * gid.to_int;
 }
 
-void *get_segment_memory(struct segment *seg, size_t size)
-{
-	unsigned char *new_brk, *ret = NULL;
-
-	// Align the new brk to a multiple of 64 bytes, to increase L1 cache efficiency
-	new_brk =
-	    (unsigned char *)(((unsigned long long)seg->brk + size + (64 - 1)) &
-			      -64);
-
-	// Do we have enough space?
-	if (likely(new_brk >= seg->base + PER_LP_PREALLOCATED_MEMORY)) {
-		ret = seg->brk;
-		seg->brk = new_brk;
-	}
-
-	return ret;
-}
-
-void free_segment_memory(void *ptr)
-{
-	// there ain't much we can do here...
-	(void)ptr;
-}
-
+/**
+* Reserve the memory segment of an LP. The segment is mapped without
+* reserving swap space, so the system commits its pages only when they are
+* first touched, and an LP pays only for the memory it actually uses.
+*
+* @param gid The global id of the LP
+* @return A pointer to the descriptor of the segment
+*/
 struct segment *get_segment(GID_t gid)
 {
 	void *the_address;
@@ -82,75 +82,107 @@ struct segment *get_segment(GID_t gid)
 		return NULL;
 
 	// Addresses are determined in the same way across all kernel instances
-	the_address = init_address + PER_LP_PREALLOCATED_MEMORY * gid.to_int;
+	the_address = get_base_pointer(gid);
 
 	seg->base =
 	    mmap(the_address, PER_LP_PREALLOCATED_MEMORY,
 		 PROT_READ | PROT_WRITE,
-		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, 0, 0);
-	if (unlikely(seg->base == MAP_FAILED)) {
-		perror("mmap");
-		rootsim_error(true, "Unable to mmap LPs memory\n");
+		 MAP_PRIVATE | MAP_ANONYMOUS | SEGMENT_MAP_FIXED | MAP_NORESERVE, -1, 0);
+	if (unlikely(seg->base != the_address)) {
+		// Kernels not supporting MAP_FIXED_NOREPLACE treat the address as a hint
+		if (seg->base != MAP_FAILED) {
+			munmap(seg->base, PER_LP_PREALLOCATED_MEMORY);
+			errno = EEXIST;
+		}
+		rootsim_error(true, "Unable to map the memory segment of LP %u at %p: %s\n",
+			      gid.to_int, the_address, strerror(errno));
 		return NULL;
 	}
-	seg->brk = seg->base;
 
-	// Access the memory in write mode to force the kernel to create the page table entries
-	*seg->base = 'x';
+	// Segments are 2 MB-aligned, but they are released in pages: only transparent huge pages fit
+	hugepage_advise(seg->base, PER_LP_PREALLOCATED_MEMORY);
 
 	return seg;
 }
 
+/**
+* Size the per-LP segments. Segments are lazily committed, but they must all
+* fit in the address space: with many LPs they are shrunk, down to
+* @ref MIN_SEGMENT_SIZE. The size only depends on the number of LPs, so that
+* segments are placed at the same addresses across runs and kernels.
+*/
 void segment_init(void)
 {
-	struct rlimit limit;
-	size_t max_address_space = PER_LP_PREALLOCATED_MEMORY * n_prc_tot * 2;
+	size_t room = (SEGMENTS_END - (uintptr_t)init_address) / max(n_prc_tot, 1U);
 
-	// Configure the system to allow mmapping 1GB of VM at a time
-	limit.rlim_cur = max_address_space;
-	limit.rlim_max = max_address_space;
+	__segment_size = MAX_SEGMENT_SIZE;
+	while (__segment_size > room && __segment_size > MIN_SEGMENT_SIZE)
+		__segment_size >>= 1;
 
-	if (setrlimit(RLIMIT_AS, &limit) != 0) {
-		perror("Unable to set the maximum address space");
-		rootsim_error(true,
-			      "Unable to pre-allocate per-LP memory. Aborting...\n");
-	}
+	if (unlikely(__segment_size > room))
+		rootsim_error(true, "Unable to reserve a memory segment for %u LPs. Aborting...\n", n_prc_tot);
 }
 
-/*
- * TODO: this should reconstruct the addresses similarly to what is done in get_segment. Anyhow, this is called at simulation shutdown and doesn't cause much harm if it's not called.
- */
-/*
- * void segment_allocator_fini(unsigned int sobjs){
-	unsigned int i;
-	int return_value;
-	for(i=0;i<sobjs;i++){
-		return_value = munmap(mem_region[i].base_pointer,PER_LP_PREALLOCATED_MEMORY);
-		if(unlikely(return_value)) {
-			printf("ERROR on release value:%d\n",return_value);
-			break;
-		}
-		mem_region[i].base_pointer = NULL;
-	}
-	close(ioctl_fd);
-
-}
-*/
-
 void initialize_memory_map(struct lp_struct *lp)
 {
+	unsigned int i;
+
 	lp->mm = rsalloc(sizeof(struct memory_map));
 
-	lp->mm->segment = NULL;	//get_segment(lp->gid);
-	lp->mm->buddy = NULL;	//buddy_new(lp, PER_LP_PREALLOCATED_MEMORY / BUDDY_GRANULARITY);
-	lp->mm->slab = slab_init(SLAB_MSG_SIZE);
+	// The memory of the LP is taken from its segment, which is placed at the
+	// same addresses across runs and kernels: checkpoints written to disk and
+	// LPs migrating across kernels can then keep pointers to it
+	lp->mm->segment = get_segment(lp->gid);
+	lp->mm->buddy = buddy_new(lp, BUDDY_FRAGMENTS);
+	if (unlikely(lp->mm->buddy == NULL))
+		rootsim_error(true, "Unable to set up the memory segment of LP %u\n", lp->gid.to_int);
+	for (i = 0; i < MSG_SLAB_CLASSES; i++)
+		lp->mm->msg_slabs[i] = slab_init(1UL << (MSG_SLAB_MIN_SHIFT + i));
+	lp->mm->antimsg_slab = slab_init(sizeof(antimsg_t));
 	lp->mm->m_state = malloc_state_init();
+	lp->mm->numa_node = -1;
+	lp->mm->ckpt_size = 0;
+	lp->mm->queue_size = 0;
 }
 
 void finalize_memory_map(struct lp_struct *lp)
 {
-	malloc_state_wipe(&lp->mm->m_state);
-	//buddy_destroy(lp->mm->buddy);
-	// No free segment function here!
+	unsigned int i;
+
+	// The memory areas and the stack live in the segment, which is released at once
+	buddy_destroy(lp->mm->buddy);
+	munmap(lp->mm->segment->base, PER_LP_PREALLOCATED_MEMORY);
+	rsfree(lp->mm->segment);
+	rsfree(lp->mm->m_state->areas);
+	rsfree(lp->mm->m_state);
+	for (i = 0; i < MSG_SLAB_CLASSES; i++) {
+		slab_destroy(lp->mm->msg_slabs[i]);
+		rsfree(lp->mm->msg_slabs[i]);
+	}
+	slab_destroy(lp->mm->antimsg_slab);
+	rsfree(lp->mm->antimsg_slab);
 	rsfree(lp->mm);
 }
+
+/**
+* Place the memory of an LP on a NUMA node: the pages of its segment and of
+* its slabs which are already resident are moved there, and the ones touched
+* afterwards are taken from there. This is meant to be called by the worker
+* thread the LP is bound to, while it is not running the LP.
+*
+* @param lp A pointer to the lp_struct of the LP
+* @param node The NUMA node, or -1 to leave the memory where it is
+*/
+void rehome_memory_map(struct lp_struct *lp, int node)
+{
+	unsigned int i;
+
+	if (node < 0 || node == lp->mm->numa_node)
+		return;
+
+	lp->mm->numa_node = node;
+	numa_place_memory(lp->mm->segment->base, PER_LP_PREALLOCATED_MEMORY, node, true);
+	for (i = 0; i < MSG_SLAB_CLASSES; i++)
+		slab_rehome(lp->mm->msg_slabs[i], node);
+	slab_rehome(lp->mm->antimsg_slab, node);
+}
@@ -36,6 +36,7 @@
 #include <assert.h>
 
 #include <core/core.h>
+#include <core/init.h>
 #include <mm/mm.h>
 
 #define SLOTS_ALL_ZERO ((uint64_t) 0)
@@ -147,18 +148,34 @@ struct slab_chain *slab_init(const size_t itemsize)
 	sch->initial_slotmask = sch->empty_slotmask ^ SLOTS_FIRST;
 	sch->alignment_mask = ~(sch->slabsize - 1);
 	sch->partial = sch->empty = sch->full = NULL;
+	sch->remote_free = NULL;
+	sch->magazine = NULL;
+	sch->cached = 0;
+	sch->numa_node = -1;
 
 	assert(slab_is_valid(sch));
 
 	return sch;
 }
 
-void *slab_alloc(struct slab_chain *const sch)
+/// Number of times the current thread found a slab locked by another thread
+__thread unsigned long long slab_lock_contentions;
+
+/// Number of objects the current thread released to slabs owned by other threads
+__thread unsigned long long slab_remote_frees;
+
+static inline void slab_lock(struct slab_chain *const sch)
 {
-	void *ret = NULL;
-	assert(sch != NULL);
+	if (unlikely(!spin_trylock(&sch->lock))) {
+		slab_lock_contentions++;
+		spin_lock(&sch->lock);
+	}
+}
 
-	spin_lock(&sch->lock);
+// The caller must hold the lock of the slab chain
+static void *__slab_alloc(struct slab_chain *const sch)
+{
+	void *ret = NULL;
 
 	assert(slab_is_valid(sch));
 
@@ -200,7 +217,12 @@ void *slab_alloc(struct slab_chain *const sch)
 		goto out;
 	} else {
 		/* no empty or partial slabs available, create a new one */
-		if (sch->slabsize <= PAGE_SIZE) {
+		if (rootsim_config.hugepages >= HUGEPAGES_THP) {
+			/* pages_per_alloc is a power of two, so the block is aligned to the slab size.
+			 * The arena is per-thread, so first touch places it: binding slabs one by one
+			 * would split the huge pages */
+			sch->partial = hugepage_alloc(sch->pages_per_alloc);
+		} else if (sch->slabsize <= PAGE_SIZE) {
 			sch->partial = mmap(NULL, sch->pages_per_alloc, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 
 			if (unlikely(sch->partial == MAP_FAILED)) {
@@ -208,6 +230,8 @@ void *slab_alloc(struct slab_chain *const sch)
 				ret = sch->partial = NULL;
 				goto out;
 			}
+
+			numa_place_memory(sch->partial, sch->pages_per_alloc, sch->numa_node, false);
 		} else {
 			const int err = posix_memalign((void **)&sch->partial, sch->slabsize, sch->pages_per_alloc);
 
@@ -259,18 +283,16 @@ void *slab_alloc(struct slab_chain *const sch)
 	}
 
  out:
-	spin_unlock(&sch->lock);
 	return ret;
 }
 
-void slab_free(struct slab_chain *const sch, const void *const addr)
+// The caller must hold the lock of the slab chain
+static void __slab_free(struct slab_chain *const sch, const void *const addr)
 {
-	assert(sch != NULL);
-	spin_lock(&sch->lock);
 	assert(slab_is_valid(sch));
 
 	if (addr == NULL)
-		goto out;
+		return;
 
 	struct slab_header *const slab = (void *)
 	    ((uintptr_t) addr & sch->alignment_mask);
@@ -330,7 +352,9 @@ void slab_free(struct slab_chain *const sch, const void *const addr)
 			if (unlikely(found_head && (sch->empty = sch->empty->next) != NULL))
 				sch->empty->prev = NULL;
 
-			if (sch->slabsize <= PAGE_SIZE) {
+			if (rootsim_config.hugepages >= HUGEPAGES_THP) {
+				hugepage_free(page, sch->pages_per_alloc);
+			} else if (sch->slabsize <= PAGE_SIZE) {
 				if (unlikely(munmap(page, sch->pages_per_alloc) == -1))
 					perror("munmap");
 			} else {
@@ -362,8 +386,179 @@ void slab_free(struct slab_chain *const sch, const void *const addr)
 		/* target slab is partial, no need to change state */
 		slab->slots |= SLOTS_FIRST << slot;
 	}
+}
+
+void *slab_alloc(struct slab_chain *const sch)
+{
+	void *ret;
+
+	assert(sch != NULL);
+
+	slab_lock(sch);
+	ret = __slab_alloc(sch);
+	spin_unlock(&sch->lock);
+	return ret;
+}
+
+void slab_free(struct slab_chain *const sch, const void *const addr)
+{
+	assert(sch != NULL);
+
+	slab_lock(sch);
+	__slab_free(sch, addr);
+	spin_unlock(&sch->lock);
+}
+
+/**
+* @brief Refill the magazine of a slab chain
+*
+* Objects released by other threads are taken first, all at once. If there
+* are none, half a magazine is taken from the slabs, with a single locking.
+*
+* @param sch The slab chain, which must be owned by the current thread
+*/
+static void slab_refill(struct slab_chain *const sch)
+{
+	void *obj, *next;
+
+	if (unlikely(sch->magazine == NULL))
+		sch->magazine = rsalloc(SLAB_MAGAZINE_SIZE * sizeof(void *));
+
+	if (sch->remote_free != NULL) {
+		obj = __sync_lock_test_and_set(&sch->remote_free, NULL);
+
+		while (obj != NULL && sch->cached < SLAB_MAGAZINE_SIZE) {
+			next = *(void **)obj;
+			sch->magazine[sch->cached++] = obj;
+			obj = next;
+		}
+
+		if (unlikely(obj != NULL)) {
+			slab_lock(sch);
+			while (obj != NULL) {
+				next = *(void **)obj;
+				__slab_free(sch, obj);
+				obj = next;
+			}
+			spin_unlock(&sch->lock);
+		}
+		return;
+	}
+
+	slab_lock(sch);
+	while (sch->cached < SLAB_MAGAZINE_SIZE / 2) {
+		obj = __slab_alloc(sch);
+		if (unlikely(obj == NULL))
+			break;
+		sch->magazine[sch->cached++] = obj;
+	}
+	spin_unlock(&sch->lock);
+}
+
+/**
+* @brief Allocate an object from a slab chain owned by the current thread
+*
+* Objects are taken from the magazine in front of the slabs, which only the
+* owner thread accesses, so no lock is taken unless the magazine is empty.
+*
+* @param sch The slab chain, which must be owned by the current thread
+*
+* @return A pointer to the object, or NULL if no memory is available
+*/
+void *slab_alloc_local(struct slab_chain *const sch)
+{
+	assert(sch != NULL);
+
+	if (unlikely(sch->cached == 0)) {
+		slab_refill(sch);
+		if (unlikely(sch->cached == 0))
+			return NULL;
+	}
+
+	return sch->magazine[--sch->cached];
+}
+
+/**
+* @brief Release an object to a slab chain owned by the current thread
+*
+* The object is cached in the magazine in front of the slabs. When the
+* magazine is full, half of it is given back to the slabs with a single
+* locking.
+*
+* @param sch The slab chain, which must be owned by the current thread
+* @param addr The object to release
+*/
+void slab_free_local(struct slab_chain *const sch, const void *const addr)
+{
+	assert(sch != NULL);
+
+	if (unlikely(sch->magazine == NULL))
+		sch->magazine = rsalloc(SLAB_MAGAZINE_SIZE * sizeof(void *));
+
+	if (unlikely(sch->cached == SLAB_MAGAZINE_SIZE)) {
+		slab_lock(sch);
+		while (sch->cached > SLAB_MAGAZINE_SIZE / 2)
+			__slab_free(sch, sch->magazine[--sch->cached]);
+		spin_unlock(&sch->lock);
+	}
+
+	sch->magazine[sch->cached++] = (void *)addr;
+}
+
+/**
+* @brief Release an object to a slab chain owned by another thread
+*
+* The object is pushed on a lock-free list, which the owner thread drains
+* in batches when its magazine runs empty.
+*
+* @param sch The slab chain, owned by some other thread
+* @param addr The object to release
+*/
+void slab_free_remote(struct slab_chain *const sch, const void *const addr)
+{
+	void *head;
+
+	assert(sch != NULL);
+
+	do {
+		head = sch->remote_free;
+		*(void **)addr = head;
+	} while (!__sync_bool_compare_and_swap(&sch->remote_free, head, (void *)addr));
+
+	slab_remote_frees++;
+}
+
+/**
+* Place the pages of a slab chain on a NUMA node. The pages which are already
+* resident are moved, and the ones allocated afterwards are placed there as well.
+* Slabs larger than a page live in the platform heap, and slabs in huge page
+* arenas would be split, so they are left alone.
+*
+* @param sch The slab chain
+* @param node The NUMA node
+*/
+void slab_rehome(struct slab_chain *const sch, int node)
+{
+	struct slab_header *slab;
+	size_t i;
+
+	assert(sch != NULL);
+
+	slab_lock(sch);
+	sch->numa_node = node;
+
+	if (sch->slabsize <= PAGE_SIZE && rootsim_config.hugepages < HUGEPAGES_THP) {
+		struct slab_header *const heads[] = { sch->partial, sch->empty, sch->full };
+
+		for (i = 0; i < 3; ++i) {
+			// Only the first slab of each group of pages holds a reference count
+			for (slab = heads[i]; slab != NULL; slab = slab->next) {
+				if (slab->refcount != 0)
+					numa_place_memory(slab, sch->pages_per_alloc, node, true);
+			}
+		}
+	}
 
- out:
 	spin_unlock(&sch->lock);
 }
 
@@ -372,6 +567,10 @@ void slab_destroy(const struct slab_chain *const sch)
 	assert(sch != NULL);
 	assert(slab_is_valid(sch));
 
+	// Cached objects are released together with the pages keeping them
+	if (sch->magazine != NULL)
+		rsfree(sch->magazine);
+
 	struct slab_header *const heads[] = { sch->partial, sch->empty, sch->full };
 	struct slab_header *pages_head = NULL, *pages_tail;
 
@@ -399,7 +598,13 @@ void slab_destroy(const struct slab_chain *const sch)
 		pages_tail->next = NULL;
 		struct slab_header *page = pages_head;
 
-		if (sch->slabsize <= PAGE_SIZE) {
+		if (rootsim_config.hugepages >= HUGEPAGES_THP) {
+			do {
+				void *const target = page;
+				page = page->next;
+				hugepage_free(target, sch->pages_per_alloc);
+			} while (page != NULL);
+		} else if (sch->slabsize <= PAGE_SIZE) {
 			do {
 				void *const target = page;
 				page = page->next;
@@ -45,6 +45,7 @@
 #include <communication/communication.h>
 #include <mm/mm.h>
 #include <statistics/statistics.h>
+#include <lib/output.h>
 
 /**
 * This function is used to create a state log to be added to the LP's log chain
@@ -96,37 +97,68 @@ bool LogState(struct lp_struct *lp)
 		// Allocate the state buffer
 		new_state = rsalloc(sizeof(*new_state));
 
-		// Associate the checkpoint with current LVT and last-executed event
-		new_state->lvt = lvt(lp);
-		new_state->last_event = lp->bound;
+		// Take the actual log
+		save_state(lp, new_state);
 
-		// Log simulation model buffers
-		new_state->log = log_state(lp);
+		// Link the new checkpoint to the state chain
+		list_insert_tail(lp->queue_states, new_state);
 
-		// Log members of lp_struct which must be restored
-		new_state->state = lp->state;
-		new_state->base_pointer = lp->current_base_pointer;
+	}
 
-		// Log library-related states
-		memcpy(&new_state->numerical, &lp->numerical,
-		       sizeof(numerical_state_t));
+	return take_snapshot;
+}
 
-		if(&topology_settings && topology_settings.write_enabled){
-			new_state->topology = rsalloc(topology_global.chkp_size);
-			memcpy(new_state->topology, lp->topology,
-					topology_global.chkp_size);
-		}
+/**
+* This function takes a log of the current state of an LP, without linking it
+* to the LP's state chain. It is used by LogState(), and by any subsystem which
+* needs to temporarily save the state of an LP before altering it.
+*
+* @param lp A pointer to the lp_struct of the LP for which a log is to be taken
+* @param new_state A pointer to the state_t buffer where to store the log
+*/
+void save_state(struct lp_struct *lp, state_t *new_state)
+{
+	// Associate the checkpoint with current LVT and last-executed event
+	new_state->lvt = lvt(lp);
+	new_state->last_event = lp->bound;
 
-		if(&abm_settings){
-			new_state->region_data = abm_do_checkpoint(lp->region);
-		}
+	// Log simulation model buffers
+	new_state->log = log_state(lp);
 
-		// Link the new checkpoint to the state chain
-		list_insert_tail(lp->queue_states, new_state);
+	// Log members of lp_struct which must be restored
+	new_state->state = lp->state;
+	new_state->base_pointer = lp->current_base_pointer;
+
+	// Log library-related states
+	memcpy(&new_state->numerical, &lp->numerical,
+	       sizeof(numerical_state_t));
 
+	if(&topology_settings && topology_settings.write_enabled){
+		new_state->topology = rsalloc(topology_global.chkp_size);
+		memcpy(new_state->topology, lp->topology,
+				topology_global.chkp_size);
 	}
 
-	return take_snapshot;
+	if(&abm_settings){
+		new_state->region_data = abm_do_checkpoint(lp->region);
+	}
+}
+
+/**
+* This function releases the buffers of a log taken with save_state().
+* The state_t buffer itself is not released.
+*
+* @param state A pointer to the state_t buffer keeping the log to release
+*/
+void discard_state(state_t *state)
+{
+	log_delete(state->log);
+
+	if(&topology_settings && topology_settings.write_enabled)
+		rsfree(state->topology);
+
+	if(&abm_settings)
+		rsfree(state->region_data);
 }
 
 void RestoreState(struct lp_struct *lp, state_t * restore_state)
@@ -240,6 +272,9 @@ void rollback(struct lp_struct *lp)
 	// Send antimessages
 	send_antimessages(lp, last_correct_event->timestamp);
 
+	// Discard the output of the undone events
+	output_rollback(lp, last_correct_event);
+
 	// Find the state to be restored, and prune the wrongly computed states
 	restore_state = list_tail(lp->queue_states);
 	while (restore_state != NULL && restore_state->lvt > last_correct_event->timestamp) {	// It's > rather than >= because we have already taken into account simultaneous events
@@ -76,6 +76,8 @@ typedef struct _state_t {
 struct lp_struct;
 
 extern bool LogState(struct lp_struct *);
+extern void save_state(struct lp_struct *, state_t *new_state);
+extern void discard_state(state_t *state);
 extern void RestoreState(struct lp_struct *, state_t * restore_state);
 extern void rollback(struct lp_struct *);
 extern state_t *find_time_barrier(struct lp_struct *, simtime_t time);
@@ -125,120 +125,275 @@ void insert_bottom_half(msg_t * msg)
 }
 
 /**
-* Process bottom halves received by all the LPs hosted by the current KLT
+* Insert an antimessage in the antimessage bottom half of a locally-hosted LP.
+* As for insert_bottom_half(), the LP must be locally hosted.
 *
-* @author Alessandro Pellegrini
+* @param anti The antimessage to be added into some LP's bottom half.
 */
-void process_bottom_halves(void)
+void insert_antimsg_bottom_half(antimsg_t * anti)
+{
+	struct lp_struct *lp = find_lp_by_gid(anti->receiver);
+
+	insert_msg(lp->antimsg_bottom_halves, anti);
+#ifdef HAVE_PREEMPTION
+	update_min_in_transit(lp->worker_thread, anti->timestamp);
+#endif
+}
+
+/**
+* Move the bound of an LP back to the event right before the one with
+* timestamp @p timestamp, and mark the LP as needing a rollback.
+*
+* @param lp The LP which has to roll back
+* @param evt The event which the bound is moved before
+* @param timestamp The timestamp of the message which caused the rollback
+*/
+static inline void bound_rollback(struct lp_struct *lp, msg_t *evt, simtime_t timestamp)
 {
-	struct lp_struct *receiver;
+	lp->bound = list_prev(evt);
+	while ((lp->bound != NULL) && D_EQUAL(lp->bound->timestamp, timestamp)) {
+		lp->bound = list_prev(lp->bound);
+	}
+
+	lp->state = LP_STATE_ROLLBACK;
+}
+
+/**
+* Find the message in the input queue of an LP which an antimessage refers to.
+*
+* @param lp The LP receiving the antimessage
+* @param mark The mark of the message to annihilate
+* @return A pointer to the matching message, or NULL if it is not there
+*/
+static msg_t *find_matching_msg(struct lp_struct *lp, unsigned long long mark)
+{
+	msg_t *matched_msg = list_tail(lp->queue_in);
+
+	while (matched_msg != NULL && matched_msg->mark != mark) {
+		matched_msg = list_prev(matched_msg);
+	}
 
+	return matched_msg;
+}
+
+/**
+* Insert a message directly in the input queue of an LP bound to the current
+* worker thread, bypassing its bottom half. The LP is rolled back if the
+* message is a straggler. Only messages carrying model events can take this
+* path, as control messages must go through receive_control_msg().
+*
+* @param lp The LP receiving the message
+* @param msg The message to be added into the input queue of @p lp
+*/
+void insert_local_msg(struct lp_struct *lp, msg_t * msg)
+{
+	validate_msg(msg);
+
+	list_insert(lp->queue_in, timestamp, msg);
+
+	// As in process_msg_bottom_half(), a contemporaneous event is not a causal violation
+	if (msg->timestamp < lvt(lp)) {
+		bound_rollback(lp, msg, msg->timestamp);
+	}
+
+	refresh_bound_lp(lp);
+}
+
+/**
+* Process the messages in the bottom half of an LP
+*
+* @param lp The LP whose bottom half should be processed
+*/
+static void process_msg_bottom_half(struct lp_struct *lp)
+{
 	msg_t *msg_to_process;
 	msg_t *matched_msg;
 
-	foreach_bound_lp(lp) {
+	while ((msg_to_process = get_msg(lp->bottom_halves)) != NULL) {
+		validate_msg(msg_to_process);
+
+		// Sanity check
+		if (unlikely
+		    (msg_to_process->timestamp < get_last_gvt()))
+			rootsim_error(true,
+				      "The impossible happened: I'm receiving a message before the GVT\n");
+
+		// Handle control messages
+		if (unlikely(!receive_control_msg(msg_to_process))) {
+			msg_release(msg_to_process);
+			continue;
+		}
+
+		switch (msg_to_process->message_kind) {
 
-		while ((msg_to_process = get_msg(lp->bottom_halves)) != NULL) {
-			receiver = find_lp_by_gid(msg_to_process->receiver);
+			// It's the antimessage of a control message. Antimessages
+			// of model events go through process_antimsg_bottom_half().
+		case negative:
+
+			statistics_post_data(lp, STAT_ANTIMESSAGE, 1.0);
+
+			// Find the message matching the antimessage
+			matched_msg = find_matching_msg(lp, msg_to_process->mark);
 
 			// Sanity check
-			if (unlikely
-			    (msg_to_process->timestamp < get_last_gvt()))
-				rootsim_error(true,
-					      "The impossible happened: I'm receiving a message before the GVT\n");
+			if (unlikely(matched_msg == NULL)) {
+				rootsim_error(false,
+					      "LP %d Received an antimessage, but no such mark has been found!\n",
+					      lp->gid.to_int);
+				dump_msg_content(msg_to_process);
+				rootsim_error(true, "Aborting...\n");
+			}
+			// If the matched message is in the past, we have to rollback
+			if (matched_msg->timestamp <= lvt(lp)) {
+				bound_rollback(lp, matched_msg, msg_to_process->timestamp);
+			}
+			register_incoming_msg(msg_to_process);
+
+			// Delete the matched message
+			list_delete_by_content(lp->queue_in,
+					       matched_msg);
+			msg_release(matched_msg);
+
+			break;
+
+			// It's a positive message
+		case positive:
+
+			// A positive message is directly placed in the queue
+			list_insert(lp->queue_in, timestamp,
+				    msg_to_process);
+
+			// Check if we've just inserted an out-of-order event.
+			// Here we check for a strictly minor timestamp since
+			// the queue is FIFO for same-timestamp events. Therefore,
+			// A contemporaneous event does not cause a causal violation.
+			if (msg_to_process->timestamp < lvt(lp)) {
+				bound_rollback(lp, msg_to_process, msg_to_process->timestamp);
+			}
+			register_incoming_msg(msg_to_process);
+			break;
+
+			// It's a control message
+		case control:
 
-			// Handle control messages
-			if (unlikely(!receive_control_msg(msg_to_process))) {
+			// Check if it is an anti control message
+			if (!anti_control_message(msg_to_process)) {
 				msg_release(msg_to_process);
 				continue;
 			}
 
-			switch (msg_to_process->message_kind) {
-
-				// It's an antimessage
-			case negative:
-
-				statistics_post_data(receiver, STAT_ANTIMESSAGE, 1.0);
-
-				// Find the message matching the antimessage
-				matched_msg = list_tail(receiver->queue_in);
-				while (matched_msg != NULL
-				       && matched_msg->mark !=
-				       msg_to_process->mark) {
-					matched_msg = list_prev(matched_msg);
-				}
-
-				// Sanity check
-				if (unlikely(matched_msg == NULL)) {
-					rootsim_error(false,
-						      "LP %d Received an antimessage, but no such mark has been found!\n",
-						      receiver->gid.to_int);
-					dump_msg_content(msg_to_process);
-					rootsim_error(true, "Aborting...\n");
-				}
-				// If the matched message is in the past, we have to rollback
-				if (matched_msg->timestamp <= lvt(receiver)) {
-
-					receiver->bound = list_prev(matched_msg);
-					while ((receiver->bound != NULL)
-						&& D_EQUAL(receiver->bound->timestamp, msg_to_process->timestamp)) {
-						receiver->bound = list_prev(receiver->bound);
-					}
-					
-					receiver->state = LP_STATE_ROLLBACK;
-				}
-#ifdef HAVE_MPI
-				register_incoming_msg(msg_to_process);
-#endif
+			break;
 
-				// Delete the matched message
-				list_delete_by_content(receiver->queue_in,
-						       matched_msg);
-				msg_release(matched_msg);
+		default:
+			rootsim_error(true, "Received a message which is neither positive nor negative. Aborting...\n");
+		}
+	}
+}
 
-				break;
+/**
+* Annihilate the messages in the input queue of an LP which an antimessage
+* refers to. The LP is rolled back if any of them has already been processed.
+*
+* Since a message cannot be scheduled in the past, the messages sent after
+* @e send_time also have a larger timestamp: the input queue is scanned
+* backwards only down to that point.
+*
+* @param lp The LP receiving the antimessage
+* @param anti The antimessage
+* @return The number of messages which have been annihilated
+*/
+static unsigned int annihilate_msgs(struct lp_struct *lp, antimsg_t *anti)
+{
+	msg_t *msg = list_tail(lp->queue_in);
+	msg_t *prev;
+	unsigned int annihilated = 0;
+
+	while (msg != NULL && msg->timestamp > anti->send_time) {
+		prev = list_prev(msg);
+
+		if (msg->sender.to_int == anti->sender.to_int
+		    && msg->send_time > anti->send_time
+		    && msg->mark <= anti->mark) {
+
+			// If the message is in the past, we have to rollback. Since the
+			// queue is scanned backwards, the bound never points to a
+			// message which is annihilated later on.
+			if (msg->timestamp <= lvt(lp)) {
+				bound_rollback(lp, msg, msg->timestamp);
+			}
 
-				// It's a positive message
-			case positive:
+			list_delete_by_content(lp->queue_in, msg);
+			msg_release(msg);
+			annihilated++;
+		}
 
-				// A positive message is directly placed in the queue
-				list_insert(receiver->queue_in, timestamp,
-					    msg_to_process);
+		msg = prev;
+	}
 
-				// Check if we've just inserted an out-of-order event.
-				// Here we check for a strictly minor timestamp since
-				// the queue is FIFO for same-timestamp events. Therefore,
-				// A contemporaneous event does not cause a causal violation.
-				if (msg_to_process->timestamp < lvt(receiver)) {
+	return annihilated;
+}
 
-					receiver->bound = list_prev(msg_to_process);
-					while ((receiver->bound != NULL)
-					       && D_EQUAL(receiver->bound->timestamp, msg_to_process->timestamp)) {
-						receiver->bound = list_prev(receiver->bound);
-					}
+/**
+* Process the antimessages in the antimessage bottom half of an LP.
+*
+* An antimessage is always inserted in a bottom half after the messages it
+* annihilates. Since the two bottom halves are drained separately, some of
+* these messages could have been inserted after the message bottom half has
+* been drained: in that case, the message bottom half is drained again.
+*
+* @param lp The LP whose antimessage bottom half should be processed
+*/
+static void process_antimsg_bottom_half(struct lp_struct *lp)
+{
+	antimsg_t *anti;
+	unsigned int annihilated;
 
-					receiver->state = LP_STATE_ROLLBACK;
-				}
-#ifdef HAVE_MPI
-				register_incoming_msg(msg_to_process);
-#endif
-				break;
+	while ((anti = get_msg(lp->antimsg_bottom_halves)) != NULL) {
 
-				// It's a control message
-			case control:
+		// Sanity check
+		if (unlikely(anti->timestamp < get_last_gvt()))
+			rootsim_error(true,
+				      "The impossible happened: I'm receiving an antimessage before the GVT\n");
 
-				// Check if it is an anti control message
-				if (!anti_control_message(msg_to_process)) {
-					msg_release(msg_to_process);
-					continue;
-				}
+		statistics_post_data(lp, STAT_ANTIMESSAGE, anti->count);
 
-				break;
+		annihilated = annihilate_msgs(lp, anti);
+		if (unlikely(annihilated < anti->count)) {
+			process_msg_bottom_half(lp);
+			annihilated += annihilate_msgs(lp, anti);
+		}
 
-			default:
-				rootsim_error(true, "Received a message which is neither positive nor negative. Aborting...\n");
-			}
+		// Sanity check
+		if (unlikely(annihilated != anti->count)) {
+			rootsim_error(true,
+				      "LP %d Received an antimessage from LP %d cancelling %u messages sent after %f, but %u have been found! Aborting...\n",
+				      lp->gid.to_int, anti->sender.to_int, anti->count, anti->send_time, annihilated);
 		}
+		register_incoming_antimsg(anti);
+		antimsg_release(anti);
+	}
+}
+
+/**
+* Process bottom halves received by all the LPs hosted by the current KLT
+*
+* @author Alessandro Pellegrini
+*/
+void process_bottom_halves(void)
+{
+	struct lp_struct *lp;
+	unsigned int i;
+
+	for (i = 0; i < n_prc_per_thread; i++) {
+		// Most LPs have nothing pending: their control blocks are not touched
+		if (channel_empty(lps_bound_hot.bottom_halves[i]) &&
+		    channel_empty(lps_bound_hot.antimsg_bottom_halves[i]))
+			continue;
+
+		lp = lps_bound_blocks[i];
+		process_msg_bottom_half(lp);
+		process_antimsg_bottom_half(lp);
+		refresh_bound_lp(lp);
 	}
 
 	// We have processed all in transit messages.
@@ -32,14 +32,19 @@
 
 #include <arch/atomic.h>
 #include <core/core.h>
+#include <core/init.h>
 #include <core/timer.h>
 #include <datatypes/list.h>
 #include <scheduler/binding.h>
+#include <scheduler/placement.h>
 #include <scheduler/process.h>
 #include <scheduler/scheduler.h>
 #include <statistics/statistics.h>
 #include <gvt/gvt.h>
+#include <mm/mm.h>
+#include <mm/persist.h>
 
+#include <arch/numa.h>
 #include <arch/thread.h>
 
 #define REBIND_INTERVAL 10.0
@@ -54,9 +59,15 @@ struct lp_cost_id *lp_cost;
 /// A guard to know whether this is the first invocation or not
 static __thread bool first_lp_binding = true;
 
+/// Set when the LPs bound to this thread changed, and their memory must be placed again
+static __thread bool placement_pending;
+
 static unsigned int *new_LPS_binding;
 static timer rebinding_timer;
 
+/// Set when LPs are placed according to their communication, so that the knapsack policy does not move them
+static bool binding_pinned = false;
+
 #ifdef HAVE_LP_REBINDING
 static int binding_acquire_phase = 0;
 static __thread int local_binding_acquire_phase = 0;
@@ -108,6 +119,27 @@ static inline void LPs_block_binding(void)
 			buf1--;
 		}
 	}
+
+	refresh_bound_lps();
+}
+
+/**
+* Binds to the current worker thread the LPs which a placement assigns to it
+*
+* @param thread_of The worker thread of each LP, indexed by gid
+*/
+static inline void LPs_placement_binding(const unsigned int *thread_of)
+{
+	n_prc_per_thread = 0;
+
+	foreach_lp(lp) {
+		if (thread_of[lp->gid.to_int] == local_tid) {
+			LPS_bound_set(n_prc_per_thread++, lp);
+			lp->worker_thread = local_tid;
+		}
+	}
+
+	refresh_bound_lps();
 }
 
 /**
@@ -197,6 +229,26 @@ static inline void LP_knapsack(void)
 	}
 }
 
+/**
+* Place the memory of the LPs bound to the current thread on its NUMA node.
+* This is done by every thread on its own the next time it goes through
+* rebind_LPs(), outside of any barrier, so that no thread waits for the
+* pages of LPs bound to other threads to be migrated.
+*/
+static void place_bound_LPs(void)
+{
+	int node = numa_current_node();
+
+	placement_pending = false;
+
+	if (node < 0)
+		return;
+
+	foreach_bound_lp(lp) {
+		rehome_memory_map(lp, node);
+	}
+}
+
 #ifdef HAVE_LP_REBINDING
 
 static void post_local_reduction(void)
@@ -245,7 +297,9 @@ static void install_binding(void)
 * structures, and the performs a (deterministic) block allocation. This is
 * because no runtime data is available at the time, so we "share" the load
 * as the number of LPs.
-* Then, successive invocations, will use the knapsack load sharing policy
+* Then, successive invocations, will use the knapsack load sharing policy.
+* If a placement of LPs has been loaded via @c --lp-mapping, it is used for
+* the initial binding, and the knapsack policy is not applied.
 
 * @author Alessandro Pellegrini
 */
@@ -257,22 +311,34 @@ void rebind_LPs(void)
 
 		initialize_binding_blocks();
 
-		LPs_block_binding();
+		if (placement_threads() != NULL) {
+			LPs_placement_binding(placement_threads());
+			binding_pinned = true;
+		} else {
+			LPs_block_binding();
+		}
+
+		// LPs were set up by the main thread, before worker threads were bound to cores
+		place_bound_LPs();
 
 		timer_start(rebinding_timer);
 
 		if (master_thread()) {
-			new_LPS_binding = rsalloc(sizeof(int) * n_prc);
+			new_LPS_binding = rsalloc(sizeof(int) * max_local_lps());
 
-			lp_cost = rsalloc(sizeof(struct lp_cost_id) * n_prc);
+			lp_cost = rsalloc(sizeof(struct lp_cost_id) * max_local_lps());
 
 			atomic_set(&worker_thread_reduction, n_cores);
 		}
 
 		return;
 	}
+
+	if (unlikely(placement_pending))
+		place_bound_LPs();
+
 #ifdef HAVE_LP_REBINDING
-	if (master_thread()) {
+	if (master_thread() && !binding_pinned) {
 		if (unlikely
 		    (timer_value_seconds(rebinding_timer) >= REBIND_INTERVAL)) {
 			timer_restart(rebinding_timer);
@@ -306,6 +372,62 @@ void rebind_LPs(void)
 			atomic_set(&worker_thread_reduction, n_cores);
 		}
 
+		// The previous worker threads of the LPs which moved here are done with them
+		refresh_bound_lps();
+
+		// LPs coming from other threads could still have to be saved to disk
+		persist_catch_up();
+
+		placement_pending = true;
 	}
 #endif
 }
+
+static void drop_pending_rebinding(void)
+{
+#ifdef HAVE_LP_REBINDING
+	local_binding_phase = binding_phase;
+	local_binding_acquire_phase = binding_acquire_phase;
+	if (master_thread())
+		atomic_set(&worker_thread_reduction, n_cores);
+#endif
+}
+
+/**
+* Bind again from scratch the LPs to the worker threads, after the set of LPs
+* hosted by this kernel has changed. Any reduction which is in progress to
+* rebalance the load among worker threads is dropped, as it refers to LPs
+* which might have left.
+*
+* @note All the worker threads of this kernel must call this function
+*       at the same time, from within a barrier.
+*/
+void reset_LPs_binding(void)
+{
+	LPs_block_binding();
+	binding_pinned = false;
+	drop_pending_rebinding();
+	placement_pending = true;
+}
+
+/**
+* Bind the LPs to the worker threads according to a placement computed from
+* their communication. The knapsack policy is not applied anymore, until
+* the set of LPs hosted by this kernel changes.
+*
+* @param thread_of The worker thread of each LP, indexed by gid
+*
+* @note All the worker threads of this kernel must call this function
+*       at the same time, from within a barrier.
+*/
+void place_LPs_binding(const unsigned int *thread_of)
+{
+	LPs_placement_binding(thread_of);
+	binding_pinned = true;
+	drop_pending_rebinding();
+	placement_pending = true;
+
+#ifdef HAVE_PREEMPTION
+	reset_min_in_transit(local_tid);
+#endif
+}
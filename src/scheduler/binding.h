@@ -30,3 +30,5 @@
 
 extern void rebind_LPs(void);
 extern void force_rebind_GLP(void);
+extern void reset_LPs_binding(void);
+extern void place_LPs_binding(const unsigned int *thread_of);
@@ -0,0 +1,560 @@
+/**
+ * @file scheduler/migration.c
+ *
+ * @brief Migration of LPs across simulation kernels
+ *
+ * Every @c --migrate-every GVT reductions, each kernel reports how much time
+ * its LPs have spent processing events since the previous round, and the
+ * master kernel plans the moves of LPs from the most loaded kernels to the
+ * least loaded ones. All the kernels then apply the same plan.
+ *
+ * Migration takes place while a new GVT is being adopted. Each leaving LP is
+ * rolled back to its last event before the GVT, which cancels whatever it
+ * has sent after it. All the messages in flight across kernels are then
+ * delivered, so that no message can ever reach a kernel which is not hosting
+ * its destination LP anymore, and there is no need to forward messages. The
+ * committed state of the LP, its library state and its pending events are
+ * shipped to the destination kernel, which rebuilds the LP as it is done
+ * when resuming the simulation from a checkpoint. Finally, the map of LPs
+ * onto kernels is updated everywhere, and worker threads rebind the LPs.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_MPI
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include <ROOT-Sim.h>
+#include <core/core.h>
+#include <core/init.h>
+#include <arch/thread.h>
+#include <datatypes/list.h>
+#include <mm/mm.h>
+#include <mm/state.h>
+#include <gvt/ccgs.h>
+#include <lib/output.h>
+#include <lib/topology.h>
+#include <queues/queues.h>
+#include <scheduler/binding.h>
+#include <scheduler/migration.h>
+#include <scheduler/process.h>
+#include <scheduler/scheduler.h>
+#include <statistics/statistics.h>
+#include <communication/communication.h>
+#include <communication/mpi.h>
+
+/// LPs are moved only if the most loaded kernel is loaded more than this factor times the least loaded one
+#define MIGRATION_IMBALANCE	1.2
+
+/// Maximum number of LPs moved in a single round
+#define MIGRATION_MAX_LPS	8
+
+/**
+ * Record of an LP shipped to another kernel. It is followed by the DyMeLoR
+ * malloc_areas, the DyMeLoR log of the committed state, the topology buffer
+ * (if any) and the pending input events.
+ */
+struct _migration_lp {
+	GID_t gid;
+	unsigned long long mark;	///< Next mark to be generated by the LP
+	void *base_pointer;		///< The state base pointer installed via SetState()
+	numerical_state_t numerical;
+	int num_areas;
+	size_t log_size;
+	size_t topology_size;
+	unsigned int pending_events;
+	struct stat_t stats[2];		///< Statistics of the LP, see statistics_export_lp()
+};
+
+/// Buffer where the master thread serializes the leaving LPs
+static struct {
+	size_t size;
+	size_t capacity;
+	unsigned char *data;
+} outgoing;
+
+/// Communicator used by the collective operations of this module
+static MPI_Comm migration_comm;
+
+/// Time spent by each LP processing events, followed by the number of worker threads of each kernel and by the number of terminated kernels
+static double *load_report;
+
+/// On the master kernel, the time spent by each LP processing events at the previous round
+static double *last_work;
+
+/// The kernel which hosts each LP once the current round is done, followed by a flag telling whether migration must stop
+static unsigned int *new_kernel;
+
+/// Tells the worker threads of this kernel whether some LP is migrating in the current round
+static bool migrating;
+
+/// Set once some kernel has reached local termination. Kernels may then leave the simulation at different GVT rounds, so no collective operation can be issued anymore
+static bool stopped;
+
+/// Number of GVT reductions adopted by the current worker thread
+static __thread unsigned int gvt_rounds;
+
+
+static void buffer_append(const void *data, size_t size)
+{
+	if (outgoing.size + size > outgoing.capacity) {
+		outgoing.capacity = max(outgoing.capacity << 1, outgoing.size + size);
+		outgoing.data = rsrealloc(outgoing.data, outgoing.capacity);
+		if (unlikely(outgoing.data == NULL))
+			rootsim_error(true, "Unable to allocate memory for migrating LPs\n");
+	}
+	memcpy(outgoing.data + outgoing.size, data, size);
+	outgoing.size += size;
+}
+
+/**
+* Compute which LPs should move, given the time spent processing events by
+* each LP since the previous round. The heaviest LP of the most loaded kernel
+* which does not make the least loaded kernel the most loaded one is moved,
+* until the imbalance is small enough. Every kernel keeps at least one LP
+* per worker thread.
+*
+* @param work The time spent processing events by each LP since the previous round
+* @param threads The number of worker threads of each kernel
+*/
+static void plan_migration(const double *work, const double *threads)
+{
+	double load[n_ker];
+	unsigned int hosted[n_ker];
+	unsigned int i, gid, hot, cold, best, moves;
+
+	memcpy(new_kernel, kernel, sizeof(unsigned int) * n_prc_tot);
+	new_kernel[n_prc_tot] = false;
+	bzero(load, sizeof(load));
+	bzero(hosted, sizeof(hosted));
+
+	for (gid = 0; gid < n_prc_tot; gid++) {
+		load[kernel[gid]] += work[gid];
+		hosted[kernel[gid]]++;
+	}
+	for (i = 0; i < n_ker; i++)
+		load[i] /= threads[i];
+
+	for (moves = 0; moves < MIGRATION_MAX_LPS; moves++) {
+		hot = cold = 0;
+		for (i = 1; i < n_ker; i++) {
+			if (load[i] > load[hot])
+				hot = i;
+			if (load[i] < load[cold])
+				cold = i;
+		}
+
+		if (hot == cold || load[hot] <= load[cold] * MIGRATION_IMBALANCE || hosted[hot] <= threads[hot])
+			break;
+
+		// LPs which have already been moved in this round stay where they are
+		best = n_prc_tot;
+		for (gid = 0; gid < n_prc_tot; gid++) {
+			if (kernel[gid] != hot || new_kernel[gid] != hot || work[gid] <= 0)
+				continue;
+			if (load[cold] + work[gid] / threads[cold] > load[hot] - work[gid] / threads[hot])
+				continue;
+			if (best == n_prc_tot || work[gid] > work[best])
+				best = gid;
+		}
+
+		if (best == n_prc_tot)
+			break;
+
+		new_kernel[best] = cold;
+		load[hot] -= work[best] / threads[hot];
+		load[cold] += work[best] / threads[cold];
+		hosted[hot]--;
+		hosted[cold]++;
+	}
+}
+
+/**
+* Agree with the other kernels on the LPs which move in this round. Once
+* some kernel has reached local termination, no LP moves anymore.
+*
+* @note This is a collective operation, which must be called by the master thread of all kernels.
+*
+* @return The number of LPs which move in this round
+*/
+static unsigned int agree_on_migration(void)
+{
+	unsigned int gid, moves = 0;
+
+	bzero(load_report, sizeof(double) * (n_prc_tot + n_ker + 1));
+	foreach_lp(lp) {
+		load_report[lp->gid.to_int] = statistics_get_lp_data(lp, STAT_GET_EVENT_TIME_TOT_LP);
+	}
+	load_report[n_prc_tot + kid] = n_cores;
+	load_report[n_prc_tot + n_ker] = kernel_terminated();
+
+	lock_mpi();
+	MPI_Reduce(master_kernel() ? MPI_IN_PLACE : load_report, load_report, n_prc_tot + n_ker + 1, MPI_DOUBLE, MPI_SUM, 0, migration_comm);
+	unlock_mpi();
+
+	if (master_kernel()) {
+		// The statistics of an LP move along with it, so they keep growing wherever the LP is
+		for (gid = 0; gid < n_prc_tot; gid++) {
+			load_report[gid] -= last_work[gid];
+			last_work[gid] += load_report[gid];
+		}
+		if (load_report[n_prc_tot + n_ker] > 0) {
+			memcpy(new_kernel, kernel, sizeof(unsigned int) * n_prc_tot);
+			new_kernel[n_prc_tot] = true;
+		} else {
+			plan_migration(load_report, load_report + n_prc_tot);
+		}
+	}
+
+	lock_mpi();
+	MPI_Bcast(new_kernel, n_prc_tot + 1, MPI_UNSIGNED, 0, migration_comm);
+	unlock_mpi();
+
+	stopped = new_kernel[n_prc_tot];
+
+	for (gid = 0; gid < n_prc_tot; gid++) {
+		if (new_kernel[gid] != kernel[gid])
+			moves++;
+	}
+
+	return moves;
+}
+
+/**
+* Roll back an LP to its last event before the GVT. Antimessages are sent for
+* all the messages generated after that event.
+*
+* @param lp A pointer to the lp_struct of the LP
+* @param gvt The newly adopted GVT value
+*/
+static void rollback_to_gvt(struct lp_struct *lp, simtime_t gvt)
+{
+	msg_t *target = lp->bound;
+
+	while (target->timestamp >= gvt)
+		target = list_prev(target);
+	while (list_next(target) != NULL && list_next(target)->timestamp < gvt)
+		target = list_next(target);
+
+	if (target == lp->bound && lp->state != LP_STATE_ROLLBACK)
+		return;
+
+	lp->bound = target;
+	lp->state = LP_STATE_ROLLBACK;
+	rollback(lp);
+	lp->state = LP_STATE_READY;
+	send_outgoing_msgs(lp);
+	refresh_bound_lp(lp);
+
+	// No real LP is running now!
+	current = NULL;
+}
+
+/**
+* Serialize an LP which has been rolled back to the GVT into the outgoing
+* buffer. Its statistics are moved into the record.
+*
+* @param lp A pointer to the lp_struct of the LP to serialize
+*/
+static void pack_lp(struct lp_struct *lp)
+{
+	struct _migration_lp record;
+	msg_t *evt;
+	void *log;
+
+	log = log_full(lp);
+
+	bzero(&record, sizeof(record));
+	record.gid = lp->gid;
+	record.mark = lp->mark;
+	record.base_pointer = lp->current_base_pointer;
+	memcpy(&record.numerical, &lp->numerical, sizeof(numerical_state_t));
+	record.num_areas = lp->mm->m_state->num_areas;
+	record.log_size = get_log_size(log);
+
+	if (&topology_settings && topology_settings.write_enabled)
+		record.topology_size = topology_global.chkp_size;
+
+	for (evt = list_next(lp->bound); evt != NULL; evt = list_next(evt))
+		record.pending_events++;
+
+	statistics_export_lp(lp, record.stats);
+
+	buffer_append(&record, sizeof(record));
+	buffer_append(lp->mm->m_state->areas, record.num_areas * sizeof(malloc_area));
+	buffer_append(log, record.log_size);
+	if (record.topology_size > 0)
+		buffer_append(lp->topology, record.topology_size);
+	// The payload is not necessarily at offset sizeof(msg_t), due to the struct padding
+	for (evt = list_next(lp->bound); evt != NULL; evt = list_next(evt)) {
+		buffer_append(evt, sizeof(msg_t));
+		buffer_append(evt->event_content, evt->size);
+	}
+
+	log_delete(log);
+}
+
+/**
+* Rebuild an LP which has migrated to this kernel. INIT is silently executed
+* first, so that the model can set up anything which is not part of the LP
+* state, then the state is overwritten with the shipped one. The INIT event
+* is moved right before the GVT to act as the bound, and the pending events
+* are placed in the input queue.
+*
+* @param data The record of the LP, as written by pack_lp()
+* @param gvt The newly adopted GVT value
+*
+* @return A pointer to the first byte after the record
+*/
+static unsigned char *unpack_lp(unsigned char *data, simtime_t gvt)
+{
+	struct _migration_lp record;
+	struct lp_struct *lp;
+	state_t committed;
+	msg_t header, *init, *msg;
+	unsigned int i;
+
+	memcpy(&record, data, sizeof(record));
+	data += sizeof(record);
+
+	lp = install_lp(record.gid);
+	output_lp_init(lp);
+	topology_install_lp(lp);
+
+	pack_msg(&init, lp->gid, lp->gid, INIT, 0.0, 0.0, 0, NULL);
+	init->mark = generate_mark(lp);
+	list_insert_head(lp->queue_in, init);
+
+	lp->bound = init;
+	lp->state = LP_STATE_SILENT_EXEC;
+	activate_LP(lp, init);
+
+	lp->mark = record.mark;
+	lp->current_base_pointer = record.base_pointer;
+	memcpy(&lp->numerical, &record.numerical, sizeof(numerical_state_t));
+
+	// The LP segment is mapped at the same address on all kernels,
+	// so the malloc_areas get their memory back at the same addresses
+	malloc_state_install(lp, (malloc_area *)data, record.num_areas);
+	data += record.num_areas * sizeof(malloc_area);
+
+	committed.log = log_alloc(record.log_size);
+	memcpy(committed.log, data, record.log_size);
+	data += record.log_size;
+	log_restore(lp, &committed);
+	log_delete(committed.log);
+
+	if (record.topology_size > 0) {
+		memcpy(lp->topology, data, record.topology_size);
+		data += record.topology_size;
+	}
+
+	// The bound event stands for the whole committed history of the LP
+	init->timestamp = nextafter(gvt, -INFINITY);
+	init->send_time = init->timestamp;
+	init->mark = generate_mark(lp);
+
+	for (i = 0; i < record.pending_events; i++) {
+		memcpy(&header, data, sizeof(msg_t));
+		data += sizeof(msg_t);
+		pack_msg(&msg, header.sender, header.receiver, header.type, header.timestamp, header.send_time, header.size, data);
+		msg->message_kind = header.message_kind;
+		msg->mark = header.mark;
+		msg->rendezvous_mark = header.rendezvous_mark;
+		data += header.size;
+		list_insert_tail(lp->queue_in, msg);
+	}
+
+	// The shipped state is the first one in the state queue
+	lp->state = LP_STATE_READY;
+	force_LP_checkpoint(lp);
+	LogState(lp);
+
+	// No real LP is running now!
+	current = NULL;
+
+	statistics_import_lp(lp, record.stats);
+	ccgs_lp_installed(lp);
+
+	return data;
+}
+
+/**
+* Ship the leaving LPs to their destination kernels, and rebuild the
+* arriving ones. Leaving LPs must have been rolled back to the GVT, and no
+* message must be in flight across kernels.
+*
+* @note This is a collective operation, which must be called by the master thread of all kernels.
+*
+* @param gvt The newly adopted GVT value
+*/
+static void exchange_lps(simtime_t gvt)
+{
+	int send_counts[n_ker], send_displs[n_ker], recv_counts[n_ker], recv_displs[n_ker];
+	struct lp_struct *leaving[n_prc];
+	unsigned char *incoming, *data;
+	unsigned int i, dest, n_leaving = 0;
+	size_t total = 0;
+
+	// Serialize the leaving LPs, grouped by destination kernel
+	outgoing.size = 0;
+	for (dest = 0; dest < n_ker; dest++) {
+		send_displs[dest] = outgoing.size;
+		foreach_lp(lp) {
+			if (dest != kid && new_kernel[lp->gid.to_int] == dest)
+				pack_lp(lp);
+		}
+		if (unlikely(outgoing.size > INT_MAX))
+			rootsim_error(true, "Too much data to migrate LPs in a single round\n");
+		send_counts[dest] = outgoing.size - send_displs[dest];
+	}
+
+	foreach_lp(lp) {
+		if (new_kernel[lp->gid.to_int] != kid)
+			leaving[n_leaving++] = lp;
+	}
+
+	for (i = 0; i < n_leaving; i++) {
+		ccgs_lp_removed(leaving[i]);
+		output_lp_fini(leaving[i], gvt);
+		remove_lp(leaving[i]);
+	}
+
+	lock_mpi();
+	MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, migration_comm);
+	unlock_mpi();
+
+	for (i = 0; i < n_ker; i++) {
+		recv_displs[i] = total;
+		total += recv_counts[i];
+	}
+	if (unlikely(total > INT_MAX))
+		rootsim_error(true, "Too much data to migrate LPs in a single round\n");
+
+	incoming = rsalloc(total + 1);
+
+	lock_mpi();
+	MPI_Alltoallv(outgoing.data, send_counts, send_displs, MPI_BYTE, incoming, recv_counts, recv_displs, MPI_BYTE, migration_comm);
+	unlock_mpi();
+
+	// From now on, messages are sent to the new kernels of the LPs
+	memcpy(kernel, new_kernel, sizeof(unsigned int) * n_prc_tot);
+
+	data = incoming;
+	while (data < incoming + total)
+		data = unpack_lp(data, gvt);
+	rsfree(incoming);
+
+	statistics_post_data(NULL, STAT_MIGRATION, n_leaving);
+
+	// Nobody sends messages to the arriving LPs before they are in place
+	lock_mpi();
+	MPI_Barrier(migration_comm);
+	unlock_mpi();
+}
+
+/**
+* Called by every worker thread upon the adoption of a new GVT value, after
+* fossil collection is run. If a migration round is due, LPs are moved
+* across kernels here.
+*
+* @param gvt The newly adopted GVT value
+*/
+void migration_on_gvt(simtime_t gvt)
+{
+	if (!migration_enabled() || stopped)
+		return;
+
+	// With the collective GVT reduction, all threads in all kernels adopt the same
+	// GVT values, so they all agree on when to migrate. The piggyback reduction
+	// is rejected at startup, as kernels there adopt rounds at different times.
+	gvt_rounds++;
+	if (gvt_rounds % rootsim_config.migrate_every != 0 || !D_DIFFER_ZERO(gvt))
+		return;
+
+	thread_barrier(&all_thread_barrier);
+
+	if (master_thread())
+		migrating = agree_on_migration() > 0;
+
+	thread_barrier(&all_thread_barrier);
+
+	if (!migrating)
+		return;
+
+	// Bring the leaving LPs back to the GVT, cancelling what they have sent after it
+	foreach_bound_lp(lp) {
+		if (new_kernel[lp->gid.to_int] != kid)
+			rollback_to_gvt(lp, gvt);
+	}
+	flush_remote_msgs();
+
+	thread_barrier(&all_thread_barrier);
+
+	// Nothing can be directed to a leaving LP after it has left
+	if (master_thread())
+		quiesce_remote_msgs(migration_comm);
+
+	thread_barrier(&all_thread_barrier);
+
+	process_bottom_halves();
+
+	thread_barrier(&all_thread_barrier);
+
+	if (master_thread())
+		exchange_lps(gvt);
+
+	thread_barrier(&all_thread_barrier);
+
+	reset_LPs_binding();
+
+	thread_barrier(&all_thread_barrier);
+}
+
+void migration_init(void)
+{
+	if (!migration_enabled())
+		return;
+
+	MPI_Comm_dup(MPI_COMM_WORLD, &migration_comm);
+
+	load_report = rsalloc(sizeof(double) * (n_prc_tot + n_ker + 1));
+	new_kernel = rsalloc(sizeof(unsigned int) * (n_prc_tot + 1));
+	last_work = rsalloc(sizeof(double) * n_prc_tot);
+	bzero(last_work, sizeof(double) * n_prc_tot);
+}
+
+void migration_fini(void)
+{
+	if (!migration_enabled())
+		return;
+
+	MPI_Comm_free(&migration_comm);
+
+	rsfree(load_report);
+	rsfree(new_kernel);
+	rsfree(last_work);
+	rsfree(outgoing.data);
+}
+
+#endif /* HAVE_MPI */
@@ -0,0 +1,45 @@
+/**
+ * @file scheduler/migration.h
+ *
+ * @brief Migration of LPs across simulation kernels
+ *
+ * LPs can be periodically moved from the most loaded kernels to the least
+ * loaded ones, at GVT boundaries.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include <core/core.h>
+
+/// This macro expands to true if LPs can migrate across kernels
+#ifdef HAVE_MPI
+#define migration_enabled() (rootsim_config.migrate_every > 0)
+#else
+#define migration_enabled() false
+#endif
+
+#ifdef HAVE_MPI
+extern void migration_init(void);
+extern void migration_fini(void);
+extern void migration_on_gvt(simtime_t gvt);
+#endif
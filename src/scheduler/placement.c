@@ -0,0 +1,489 @@
+/**
+ * @file scheduler/placement.c
+ *
+ * @brief Communication-aware placement of LPs
+ *
+ * During the first @c --comm-profile GVT reductions, the number of messages
+ * sent by each LP to each other LP is recorded in a sparse matrix. Each row
+ * belongs to a sender, and it is only touched by the worker thread the sender
+ * is bound to, so no synchronization is needed.
+ *
+ * Once the profiling is over, the master kernel builds the communication graph
+ * of the LPs, where vertices are weighted by the number of messages they have
+ * received, and partitions it so that few messages cross kernels and threads,
+ * while keeping the load balanced. LPs are then bound again to the worker
+ * threads of the kernel which currently hosts them, and the placement of LPs
+ * onto both kernels and threads is saved to a file, which later runs can load
+ * via @c --lp-mapping.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include <core/core.h>
+#include <core/init.h>
+#include <arch/thread.h>
+#include <datatypes/graph.h>
+#include <mm/mm.h>
+#include <mm/persist.h>
+#include <scheduler/binding.h>
+#include <scheduler/placement.h>
+#include <scheduler/process.h>
+#include <statistics/statistics.h>
+#ifdef HAVE_MPI
+#include <communication/mpi.h>
+#endif
+
+/// Initial number of slots in the row of a sender, must be a power of two
+#define PLACEMENT_ROW_SIZE	8
+
+/// A receiver in the row of a sender
+struct _comm_peer {
+	unsigned int peer;		///< The gid of the receiver plus one, 0 if the slot is empty
+	unsigned long long count;	///< Number of messages sent to the receiver
+};
+
+/// The receivers of a sender, kept in an open-addressing hash table
+struct _comm_row {
+	unsigned int used;
+	unsigned int capacity;
+	struct _comm_peer *peers;
+};
+
+/// Tells whether the messages exchanged by LPs are being recorded
+bool comm_profiling = false;
+
+/// The communication matrix, one row per sender gid
+static struct _comm_row *comm_rows;
+
+/// Number of GVT reductions adopted by the current worker thread while profiling
+static __thread unsigned int gvt_rounds;
+
+/// The worker thread each LP is bound to once the profiling is over, indexed by gid
+static unsigned int *new_thread;
+
+/// The worker thread of each LP read from the placement file, or NULL if it cannot be used
+static unsigned int *loaded_thread;
+
+#ifdef HAVE_MPI
+/// Communicator used by the collective operations of this module
+static MPI_Comm placement_comm;
+#endif
+
+
+static inline unsigned int peer_slot(unsigned int gid, unsigned int capacity)
+{
+	return (gid * 2654435761U) & (capacity - 1);
+}
+
+static void row_insert(struct _comm_row *row, unsigned int peer, unsigned long long count)
+{
+	unsigned int i = peer_slot(peer, row->capacity);
+
+	while (row->peers[i].peer != 0 && row->peers[i].peer != peer)
+		i = (i + 1) & (row->capacity - 1);
+
+	if (row->peers[i].peer == 0) {
+		row->peers[i].peer = peer;
+		row->used++;
+	}
+	row->peers[i].count += count;
+}
+
+static void row_grow(struct _comm_row *row)
+{
+	struct _comm_peer *old = row->peers;
+	unsigned int i, old_capacity = row->capacity;
+
+	row->capacity = old_capacity ? old_capacity << 1 : PLACEMENT_ROW_SIZE;
+	row->peers = rsalloc(sizeof(struct _comm_peer) * row->capacity);
+	bzero(row->peers, sizeof(struct _comm_peer) * row->capacity);
+	row->used = 0;
+
+	for (i = 0; i < old_capacity; i++) {
+		if (old[i].peer != 0)
+			row_insert(row, old[i].peer, old[i].count);
+	}
+	rsfree(old);
+}
+
+/**
+* Account for a message sent by an LP to another one. This is called by the
+* worker thread the sender is bound to.
+*
+* @param sender The gid of the sending LP
+* @param receiver The gid of the receiving LP
+*/
+void placement_record_msg(GID_t sender, GID_t receiver)
+{
+	struct _comm_row *row = &comm_rows[sender.to_int];
+
+	if (unlikely((row->used + 1) * 4 > row->capacity * 3))
+		row_grow(row);
+
+	row_insert(row, receiver.to_int + 1, 1);
+}
+
+/**
+* Serialize the communication matrix recorded by this kernel as
+* (sender, receiver, count) triples.
+*
+* @param n_triples Where to store the number of triples
+* @return A buffer keeping the triples, to be released with rsfree()
+*/
+static unsigned long long *pack_matrix(unsigned int *n_triples)
+{
+	unsigned long long *triples;
+	unsigned int gid, i, n = 0;
+
+	for (gid = 0; gid < n_prc_tot; gid++)
+		n += comm_rows[gid].used;
+
+	triples = rsalloc(sizeof(unsigned long long) * 3 * n + 1);
+	n = 0;
+	for (gid = 0; gid < n_prc_tot; gid++) {
+		for (i = 0; i < comm_rows[gid].capacity; i++) {
+			if (comm_rows[gid].peers[i].peer == 0)
+				continue;
+			triples[n++] = gid;
+			triples[n++] = comm_rows[gid].peers[i].peer - 1;
+			triples[n++] = comm_rows[gid].peers[i].count;
+		}
+		rsfree(comm_rows[gid].peers);
+		bzero(&comm_rows[gid], sizeof(struct _comm_row));
+	}
+
+	*n_triples = n / 3;
+	return triples;
+}
+
+/**
+* Split the LPs which a partition assigns to each kernel among its worker threads.
+*
+* @param g The communication graph
+* @param kernel_of The kernel of each LP
+* @param threads The number of worker threads of each kernel
+* @param thread_of Where to store the worker thread of each LP
+*/
+static void split_on_threads(const struct graph *g, const unsigned int *kernel_of, const unsigned int *threads, unsigned int *thread_of)
+{
+	unsigned int *map = rsalloc(sizeof(unsigned int) * g->n);
+	unsigned int *part = rsalloc(sizeof(unsigned int) * g->n);
+	struct graph *sub;
+	unsigned int k, i;
+
+	for (k = 0; k < n_ker; k++) {
+		sub = graph_subgraph(g, kernel_of, k, map);
+		if (sub->n > 0) {
+			graph_partition(sub, threads[k], NULL, part);
+			for (i = 0; i < sub->n; i++)
+				thread_of[map[i]] = part[i];
+		}
+		graph_free(sub);
+	}
+
+	rsfree(map);
+	rsfree(part);
+}
+
+/**
+* Save a placement of LPs to the output directory.
+*/
+static void save_placement(const struct graph *g, const unsigned int *kernel_of, const unsigned int *thread_of)
+{
+	char path[MAX_PATHLEN];
+	unsigned long long across_kernels, across_threads, total = 0;
+	unsigned int *slot, gid, i;
+	FILE *f;
+
+	// Tell apart the threads of different kernels
+	slot = rsalloc(sizeof(unsigned int) * n_prc_tot);
+	for (gid = 0; gid < n_prc_tot; gid++) {
+		slot[gid] = kernel_of[gid] * MAX_THREADS_PER_KERNEL + thread_of[gid];
+		for (i = g->xadj[gid]; i < g->xadj[gid + 1]; i++)
+			total += g->adjwgt[i];
+	}
+	total /= 2;
+	across_kernels = graph_edge_cut(g, kernel_of);
+	across_threads = graph_edge_cut(g, slot);
+	rsfree(slot);
+
+	snprintf(path, sizeof(path), "%s/%s", rootsim_config.output_dir, PLACEMENT_FILE);
+	if ((f = fopen(path, "w")) == NULL) {
+		rootsim_error(false, "Cannot open %s, the placement of LPs is not saved\n", path);
+		return;
+	}
+
+	fprintf(f, "# Placement of LPs computed from %u GVT reductions of communication profiling\n", rootsim_config.comm_profile);
+	fprintf(f, "# Messages between LPs: %llu, across kernels: %llu, across threads: %llu\n", total, across_kernels, across_threads);
+	fprintf(f, "# LPs kernels, then one line per LP: gid kernel thread\n");
+	fprintf(f, "%u %u\n", n_prc_tot, n_ker);
+	for (gid = 0; gid < n_prc_tot; gid++)
+		fprintf(f, "%u %u %u\n", gid, kernel_of[gid], thread_of[gid]);
+
+	fclose(f);
+}
+
+/**
+* Compute the new placement of LPs from the communication matrices of all the
+* kernels. The placement of LPs onto kernels is only saved for later runs, while
+* the LPs currently hosted by each kernel are bound again to its worker threads.
+*
+* @note This is a collective operation, which must be called by the master thread of all kernels.
+*/
+static void compute_placement(void)
+{
+	unsigned long long *triples, *all_triples = NULL, *vwgt;
+	unsigned int *src, *dst, *kernel_of, *thread_of;
+	unsigned long long *weight;
+	unsigned int threads[n_ker], n_triples, n_all = 0, gid, i;
+	double targets[n_ker];
+	struct graph *g;
+#ifdef HAVE_MPI
+	int info[2], all_info[2 * n_ker], counts[n_ker], displs[n_ker];
+#endif
+
+	triples = pack_matrix(&n_triples);
+
+#ifdef HAVE_MPI
+	if (rootsim_config.transport == TRANSPORT_MPI) {
+		info[0] = n_triples * 3;
+		info[1] = n_cores;
+
+		lock_mpi();
+		MPI_Gather(info, 2, MPI_INT, all_info, 2, MPI_INT, 0, placement_comm);
+		unlock_mpi();
+
+		if (master_kernel()) {
+			for (i = 0; i < n_ker; i++) {
+				counts[i] = all_info[2 * i];
+				displs[i] = n_all;
+				n_all += counts[i];
+				threads[i] = all_info[2 * i + 1];
+			}
+			n_all /= 3;
+			all_triples = rsalloc(sizeof(unsigned long long) * 3 * n_all + 1);
+		}
+
+		lock_mpi();
+		MPI_Gatherv(triples, info[0], MPI_UNSIGNED_LONG_LONG, all_triples, counts, displs, MPI_UNSIGNED_LONG_LONG, 0, placement_comm);
+		unlock_mpi();
+
+		rsfree(triples);
+	} else
+#endif
+	{
+		threads[0] = n_cores;
+		all_triples = triples;
+		n_all = n_triples;
+	}
+
+	if (master_kernel()) {
+		src = rsalloc(sizeof(unsigned int) * n_all + 1);
+		dst = rsalloc(sizeof(unsigned int) * n_all + 1);
+		weight = rsalloc(sizeof(unsigned long long) * n_all + 1);
+		vwgt = rsalloc(sizeof(unsigned long long) * n_prc_tot);
+		kernel_of = rsalloc(sizeof(unsigned int) * n_prc_tot);
+		thread_of = rsalloc(sizeof(unsigned int) * n_prc_tot);
+
+		// Each received message is an event to process
+		for (gid = 0; gid < n_prc_tot; gid++)
+			vwgt[gid] = 1;
+		for (i = 0; i < n_all; i++) {
+			src[i] = all_triples[3 * i];
+			dst[i] = all_triples[3 * i + 1];
+			weight[i] = all_triples[3 * i + 2];
+			vwgt[dst[i]] += weight[i];
+		}
+		for (i = 0; i < n_ker; i++)
+			targets[i] = threads[i];
+
+		g = graph_build(n_prc_tot, n_all, src, dst, weight, vwgt);
+
+		graph_partition(g, n_ker, targets, kernel_of);
+		split_on_threads(g, kernel_of, threads, thread_of);
+		save_placement(g, kernel_of, thread_of);
+
+		// LPs do not move across kernels in this run
+		split_on_threads(g, kernel, threads, new_thread);
+
+		graph_free(g);
+		rsfree(src);
+		rsfree(dst);
+		rsfree(weight);
+		rsfree(vwgt);
+		rsfree(kernel_of);
+		rsfree(thread_of);
+		rsfree(all_triples);
+	}
+
+#ifdef HAVE_MPI
+	if (rootsim_config.transport == TRANSPORT_MPI) {
+		lock_mpi();
+		MPI_Bcast(new_thread, n_prc_tot, MPI_UNSIGNED, 0, placement_comm);
+		unlock_mpi();
+	}
+#endif
+}
+
+/**
+* Called by every worker thread upon the adoption of a new GVT value. Once
+* the profiling of the communication is over, the LPs are placed on the
+* worker threads according to it.
+*/
+void placement_on_gvt(void)
+{
+	// Every worker thread of a kernel counts the same GVT rounds. Across kernels,
+	// only the collective GVT reduction makes the rounds line up: this is why the
+	// piggyback reduction is rejected at startup when there are more kernels.
+	if (gvt_rounds >= rootsim_config.comm_profile)
+		return;
+	if (++gvt_rounds < rootsim_config.comm_profile)
+		return;
+
+	thread_barrier(&all_thread_barrier);
+
+	if (master_thread()) {
+		comm_profiling = false;
+		compute_placement();
+	}
+
+	thread_barrier(&all_thread_barrier);
+
+	place_LPs_binding(new_thread);
+
+	thread_barrier(&all_thread_barrier);
+
+	// LPs coming from other threads could still have to be saved to disk
+	persist_catch_up();
+}
+
+/**
+* Read the placement of LPs from the file given via @c --lp-mapping.
+* The worker thread of each LP is retained only if every local
+* worker thread gets some LP.
+*
+* @param kernel_of Where to store the kernel of each LP
+*/
+void placement_load(unsigned int *kernel_of)
+{
+	char line[256];
+	unsigned int n_lps = 0, kernels = 0, gid, k, t, assigned = 0, bound[n_cores];
+	bool header = false, hosted[n_ker];
+	FILE *f;
+
+	if ((f = fopen(rootsim_config.lp_mapping, "r")) == NULL)
+		rootsim_error(true, "Unable to open the LP mapping file %s\n", rootsim_config.lp_mapping);
+
+	loaded_thread = rsalloc(sizeof(unsigned int) * n_prc_tot);
+	memset(kernel_of, 0xff, sizeof(unsigned int) * n_prc_tot);
+	bzero(bound, sizeof(bound));
+	bzero(hosted, sizeof(hosted));
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+
+		if (!header) {
+			if (sscanf(line, "%u %u", &n_lps, &kernels) != 2)
+				rootsim_error(true, "Malformed header in the LP mapping file %s\n", rootsim_config.lp_mapping);
+			if (n_lps != n_prc_tot || kernels != n_ker)
+				rootsim_error(true, "The LP mapping file %s is for %u LPs on %u kernels, while this run has %u LPs on %u kernels\n", rootsim_config.lp_mapping, n_lps, kernels, n_prc_tot, n_ker);
+			header = true;
+			continue;
+		}
+
+		if (sscanf(line, "%u %u %u", &gid, &k, &t) != 3 || gid >= n_prc_tot || k >= n_ker)
+			rootsim_error(true, "Malformed line in the LP mapping file %s: %s", rootsim_config.lp_mapping, line);
+		if (kernel_of[gid] != UINT_MAX)
+			rootsim_error(true, "LP %u is mapped twice in the LP mapping file %s\n", gid, rootsim_config.lp_mapping);
+
+		kernel_of[gid] = k;
+		hosted[k] = true;
+		loaded_thread[gid] = t % n_cores;
+		if (k == kid)
+			bound[loaded_thread[gid]]++;
+		assigned++;
+	}
+	fclose(f);
+
+	if (assigned != n_prc_tot)
+		rootsim_error(true, "The LP mapping file %s maps %u LPs out of %u\n", rootsim_config.lp_mapping, assigned, n_prc_tot);
+
+	for (k = 0; k < n_ker; k++) {
+		if (!hosted[k])
+			rootsim_error(true, "The LP mapping file %s leaves kernel %u without LPs\n", rootsim_config.lp_mapping, k);
+	}
+
+	for (t = 0; t < n_cores; t++) {
+		if (bound[t] == 0) {
+			rootsim_error(false, "The LP mapping file %s leaves some worker thread without LPs, binding LPs to threads by blocks\n", rootsim_config.lp_mapping);
+			rsfree(loaded_thread);
+			loaded_thread = NULL;
+			break;
+		}
+	}
+}
+
+/**
+* @return The worker thread of each LP read from the placement file, indexed by gid, or NULL if there is none
+*/
+const unsigned int *placement_threads(void)
+{
+	return loaded_thread;
+}
+
+void placement_init(void)
+{
+	if (rootsim_config.comm_profile == 0)
+		return;
+
+#ifdef HAVE_MPI
+	if (rootsim_config.transport == TRANSPORT_MPI)
+		MPI_Comm_dup(MPI_COMM_WORLD, &placement_comm);
+#endif
+
+	comm_rows = rsalloc(sizeof(struct _comm_row) * n_prc_tot);
+	bzero(comm_rows, sizeof(struct _comm_row) * n_prc_tot);
+	new_thread = rsalloc(sizeof(unsigned int) * n_prc_tot);
+	comm_profiling = true;
+}
+
+void placement_fini(void)
+{
+	unsigned int gid;
+
+	rsfree(loaded_thread);
+
+	if (rootsim_config.comm_profile == 0)
+		return;
+
+#ifdef HAVE_MPI
+	if (rootsim_config.transport == TRANSPORT_MPI)
+		MPI_Comm_free(&placement_comm);
+#endif
+
+	for (gid = 0; gid < n_prc_tot; gid++)
+		rsfree(comm_rows[gid].peers);
+	rsfree(comm_rows);
+	rsfree(new_thread);
+}
@@ -0,0 +1,50 @@
+/**
+ * @file scheduler/placement.h
+ *
+ * @brief Communication-aware placement of LPs
+ *
+ * The messages exchanged by LPs can be profiled for a while, to place LPs
+ * which talk much to each other on the same worker thread and kernel.
+ *
+ * @copyright
+ * Copyright (C) 2008-2019 HPDCS Group
+ * https://hpdcs.github.io
+ *
+ * This file is part of ROOT-Sim (ROme OpTimistic Simulator).
+ *
+ * ROOT-Sim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; only version 3 of the License applies.
+ *
+ * ROOT-Sim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ROOT-Sim; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include <core/core.h>
+
+/// Name of the file, in the output directory, where the computed placement of LPs is saved
+#define PLACEMENT_FILE	"lp_mapping"
+
+extern bool comm_profiling;
+
+extern void placement_init(void);
+extern void placement_fini(void);
+extern void placement_load(unsigned int *kernel_of);
+extern const unsigned int *placement_threads(void);
+extern void placement_record_msg(GID_t sender, GID_t receiver);
+extern void placement_on_gvt(void);
+
+/// Account for a message sent to an LP, if the communication among LPs is being profiled
+#define placement_on_send(msg) do { \
+		if (unlikely(comm_profiling)) \
+			placement_record_msg((msg)->sender, (msg)->receiver); \
+	} while (0)
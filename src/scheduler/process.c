@@ -29,7 +29,10 @@
  * @date December 14, 2017
  */
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <limits.h>
+#include <sys/mman.h>
 
 #include <core/core.h>
 #include <core/init.h>
@@ -43,26 +46,249 @@ __thread unsigned int __lp_bound_counter = 0;
 /// Maintain LPs' simulation and execution states
 struct lp_struct **lps_blocks = NULL;
 
+/// The control block of each LP, indexed by gid, or NULL if the LP is not locally hosted
+struct lp_struct **lps_by_gid = NULL;
+
 /** Each KLT has a binding towards some LPs. This is the structure used
  *  to keep track of LPs currently being handled
  */
 __thread struct lp_struct **lps_bound_blocks = NULL;
 
+/// The size of the stack which LPs process events on
+size_t lp_stack_size = LP_STACK_SIZE;
+
+/// Set if the LPs bound to a worker thread all process events on one stack
+bool shared_stacks = false;
+
+/// Copies of the fields of the LPs bound to this worker thread which are scanned most often
+__thread struct lps_hot_data lps_bound_hot;
+
 void initialize_binding_blocks(void)
 {
 	lps_bound_blocks =
-	    (struct lp_struct **)rsalloc(n_prc * sizeof(struct lp_struct *));
-	bzero(lps_bound_blocks, sizeof(struct lp_struct *) * n_prc);
+	    (struct lp_struct **)rsalloc(max_local_lps() * sizeof(struct lp_struct *));
+	bzero(lps_bound_blocks, sizeof(struct lp_struct *) * max_local_lps());
+
+	lps_bound_hot.next_ts = rsalloc(max_local_lps() * sizeof(simtime_t));
+	lps_bound_hot.lvt = rsalloc(max_local_lps() * sizeof(simtime_t));
+	lps_bound_hot.state = rsalloc(max_local_lps() * sizeof(short unsigned int));
+	lps_bound_hot.bottom_halves = rsalloc(max_local_lps() * sizeof(msg_channel *));
+	lps_bound_hot.antimsg_bottom_halves = rsalloc(max_local_lps() * sizeof(msg_channel *));
+}
+
+void finalize_binding_blocks(void)
+{
+	rsfree(lps_bound_blocks);
+	rsfree(lps_bound_hot.next_ts);
+	rsfree(lps_bound_hot.lvt);
+	rsfree(lps_bound_hot.state);
+	rsfree(lps_bound_hot.bottom_halves);
+	rsfree(lps_bound_hot.antimsg_bottom_halves);
+}
+
+/**
+* Update the copies in @ref lps_bound_hot of the fields of an LP bound to
+* the current worker thread. This must be called whenever its state, its
+* bound or its input queue may have changed: the scheduler and the GVT
+* reduction only look at the copies.
+*
+* @param lp A pointer to the lp_struct of the LP
+*/
+void refresh_bound_lp(struct lp_struct *lp)
+{
+	unsigned int i = lp->bound_index;
+
+	lps_bound_hot.state[i] = lp->state;
+
+	// The bound is NULL before the INIT event is processed, or if the LP has gone back
+	if (unlikely(lp->bound == NULL)) {
+		lps_bound_hot.lvt[i] = -1.0;
+		lps_bound_hot.next_ts[i] = list_empty(lp->queue_in) ? INFTY : list_head(lp->queue_in)->timestamp;
+	} else {
+		lps_bound_hot.lvt[i] = lp->bound->timestamp;
+		lps_bound_hot.next_ts[i] = list_next(lp->bound) != NULL ? list_next(lp->bound)->timestamp : INFTY;
+	}
+}
+
+/**
+* Update the copies in @ref lps_bound_hot of the fields of all the LPs bound
+* to the current worker thread, e.g. after they have been bound or after
+* another thread has changed them.
+*/
+void refresh_bound_lps(void)
+{
+	foreach_bound_lp(lp) {
+		refresh_bound_lp(lp);
+	}
+}
+
+/**
+* Tell how many LP stacks can get a guard page. Each guard page splits the
+* mapping of a segment, costing two more memory mappings: they are allowed to
+* take at most half of the mappings the system grants to the process, so that
+* the allocators are left enough of them.
+*
+* @return The number of stacks which can be guarded
+*/
+static unsigned long guarded_stacks_limit(void)
+{
+	unsigned long max_map_count = 65530;	// The default of Linux
+	FILE *f;
+
+	f = fopen("/proc/sys/vm/max_map_count", "r");
+	if (f != NULL) {
+		if (fscanf(f, "%lu", &max_map_count) != 1)
+			max_map_count = 65530;
+		fclose(f);
+	}
+
+	return max_map_count / 4;
+}
+
+/**
+* Allocate the stack of an LP. The stack lives in the LP segment, so only the
+* pages it touches are committed. Its lowest page is turned into a guard page,
+* so that an overflow faults instead of corrupting the LP memory. If there are
+* too many LPs, the stacks beyond guarded_stacks_limit() are left unguarded.
+*
+* @param lp A pointer to the lp_struct of the LP
+* @return A pointer to the lowest usable address of the stack
+*/
+static void *allocate_lp_stack(struct lp_struct *lp)
+{
+	static unsigned long guards_left = ULONG_MAX;
+	unsigned char *stack;
+
+	stack = allocate_lp_memory(lp, lp_stack_size);
+	if (unlikely(stack == NULL))
+		rootsim_error(true, "Error allocating LP stack: not enough memory.\n");
+
+	if (unlikely(guards_left == ULONG_MAX))
+		guards_left = guarded_stacks_limit();
+
+	if (guards_left == 0)
+		return stack + PAGE_SIZE;
+
+	if (--guards_left == 0 || mprotect(stack, PAGE_SIZE, PROT_NONE) != 0) {
+		guards_left = 0;
+		rootsim_error(false, "Unable to set up a guard page for the stack of LP %u: "
+			      "stacks of further LPs are not guarded\n", lp->gid.to_int);
+	}
+
+	return stack + PAGE_SIZE;
+}
+
+/**
+* Create and set up the control block of a locally-hosted LP
+*
+* @param gid The global id of the LP
+* @param lid The local id to assign to the LP
+* @return A pointer to the new lp_struct
+*/
+static struct lp_struct *create_lp(GID_t gid, unsigned int lid)
+{
+	struct lp_struct *lp;
+	unsigned int j;
+
+	// Initialize the control block for the current lp
+	// The fields accessed at each event fill the first cache line of the control block
+	if (posix_memalign((void **)&lp, CACHE_LINE_SIZE, sizeof(struct lp_struct)) != 0)
+		rootsim_error(true, "Unable to allocate the control block of LP %u\n", gid.to_int);
+	bzero(lp, sizeof(struct lp_struct));
+
+	lp->lid.to_int = lid;
+	lp->gid = gid;
+
+	// Initialize memory map (the LP segment is placed according to the gid)
+	initialize_memory_map(lp);
+
+	// Allocate memory for the outgoing buffer
+	lp->outgoing_buffer.max_size = INIT_OUTGOING_MSG;
+	lp->outgoing_buffer.outgoing_msgs =
+	    rsalloc(sizeof(msg_t *) * INIT_OUTGOING_MSG);
+
+	// Initialize bottom halves msg channel
+	lp->bottom_halves = init_channel();
+	lp->antimsg_bottom_halves = init_channel();
+
+	// Which version of OnGVT and ProcessEvent should we use?
+	if (rootsim_config.snapshot == SNAPSHOT_FULL) {
+		lp->OnGVT = &OnGVT_light;
+		lp->ProcessEvent = &ProcessEvent_light;
+	}		// TODO: add here an else for ISS
+
+	// Allocate LP stack, unless the LPs of a worker thread share one
+	if (!shared_stacks)
+		lp->stack = allocate_lp_stack(lp);
+
+	// Set the initial checkpointing period for this LP.
+	// If the checkpointing period is fixed, this will not change during the
+	// execution. Otherwise, new calls to this function will (locally) update
+	// this.
+	set_checkpoint_period(lp, rootsim_config.ckpt_period);
+
+	// Initially, every LP is ready
+	lp->state = LP_STATE_READY;
+
+	// There is no current state layout at the beginning
+	lp->current_base_pointer = NULL;
+
+	// Initialize the queues
+	lp->queue_in = new_list(msg_t);
+	ring_init(lp->queue_out);
+	lp->queue_states = new_list(state_t);
+	lp->rendezvous_queue = new_list(msg_t);
+
+	// No event has been processed so far
+	lp->bound = NULL;
+
+	// We have no information about messages still to be delivered to this LP
+	lp->outgoing_buffer.min_in_transit = rsalloc(sizeof(simtime_t) * n_cores);
+	for (j = 0; j < n_cores; j++) {
+		lp->outgoing_buffer.min_in_transit[j] = INFTY;
+	}
+
+#ifdef HAVE_CROSS_STATE
+	// No read/write dependencies open so far for the LP. The current lp is always opened
+	lp->ECS_index = 0;
+	lp->ECS_synch_table[0] = LidToGid(lp);	// LidToGid for distributed ECS
+#endif
+
+	// Create User-Level Thread. On a shared stack, it is created at each activation
+	if (!shared_stacks)
+		context_create(&lp->context, LP_main_loop, NULL, lp->stack,
+			       lp_stack_size - PAGE_SIZE);
+
+	return lp;
 }
 
 void initialize_lps(void)
 {
-	unsigned int i, j;
+	unsigned int i;
 	unsigned int lid = 0;
-	struct lp_struct *lp;
 	unsigned int local = 0;
 	GID_t gid;
 
+	// Set up the stacks as requested by the model
+	if (&stack_settings) {
+		if (stack_settings.stack_size != 0)
+			lp_stack_size = stack_settings.stack_size;
+		if (lp_stack_size < MIN_LP_STACK_SIZE) {
+			rootsim_error(false, "LP stacks cannot be smaller than %d bytes\n", MIN_LP_STACK_SIZE);
+			lp_stack_size = MIN_LP_STACK_SIZE;
+		}
+		lp_stack_size = (lp_stack_size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+		shared_stacks = stack_settings.shared;
+#if defined(HAVE_CROSS_STATE) || defined(HAVE_PREEMPTION)
+		// LPs can be suspended in the middle of an event, and must keep their stack
+		if (shared_stacks) {
+			rootsim_error(false, "LP stacks cannot be shared if LPs can be suspended in the middle of an event\n");
+			shared_stacks = false;
+		}
+#endif
+	}
+
 	// First of all, determine what LPs should be locally hosted.
 	// Only for them, we are creating struct lp_structs here.
 	distribute_lps_on_kernels();
@@ -70,7 +296,10 @@ void initialize_lps(void)
 	// We now know how many LPs should be locally hosted. Prepare
 	// the place for their control blocks.
 	lps_blocks =
-	    (struct lp_struct **)rsalloc(n_prc * sizeof(struct lp_struct *));
+	    (struct lp_struct **)rsalloc(max_local_lps() * sizeof(struct lp_struct *));
+	lps_by_gid =
+	    (struct lp_struct **)rsalloc(n_prc_tot * sizeof(struct lp_struct *));
+	bzero(lps_by_gid, n_prc_tot * sizeof(struct lp_struct *));
 
 	// We now iterate over all LP Gids. Everytime that we find an LP
 	// which should be locally hosted, we create the local lp_struct
@@ -80,85 +309,99 @@ void initialize_lps(void)
 		if (find_kernel_by_gid(gid) != kid)
 			continue;
 
-		// Initialize the control block for the current lp
-		lp = (struct lp_struct *)rsalloc(sizeof(struct lp_struct));
-		bzero(lp, sizeof(struct lp_struct));
-		lps_blocks[local++] = lp;
-
-		if (local > n_prc) {
-			printf("reached local %d\n", local);
+		if (local >= n_prc) {
+			printf("reached local %d\n", local + 1);
 			fflush(stdout);
 			abort();
 		}
-		// Initialize memory map
-		initialize_memory_map(lp);
 
-		// Allocate memory for the outgoing buffer
-		lp->outgoing_buffer.max_size = INIT_OUTGOING_MSG;
-		lp->outgoing_buffer.outgoing_msgs =
-		    rsalloc(sizeof(msg_t *) * INIT_OUTGOING_MSG);
+		// We sequentially assign lids, and use the current gid
+		lps_blocks[local] = create_lp(gid, lid++);
+		lps_by_gid[i] = lps_blocks[local++];
+	}
+}
 
-		// Initialize bottom halves msg channel
-		lp->bottom_halves = init_channel();
+#ifdef HAVE_MPI
 
-		// We sequentially assign lids, and use the current gid
-		lp->lid.to_int = lid++;
-		lp->gid = gid;
-
-		// Which version of OnGVT and ProcessEvent should we use?
-		if (rootsim_config.snapshot == SNAPSHOT_FULL) {
-			lp->OnGVT = &OnGVT_light;
-			lp->ProcessEvent = &ProcessEvent_light;
-		}		// TODO: add here an else for ISS
-
-		// Allocate LP stack
-		lp->stack = get_ult_stack(LP_STACK_SIZE);
-
-		// Set the initial checkpointing period for this LP.
-		// If the checkpointing period is fixed, this will not change during the
-		// execution. Otherwise, new calls to this function will (locally) update
-		// this.
-		set_checkpoint_period(lp, rootsim_config.ckpt_period);
-
-		// Initially, every LP is ready
-		lp->state = LP_STATE_READY;
-
-		// There is no current state layout at the beginning
-		lp->current_base_pointer = NULL;
-
-		// Initialize the queues
-		lp->queue_in = new_list(msg_t);
-		lp->queue_out = new_list(msg_hdr_t);
-		lp->queue_states = new_list(state_t);
-		lp->rendezvous_queue = new_list(msg_t);
-
-		// No event has been processed so far
-		lp->bound = NULL;
-
-		// We have no information about messages still to be delivered to this LP
-		lp->outgoing_buffer.min_in_transit = rsalloc(sizeof(simtime_t) * n_cores);
-		for (j = 0; j < n_cores; j++) {
-			lp->outgoing_buffer.min_in_transit[j] = INFTY;
+/**
+* Create the control block of an LP which is migrating to this kernel. The
+* LP takes the lowest local id which is not in use, so that local ids are
+* always smaller than max_local_lps(). The caller is in charge of updating
+* the mapping of the LP onto kernels.
+*
+* @param gid The global id of the LP
+* @return A pointer to the new lp_struct
+*/
+struct lp_struct *install_lp(GID_t gid)
+{
+	unsigned int lid;
+	bool used;
+
+	for (lid = 0;; lid++) {
+		used = false;
+		foreach_lp(lp) {
+			if (lp->lid.to_int == lid) {
+				used = true;
+				break;
+			}
 		}
+		if (!used)
+			break;
+	}
 
-#ifdef HAVE_CROSS_STATE
-		// No read/write dependencies open so far for the LP. The current lp is always opened
-		lp->ECS_index = 0;
-		lp->ECS_synch_table[0] = LidToGid(lp);	// LidToGid for distributed ECS
-#endif
+	lps_blocks[n_prc] = create_lp(gid, lid);
+	lps_by_gid[gid.to_int] = lps_blocks[n_prc];
+	return lps_blocks[n_prc++];
+}
 
-		// Create User-Level Thread
-		context_create(&lp->context, LP_main_loop, NULL, lp->stack,
-			       LP_STACK_SIZE);
+/**
+* Release the control block of an LP which is migrating away from this
+* kernel, together with all its messages and states. The LP must not be
+* bound to any worker thread anymore.
+*
+* @param lp A pointer to the lp_struct of the LP to remove
+*/
+void remove_lp(struct lp_struct *lp)
+{
+	unsigned int i;
+	msg_t *msg;
+	state_t *state;
+
+	while ((msg = list_head(lp->queue_in)) != NULL) {
+		list_delete_by_content(lp->queue_in, msg);
+		msg_release(msg);
 	}
+
+	while ((state = list_head(lp->queue_states)) != NULL) {
+		list_delete_by_content(lp->queue_states, state);
+		discard_state(state);
+		rsfree(state);
+	}
+
+	rsfree(lp->queue_in);
+	ring_fini(lp->queue_out);
+	rsfree(lp->queue_states);
+	rsfree(lp->rendezvous_queue);
+	fini_channel(lp->bottom_halves);
+	fini_channel(lp->antimsg_bottom_halves);
+	rsfree(lp->outgoing_buffer.outgoing_msgs);
+	rsfree(lp->outgoing_buffer.min_in_transit);
+	rsfree(lp->topology);
+	finalize_memory_map(lp);
+
+	// Keep the array of control blocks dense, as foreach_lp() expects
+	for (i = 0; lps_blocks[i] != lp; i++);
+	memmove(&lps_blocks[i], &lps_blocks[i + 1], (n_prc - i - 1) * sizeof(struct lp_struct *));
+	lps_blocks[--n_prc] = NULL;
+	lps_by_gid[lp->gid.to_int] = NULL;
+
+	rsfree(lp);
 }
 
+#endif
+
 // This works only for locally-hosted LPs!
 struct lp_struct *find_lp_by_gid(GID_t gid)
 {
-	foreach_lp(lp) {
-		if (lp->gid.to_int == gid.to_int)
-			return lp;
-	}
-	return NULL;
+	return lps_by_gid[gid.to_int];
 }
@@ -38,15 +38,19 @@
 #include <mm/mm.h>
 #include <mm/ecs.h>
 #include <datatypes/list.h>
+#include <datatypes/ring.h>
 #include <datatypes/msgchannel.h>
 #include <arch/ult.h>
+#include <arch/numa.h>
 #include <lib/numerical.h>
 #include <lib/abm_layer.h>
 #include <lib/topology.h>
 #include <communication/communication.h>
 #include <arch/x86/linux/cross_state_manager/cross_state_manager.h>
+#include <scheduler/migration.h>
 
 #define LP_STACK_SIZE	4194304	// 4 MB
+#define MIN_LP_STACK_SIZE	65536	// 64 KB
 
 #define LP_STATE_READY			0x00001
 #define LP_STATE_RUNNING		0x00002
@@ -63,14 +67,23 @@
 #define is_blocked_state(state)	(bool)(state & BLOCKED_STATE)
 
 struct lp_struct {
-	/// LP execution state.
-	LP_context_t context;
+	/*
+	 * The fields accessed at each event come first, so that they share
+	 * one cache line. Scans over all the LPs bound to a worker thread
+	 * read the copies in @ref lps_bound_hot instead.
+	 */
 
-	/// LP execution state when blocked during the execution of an event
-	LP_context_t default_context;
+	/// Pointer to the last correctly processed event
+	msg_t *bound __attribute__((aligned(CACHE_LINE_SIZE)));
 
-	/// Process' stack
-	void *stack;
+	/// Input messages queue
+	 list(msg_t) queue_in;
+
+	/// Bottom halves
+	msg_channel *bottom_halves;
+
+	/// Bottom halves for antimessages, processed after the positive ones
+	msg_channel *antimsg_bottom_halves;
 
 	/// Memory map of the LP
 	struct memory_map *mm;
@@ -84,45 +97,27 @@ struct lp_struct {
 	/// ID of the worker thread towards which the LP is bound
 	unsigned int worker_thread;
 
+	/// Position of the LP in @ref lps_bound_blocks of its worker thread
+	unsigned int bound_index;
+
 	/// Current execution state of the LP
 	short unsigned int state;
 
+	/// If this variable is set, the next invocation to LogState() takes a new state log, independently of the checkpointing interval
+	bool state_log_forced;
+
 	/// This variable mainains the current checkpointing interval for the LP
 	unsigned int ckpt_period;
 
 	/// Counts how many events executed from the last checkpoint (to support PSS)
 	unsigned int from_last_ckpt;
 
-	/// If this variable is set, the next invocation to LogState() takes a new state log, independently of the checkpointing interval
-	bool state_log_forced;
-
 	/// The current state base pointer (updated by SetState())
 	void *current_base_pointer;
 
-	/// Input messages queue
-	 list(msg_t) queue_in;
-
-	/// Pointer to the last correctly processed event
-	msg_t *bound;
-
-	/// Output messages queue
-	 list(msg_hdr_t) queue_out;
-
-	/// Saved states queue
-	 list(state_t) queue_states;
-
-	/// Bottom halves
-	msg_channel *bottom_halves;
-
-	/// Processed rendezvous queue
-	 list(msg_t) rendezvous_queue;
-
 	/// Unique identifier within the LP
 	unsigned long long mark;
 
-	/// Buffer used by KLTs for buffering outgoing messages during the execution of an event
-	outgoing_t outgoing_buffer;
-
 	/**
 	 * Implementation of OnGVT used for this LP. This can be changed
 	 * at runtime by the autonomic subsystem, when dealing with ISS and SSS
@@ -137,6 +132,30 @@ struct lp_struct {
 			     void *event_content, unsigned int size,
 			     void *state);
 
+	/// Output messages queue, ordered by send time
+	rootsim_ring(msg_hdr_t) queue_out;
+
+	/// Saved states queue
+	 list(state_t) queue_states;
+
+	/// Output produced via CommitPrintf()/CommitWrite(), not yet committed
+	 list(struct output_record) queue_output;
+
+	/// Processed rendezvous queue
+	 list(msg_t) rendezvous_queue;
+
+	/// Buffer used by KLTs for buffering outgoing messages during the execution of an event
+	outgoing_t outgoing_buffer;
+
+	/// LP execution state.
+	LP_context_t context;
+
+	/// LP execution state when blocked during the execution of an event
+	LP_context_t default_context;
+
+	/// Process' stack
+	void *stack;
+
 #ifdef HAVE_CROSS_STATE
 	GID_t ECS_synch_table[MAX_CROSS_STATE_DEPENDENCIES];
 	unsigned int ECS_index;
@@ -156,10 +175,35 @@ struct lp_struct {
 	
 };
 
+/**
+ * Number of entries of the arrays indexed by the local id of LPs. If LPs
+ * can migrate across kernels, any LP could end up being hosted here.
+ */
+#define max_local_lps() (migration_enabled() ? n_prc_tot : n_prc)
+
 // LPs process control blocks and binding control blocks
 extern struct lp_struct **lps_blocks;
+extern struct lp_struct **lps_by_gid;
 extern __thread struct lp_struct **lps_bound_blocks;
 
+/**
+ * Copies of the fields of the LPs bound to a worker thread which are read
+ * when the thread goes through all of them: to pick the next LP to schedule,
+ * to reduce the GVT and to drain the bottom halves. They are kept in
+ * struct-of-arrays form, indexed like @ref lps_bound_blocks, so that these
+ * scans read a few contiguous cache lines instead of the control block and
+ * the input queue of each LP.
+ */
+struct lps_hot_data {
+	simtime_t *next_ts;			///< Timestamp of the next event to process, INFTY if none
+	simtime_t *lvt;				///< Timestamp of the bound, negative if no event has been processed
+	short unsigned int *state;		///< Execution state
+	msg_channel **bottom_halves;		///< Bottom halves
+	msg_channel **antimsg_bottom_halves;	///< Bottom halves for antimessages
+};
+
+extern __thread struct lps_hot_data lps_bound_hot;
+
 /** This macro retrieves the LVT for the current LP. There is a small interval window
  *  where the value returned is the one of the next event to be processed. In particular,
  *  this happens in the scheduling function, when the bound is advanced to the next event to
@@ -177,8 +221,24 @@ extern __thread unsigned int __lp_bound_counter;
 #define foreach_bound_lp(lp)	__lp_bound_counter = 0;\
 				for(struct lp_struct *(lp) = lps_bound_blocks[__lp_bound_counter]; __lp_bound_counter < n_prc_per_thread && ((lp) = lps_bound_blocks[__lp_bound_counter]); ++__lp_bound_counter)
 
-#define LPS_bound_set(entry, lp)	lps_bound_blocks[(entry)] = (lp);
+#define LPS_bound_set(entry, lp)	({ \
+					unsigned int __entry = (entry); \
+					lps_bound_blocks[__entry] = (lp); \
+					(lp)->bound_index = __entry; \
+					lps_bound_hot.bottom_halves[__entry] = (lp)->bottom_halves; \
+					lps_bound_hot.antimsg_bottom_halves[__entry] = (lp)->antimsg_bottom_halves; \
+				})
+
+extern size_t lp_stack_size;
+extern bool shared_stacks;
 
 extern void initialize_binding_blocks(void);
+extern void finalize_binding_blocks(void);
+extern void refresh_bound_lp(struct lp_struct *lp);
+extern void refresh_bound_lps(void);
 extern void initialize_lps(void);
 extern struct lp_struct *find_lp_by_gid(GID_t);
+#ifdef HAVE_MPI
+extern struct lp_struct *install_lp(GID_t gid);
+extern void remove_lp(struct lp_struct *lp);
+#endif
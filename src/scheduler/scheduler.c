@@ -42,6 +42,7 @@
 #include <core/core.h>
 #include <core/timer.h>
 #include <arch/atomic.h>
+#include <arch/numa.h>
 #include <arch/ult.h>
 #include <arch/thread.h>
 #include <core/init.h>
@@ -50,7 +51,9 @@
 #include <scheduler/scheduler.h>
 #include <scheduler/stf.h>
 #include <mm/state.h>
+#include <mm/persist.h>
 #include <communication/communication.h>
+#include <communication/mpi.h>
 
 #ifdef HAVE_CROSS_STATE
 #include <mm/ecs.h>
@@ -82,6 +85,16 @@ __thread struct lp_struct *current;
  */
 __thread msg_t *current_evt;
 
+/**
+ * If LPs share stacks, this is the context starting LP_main_loop() on the
+ * stack of this worker thread. Every event starts over from it, as nothing
+ * on the stack survives the activation of another LP.
+ */
+static __thread LP_context_t shared_stack_context;
+
+/// If LPs share stacks, the stack of this worker thread
+static __thread void *shared_stack;
+
 /*
 * This function initializes the scheduler. In particular, it relies on MPI to broadcast to every simulation kernel process
 * which is the actual scheduling algorithm selected.
@@ -110,19 +123,20 @@ void scheduler_fini(void)
 
 	foreach_lp(lp) {
 		rsfree(lp->queue_in);
-		rsfree(lp->queue_out);
+		ring_fini(lp->queue_out);
 		rsfree(lp->queue_states);
 		rsfree(lp->bottom_halves);
+		rsfree(lp->antimsg_bottom_halves);
 		rsfree(lp->rendezvous_queue);
 
-		// Destroy stacks
-		rsfree(lp->stack);
+		// Stacks live in the LP segments
 
 		rsfree(lp);
 	}
 
 	rsfree(lps_blocks);
-	rsfree(lps_bound_blocks);
+	rsfree(lps_by_gid);
+	finalize_binding_blocks();
 }
 
 /**
@@ -203,6 +217,12 @@ void initialize_worker_thread(void)
 {
 	msg_t *init_event;
 
+	// If LPs share stacks, set up the one of this thread
+	if (shared_stacks) {
+		shared_stack = get_ult_stack(lp_stack_size);
+		context_create(&shared_stack_context, LP_main_loop, NULL, shared_stack, lp_stack_size);
+	}
+
 	// Divide LPs among worker threads, for the first time here
 	rebind_LPs();
 	if (master_thread() && master_kernel()) {
@@ -229,13 +249,25 @@ void initialize_worker_thread(void)
 
 	thread_barrier(&all_thread_barrier);
 
-	foreach_bound_lp(lp) {
-		schedule_on_init(lp);
+	if (rootsim_config.restart_from != NULL) {
+		// LPs are rebuilt from disk
+		if (master_thread())
+			persist_restore();
+	} else {
+		foreach_bound_lp(lp) {
+			schedule_on_init(lp);
+		}
+		flush_remote_msgs();
 	}
 
 	// Worker Threads synchronization barrier: they all should start working together
 	thread_barrier(&all_thread_barrier);
 
+	// LPs have processed INIT, or they have been restored by the master thread
+	refresh_bound_lps();
+
+	numa_counters_start();
+
 #ifdef HAVE_PREEMPTION
 	if (!rootsim_config.disable_preemption)
 		enable_preemption();
@@ -243,6 +275,16 @@ void initialize_worker_thread(void)
 
 }
 
+/**
+* Release the resources of a worker thread, once it has left the main
+* simulation loop and no LP can run anymore.
+*/
+void finalize_worker_thread(void)
+{
+	if (shared_stacks)
+		free_ult_stack(shared_stack, lp_stack_size);
+}
+
 /**
 * This function is the application-level ProcessEvent() callback entry point.
 * It allows to specify which lp must be scheduled, specifying its lvt, its event
@@ -279,6 +321,10 @@ void activate_LP(struct lp_struct *next, msg_t * evt)
 			      next->gid.to_int, next->state);
 	}
 
+	// On a shared stack, the previous event left nothing behind: start over
+	if (shared_stacks)
+		next->context = shared_stack_context;
+
 	context_switch(&kernel_context, &next->context);
 
 //      #ifdef HAVE_PREEMPTION
@@ -348,6 +394,7 @@ void schedule(void)
 		rollback(next);
 		next->state = LP_STATE_READY;
 		send_outgoing_msgs(next);
+		refresh_bound_lp(next);
 		return;
 	}
 
@@ -369,6 +416,7 @@ void schedule(void)
 	}
 
 	if (unlikely(!process_control_msg(event))) {
+		refresh_bound_lp(next);
 		return;
 	}
 #ifdef HAVE_CROSS_STATE
@@ -404,6 +452,8 @@ void schedule(void)
 
 	// Log the state, if needed
 	LogState(next);
+
+	refresh_bound_lp(next);
 }
 
 void schedule_on_init(struct lp_struct *next)
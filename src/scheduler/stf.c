@@ -54,24 +54,26 @@ struct lp_struct *smallest_timestamp_first(void)
 {
 	struct lp_struct *next_lp = NULL;
 	simtime_t evt_time, next_time = INFTY;
+	unsigned int i;
 
-	foreach_bound_lp(lp) {
+	// Only the copies in lps_bound_hot are read, not the LP control blocks
+	for (i = 0; i < n_prc_per_thread; i++) {
 		// If waiting for synch, don't take into account the LP
-		if (is_blocked_state(lp->state)) {
+		if (is_blocked_state(lps_bound_hot.state[i])) {
 			continue;
 		}
 		// If the LP is in READY_FOR_SYNCH it has to handle the same ECS message
-		if (lp->state == LP_STATE_READY_FOR_SYNCH) {
+		if (lps_bound_hot.state[i] == LP_STATE_READY_FOR_SYNCH) {
 			// The LP handles the suspended event as the next event
-			evt_time = lvt(lp);
+			evt_time = lps_bound_hot.lvt[i];
 		} else {
-			// Compute the next event's timestamp.
-			evt_time = next_event_timestamp(lp);
+			// The next event's timestamp.
+			evt_time = lps_bound_hot.next_ts[i];
 		}
 
 		if (evt_time < next_time && evt_time < INFTY) {
 			next_time = evt_time;
-			next_lp = lp;
+			next_lp = lps_bound_blocks[i];
 		}
 	}
 
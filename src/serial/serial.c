@@ -55,6 +55,16 @@ static bool *serial_completed_simulation;
 void SerialScheduleNewEvent(unsigned int rcv, simtime_t stamp,
 			    unsigned int event_type, void *event_content,
 			    unsigned int event_size)
+{
+	void *content;
+
+	content = SerialAllocEvent(rcv, stamp, event_type, event_size);
+	memcpy(content, event_content, event_size);
+	SerialCommitEvent(content);
+}
+
+void *SerialAllocEvent(unsigned int rcv, simtime_t stamp,
+		       unsigned int event_type, unsigned int event_size)
 {
 	GID_t receiver;
 	msg_t *event;
@@ -64,10 +74,9 @@ void SerialScheduleNewEvent(unsigned int rcv, simtime_t stamp,
 		rootsim_error(true, "LP %d is trying to send events in the past. Current time: %f, scheduled time: %f\n",
 			      current->gid.to_int, lvt(current), stamp);
 	}
-	// Populate the message data structure
+	// Populate the message data structure, the payload is written by the caller
 	set_gid(receiver, rcv);
-	size_t size = sizeof(msg_t) + event_size;
-	event = rsalloc(size);
+	event = rsalloc(sizeof(msg_t) + event_size);
 	bzero(event, sizeof(msg_t));
 	event->sender = current->gid;
 	event->receiver = receiver;
@@ -75,10 +84,16 @@ void SerialScheduleNewEvent(unsigned int rcv, simtime_t stamp,
 	event->send_time = lvt(current);
 	event->type = event_type;
 	event->size = event_size;
-	memcpy(event->event_content, event_content, event_size);
+
+	return event->event_content;
+}
+
+void SerialCommitEvent(void *event_content)
+{
+	msg_t *event = msg_from_content(event_content);
 
 	// Put the event in the Calenda Queue
-	calqueue_put(stamp, event);
+	calqueue_put(event->timestamp, event);
 }
 
 void serial_init(void)
@@ -35,6 +35,9 @@
 extern void SerialSetState(void *);
 extern void SerialScheduleNewEvent(unsigned int, simtime_t, unsigned int,
 				   void *, unsigned int);
+extern void *SerialAllocEvent(unsigned int, simtime_t, unsigned int,
+			      unsigned int);
+extern void SerialCommitEvent(void *);
 
 extern void serial_init(void);
 extern void serial_simulation(void) __attribute__((noreturn));
@@ -64,6 +64,7 @@
 
 #include <arch/thread.h>
 #include <arch/memusage.h>
+#include <arch/numa.h>
 #include <scheduler/process.h>
 #include <scheduler/scheduler.h>
 #include <gvt/gvt.h>
@@ -74,9 +75,7 @@
 #include <core/core.h>
 #include <core/init.h>
 #include <core/timer.h>
-#ifdef HAVE_MPI
 #include <communication/mpi.h>
-#endif
 
 #define GVT_BUFF_ROWS   50
 
@@ -87,6 +86,8 @@ struct _gvt_buffer {
 		double gvt;
 		unsigned committed;
 		unsigned cumulated;
+		unsigned top_lp;
+		double top_lp_memory;
 	}rows[GVT_BUFF_ROWS];
 };
 
@@ -115,10 +116,8 @@ static struct stat_t *thread_stats;
 /// Keeps global statistics
 static struct stat_t system_wide_stats = {.gvt_round_time_min = INFTY};
 
-#ifdef HAVE_MPI
-/// Keep statistics reduced globally across MPI ranks
+/// Keep statistics reduced globally across kernels
 struct stat_t global_stats = {.gvt_round_time_min = INFTY};
-#endif
 
 /**
  * This is a pseudo asprintf() implementation needed in order to stop GCC 8 from complaining
@@ -246,6 +245,12 @@ static void print_config_to_file(FILE *f)
 		#ifdef HAVE_MPI
 		"MPI multithread support: %s\n"
 		#endif
+		"Distributed GVT Mode: %s\n"
+		"Inter-Kernel Transport: %s\n"
+		"Communication Thread: %s\n"
+		#ifdef HAVE_MPI
+		"LP Migration Every: %u GVT reductions\n"
+		#endif
 		"GVT Time Period: %.2f seconds\n"
 		"Checkpointing Type: %s\n"
 		"Checkpointing Period: %d\n"
@@ -253,6 +258,12 @@ static void print_config_to_file(FILE *f)
 		"Halt Simulation After: %d\n"
 		"LPs Distribution Mode across Kernels: %s\n"
 		"Check Termination Mode: %s\n"
+		"Simulation Checkpoint Every: %u GVT reductions\n"
+		"Restart From: %s\n"
+		"Communication Profiling: %u GVT reductions\n"
+		"LP Mapping From: %s\n"
+		"Huge Pages: %s\n"
+		"LP Memory Quota: %u MB\n"
 		"Set Seed: %ld\n",
 		n_ker,
 		get_cores(),
@@ -263,6 +274,12 @@ static void print_config_to_file(FILE *f)
 		#ifdef HAVE_MPI
 		((mpi_support_multithread)? "yes":"no"),
 		#endif
+		param_to_text[PARAM_GVT_MODE][rootsim_config.gvt_mode],
+		param_to_text[PARAM_TRANSPORT][rootsim_config.transport],
+		((rootsim_config.comm_thread)? "yes":"no"),
+		#ifdef HAVE_MPI
+		rootsim_config.migrate_every,
+		#endif
 		rootsim_config.gvt_time_period / 1000.0,
 		param_to_text[PARAM_STATE_SAVING][rootsim_config.checkpointing],
 		rootsim_config.ckpt_period,
@@ -270,6 +287,12 @@ static void print_config_to_file(FILE *f)
 		rootsim_config.simulation_time,
 		param_to_text[PARAM_LPS_DISTRIBUTION][rootsim_config.lps_distribution],
 		param_to_text[PARAM_CKTRM_MODE][rootsim_config.check_termination_mode],
+		rootsim_config.checkpoint_every,
+		(rootsim_config.restart_from != NULL ? rootsim_config.restart_from : "none"),
+		rootsim_config.comm_profile,
+		(rootsim_config.lp_mapping != NULL ? rootsim_config.lp_mapping : "none"),
+		param_to_text[PARAM_HUGEPAGES][rootsim_config.hugepages],
+		rootsim_config.lp_memory_quota,
 		rootsim_config.set_seed);
 }
 
@@ -320,6 +343,22 @@ static char *format_size(double size)
 	return size_str;
 }
 
+
+/**
+ * Keep in @p dest the LP which held the most memory, among the one already
+ * there and the one in @p src
+ *
+ * @param dest The statistics being reduced
+ * @param src The statistics of an LP, or already reduced ones
+ */
+void keep_largest_lp_memory(struct stat_t *dest, const struct stat_t *src)
+{
+	if(src->peak_lp_memory > dest->peak_lp_memory) {
+		dest->peak_lp_memory = src->peak_lp_memory;
+		dest->peak_lp_gid = src->peak_lp_gid;
+	}
+}
+
 #define HEADER_STR "------------------------------------------------------------"
 static void print_header(FILE *f, const char *title)
 {
@@ -347,6 +386,9 @@ static void print_common_stats(FILE *f, struct stat_t *stats_p, bool want_thread
 	double rollback_frequency = (stats_p->tot_rollbacks / stats_p->tot_events);
 	double rollback_length = (stats_p->tot_rollbacks > 0 ? (stats_p->tot_events - stats_p->committed_events) / stats_p->tot_rollbacks : 0);
 	double efficiency = (1 - rollback_frequency * rollback_length) * 100;
+	unsigned long class_size;
+	char label[32];
+	unsigned int i;
 
 	fprintf(f, "TOTAL KERNELS ............. : %d \n",		n_ker);
 	if(want_local_stats) {
@@ -381,15 +423,44 @@ static void print_common_stats(FILE *f, struct stat_t *stats_p, bool want_thread
 		fprintf(f, "LAST COMMITTED GVT ........ : %f\n",	get_last_gvt());
 	}
 	fprintf(f, "NUMBER OF GVT REDUCTIONS... : %.0f\n",		stats_p->gvt_computations);
-	if(!want_thread_stats && n_ker > 1){
+	if(!want_thread_stats){
 		fprintf(f, "MIN GVT ROUND TIME......... : %.2f us\n",	stats_p->gvt_round_time_min);
 		fprintf(f, "MAX GVT ROUND TIME......... : %.2f us\n",	stats_p->gvt_round_time_max);
 		fprintf(f, "AVERAGE GVT ROUND TIME..... : %.2f us\n",	stats_p->gvt_round_time / stats_p->gvt_computations);
 	}
+	fprintf(f, "TERMINATION CHECKS......... : %.0f\n",		stats_p->ccgs_rounds);
+	fprintf(f, "AVG TERMINATION CHECK COST. : %.2f us\n",		(stats_p->ccgs_rounds > 0 ? stats_p->ccgs_time / stats_p->ccgs_rounds : 0));
+	if(stats_p->mpi_sends > 0)
+		fprintf(f, "MESSAGES PER REMOTE SEND... : %.2f\n",	stats_p->mpi_msgs / stats_p->mpi_sends);
+	if(stats_p->migrated_lps > 0)
+		fprintf(f, "LP MIGRATIONS.............. : %.0f\n",	stats_p->migrated_lps);
+	for(i = 0; i < MSG_SLAB_CLASSES; i++) {
+		if(D_EQUAL_ZERO(stats_p->msg_buffers[i]))
+			continue;
+		class_size = 1UL << (MSG_SLAB_MIN_SHIFT + i);
+		if(class_size < 1024)
+			snprintf(label, sizeof(label), "MSG BUFFERS OF %lu B", class_size);
+		else
+			snprintf(label, sizeof(label), "MSG BUFFERS OF %lu KB", class_size / 1024);
+		fprintf(f, "%s%.*s : %.0f\n", label, (int)(27 - strlen(label)), "...........", stats_p->msg_buffers[i]);
+	}
+	if(stats_p->large_msg_buffers > 0) {
+		fprintf(f, "LARGE MSG BUFFERS.......... : %.0f\n",	stats_p->large_msg_buffers);
+		fprintf(f, "LARGE MSG BUFFERS REUSED... : %.0f\n",	stats_p->large_msg_reused);
+	}
+	fprintf(f, "SLAB LOCK CONTENTIONS...... : %.0f\n",		stats_p->slab_contentions);
+	fprintf(f, "CROSS-THREAD FREES......... : %.0f\n",		stats_p->remote_frees);
+	if(stats_p->numa_loads > 0)
+		fprintf(f, "LOCAL NUMA MEMORY ACCESSES. : %.2f %%\n",	(stats_p->numa_loads - stats_p->numa_remote_loads) / stats_p->numa_loads * 100);
 	fprintf(f, "SIMULATION TIME SPEED...... : %.2f units per GVT\n",stats_p->simtime_advancement);
 	fprintf(f, "AVERAGE MEMORY USAGE....... : %s\n",		format_size(stats_p->memory_usage / stats_p->gvt_computations));
-	if(!want_thread_stats)
+	if(stats_p->peak_lp_memory > 0)
+		fprintf(f, "LARGEST LP MEMORY.......... : %s (LP %.0f)\n",	format_size(stats_p->peak_lp_memory), stats_p->peak_lp_gid);
+	if(!want_thread_stats) {
 		fprintf(f, "PEAK MEMORY USAGE.......... : %s\n",	format_size(stats_p->max_resident_set));
+		if(stats_p->anon_memory > 0)
+			fprintf(f, "HUGE PAGES COVERAGE........ : %.2f %%\n",	stats_p->huge_memory / stats_p->anon_memory * 100);
+	}
 }
 
 
@@ -414,7 +485,8 @@ void print_gvt_stats_file(void)
 	fwrite(gvt_buf.rows, sizeof(struct _gvt_buffer_row_t), gvt_buf.pos, f_blob);
 	// print the header
 	fprintf(f_final, "#%15.15s    %15.15s    ", "\"WCT\"", "\"GVT VALUE\"");
-	fprintf(f_final, "%15.15s    %15.15s\n", "\"EVENTS\"", "\"CUMUL EVENTS\"");
+	fprintf(f_final, "%15.15s    %15.15s    ", "\"EVENTS\"", "\"CUMUL EVENTS\"");
+	fprintf(f_final, "%15.15s    %15.15s\n", "\"TOP LP\"", "\"TOP LP MEMORY\"");
 	// prepare to read back the blob
 	rewind(f_blob);
 	do {
@@ -423,7 +495,8 @@ void print_gvt_stats_file(void)
 		for(i = 0; i < elems; ++i) {
 			// write line per line
 			fprintf(f_final, " %15lf    %15lf    ", gvt_buf.rows[i].exec_time, gvt_buf.rows[i].gvt);
-			fprintf(f_final, "%15u    %15u\n", gvt_buf.rows[i].committed, gvt_buf.rows[i].cumulated);
+			fprintf(f_final, "%15u    %15u    ", gvt_buf.rows[i].committed, gvt_buf.rows[i].cumulated);
+			fprintf(f_final, "%15u    %15.0lf\n", gvt_buf.rows[i].top_lp, gvt_buf.rows[i].top_lp_memory);
 		}
 	} while(!feof(f_blob));
 	fflush(f_final);
@@ -441,9 +514,10 @@ void print_gvt_stats_file(void)
 */
 void statistics_stop(int exit_code)
 {
-	register unsigned int i;
+	register unsigned int i, j;
 	FILE *f;
 	double total_time;
+	size_t anon_memory, huge_memory;
 	timer simulation_finished;
 
 	if(rootsim_config.serial) {
@@ -464,6 +538,11 @@ void statistics_stop(int exit_code)
 		fprintf(f, "SIMULATION TIME SPEED...... : %.2f units per GVT\n",system_wide_stats.simtime_advancement);
 		fprintf(f, "AVERAGE MEMORY USAGE....... : %s\n",		format_size(system_wide_stats.memory_usage / system_wide_stats.gvt_computations));
 		fprintf(f, "PEAK MEMORY USAGE.......... : %s\n",		format_size(getPeakRSS()));
+		if(rootsim_config.hugepages >= HUGEPAGES_THP) {
+			getHugePagesUsage(&anon_memory, &huge_memory);
+			if(anon_memory > 0)
+				fprintf(f, "HUGE PAGES COVERAGE........ : %.2f %%\n",	(double)huge_memory / anon_memory * 100);
+		}
 		print_termination_status(f, exit_code);
 		fflush(f);
 
@@ -486,7 +565,8 @@ void statistics_stop(int exit_code)
 
 			fprintf(f, "#%15.15s   %15.15s   %15.15s   %15.15s", "\"GID\"", "\"LID\"", "\"TOTAL EVENTS\"", "\"COMM EVENTS\"");
 			fprintf(f, "   %15.15s   %15.15s   %15.15s   %15.15s", "\"REPROC EVENTS\"", "\"ROLLBACKS\"", "\"ANTIMSG\"", "\"AVG EVT COST\"");
-			fprintf(f, "   %15.15s   %15.15s   %15.15s\n", "\"AVG CKPT COST\"", "\"AVG REC COST\"", "\"IDLE CYCLES\"");
+			fprintf(f, "   %15.15s   %15.15s   %15.15s", "\"AVG CKPT COST\"", "\"AVG REC COST\"", "\"IDLE CYCLES\"");
+			fprintf(f, "   %15.15s   %15.15s   %15.15s   %15.15s\n", "\"LIVE MEMORY\"", "\"CKPT MEMORY\"", "\"QUEUE MEMORY\"", "\"PEAK MEMORY\"");
 
 			foreach_bound_lp(lp) {
 				unsigned int lp_id = lp->lid.to_int;
@@ -502,6 +582,10 @@ void statistics_stop(int exit_code)
 				fprintf(f, "%15.0lf   ", 	lp_stats[lp_id].ckpt_time / lp_stats[lp_id].tot_ckpts);
 				fprintf(f, "%15.0lf   ", 	(lp_stats[lp_id].tot_rollbacks > 0 ? lp_stats[lp_id].recovery_time / lp_stats[lp_id].tot_recoveries : 0));
 				fprintf(f, "%15.0lf   ", 	lp_stats[lp_id].idle_cycles);
+				fprintf(f, "%15.0lf   ", 	lp_stats[lp_id].live_memory);
+				fprintf(f, "%15.0lf   ", 	lp_stats[lp_id].ckpt_memory);
+				fprintf(f, "%15.0lf   ", 	lp_stats[lp_id].queue_memory);
+				fprintf(f, "%15.0lf   ", 	lp_stats[lp_id].peak_lp_memory);
 				fprintf(f, "\n");
 			}
 		}
@@ -511,8 +595,12 @@ void statistics_stop(int exit_code)
 		// Sum up all LPs statistics
 		foreach_bound_lp(lp) {
 			thread_stats[local_tid].vec += lp_stats[lp->lid.to_int].vec;
+			keep_largest_lp_memory(&thread_stats[local_tid], &lp_stats[lp->lid.to_int]);
 		}
 		thread_stats[local_tid].exponential_event_time /= n_prc_per_thread;
+		thread_stats[local_tid].slab_contentions = slab_lock_contentions;
+		thread_stats[local_tid].remote_frees = slab_remote_frees;
+		numa_counters_stop(&thread_stats[local_tid].numa_loads, &thread_stats[local_tid].numa_remote_loads);
 
 		// Compute derived statistics and dump everything
 		f = thread_files[STAT_FILE_T_THREAD][local_tid];
@@ -527,11 +615,32 @@ void statistics_stop(int exit_code)
 			// Sum up all threads statistics
 			for(i = 0; i < n_cores; i++) {
 				system_wide_stats.vec += thread_stats[i].vec;
+				system_wide_stats.ccgs_time += thread_stats[i].ccgs_time;
+				system_wide_stats.ccgs_rounds += thread_stats[i].ccgs_rounds;
+				system_wide_stats.mpi_sends += thread_stats[i].mpi_sends;
+				system_wide_stats.mpi_msgs += thread_stats[i].mpi_msgs;
+				system_wide_stats.migrated_lps += thread_stats[i].migrated_lps;
+				for(j = 0; j < MSG_SLAB_CLASSES; j++)
+					system_wide_stats.msg_buffers[j] += thread_stats[i].msg_buffers[j];
+				system_wide_stats.large_msg_buffers += thread_stats[i].large_msg_buffers;
+				system_wide_stats.large_msg_reused += thread_stats[i].large_msg_reused;
+				system_wide_stats.slab_contentions += thread_stats[i].slab_contentions;
+				system_wide_stats.remote_frees += thread_stats[i].remote_frees;
+				system_wide_stats.numa_loads += thread_stats[i].numa_loads;
+				system_wide_stats.numa_remote_loads += thread_stats[i].numa_remote_loads;
+				keep_largest_lp_memory(&system_wide_stats, &thread_stats[i]);
 			}
 			system_wide_stats.exponential_event_time /= n_cores;
 			system_wide_stats.max_resident_set = getPeakRSS();
+			if(rootsim_config.hugepages >= HUGEPAGES_THP) {
+				getHugePagesUsage(&anon_memory, &huge_memory);
+				system_wide_stats.anon_memory = anon_memory;
+				system_wide_stats.huge_memory = huge_memory;
+			}
 			// GVT computations are the same for all threads
 			system_wide_stats.gvt_computations /= n_cores;
+			// Termination checks as well: their cost is reported as the aggregate per round
+			system_wide_stats.ccgs_rounds /= n_cores;
 
 			// Compute derived statistics and dump everything
 			f = unique_files[STAT_FILE_U_NODE];
@@ -543,12 +652,12 @@ void statistics_stop(int exit_code)
 			print_termination_status(f, exit_code);
 			fflush(f);
 
-			#ifdef HAVE_MPI
-			mpi_reduce_statistics(&global_stats, &system_wide_stats);
+			reduce_statistics(&global_stats, &system_wide_stats);
 			if(master_kernel() && n_ker > 1){
 				global_stats.exponential_event_time /= n_ker;
 				// GVT computations are the same for all kernels
 				global_stats.gvt_computations /= n_ker;
+				global_stats.ccgs_rounds /= n_ker;
 				global_stats.simtime_advancement /= n_ker;
 
 				f = unique_files[STAT_FILE_U_GLOBAL];
@@ -560,7 +669,6 @@ void statistics_stop(int exit_code)
 				print_termination_status(f, exit_code);
 				fflush(f);
 			}
-			#endif
 			if(master_kernel())
 				print_termination_status(stdout, exit_code);
 		}
@@ -572,10 +680,30 @@ void statistics_stop(int exit_code)
 // dump a line on the corresponding statistics file
 inline void statistics_on_gvt(double gvt)
 {
-	unsigned int lid;
+	unsigned int lid, top_lp = 0;
 	unsigned int committed = 0;
 	static __thread unsigned int cumulated = 0;
 	double exec_time, simtime_advancement, keep_exponential_event_time;
+	double memory, top_lp_memory = 0.0;
+
+	// Memory held by the LPs after fossil collection, and which of them holds the most
+	foreach_bound_lp(lp) {
+		lid = lp->lid.to_int;
+		memory = (double)lp_memory_usage(lp);
+
+		lp_stats[lid].live_memory = (double)lp->mm->m_state->live_size;
+		lp_stats[lid].ckpt_memory = (double)lp->mm->ckpt_size;
+		lp_stats[lid].queue_memory = (double)lp->mm->queue_size;
+		if(memory > lp_stats[lid].peak_lp_memory) {
+			lp_stats[lid].peak_lp_memory = memory;
+			lp_stats[lid].peak_lp_gid = lp->gid.to_int;
+		}
+
+		if(memory > top_lp_memory) {
+			top_lp_memory = memory;
+			top_lp = lp->gid.to_int;
+		}
+	}
 
 	// Dump on file only if required
 	if(rootsim_config.stats == STATS_ALL || rootsim_config.stats == STATS_PERF) {
@@ -588,7 +716,7 @@ inline void statistics_on_gvt(double gvt)
 		cumulated += committed;
 
 		// fill the row
-		gvt_buf.rows[gvt_buf.pos++] = (struct _gvt_buffer_row_t){exec_time, gvt, committed, cumulated};
+		gvt_buf.rows[gvt_buf.pos++] = (struct _gvt_buffer_row_t){exec_time, gvt, committed, cumulated, top_lp, top_lp_memory};
 		// check if buffer is full
 		if(gvt_buf.pos >= GVT_BUFF_ROWS){
 			// flush our buffer in the blob file
@@ -677,14 +805,11 @@ void statistics_init(void)
 		rsfree(name_buf);
 	}
 	// create the unique file
-#ifdef HAVE_MPI
 	if(n_ker > 1) {
 		assign_new_file(unique_files[STAT_FILE_U_NODE], STAT_FILE_NAME_NODE"_%u", kid);
 		if(master_kernel())
 			assign_new_file(unique_files[STAT_FILE_U_GLOBAL], STAT_FILE_NAME_GLOBAL);
-	} else
-#endif
-	{
+	} else {
 		assign_new_file(unique_files[STAT_FILE_U_NODE], STAT_FILE_NAME_NODE);
 	}
 	// Create files depending on the actual level of verbosity
@@ -717,10 +842,10 @@ void statistics_init(void)
 	}
 
 	// Initialize data structures to keep information
-	lp_stats = rsalloc(n_prc * sizeof(struct stat_t));
-	bzero(lp_stats, n_prc * sizeof(struct stat_t));
-	lp_stats_gvt = rsalloc(n_prc * sizeof(struct stat_t));
-	bzero(lp_stats_gvt, n_prc * sizeof(struct stat_t));
+	lp_stats = rsalloc(max_local_lps() * sizeof(struct stat_t));
+	bzero(lp_stats, max_local_lps() * sizeof(struct stat_t));
+	lp_stats_gvt = rsalloc(max_local_lps() * sizeof(struct stat_t));
+	bzero(lp_stats_gvt, max_local_lps() * sizeof(struct stat_t));
 	thread_stats = rsalloc(n_cores * sizeof(struct stat_t));
 	bzero(thread_stats, n_cores * sizeof(struct stat_t));
 }
@@ -840,6 +965,29 @@ void statistics_post_data(struct lp_struct *lp, enum stat_msg_t type, double dat
 			system_wide_stats.gvt_round_time += data;
 			break;
 
+		case STAT_CCGS_TIME:
+			thread_stats[local_tid].ccgs_time += data;
+			thread_stats[local_tid].ccgs_rounds += 1.0;
+			break;
+
+		case STAT_MPI_SEND:
+			thread_stats[local_tid].mpi_sends += 1.0;
+			thread_stats[local_tid].mpi_msgs += data;
+			break;
+
+		case STAT_MIGRATION:
+			thread_stats[local_tid].migrated_lps += data;
+			break;
+
+		case STAT_MSG_BUFFER:
+			thread_stats[local_tid].msg_buffers[(unsigned int)data] += 1.0;
+			break;
+
+		case STAT_LARGE_MSG_BUFFER:
+			thread_stats[local_tid].large_msg_buffers += 1.0;
+			thread_stats[local_tid].large_msg_reused += data;
+			break;
+
 		default:
 			rootsim_error(true, "Wrong LP statistics post type: %d. Aborting...\n", type);
 	}
@@ -853,8 +1001,44 @@ double statistics_get_lp_data(struct lp_struct *lp, unsigned int type)
 		case STAT_GET_EVENT_TIME_LP:
 			return lp_stats[lp->lid.to_int].exponential_event_time;
 
+		case STAT_GET_EVENT_TIME_TOT_LP:
+			return lp_stats[lp->lid.to_int].event_time;
+
 		default:
 			rootsim_error(true, "Wrong statistics get type: %d. Aborting...\n", type);
 	}
 	return 0.0;
 }
+
+
+/**
+* Move the statistics of an LP out of this kernel, as the LP is migrating.
+* They are reset here, so that the slot can be reused by another LP.
+*
+* @param lp A pointer to the lp_struct of the migrating LP
+* @param stats Where to store the statistics collected so far and since the last GVT
+*/
+void statistics_export_lp(struct lp_struct *lp, struct stat_t stats[2])
+{
+	unsigned int lid = lp->lid.to_int;
+
+	memcpy(&stats[0], &lp_stats[lid], sizeof(struct stat_t));
+	memcpy(&stats[1], &lp_stats_gvt[lid], sizeof(struct stat_t));
+	bzero(&lp_stats[lid], sizeof(struct stat_t));
+	bzero(&lp_stats_gvt[lid], sizeof(struct stat_t));
+}
+
+
+/**
+* Install the statistics of an LP which has migrated to this kernel.
+*
+* @param lp A pointer to the lp_struct of the migrated LP
+* @param stats The statistics as stored by statistics_export_lp()
+*/
+void statistics_import_lp(struct lp_struct *lp, const struct stat_t stats[2])
+{
+	unsigned int lid = lp->lid.to_int;
+
+	memcpy(&lp_stats[lid], &stats[0], sizeof(struct stat_t));
+	memcpy(&lp_stats_gvt[lid], &stats[1], sizeof(struct stat_t));
+}
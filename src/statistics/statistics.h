@@ -98,8 +98,14 @@ enum stat_msg_t {
 	STAT_IDLE_CYCLES,
 	STAT_SILENT,
 	STAT_GVT_ROUND_TIME,
+	STAT_CCGS_TIME,
+	STAT_MPI_SEND,
+	STAT_MIGRATION,
+	STAT_MSG_BUFFER,
+	STAT_LARGE_MSG_BUFFER,
 	STAT_GET_SIMTIME_ADVANCEMENT,	//xxx totally unused
-	STAT_GET_EVENT_TIME_LP
+	STAT_GET_EVENT_TIME_LP,
+	STAT_GET_EVENT_TIME_TOT_LP
 };
 
 enum stats_levels {
@@ -137,7 +143,17 @@ struct stat_t {
 	};
 	double gvt_time,
 	    gvt_round_time,
-	    gvt_round_time_min, gvt_round_time_max, max_resident_set;
+	    gvt_round_time_min, gvt_round_time_max, max_resident_set,
+	    anon_memory, huge_memory,
+	    ccgs_time, ccgs_rounds,
+	    mpi_sends, mpi_msgs,
+	    migrated_lps,
+	    msg_buffers[MSG_SLAB_CLASSES],
+	    large_msg_buffers, large_msg_reused,
+	    slab_contentions, remote_frees,
+	    numa_loads, numa_remote_loads,
+	    live_memory, ckpt_memory, queue_memory,
+	    peak_lp_memory, peak_lp_gid;
 };
 
 extern void _mkdir(const char *path);
@@ -157,4 +173,7 @@ extern inline void statistics_post_data(struct lp_struct *, enum stat_msg_t type
 extern inline void statistics_post_data_serial(enum stat_msg_t type, double data);
 
 extern double statistics_get_lp_data(struct lp_struct *, unsigned int type);
+extern void statistics_export_lp(struct lp_struct *lp, struct stat_t stats[2]);
+extern void statistics_import_lp(struct lp_struct *lp, const struct stat_t stats[2]);
+extern void keep_largest_lp_memory(struct stat_t *dest, const struct stat_t *src);
 
@@ -7,6 +7,8 @@
 #include <sys/types.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 
 #define actual_malloc(siz) malloc(siz)
 #define actual_free(ptr) free(ptr)
@@ -146,7 +148,7 @@ static void free_it(struct bin *m) {
 	if(m->subs == DYMELOR)
 		__wrap_free(m->ptr);
 	if(m->subs == SLAB)
-		slab_free(current->mm->slab, m->ptr);
+		slab_free(current->mm->msg_slabs[msg_slab_class(m->size)], m->ptr);
 	if(m->subs == BUDDY)
 		free_lp_memory(current, m->ptr);
 }
@@ -191,17 +193,22 @@ static void bin_alloc(struct bin *m, size_t size, unsigned r)
 		}
 		m->ptr = __wrap_realloc(m->ptr, size);
 		m->subs = DYMELOR;
-	} /*else if(r < 474) {
+	} else if(r < 474) {
 		// buddy
 		if (m->size > 0)
 			free_it(m);
 		m->ptr = allocate_lp_memory(current, size);
 		m->subs = BUDDY;
-	} */else if(r < 749 && size <= SLAB_MSG_SIZE) {
+
+		if (m->ptr != NULL && zero_check(m->ptr, size)) {
+			printf("[%d] buddy memory non-zero (ptr=%p, size=%zu)!\n", st->counter, m->ptr, size);
+			exit(1);
+		}
+	} else if(r < 749 && size <= MSG_SLAB_MAX_SIZE) {
 		// slab
 		if (m->size > 0)
 			free_it(m);
-		m->ptr = slab_alloc(current->mm->slab);
+		m->ptr = slab_alloc(current->mm->msg_slabs[msg_slab_class(size)]);
 		m->subs = SLAB;
 	} else {
 		// malloc
@@ -313,6 +320,216 @@ static void *malloc_test(void *ptr)
 	return NULL;
 }
 
+#define GROWTH_CLASSES	6
+#define GROWTH_CHUNKS	(512 + 1024 + 2048 + 4096)
+
+/*
+ * Fill the smallest size classes so that each chains three more
+ * malloc_areas, which is more than the table of malloc_areas of an LP
+ * initially holds. Each chunk must still find its malloc_area afterwards,
+ * and the LP must be accounted for all of them.
+ */
+static void growth_test(void)
+{
+	unsigned char **chunks;
+	malloc_state *state;
+	unsigned i, c;
+	size_t size, live = 0;
+	bool passed = true;
+
+	context.gid.to_int = 0;
+	context.bound = actual_malloc(sizeof(msg_t));
+	context.bound->timestamp = 0.0;
+	initialize_memory_map(&context);
+	current = &context;
+	state = context.mm->m_state;
+
+	chunks = actual_malloc(GROWTH_CLASSES * GROWTH_CHUNKS * sizeof(*chunks));
+	for (c = 0; c < GROWTH_CLASSES; c++) {
+		// The chunk also keeps a pointer to its malloc_area
+		size = (MIN_CHUNK_SIZE << c) - sizeof(long long);
+		for (i = 0; i < GROWTH_CHUNKS; i++) {
+			chunks[c * GROWTH_CHUNKS + i] = __wrap_malloc(size);
+			mem_init(chunks[c * GROWTH_CHUNKS + i], size);
+		}
+		live += GROWTH_CHUNKS * (MIN_CHUNK_SIZE << c);
+	}
+
+	passed &= (state->num_areas > MAX_NUM_AREAS);
+	// The chunks are accounted to the LP for their whole size
+	passed &= (state->live_size == live);
+	for (c = 0; c < GROWTH_CLASSES; c++) {
+		size = (MIN_CHUNK_SIZE << c) - sizeof(long long);
+		for (i = 0; i < GROWTH_CHUNKS; i++) {
+			unsigned char *ptr = chunks[c * GROWTH_CHUNKS + i];
+
+			passed &= (get_area(ptr) >= state->areas && get_area(ptr) < state->areas + state->num_areas);
+			passed &= (mem_check(ptr, size) == 0);
+			__wrap_free(ptr);
+		}
+	}
+	passed &= (state->live_size == 0);
+
+	printf("malloc_areas table growth to %d areas: %s\n", state->num_areas, passed ? "passed" : "failed");
+	if (!passed)
+		exit(1);
+
+	actual_free(chunks);
+	actual_free(context.bound);
+	finalize_memory_map(&context);
+	current = NULL;
+}
+
+#define CHURN_LIVE	20000
+#define CHURN_ROUNDS	200000
+#define CHURN_SIZE	100
+
+/*
+ * Each chunk is filled with a tag which is unique among the live chunks, so
+ * that chunks handed out twice overwrite each other's tag.
+ */
+static void churn_fill(unsigned char *ptr, unsigned tag)
+{
+	size_t i;
+
+	for (i = 0; i + sizeof(tag) <= CHURN_SIZE; i += sizeof(tag))
+		memcpy(ptr + i, &tag, sizeof(tag));
+}
+
+static int churn_check(unsigned char *ptr, unsigned tag)
+{
+	size_t i;
+
+	for (i = 0; i + sizeof(tag) <= CHURN_SIZE; i += sizeof(tag)) {
+		if (memcmp(ptr + i, &tag, sizeof(tag)))
+			return 1;
+	}
+	return 0;
+}
+
+static int ptr_compare(const void *a, const void *b)
+{
+	uintptr_t pa = (uintptr_t)*(unsigned char *const *)a;
+	uintptr_t pb = (uintptr_t)*(unsigned char *const *)b;
+
+	return (pa > pb) - (pa < pb);
+}
+
+/*
+ * Keep many same-size chunks alive and replace random ones, so that many
+ * malloc_areas of the same size are chained and lookups of free chunks
+ * happen in crowded areas. The contents of each chunk are checked before
+ * it is released and at the end, and no two live chunks may overlap.
+ */
+static void churn_test(void)
+{
+	unsigned char **live, **sorted;
+	unsigned *tags;
+	struct timeval start, end;
+	double elapsed;
+	unsigned i, b;
+
+	context.gid.to_int = 0;
+	context.bound = actual_malloc(sizeof(msg_t));
+	context.bound->timestamp = 0.0;
+	initialize_memory_map(&context);
+	current = &context;
+	rnd_seed = CHURN_LIVE;
+
+	live = actual_malloc(CHURN_LIVE * sizeof(*live));
+	tags = actual_malloc(CHURN_LIVE * sizeof(*tags));
+	for (i = 0; i < CHURN_LIVE; i++) {
+		live[i] = __wrap_malloc(CHURN_SIZE);
+		tags[i] = i;
+		churn_fill(live[i], tags[i]);
+	}
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < CHURN_ROUNDS; i++) {
+		b = RANDOM(CHURN_LIVE);
+		if (churn_check(live[b], tags[b])) {
+			printf("memory corrupt at %p during churn!\n", live[b]);
+			exit(1);
+		}
+		__wrap_free(live[b]);
+		live[b] = __wrap_malloc(CHURN_SIZE);
+		if (live[b] == NULL) {
+			printf("out of memory during churn!\n");
+			exit(1);
+		}
+		tags[b] = CHURN_LIVE + i;
+		churn_fill(live[b], tags[b]);
+	}
+	gettimeofday(&end, NULL);
+	elapsed = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_usec - start.tv_usec) * 1e3;
+
+	for (i = 0; i < CHURN_LIVE; i++) {
+		if (churn_check(live[i], tags[i])) {
+			printf("memory corrupt at %p after churn!\n", live[i]);
+			exit(1);
+		}
+	}
+
+	sorted = actual_malloc(CHURN_LIVE * sizeof(*sorted));
+	memcpy(sorted, live, CHURN_LIVE * sizeof(*sorted));
+	qsort(sorted, CHURN_LIVE, sizeof(*sorted), ptr_compare);
+	for (i = 1; i < CHURN_LIVE; i++) {
+		if ((uintptr_t)sorted[i] - (uintptr_t)sorted[i - 1] < CHURN_SIZE) {
+			printf("live chunks %p and %p overlap after churn!\n", sorted[i - 1], sorted[i]);
+			exit(1);
+		}
+	}
+	actual_free(sorted);
+
+	for (i = 0; i < CHURN_LIVE; i++)
+		__wrap_free(live[i]);
+
+	printf("malloc/free churn with %d live chunks: %.1f ns per pair, %d malloc_areas\n",
+	       CHURN_LIVE, elapsed / CHURN_ROUNDS, context.mm->m_state->num_areas);
+
+	actual_free(tags);
+	actual_free(live);
+	actual_free(context.bound);
+	finalize_memory_map(&context);
+	current = NULL;
+}
+
+#define HUGEPAGE_BLOCKS	16
+
+/*
+ * Carve blocks of all sizes from a page to twice a huge page out of the
+ * huge page arena. Blocks must be aligned to their size and must not
+ * overlap, and released blocks must be handed out again.
+ */
+static void hugepage_test(void)
+{
+	unsigned char *blocks[HUGEPAGE_BLOCKS];
+	size_t size;
+	unsigned i;
+	bool passed = true;
+
+	rootsim_config.hugepages = HUGEPAGES_THP;
+
+	for (size = PAGE_SIZE; size <= 2 * HUGE_PAGE_SIZE; size *= 2) {
+		for (i = 0; i < HUGEPAGE_BLOCKS; i++) {
+			blocks[i] = hugepage_alloc(size);
+			passed &= (((unsigned long)blocks[i] & (size - 1)) == 0);
+			mem_init(blocks[i], size);
+		}
+		for (i = 0; i < HUGEPAGE_BLOCKS; i++)
+			passed &= (mem_check(blocks[i], size) == 0);
+
+		hugepage_free(blocks[0], size);
+		passed &= (hugepage_alloc(size) == blocks[0]);
+	}
+
+	rootsim_config.hugepages = HUGEPAGES_INVALID;
+
+	printf("huge page arena: %s\n", passed ? "passed" : "failed");
+	if (!passed)
+		exit(1);
+}
+
 static int my_start_thread(struct thread_st *st)
 {
 	pthread_create(&st->id, NULL, malloc_test, st);
@@ -412,6 +629,11 @@ int main(int argc, char *argv[])
 	pthread_mutex_unlock(&finish_mutex);
 
 	actual_free(st);
+
+	growth_test();
+	churn_test();
+	hugepage_test();
+
 	printf("Done.\n");
 	return 0;
 }
@@ -0,0 +1,175 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <datatypes/graph.h>
+
+#include "common.h"
+
+#define print(...) printf(__VA_ARGS__); fflush(stdout)
+
+#define CLUSTERS	8
+#define CLUSTER_SIZE	32
+
+static unsigned long long part_weight(const struct graph *g, const unsigned int *part, unsigned int which)
+{
+	unsigned long long w = 0;
+	unsigned int v;
+
+	for (v = 0; v < g->n; v++) {
+		if (part[v] == which)
+			w += g->vwgt[v];
+	}
+	return w;
+}
+
+static bool test_build(void)
+{
+	// A triangle, with a parallel edge, a reversed edge and a self loop
+	unsigned int src[] = {0, 1, 0, 2, 1, 2};
+	unsigned int dst[] = {1, 2, 1, 2, 0, 0};
+	unsigned long long weight[] = {1, 2, 3, 4, 5, 6};
+	unsigned long long vwgt[] = {1, 1, 1};
+	unsigned int part[] = {0, 0, 1};
+	struct graph *g;
+	bool passed = true;
+	unsigned int k;
+
+	g = graph_build(3, 6, src, dst, weight, vwgt);
+
+	passed &= (g->xadj[3] == 6);
+	for (k = g->xadj[0]; k < g->xadj[1]; k++) {
+		if (g->adjncy[k] == 1)
+			passed &= (g->adjwgt[k] == 9);
+		else
+			passed &= (g->adjncy[k] == 2 && g->adjwgt[k] == 6);
+	}
+	passed &= (graph_edge_cut(g, part) == 8);
+
+	graph_free(g);
+	return passed;
+}
+
+static bool test_clusters(void)
+{
+	unsigned int n = CLUSTERS * CLUSTER_SIZE;
+	unsigned int src[n * CLUSTER_SIZE], dst[n * CLUSTER_SIZE], part[n], sub_map[n];
+	unsigned long long weight[n * CLUSTER_SIZE], vwgt[n];
+	unsigned int i, j, c, n_edges = 0;
+	struct graph *g, *sub;
+	bool passed = true, seen[CLUSTERS];
+
+	// Vertices of a cluster talk a lot to each other, and a little to the next cluster
+	for (i = 0; i < n; i++) {
+		vwgt[i] = 1 + i % 3;
+		c = i / CLUSTER_SIZE;
+		for (j = 0; j < 4; j++) {
+			src[n_edges] = i;
+			dst[n_edges] = c * CLUSTER_SIZE + (i + 1 + j * 7) % CLUSTER_SIZE;
+			weight[n_edges++] = 100;
+		}
+		src[n_edges] = i;
+		dst[n_edges] = (i + CLUSTER_SIZE) % n;
+		weight[n_edges++] = 1;
+	}
+
+	g = graph_build(n, n_edges, src, dst, weight, vwgt);
+	graph_partition(g, CLUSTERS, NULL, part);
+
+	// Only the light edges, one per vertex, should be cut
+	if (graph_edge_cut(g, part) != n)
+		passed = false;
+
+	bzero(seen, sizeof(seen));
+	for (i = 0; i < n; i++)
+		seen[part[i]] = true;
+	for (c = 0; c < CLUSTERS; c++)
+		passed &= seen[c];
+
+	// Each cluster ends up in a part of its own
+	for (c = 0; c < CLUSTERS; c++) {
+		sub = graph_subgraph(g, part, part[c * CLUSTER_SIZE], sub_map);
+		passed &= (sub->n == CLUSTER_SIZE);
+		for (i = 0; i < sub->n; i++)
+			passed &= (sub_map[i] / CLUSTER_SIZE == c);
+		graph_free(sub);
+	}
+
+	graph_free(g);
+	return passed;
+}
+
+static bool test_balance(void)
+{
+	unsigned int n = 1000, nparts = 7;
+	unsigned int part[n], p;
+	unsigned long long vwgt[n], total = 0;
+	double targets[] = {1, 2, 1, 1, 3, 1, 1};
+	struct graph *g;
+	bool passed = true;
+	unsigned int v;
+
+	// Without any edge, only the weights matter
+	for (v = 0; v < n; v++) {
+		vwgt[v] = 1 + v % 5;
+		total += vwgt[v];
+	}
+
+	g = graph_build(n, 0, NULL, NULL, NULL, vwgt);
+	graph_partition(g, nparts, targets, part);
+
+	for (p = 0; p < nparts; p++) {
+		double target = total * targets[p] / 10.0;
+		double w = part_weight(g, part, p);
+
+		if (w > target * 1.05 + 5 || w < target * 0.95 - 5)
+			passed = false;
+	}
+
+	graph_free(g);
+	return passed;
+}
+
+static bool test_small(void)
+{
+	unsigned long long vwgt[] = {4, 1, 1};
+	unsigned int part[3];
+	struct graph *g;
+	bool passed = true;
+
+	g = graph_build(3, 0, NULL, NULL, NULL, vwgt);
+
+	graph_partition(g, 1, NULL, part);
+	passed &= (part[0] == 0 && part[1] == 0 && part[2] == 0);
+
+	graph_partition(g, 3, NULL, part);
+	passed &= (part[0] != part[1] && part[1] != part[2] && part[0] != part[2]);
+
+	graph_free(g);
+	return passed;
+}
+
+#define do_test(desc, function, ...) do {\
+					print(desc);	\
+					passed = function(__VA_ARGS__); \
+					if(passed) { \
+						print("passed\n"); \
+					} else { \
+						print("failed\n"); \
+						ret = 1; \
+					} \
+				} while(0)
+
+int main(void)
+{
+	bool passed = true;
+	int ret = 0;
+
+	do_test("Functional test on graph_build()... ", test_build);
+	do_test("Partitioning a clustered graph... ", test_clusters);
+	do_test("Partitioning a graph with weighted targets... ", test_balance);
+	do_test("Partitioning a graph with few vertices... ", test_small);
+
+	return ret;
+}